@@ -13,6 +13,7 @@ static uiCmdAccessState StarterAppAccess()
 int user_initialize()
   {
   uiCmdCmdId nButtonID;
+  log_init("log.txt");
   ProGenericMsg(L"EmjacParametricAutomation v1.0.0 loaded...");
   ProCmdActionAdd("StarterAppAction", (uiCmdCmdActFn) esMenu, uiProe2ndImmediate, (uiCmdAccessFn) StarterAppAccess, PRO_B_TRUE, PRO_B_TRUE, &nButtonID);
   ProMenubarmenuPushbuttonAdd("Utilities", "StarterAppAction", "EmjacParametricAutomation EmjacParametricAutomation", "EmjacParametricAutomation EmjacParametricAutomation", "Utilities.psh_util_pref", PRO_B_FALSE, nButtonID, wMsgFile);
@@ -21,4 +22,5 @@ int user_initialize()
 
 void user_terminate()
   {
+  log_shutdown();
   }
@@ -5,6 +5,7 @@
 #include "ScriptExecutor.h"	
 #include "GuiLogic.h"
 #include "semantic_analysis.h"
+#include "numfmt.h"
 
 
 
@@ -63,7 +64,7 @@ ProError track_ui_param(SymbolTable* st, const char* param_name) {
     if (!namev->data.string_value) { free(namev); return PRO_TK_GENERAL_ERROR; }
 
     size_t n = arrv->data.array.size + 1;
-    Variable** grown = (Variable**)realloc(arrv->data.array.elements, n * sizeof(*grown));
+    Variable** grown = variable_make_unique(arrv) != 0 ? NULL : (Variable**)realloc(arrv->data.array.elements, n * sizeof(*grown));
     if (!grown) { free(namev->data.string_value); free(namev); return PRO_TK_GENERAL_ERROR; }
     arrv->data.array.elements = grown;
     arrv->data.array.elements[n - 1] = namev;
@@ -179,21 +180,22 @@ ProError UserSelectMultipleCallback(char* dialog, char* component, ProAppData ap
     int n_sel = 0;
     int max_sel = -1;
     if (data->node->max_sel) {
-        Variable* msv = NULL;
-        if (evaluate_expression(data->node->max_sel, data->st, &msv) == 0 && msv) {
+        EpaValue msv;
+        if (evaluate_value(data->node->max_sel, data->st, &msv) == 0) {
             /* Coerce to int with conservative rules */
-            switch (msv->type) {
+            const char* msv_text = epa_string(&msv);
+            switch (msv.type) {
             case TYPE_INTEGER:
-                max_sel = (int)msv->data.int_value;
+                max_sel = (int)msv.data.int_value;
                 break;
             case TYPE_DOUBLE:
                 /* Truncate toward zero (consistent with C cast) */
-                max_sel = (int)msv->data.double_value;
+                max_sel = (int)msv.data.double_value;
                 break;
             case TYPE_STRING:
-                if (msv->data.string_value && msv->data.string_value[0] != '\0') {
+                if (msv_text && msv_text[0] != '\0') {
                     char* endp = NULL;
-                    long v = strtol(msv->data.string_value, &endp, 10);
+                    long v = epa_strtol(msv_text, &endp);
                     if (endp && *endp == '\0') {
                         max_sel = (int)v;
                     }
@@ -208,11 +210,10 @@ ProError UserSelectMultipleCallback(char* dialog, char* component, ProAppData ap
                 max_sel = -1;
                 break;
             default:
-                ProPrintfChar("Warning: Unsupported max_sel type %d; using unlimited", (int)msv->type);
+                ProPrintfChar("Warning: Unsupported max_sel type %d; using unlimited", (int)msv.type);
                 max_sel = -1;
                 break;
             }
-            free_variable(msv);
         }
         else {
             ProPrintfChar("Warning: Failed to evaluate max_sel; using unlimited");
@@ -310,7 +311,7 @@ ProError UserSelectMultipleCallback(char* dialog, char* component, ProAppData ap
     if (added > 0) {
         size_t old_size = arr_var->data.array.size;
         size_t new_size = old_size + (size_t)added;
-        Variable** new_elements = realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
+        Variable** new_elements = variable_make_unique(arr_var) != 0 ? NULL : realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
         if (!new_elements) {
             // Free new elems only; keep original array intact
             for (int i = 0; i < added; i++) {
@@ -363,6 +364,8 @@ ProError UserSelectMultipleCallback(char* dialog, char* component, ProAppData ap
 
 
     /* Keep your existing OK revalidation and reactive refresh */
+    touch_symbol(data->st, data->node->array);  /* selection was stored in place */
+    EPA_MarkDirty(data->st, data->node->array);
     EPA_ReactiveRefresh();
 
 
@@ -449,21 +452,22 @@ ProError UserSelectMultipleOptionalCallback(char* dialog, char* component, ProAp
     int n_sel = 0;
     int max_sel = -1;
     if (data->node->max_sel) {
-        Variable* msv = NULL;
-        if (evaluate_expression(data->node->max_sel, data->st, &msv) == 0 && msv) {
+        EpaValue msv;
+        if (evaluate_value(data->node->max_sel, data->st, &msv) == 0) {
             /* Coerce to int with conservative rules */
-            switch (msv->type) {
+            const char* msv_text = epa_string(&msv);
+            switch (msv.type) {
             case TYPE_INTEGER:
-                max_sel = (int)msv->data.int_value;
+                max_sel = (int)msv.data.int_value;
                 break;
             case TYPE_DOUBLE:
                 /* Truncate toward zero (consistent with C cast) */
-                max_sel = (int)msv->data.double_value;
+                max_sel = (int)msv.data.double_value;
                 break;
             case TYPE_STRING:
-                if (msv->data.string_value && msv->data.string_value[0] != '\0') {
+                if (msv_text && msv_text[0] != '\0') {
                     char* endp = NULL;
-                    long v = strtol(msv->data.string_value, &endp, 10);
+                    long v = epa_strtol(msv_text, &endp);
                     if (endp && *endp == '\0') {
                         max_sel = (int)v;
                     }
@@ -478,11 +482,10 @@ ProError UserSelectMultipleOptionalCallback(char* dialog, char* component, ProAp
                 max_sel = -1;
                 break;
             default:
-                ProPrintfChar("Warning: Unsupported max_sel type %d; using unlimited", (int)msv->type);
+                ProPrintfChar("Warning: Unsupported max_sel type %d; using unlimited", (int)msv.type);
                 max_sel = -1;
                 break;
             }
-            free_variable(msv);
         }
         else {
             ProPrintfChar("Warning: Failed to evaluate max_sel; using unlimited");
@@ -580,7 +583,7 @@ ProError UserSelectMultipleOptionalCallback(char* dialog, char* component, ProAp
     if (added > 0) {
         size_t old_size = arr_var->data.array.size;
         size_t new_size = old_size + (size_t)added;
-        Variable** new_elements = realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
+        Variable** new_elements = variable_make_unique(arr_var) != 0 ? NULL : realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
         if (!new_elements) {
             // Free new elems only; keep original array intact
             for (int i = 0; i < added; i++) {
@@ -632,6 +635,8 @@ ProError UserSelectMultipleOptionalCallback(char* dialog, char* component, ProAp
     }
 
     /* Keep your existing OK revalidation and reactive refresh */
+    touch_symbol(data->st, data->node->array);  /* selection was stored in place */
+    EPA_MarkDirty(data->st, data->node->array);
     EPA_ReactiveRefresh();
 
 
@@ -811,7 +816,7 @@ ProError UserSelectOptionalCallback(char* dialog, char* component, ProAppData ap
     if (added > 0) {
         size_t old_size = arr_var->data.array.size;
         size_t new_size = old_size + (size_t)added;
-        Variable** new_elements = realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
+        Variable** new_elements = variable_make_unique(arr_var) != 0 ? NULL : realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
         if (!new_elements) {
             // Free new elems only; keep original array intact
             for (int i = 0; i < added; i++) {
@@ -863,6 +868,8 @@ ProError UserSelectOptionalCallback(char* dialog, char* component, ProAppData ap
     }
 
     /* Keep your existing OK revalidation and reactive refresh */
+    touch_symbol(data->st, data->node->reference);  /* selection was stored in place */
+    EPA_MarkDirty(data->st, data->node->reference);
     EPA_ReactiveRefresh();
 
 
@@ -909,8 +916,10 @@ ProError set_checkbox_param_enabled(char* dialog, SymbolTable* st, const char* p
 
             // Sync the backing variable to 0 so logic doesn't see stale TRUE
             Variable* v = get_symbol(st, (char*)param);
-            if (v && (v->type == TYPE_INTEGER || v->type == TYPE_BOOL)) {
+            if (v && (v->type == TYPE_INTEGER || v->type == TYPE_BOOL) && v->data.int_value != 0) {
                 v->data.int_value = 0;
+                touch_symbol(st, param);  /* IF winners cached this refresh read the old value */
+                EPA_MarkDirty(st, param);
             }
         }
     }
@@ -965,7 +974,7 @@ ProError UserSelectCallback(char* dialog, char* component, ProAppData app_data)
         in_callback = PRO_B_FALSE;
         return PRO_TK_BAD_INPUTS;
     }
-    LogOnlyPrintfChar("Debug: Entering UserSelectCallback for reference '%s'", data->node->reference);
+    LOG_DEBUG("Debug: Entering UserSelectCallback for reference '%s'", data->node->reference);
 
     // Step 1: Build selection type string dynamically
     size_t num_types = data->node->type_count;
@@ -1008,7 +1017,7 @@ ProError UserSelectCallback(char* dialog, char* component, ProAppData app_data)
         }
     }
     sel_type[offset] = '\0';
-    LogOnlyPrintfChar("Debug: Constructed selection type: %s", sel_type);
+    LOG_DEBUG("Debug: Constructed selection type: %s", sel_type);
 
     // Step 2: Clear existing selections
     ProSelbufferClear();
@@ -1037,7 +1046,7 @@ ProError UserSelectCallback(char* dialog, char* component, ProAppData app_data)
     }
 
     if (status != PRO_TK_NO_ERROR || n_sel < 1) {
-        LogOnlyPrintfChar("Debug: No selection; requesting repaint for ref='%s' draw='%s'",
+        LOG_DEBUG("Debug: No selection; requesting repaint for ref='%s' draw='%s'",
             data->node->reference, data->draw_area_id);
         // Trigger repaint even on no selection to ensure consistency
         if (strlen(data->draw_area_id) > 0) {
@@ -1120,7 +1129,7 @@ ProError UserSelectCallback(char* dialog, char* component, ProAppData app_data)
     if (added > 0) {
         size_t old_size = arr_var->data.array.size;
         size_t new_size = old_size + (size_t)added;
-        Variable** new_elements = realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
+        Variable** new_elements = variable_make_unique(arr_var) != 0 ? NULL : realloc(arr_var->data.array.elements, new_size * sizeof(Variable*));
         if (!new_elements) {
             // Free new elems only; keep original array intact
             for (int i = 0; i < added; i++) {
@@ -1154,7 +1163,7 @@ ProError UserSelectCallback(char* dialog, char* component, ProAppData app_data)
     }
 
     LogOnlyPrintfChar("Completed selection storage with %d new items, total %zu.\n", added, arr_var->data.array.size);
-    LogOnlyPrintfChar("Debug: Exiting UserSelectCallback successfully");
+    LOG_DEBUG("Debug: Exiting UserSelectCallback successfully");
 
 
     // Step 10: Re-validate OK button
@@ -1172,6 +1181,8 @@ ProError UserSelectCallback(char* dialog, char* component, ProAppData app_data)
     }
 
     /* Keep your existing OK revalidation and reactive refresh */
+    touch_symbol(data->st, data->node->reference);  /* selection was stored in place */
+    EPA_MarkDirty(data->st, data->node->reference);
     EPA_ReactiveRefresh();
 
 
@@ -1190,6 +1201,8 @@ ProError unrequire_select(SymbolTable* st, const char* reference) {
         Variable* item = arr->elements[i];
         if (item && item->type == TYPE_STRING && item->data.string_value &&
             strcmp(item->data.string_value, reference) == 0) {
+            if (variable_make_unique(req) != 0) return PRO_TK_GENERAL_ERROR;
+            item = arr->elements[i];
             // Free the item and shift remaining elements
             free_variable(item);
             for (size_t j = i; j < arr->size - 1; ++j) {
@@ -1246,7 +1259,7 @@ ProError require_select(SymbolTable* st, const char* reference)
     if (!namev->data.string_value) { free(namev); return PRO_TK_GENERAL_ERROR; }
 
     size_t n = req->data.array.size + 1;
-    Variable** grown = (Variable**)realloc(req->data.array.elements, n * sizeof(*grown));
+    Variable** grown = variable_make_unique(req) != 0 ? NULL : (Variable**)realloc(req->data.array.elements, n * sizeof(*grown));
     if (!grown) { free(namev->data.string_value); free(namev); return PRO_TK_GENERAL_ERROR; }
     req->data.array.elements = grown;
     req->data.array.elements[n - 1] = namev;
@@ -1317,7 +1330,7 @@ ProError UserSelectOptionalUpdateCallback(char* dialog, char* component, ProAppD
     /* Set the foreground color */
     ProError status = ProUIDrawingareaFgcolorSet(dialog, component, target);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Set failed for '%s' status=%d\n",
+        LOG_DEBUG("Debug: Set failed for '%s' status=%d\n",
             reference, status);
         return status;
     }
@@ -1329,13 +1342,13 @@ ProError UserSelectOptionalUpdateCallback(char* dialog, char* component, ProAppD
     int da_w = 0, da_h = 0;
     status = ProUIDrawingareaDrawingwidthGet(dialog, component, &da_w);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Could not get width for '%s' (draw_id '%s'): status=%d\n",
+        LOG_DEBUG("Debug: Could not get width for '%s' (draw_id '%s'): status=%d\n",
             reference, component, status);
         return status;
     }
     status = ProUIDrawingareaDrawingheightGet(dialog, component, &da_h);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Could not get height for '%s' (draw_id '%s'): status=%d\n",
+        LOG_DEBUG("Debug: Could not get height for '%s' (draw_id '%s'): status=%d\n",
             reference, component, status);
         return status;
     }
@@ -1348,7 +1361,7 @@ ProError UserSelectOptionalUpdateCallback(char* dialog, char* component, ProAppD
     rect.height = 25; /* Adjust for precise border outline */
     status = ProUIDrawingareaRectDraw(dialog, component, &rect);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Could not draw rectangle for '%s' (draw_id '%s'): status=%d\n",
+        LOG_DEBUG("Debug: Could not draw rectangle for '%s' (draw_id '%s'): status=%d\n",
             reference, component, status);
         return status;
     }
@@ -1393,7 +1406,7 @@ ProError UserSelectUpdateCallback(char* dialog, char* component, ProAppData app_
     /* Set the foreground color */
     ProError status = ProUIDrawingareaFgcolorSet(dialog, component, target);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Set failed for '%s' status=%d\n",
+        LOG_DEBUG("Debug: Set failed for '%s' status=%d\n",
             reference, status);
         return status;
     }
@@ -1405,13 +1418,13 @@ ProError UserSelectUpdateCallback(char* dialog, char* component, ProAppData app_
     int da_w = 0, da_h = 0;
     status = ProUIDrawingareaDrawingwidthGet(dialog, component, &da_w);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Could not get width for '%s' (draw_id '%s'): status=%d\n",
+        LOG_DEBUG("Debug: Could not get width for '%s' (draw_id '%s'): status=%d\n",
             reference, component, status);
         return status;
     }
     status = ProUIDrawingareaDrawingheightGet(dialog, component, &da_h);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Could not get height for '%s' (draw_id '%s'): status=%d\n",
+        LOG_DEBUG("Debug: Could not get height for '%s' (draw_id '%s'): status=%d\n",
             reference, component, status);
         return status;
     }
@@ -1424,7 +1437,7 @@ ProError UserSelectUpdateCallback(char* dialog, char* component, ProAppData app_
     rect.height = 25; /* Adjust for precise border outline */
     status = ProUIDrawingareaRectDraw(dialog, component, &rect);
     if (status != PRO_TK_NO_ERROR) {
-        LogOnlyPrintfChar("Debug: Could not draw rectangle for '%s' (draw_id '%s'): status=%d\n",
+        LOG_DEBUG("Debug: Could not draw rectangle for '%s' (draw_id '%s'): status=%d\n",
             reference, component, status);
         return status;
     }
@@ -1771,7 +1784,7 @@ ProError require_input(SymbolTable* st, const char* param_name) {
     if (!namev->data.string_value) { free(namev); return PRO_TK_GENERAL_ERROR; }
 
     size_t n = req->data.array.size + 1;
-    Variable** grown = (Variable**)realloc(req->data.array.elements, n * sizeof(*grown));
+    Variable** grown = variable_make_unique(req) != 0 ? NULL : (Variable**)realloc(req->data.array.elements, n * sizeof(*grown));
     if (!grown) { free(namev->data.string_value); free(namev); return PRO_TK_GENERAL_ERROR; }
     req->data.array.elements = grown;
     req->data.array.elements[n - 1] = namev;
@@ -2013,7 +2026,7 @@ ProError update_show_param_label(char* dialog, const char* param_name, const Var
 
 /* Winner-aware SHOW_PARAM refresh
  * Walks only the active IF branch (or ELSE), like the sub-picture and assignment walkers.
- * Honors TARGET_IF_ID to support targeted reactive refreshes.
+ * Honors the run's target IF id to support targeted reactive refreshes.
  */
 static ProError refresh_all_show_params_impl(Block* blk, char* dialog_name, SymbolTable* st, int target_if_id, int in_winner)
 {
@@ -2033,24 +2046,13 @@ static ProError refresh_all_show_params_impl(Block* blk, char* dialog_name, Symb
                 continue;
             }
 
-            /* Pick the winning branch (same logic as in rebuild_sub_pictures_only_impl / update_assignments_only_impl) */
+            /* Winning branch (cached per refresh, shared with the other walkers) */
             size_t winner = (size_t)-1;
-            for (size_t b = 0; b < node->branch_count; ++b) {
-                IfBranch* br = node->branches[b];
-                Variable* cv = NULL;
-                if (evaluate_expression(br->condition, st, &cv) == 0 && cv) {
-                    int truth = 0;
-                    if (cv->type == TYPE_BOOL || cv->type == TYPE_INTEGER) truth = (cv->data.int_value != 0);
-                    else if (cv->type == TYPE_DOUBLE) truth = (cv->data.double_value != 0.0);
-                    free_variable(cv);
-                    if (truth) { winner = b; break; }
-                }
-            }
+            (void)if_winner(node, st, &winner);
 
-            /* Push __CURRENT_IF_ID while walking the chosen branch (mirrors other walkers) */
-            int old_cur = 0;
-            int had_old = st_get_int(st, "__CURRENT_IF_ID", &old_cur);
-            st_put_int(st, "__CURRENT_IF_ID", gate_id);
+            /* Make this IF current while walking the chosen branch (mirrors other walkers) */
+            const int old_cur = st->exec->current_if_id;
+            st->exec->current_if_id = gate_id;
 
             if (winner != (size_t)-1) {
                 IfBranch* br = node->branches[winner];
@@ -2062,9 +2064,8 @@ static ProError refresh_all_show_params_impl(Block* blk, char* dialog_name, Symb
                 (void)refresh_all_show_params_impl(&eb, dialog_name, st, target_if_id, 1 /* in_winner */);
             }
 
-            /* Pop __CURRENT_IF_ID */
-            if (had_old) st_put_int(st, "__CURRENT_IF_ID", old_cur);
-            else remove_symbol(st, "__CURRENT_IF_ID");
+            /* Restore the previous current IF */
+            st->exec->current_if_id = old_cur;
 
             /* Done with this IF node */
             continue;
@@ -2098,13 +2099,12 @@ static ProError refresh_all_show_params_impl(Block* blk, char* dialog_name, Symb
     return PRO_TK_NO_ERROR;
 }
 
-/* Public entry: read __TARGET_IF_ID (0 = full), then delegate to the winner-aware walker. */
+/* Public entry: read the run's target IF id (0 = full), then delegate to the winner-aware walker. */
 ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
 {
-    if (!blk || !dialog_name || !st) return PRO_TK_BAD_INPUTS;
+    if (!blk || !dialog_name || !st || !st->exec) return PRO_TK_BAD_INPUTS;
 
-    int target_if_id = 0;
-    (void)st_get_int(st, "__TARGET_IF_ID", &target_if_id);
+    const int target_if_id = st->exec->target_if_id;
 
     /* For full refresh, start "in_winner" = 1 so top-level SHOW_PARAMs are updated.
        For targeted refresh, start "in_winner" = 0; we only refresh inside the chosen IF branch. */
@@ -2127,7 +2127,7 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
      case TYPE_DOUBLE: {
          // Use a compact, precise format
          char buf[64];
-         snprintf(buf, sizeof(buf), "%.15g", var->data.double_value);
+         epa_format_double(var->data.double_value, buf, sizeof(buf));
          LogOnlyPrintfChar("Updated '%s' := %s", param_name, buf);
          break;
      }
@@ -2149,39 +2149,6 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
  * 
  *
  \*=================================================*/
- static Variable* clone_scalar_var(const Variable* v) {
-     if (!v) return NULL;
-     Variable* c = (Variable*)calloc(1, sizeof(Variable));
-     if (!c) return NULL;
-     c->type = v->type;
-     switch (v->type) {
-     case TYPE_INTEGER:
-     case TYPE_BOOL:
-         c->data.int_value = v->data.int_value;
-         break;
-     case TYPE_DOUBLE:
-         c->data.double_value = v->data.double_value;
-         break;
-     case TYPE_STRING:
-         c->data.string_value = v->data.string_value ? _strdup(v->data.string_value) : NULL;
-         break;
-     default:
-         /* unsupported -> treat as null */
-         c->type = TYPE_NULL;
-         break;
-     }
-     return c;
- }
-
- /* local int getter (kept file-local to avoid cross-TU deps) */
- static int st_get_int_local(SymbolTable* st, const char* key, int* out) {
-     Variable* v = get_symbol(st, (char*)key);
-     if (!v) return 0;
-     if (v->type == TYPE_INTEGER || v->type == TYPE_BOOL) { *out = v->data.int_value; return 1; }
-     if (v->type == TYPE_DOUBLE) { *out = (int)v->data.double_value; return 1; }
-     return 0;
- }
-
  /* Ensure we have ASSIGN_OVERRIDES: map var_name -> array of entries { if_id, snapshot } */
  static Variable* ensure_assign_overrides_root(SymbolTable* st) {
      Variable* root = get_symbol(st, "ASSIGN_OVERRIDES");
@@ -2207,7 +2174,7 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
  /* Make sure there is an array for this variable inside ASSIGN_OVERRIDES */
  static Variable* ensure_override_array_for(SymbolTable* st, const char* var_name) {
      Variable* root = ensure_assign_overrides_root(st);
-     if (!root) return NULL;
+     if (!root || variable_make_unique(root) != 0) return NULL;
      Variable* arr = hash_table_lookup(root->data.map, var_name);
      if (!arr || arr->type != TYPE_ARRAY) {
          if (arr) free_variable(arr);
@@ -2251,7 +2218,7 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
      idv->data.int_value = if_id;
      hash_table_insert(m, "if_id", idv);
 
-     Variable* snap = clone_scalar_var(cur);
+     Variable* snap = variable_share(cur);  /* aggregates are shared, not copied */
      if (!snap) { free_hash_table(m); return; }
      hash_table_insert(m, "snapshot", snap);
 
@@ -2261,7 +2228,7 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
      entry->data.map = m;
 
      size_t n = arr->data.array.size + 1;
-     Variable** grown = (Variable**)realloc(arr->data.array.elements, n * sizeof(Variable*));
+     Variable** grown = variable_make_unique(arr) != 0 ? NULL : (Variable**)realloc(arr->data.array.elements, n * sizeof(Variable*));
      if (!grown) { free_variable(entry); return; }
 
      arr->data.array.elements = grown;
@@ -2275,12 +2242,12 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
      Variable* root = get_symbol(st, "ASSIGN_OVERRIDES");
      if (!root || root->type != TYPE_MAP || !root->data.map) return;
 
+     if (variable_make_unique(root) != 0) return;
      HashTable* map = root->data.map;
-     for (size_t k = 0; k < map->key_count; ++k) {
-         const char* var_name = map->key_order[k];
-         if (!var_name) continue;
-         Variable* arr = hash_table_lookup(map, var_name);
-         if (!arr || arr->type != TYPE_ARRAY) continue;
+     const char* var_name;
+     Variable* arr;
+     for (size_t it = 0; hash_table_next(map, &it, &var_name, &arr); ) {
+         if (!arr || arr->type != TYPE_ARRAY || variable_make_unique(arr) != 0) continue;
 
          ArrayData* a = &arr->data.array;
          size_t w = 0;
@@ -2294,7 +2261,7 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
                      /* restore snapshot and drop this entry */
                      Variable* snap = hash_table_lookup(entry->data.map, "snapshot");
                      if (snap) {
-                         Variable* copy = clone_scalar_var(snap);
+                         Variable* copy = variable_share(snap);
                          if (copy) set_symbol(st, (char*)var_name, copy);
                      }
                      free_variable(entry);
@@ -2319,8 +2286,8 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
          return PRO_TK_NO_ERROR;  /* silently skip */
 
      /* IF-scope: capture baseline once per (var, gate) before we overwrite */
-     int cur_if = 0;
-     if (st_get_int_local(st, "__CURRENT_IF_ID", &cur_if) && cur_if > 0 && lhs_name) {
+     const int cur_if = st->exec ? st->exec->current_if_id : 0;
+     if (cur_if > 0 && lhs_name) {
          push_override_snapshot(st, lhs_name, cur_if);
      }
 
@@ -2331,7 +2298,7 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
  ProError update_assignments_only_impl(Block* blk, SymbolTable* st,
      int target_if_id, int in_winner)
  {
-     if (!blk || !st) return PRO_TK_NO_ERROR;
+     if (!blk || !st || !st->exec) return PRO_TK_NO_ERROR;
 
      for (size_t i = 0; i < blk->command_count; ++i) {
          CommandNode* cmd = blk->commands[i];
@@ -2346,24 +2313,13 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
                  continue;
              }
 
-             /* Pick the winning branch (same as in rebuild_sub_pictures_only_impl). */
+             /* Winning branch (cached per refresh, shared with the other walkers) */
              size_t winner = (size_t)-1;
-             for (size_t b = 0; b < node->branch_count; ++b) {
-                 Variable* cv = NULL;
-                 IfBranch* br = node->branches[b];
-                 if (evaluate_expression(br->condition, st, &cv) == 0 && cv) {
-                     int truth = 0;
-                     if (cv->type == TYPE_BOOL || cv->type == TYPE_INTEGER) truth = (cv->data.int_value != 0);
-                     else if (cv->type == TYPE_DOUBLE) truth = (cv->data.double_value != 0.0);
-                     free_variable(cv);
-                     if (truth) { winner = b; break; }
-                 }
-             }
+             (void)if_winner(node, st, &winner);
 
-             /* Push __CURRENT_IF_ID for the chosen branch, just like the picture walker. */
-             int old_cur = 0;
-             int had_old = st_get_int(st, "__CURRENT_IF_ID", &old_cur);
-             st_put_int(st, "__CURRENT_IF_ID", gate_id);
+             /* Make this IF current for the chosen branch, just like the picture walker. */
+             const int old_cur = st->exec->current_if_id;
+             st->exec->current_if_id = gate_id;
 
              /* NEW: revert all variables previously overridden by this IF gate */
              revert_if_contributions(st, gate_id);
@@ -2378,9 +2334,8 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
                  (void)update_assignments_only_impl(&eb, st, target_if_id, 1 /* in_winner */);
              }
 
-             /* Pop __CURRENT_IF_ID */
-             if (had_old) st_put_int(st, "__CURRENT_IF_ID", old_cur);
-             else remove_symbol(st, "__CURRENT_IF_ID");
+             /* Restore the previous current IF */
+             st->exec->current_if_id = old_cur;
 
              /* Continue scanning siblings (targeted mode will skip unrelated IFs above). */
              continue;
@@ -2403,21 +2358,16 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
  /* Public entry: update only assignments across the GUI block. */
  ProError update_assignments_only(Block* gui_block, SymbolTable* st)
  {
-     if (!gui_block) return PRO_TK_NO_ERROR;
+     if (!gui_block || !st || !st->exec) return PRO_TK_NO_ERROR;
 
-     int target_if_id = 0;
-     {
-         Variable* v = get_symbol(st, "__TARGET_IF_ID");
-         if (v && v->type == TYPE_INTEGER) target_if_id = v->data.int_value;
-     }
-     return update_assignments_only_impl(gui_block, st, target_if_id, 0);
+     return update_assignments_only_impl(gui_block, st, st->exec->target_if_id, 0);
  }
 
  /* --- prune only subpictures emitted by a specific IF gate --- */
  static void remove_sub_pictures_for_gate(SymbolTable* st, int gate_id)
  {
      Variable* arr = get_symbol(st, "SUB_PICTURES");
-     if (!arr || arr->type != TYPE_ARRAY) return;
+     if (!arr || arr->type != TYPE_ARRAY || variable_make_unique(arr) != 0) return;
 
      ArrayData* a = &arr->data.array;
      size_t w = 0;
@@ -2456,29 +2406,18 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
                  continue;
              }
 
-             /* pick the winning branch */
+             /* pick the winning branch (cached per refresh) */
              size_t winner = (size_t)-1;
-             for (size_t b = 0; b < node->branch_count; ++b) {
-                 Variable* cv = NULL;
-                 IfBranch* br = node->branches[b];
-                 if (evaluate_expression(br->condition, st, &cv) == 0 && cv) {
-                     int truth = 0;
-                     if (cv->type == TYPE_BOOL || cv->type == TYPE_INTEGER) truth = (cv->data.int_value != 0);
-                     else if (cv->type == TYPE_DOUBLE) truth = (cv->data.double_value != 0.0);
-                     free_variable(cv);
-                     if (truth) { winner = b; break; }
-                 }
-             }
+             (void)if_winner(node, st, &winner);
 
              /* targeted: prune only this IF's old pictures before re-emitting */
              if (target_if_id != 0) {
                  remove_sub_pictures_for_gate(st, gate_id);
              }
 
-             /* push __CURRENT_IF_ID while walking the chosen branch */
-             int old_cur = 0;
-             int had_old = st_get_int(st, "__CURRENT_IF_ID", &old_cur);
-             st_put_int(st, "__CURRENT_IF_ID", gate_id);
+             /* make this IF current while walking the chosen branch */
+             const int old_cur = st->exec->current_if_id;
+             st->exec->current_if_id = gate_id;
 
              if (winner != (size_t)-1) {
                  IfBranch* br = node->branches[winner];
@@ -2490,9 +2429,8 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
                  (void)rebuild_sub_pictures_only_impl(&eb, st, target_if_id, 1 /* in_winner */);
              }
 
-             /* pop __CURRENT_IF_ID */
-             if (had_old) st_put_int(st, "__CURRENT_IF_ID", old_cur);
-             else remove_symbol(st, "__CURRENT_IF_ID");
+             /* restore the previous current IF */
+             st->exec->current_if_id = old_cur;
 
              /* full rebuild: keep walking siblings; targeted: siblings are skipped by gate check above */
              continue;
@@ -2530,14 +2468,8 @@ ProError refresh_all_show_params(Block* blk, char* dialog_name, SymbolTable* st)
  /* public entry point */
  ProError rebuild_sub_pictures_only(Block* gui_block, SymbolTable* st)
  {
-     if (!gui_block) return PRO_TK_NO_ERROR;
-
-     int target_if_id = 0;
-     {
-         Variable* v = get_symbol(st, "__TARGET_IF_ID");
-         if (v && v->type == TYPE_INTEGER) target_if_id = v->data.int_value;
-     }
+     if (!gui_block || !st || !st->exec) return PRO_TK_NO_ERROR;
 
      /* start outside any winner */
-     return rebuild_sub_pictures_only_impl(gui_block, st, target_if_id, 0);
+     return rebuild_sub_pictures_only_impl(gui_block, st, st->exec->target_if_id, 0);
  }
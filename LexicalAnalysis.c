@@ -4,41 +4,200 @@
 #include "utility.h"
 #include "LexicalAnalysis.h"
 
-static void add_token(Lexer* lexer, Token type, char* val);
-static int is_keyword(const char* str);
-static int is_number(const char* str);
+static void add_token(Lexer* lexer, Token type, const char* start, size_t len);
+static void add_side_token(Lexer* lexer, Token type, size_t side_offset, size_t len);
+static void add_no_value_token(Lexer* lexer);
+static void add_word_token(Lexer* lexer, Token type, const char* start, size_t len, LexWord word);
+static int side_append(Lexer* lexer, const char* text, size_t len);
+static int is_number(const char* str, size_t len);
 static int is_operator_char(char c);
 
-static int is_option(const char* str)
+/* Offset of "NO_VALUE" in the side table (interned once by lex) */
+#define SIDE_NO_VALUE 0
+
+/* Word classes; a word may belong to more than one (NO_VALUE is keyword and type) */
+#define WORD_KEYWORD 0x1
+#define WORD_TYPE    0x2
+#define WORD_OPTION  0x4
+
+typedef struct {
+    const char* text;
+    unsigned char length;
+    unsigned char classes;
+} WordInfo;
+
+/* Indexed by LexWord (entry 0 is WORD_NONE) */
+static const WordInfo s_words[WORD_COUNT] = {
+    { "", 0, 0 },
+    { "BEGIN_GUI_DESCR", 15, WORD_KEYWORD },
+    { "END_GUI_DESCR", 13, WORD_KEYWORD },
+    { "BEGIN_TAB_DESCR", 15, WORD_KEYWORD },
+    { "END_TAB_DESCR", 13, WORD_KEYWORD },
+    { "BEGIN_TABLE", 11, WORD_KEYWORD },
+    { "END_TABLE", 9, WORD_KEYWORD },
+    { "DECLARE_VARIABLE", 16, WORD_KEYWORD },
+    { "GLOBAL_PICTURE", 14, WORD_KEYWORD },
+    { "SUB_PICTURE", 11, WORD_KEYWORD },
+    { "SHOW_PARAM", 10, WORD_KEYWORD },
+    { "USER_SELECT", 11, WORD_KEYWORD },
+    { "USER_INPUT_PARAM", 16, WORD_KEYWORD },
+    { "RADIOBUTTON_PARAM", 17, WORD_KEYWORD },
+    { "CHECKBOX_PARAM", 14, WORD_KEYWORD },
+    { "IF", 2, WORD_KEYWORD },
+    { "ELSE_IF", 7, WORD_KEYWORD },
+    { "ELSE", 4, WORD_KEYWORD },
+    { "END_IF", 6, WORD_KEYWORD },
+    { "TABLE_OPTION", 12, WORD_KEYWORD },
+    { "SEL_STRING", 10, WORD_KEYWORD },
+    { "BEGIN_ASM_DESCR", 15, WORD_KEYWORD },
+    { "END_ASM_DESCR", 13, WORD_KEYWORD },
+    { "CONFIG_ELEM", 11, WORD_KEYWORD },
+    { "NO_VALUE", 8, WORD_KEYWORD | WORD_TYPE },
+    { "BEGIN_SUBTABLE", 14, WORD_KEYWORD },
+    { "END_SUBTABLE", 12, WORD_KEYWORD },
+    { "INVALIDATE_PARAM", 16, WORD_KEYWORD },
+    { "USER_SELECT_MULTIPLE", 20, WORD_KEYWORD },
+    { "USER_SELECT_OPTIONAL", 20, WORD_KEYWORD },
+    { "USER_SELECT_MULTIPLE_OPTIONAL", 29, WORD_KEYWORD },
+    { "MEASURE_DISTANCE", 16, WORD_KEYWORD },
+    { "SEARCH_MDL_REFS", 15, WORD_KEYWORD },
+    { "SEARCH_MDL_REF", 14, WORD_KEYWORD },
+    { "BEGIN_CATCH_ERROR", 17, WORD_KEYWORD },
+    { "END_CATCH_ERROR", 15, WORD_KEYWORD },
+    { "MEASURE_LENGTH", 14, WORD_KEYWORD },
+    { "STRING", 6, WORD_TYPE },
+    { "INTEGER", 7, WORD_TYPE },
+    { "DOUBLE", 6, WORD_TYPE },
+    { "BOOL", 4, WORD_TYPE },
+    { "PLANE", 5, WORD_TYPE },
+    { "SURFACE", 7, WORD_TYPE },
+    { "POINT", 5, WORD_TYPE },
+    { "AXIS", 4, WORD_TYPE },
+    { "CURVE", 5, WORD_TYPE },
+    { "EDGE", 4, WORD_TYPE },
+    { "SUBTABLE", 8, WORD_TYPE },
+    { "SUBCOMP", 7, WORD_TYPE },
+    { "CONFIG_DELETE_IDS", 17, WORD_TYPE },
+    { "CONFIG_STATE", 12, WORD_TYPE },
+    { "NO_TABLES", 9, WORD_OPTION },
+    { "NO_GUI", 6, WORD_OPTION },
+    { "AUTO_COMMIT", 11, WORD_OPTION },
+    { "AUTO_CLOSE", 10, WORD_OPTION },
+    { "SHOW_GUI_FOR_EXISTING", 21, WORD_OPTION },
+    { "NO_AUTO_UPDATE", 14, WORD_OPTION },
+    { "CONTINUE_ON_CANCEL", 18, WORD_OPTION },
+    { "SCREEN_LOCATION", 15, WORD_OPTION },
+    { "ON_PICTURE", 10, WORD_OPTION },
+    { "TOOLTIP", 7, WORD_OPTION },
+    { "NO_AUTOSEL", 10, WORD_OPTION },
+    { "NO_FILTER", 9, WORD_OPTION },
+    { "DEPEND_ON_INPUT", 15, WORD_OPTION },
+    { "DEFAULT_FOR", 11, WORD_OPTION },
+    { "WIDTH", 5, WORD_OPTION },
+    { "DECIMAL_PLACES", 14, WORD_OPTION },
+    { "MODEL", 5, WORD_OPTION },
+    { "REQUIRED", 8, WORD_OPTION },
+    { "NO_UPDATE", 9, WORD_OPTION },
+    { "DISPLAY_ORDER", 13, WORD_OPTION },
+    { "MIN_VALUE", 9, WORD_OPTION },
+    { "MAX_VALUE", 9, WORD_OPTION },
+    { "INVALIDATE_ON_UNSELECT", 22, WORD_OPTION },
+    { "SHOW_AUTOSEL", 12, WORD_OPTION },
+    { "FILTER_RIGID", 12, WORD_OPTION },
+    { "FILTER_ONLY_COLUMN", 18, WORD_OPTION },
+    { "FILTER_COLUMN", 13, WORD_OPTION },
+    { "TABLE_HEIGHT", 12, WORD_OPTION },
+    { "ARRAY", 5, WORD_OPTION },
+    { "RECURSIVE", 9, WORD_OPTION },
+    { "ALLOW_SUPPRESSED", 16, WORD_OPTION },
+    { "ALLOW_SIMPREP_SUPPRESSED", 24, WORD_OPTION },
+    { "EXCLUDE_INHERITED", 17, WORD_OPTION },
+    { "EXCLUDE_FOOTER", 14, WORD_OPTION },
+    { "INCLUDE_MULTI_CAD", 17, WORD_OPTION },
+    { "STRUCTURE", 9, WORD_TYPE },
+};
+
+/* Perfect hash of every reserved word: FNV-1a seeded with WORD_HASH_SEED,
+   bits 8 and up index s_word_slots, which holds the LexWord or 0.
+   Generated by tools/gen_lexwords.py from s_words: after adding a word here
+   and in LexWord, run it rather than editing the table by hand. */
+#define WORD_HASH_SEED 1641u
+#define WORD_HASH_SIZE 512
+
+static const unsigned char s_word_slots[WORD_HASH_SIZE] = {
+     0,  0,  0, 17,  0,  0,  0,  0, 67, 73,  0,  0,  0,  0,  0,  0,
+     0, 55, 69,  0,  0,  0,  0,  0,  0,  0, 59,  0,  0,  0,  0,  0,
+     0,  0,  0, 38,  0,  0,  0,  0, 53,  0,  0,  0,  0, 72,  0,  0,
+     0,  0,  0,  0,  0, 63, 65,  0,  0, 52,  0,  0,  8,  0, 40, 62,
+     0,  0,  0,  0,  0,  0,  0,  0, 26,  0,  0, 14,  0,  0,  0,  0,
+     0,  0,  0, 30,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     3,  0, 16,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0, 54,  0,  0,  0,  0, 31,  0,
+     0,  0,  0, 42,  0,  0,  0,  0, 43,  0,  0,  0,  0,  0, 13,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 34, 28,  0,  0,
+     0,  0,  0, 45,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 24,
+    77,  0,  0,  0,  0, 10,  0,  0, 19, 81, 82,  0,  0,  0,  0,  0,
+    57,  0,  0,  0,  0,  0,  0, 27,  0,  0,  0, 44,  0,  0,  0,  0,
+     0,  0,  0,  0, 85,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0, 80,  0,  0,  0,  0,  0, 74,  0,
+    84,  0,  0,  0,  0,  0,  1,  0, 48,  0, 23,  2,  0, 33,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    32,  0,  0,  0,  0,  0, 29,  0,  0, 49,  0, 86,  0,  0,  0,  0,
+     0,  0,  0, 46,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 83,
+     0, 56,  0,  0,  0,  0,  0, 36,  0,  0,  0,  0,  0,  0, 21,  0,
+     0,  0,  0,  0,  0,  0, 25,  0, 50,  0,  0,  0,  0,  0,  0,  0,
+     0, 79,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  7,  0,  0, 15,  0,  0,  0,  0, 18, 76, 70,  6,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    58,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 47,  0,  0,
+     0,  0,  0,  0,  0,  0,  0, 20, 64,  0,  0,  0,  0, 78,  0,  0,
+    11,  0,  0,  0,  0, 51,  0, 66,  0, 22,  0, 75,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0, 37,  0,  0,  0,  0, 71, 41, 68, 35,  0,
+     0,  4,  0,  0,  0,  0,  0,  0,  0,  0, 61,  0,  0,  0,  0,  0,
+    39,  0,  0,  0,  0,  0,  0, 60,  0, 12,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  5,  0,  9,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+/* Reserved word spelled by the len bytes at str, or WORD_NONE (one probe) */
+LexWord lex_word(const char* str, size_t len)
 {
-    static const char* all_options[] = {
-        "NO_TABLES", "NO_GUI", "AUTO_COMMIT", "AUTO_CLOSE", "SHOW_GUI_FOR_EXISTING",
-        "NO_AUTO_UPDATE", "CONTINUE_ON_CANCEL", "SCREEN_LOCATION",
-        "ON_PICTURE", "TOOLTIP",
-        "NO_AUTOSEL", "NO_FILTER", "DEPEND_ON_INPUT", "DEFAULT_FOR", "WIDTH",
-        "DECIMAL_PLACES", "MODEL", "REQUIRED", "NO_UPDATE", "DISPLAY_ORDER",
-        "MIN_VALUE", "MAX_VALUE", "NO_AUTOSEL", "NO_FILTER", "DEPEND_ON_INPUT",
-        "INVALIDATE_ON_UNSELECT", "SHOW_AUTOSEL", "FILTER_RIGID", "FILTER_ONLY_COLUMN",
-        "FILTER_COLUMN", "TABLE_HEIGHT", "ARRAY", "RECURSIVE", "ALLOW_SUPPRESSED", "ALLOW_SIMPREP_SUPPRESSED",
-        "EXCLUDE_INHERITED", "EXCLUDE_FOOTER", "NO_UPDATE", "INCLUDE_MULTI_CAD"
-    };
-    size_t num_options = sizeof(all_options) / sizeof(all_options[0]);
-    for (size_t i = 0; i < num_options; i++) {
-        if (strcmp(str, all_options[i]) == 0) return 1;
+    uint32_t h = WORD_HASH_SEED;
+    for (size_t k = 0; k < len; k++) {
+        h = (h ^ (unsigned char)str[k]) * 16777619u;
     }
-    return 0;
+    unsigned char id = s_word_slots[(h >> 8) & (WORD_HASH_SIZE - 1)];
+    if (id != WORD_NONE && s_words[id].length == len && memcmp(s_words[id].text, str, len) == 0) {
+        return (LexWord)id;
+    }
+    return WORD_NONE;
 }
 
-static int is_type_specifier(const char* str) {
-    static const char* type_specs[] = {
-        "STRING", "INTEGER", "DOUBLE", "BOOL", "PLANE", "SURFACE", "POINT", "AXIS", "CURVE", "EDGE",
-        "SUBTABLE", "SUBCOMP", "CONFIG_DELETE_IDS", "CONFIG_STATE", "NO_VALUE"
-    };
-    size_t num_type_specs = sizeof(type_specs) / sizeof(type_specs[0]);
-    for (size_t i = 0; i < num_type_specs; i++) {
-        if (strcmp(str, type_specs[i]) == 0) return 1;
+#ifdef _DEBUG
+/* Every word must hash to its own slot; a miss means the table is stale */
+static void check_word_table(void)
+{
+    static int checked = 0;
+    if (checked) return;
+    checked = 1;
+    for (int i = 1; i < WORD_COUNT; i++) {
+        if (lex_word(s_words[i].text, s_words[i].length) != (LexWord)i ||
+            s_words[i].length != strlen(s_words[i].text)) {
+            ProPrintfChar("Error: Reserved word '%s' is not in the lexer hash table; run tools/gen_lexwords.py\n",
+                s_words[i].text);
+        }
     }
-    return 0;
+}
+#endif
+
+const char* lex_word_text(LexWord word)
+{
+    return (word > WORD_NONE && word < WORD_COUNT) ? s_words[word].text : "";
+}
+
+static unsigned char word_classes(LexWord word)
+{
+    return s_words[word].classes;
 }
 
 static int prev_allows_unary_minus(Token t) {
@@ -67,32 +226,59 @@ static int prev_allows_unary_minus(Token t) {
 }
 
 
+// Prepare a lexer over text[0..length); text[length] must be '\0'.
+// The text is only read and must outlive the tokens.
+void lexer_init(Lexer* lexer, const char* text, size_t length) {
+    memset(lexer, 0, sizeof(*lexer));
+    lexer->start_tok = text;
+    lexer->cur_tok = text;
+    lexer->line_start = text;
+    lexer->line_number = 1;
+    lexer->source = text;
+    lexer->source_length = length;
+}
+
 int lex(Lexer* lexer) {
+#ifdef _DEBUG
+    check_word_table();
+#endif
     lexer->in_table = 0;
     lexer->pending_table_start = 0;
     lexer->last_token = tok_newline;
 
+    /* Tokens are slices of the source; offsets are 32-bit */
+    if (!lexer->source) {
+        lexer->source = lexer->cur_tok;
+        lexer->source_length = strlen(lexer->cur_tok);
+    }
+    if (lexer->source_length >= UINT32_MAX / 2) {
+        ProPrintfChar("Error: Source of %zu bytes is too large to tokenize\n", lexer->source_length);
+        return 1;
+    }
+    lexer->strings_length = 0;
+    if (side_append(lexer, "NO_VALUE", sizeof("NO_VALUE")) != 0) return 1;
+
     while (*lexer->cur_tok != '\0') {
         /* Whitespace (but keep '\t' when in_table) */
         while (*lexer->cur_tok != '\0' && isspace(*lexer->cur_tok)) {
             /* In tables, tabs are cell separators; do NOT consume here. */
             if (lexer->in_table && *lexer->cur_tok == '\t') break;
 
-            /* Normalize CRLF -> one newline event. */
+            /* CRLF is one newline event: step over the CR and let the LF end the line.
+               The source is never written (it may be a read-only file mapping). */
             if (*lexer->cur_tok == '\r' && *(lexer->cur_tok + 1) == '\n') {
-                *lexer->cur_tok = '\n';            /* collapse CRLF to LF */
-                *(lexer->cur_tok + 1) = '\n';      /* harmless overwrite */
+                lexer->cur_tok++;
             }
 
             if (*lexer->cur_tok == '\n') {
                 /* Handle trailing tabs at EOL in tables. */
                 if (lexer->in_table && lexer->cur_tok > lexer->line_start) {
                     size_t tabs = 0;
-                    char* q = lexer->cur_tok - 1;
+                    const char* q = lexer->cur_tok - 1;
+                    if (q >= lexer->line_start && *q == '\r') q--;
                     while (q >= lexer->line_start && *q == '\t') { tabs++; q--; }
                     for (size_t k = 1; k < tabs; ++k) {
-                        char* nov = _strdup("NO_VALUE");
-                        add_token(lexer, tok_keyword, nov);
+                        add_no_value_token(lexer);
                     }
                 }
 
@@ -100,14 +286,7 @@ int lex(Lexer* lexer) {
                 if (lexer->in_table && !lexer->pending_table_start) {
                     /* Avoid emitting duplicate rowbreaks. */
                     if (lexer->last_token != tok_newline) {
-                        char* rb = (char*)malloc(2);
-                        if (!rb) {
-                            ProPrintfChar("%zu:%zu: Memory allocation failed for row break token\n",
-                                lexer->line_number, (size_t)(lexer->cur_tok - lexer->line_start));
-                            return 1;
-                        }
-                        rb[0] = '\n'; rb[1] = '\0';
-                        add_token(lexer, tok_newline, rb);
+                        add_token(lexer, tok_newline, lexer->cur_tok, 1);
                     }
                 }
 
@@ -134,24 +313,23 @@ int lex(Lexer* lexer) {
             continue;
         }
 
-        /* Strings */
+        /* Strings: a literal without escapes is a plain slice of the source;
+           the first backslash moves it into the side table for decoding. */
         if (*lexer->cur_tok == '"') {
             lexer->cur_tok++;
-            char* str_start = lexer->cur_tok;
-            char* buffer = (char*)malloc(16);
-            if (!buffer) {
-                printf("%zu:%zu: Memory allocation failed for string buffer\n",
-                    lexer->line_number, (size_t)(str_start - lexer->line_start));
-                return 1;
-            }
-            size_t buf_len = 0;
-            size_t buf_cap = 16;
+            const char* str_start = lexer->cur_tok;
+            size_t side_start = 0;
+            int escaped = 0;
 
             while (*lexer->cur_tok != '\0' && *lexer->cur_tok != '\n') {
                 if (*lexer->cur_tok == '\\') {
+                    if (!escaped) {
+                        escaped = 1;
+                        side_start = lexer->strings_length;
+                        if (side_append(lexer, str_start, (size_t)(lexer->cur_tok - str_start)) != 0) return 1;
+                    }
                     lexer->cur_tok++;
                     if (*lexer->cur_tok == '\0' || *lexer->cur_tok == '\n') {
-                        free(buffer);
                         printf("%zu:%zu: Error: Unterminated string (incomplete escape)\n",
                             lexer->line_number, (size_t)(str_start - lexer->line_start));
                         return 1;
@@ -173,59 +351,31 @@ int lex(Lexer* lexer) {
                     default:
                         printf("%zu:%zu: Warning: Unknown escape sequence '\\%c' in string\n",
                             lexer->line_number, (size_t)(lexer->cur_tok - lexer->line_start), esc);
-                        if (buf_len + 1 >= buf_cap) {
-                            buf_cap *= 2;
-                            char* newb = (char*)realloc(buffer, buf_cap);
-                            if (!newb) {
-                                free(buffer);
-                                printf("%zu:%zu: Memory reallocation failed for string buffer\n",
-                                    lexer->line_number, (size_t)(str_start - lexer->line_start));
-                                return 1;
-                            }
-                            buffer = newb;
-                        }
-                        buffer[buf_len++] = '\\';
+                        if (side_append(lexer, "\\", 1) != 0) return 1;
                         actual = esc;
                     }
-                    if (buf_len + 1 >= buf_cap) {
-                        buf_cap *= 2;
-                        char* newb = (char*)realloc(buffer, buf_cap);
-                        if (!newb) {
-                            free(buffer);
-                            printf("%zu:%zu: Memory reallocation failed for string buffer\n",
-                                lexer->line_number, (size_t)(str_start - lexer->line_start));
-                            return 1;
-                        }
-                        buffer = newb;
-                    }
-                    buffer[buf_len++] = actual;
+                    if (side_append(lexer, &actual, 1) != 0) return 1;
                     lexer->cur_tok++;
                     continue;
                 }
                 if (*lexer->cur_tok == '"') break;
-                if (buf_len + 1 >= buf_cap) {
-                    buf_cap *= 2;
-                    char* newb = (char*)realloc(buffer, buf_cap);
-                    if (!newb) {
-                        free(buffer);
-                        printf("%zu:%zu: Memory reallocation failed for string buffer\n",
-                            lexer->line_number, (size_t)(str_start - lexer->line_start));
-                        return 1;
-                    }
-                    buffer = newb;
-                }
-                buffer[buf_len++] = *lexer->cur_tok;
+                if (escaped && side_append(lexer, lexer->cur_tok, 1) != 0) return 1;
                 lexer->cur_tok++;
             }
 
             if (*lexer->cur_tok != '"') {
-                free(buffer);
                 printf("%zu:%zu: Error: Unterminated string\n",
                     lexer->line_number, (size_t)(str_start - lexer->line_start));
                 return 1;
             }
-            buffer[buf_len] = '\0';
-            add_token(lexer, tok_string, buffer);
+            if (escaped) {
+                size_t len = lexer->strings_length - side_start;
+                if (side_append(lexer, "", 1) != 0) return 1;
+                add_side_token(lexer, tok_string, side_start, len);
+            }
+            else {
+                add_token(lexer, tok_string, str_start, (size_t)(lexer->cur_tok - str_start));
+            }
             lexer->cur_tok++;
             continue;
         }
@@ -236,18 +386,10 @@ int lex(Lexer* lexer) {
             if ((lexer->cur_tok == lexer->line_start || lexer->last_token == tok_newline) &&
                 strncmp(lexer->cur_tok, "TABLE_OPTION", 12) == 0 &&
                 (lexer->cur_tok[12] == '\0' || isspace((unsigned char)lexer->cur_tok[12]))) {
-                char* p = lexer->cur_tok;
+                const char* p = lexer->cur_tok;
 
                 /* Emit TABLE_OPTION as keyword. */
-                char* kw = (char*)malloc(13);
-                if (!kw) {
-                    ProPrintfChar("%zu:%zu: Memory allocation failed for TABLE_OPTION\n",
-                        lexer->line_number, (size_t)(p - lexer->line_start));
-                    return 1;
-                }
-                memcpy(kw, "TABLE_OPTION", 12);
-                kw[12] = '\0';
-                add_token(lexer, tok_keyword, kw);
+                add_word_token(lexer, tok_keyword, p, 12, WORD_TABLE_OPTION);
                 p += 12;
 
                 /* Tokenize rest of the line by spaces/tabs until EOL or comment '!'. */
@@ -259,23 +401,17 @@ int lex(Lexer* lexer) {
                     }
                     if (*p == '\n' || *p == '\0') break;
 
-                    char* start = p;
+                    const char* start = p;
                     while (*p != '\0' && *p != '\n' && *p != ' ' && *p != '\t' && *p != '\r') p++;
                     size_t len = (size_t)(p - start);
-                    char* word = (char*)malloc(len + 1);
-                    if (!word) {
-                        ProPrintfChar("%zu:%zu: Memory allocation failed for table option\n",
-                            lexer->line_number, (size_t)(start - lexer->line_start));
-                        return 1;
-                    }
-                    memcpy(word, start, len);
-                    word[len] = '\0';
-
-                    if (is_option(word)) { add_token(lexer, tok_option, word); }
-                    else if (is_type_specifier(word)) { add_token(lexer, tok_type, word); }
-                    else if (is_number(word)) { add_token(lexer, tok_number, word); }
-                    else if (is_keyword(word)) { add_token(lexer, tok_keyword, word); }
-                    else { add_token(lexer, tok_identifier, word); } /* identifier for options/others */
+                    LexWord word = lex_word(start, len);
+                    unsigned char classes = word_classes(word);
+
+                    if (classes & WORD_OPTION) { add_word_token(lexer, tok_option, start, len, word); }
+                    else if (classes & WORD_TYPE) { add_word_token(lexer, tok_type, start, len, word); }
+                    else if (is_number(start, len)) { add_token(lexer, tok_number, start, len); }
+                    else if (classes & WORD_KEYWORD) { add_word_token(lexer, tok_keyword, start, len, word); }
+                    else { add_token(lexer, tok_identifier, start, len); } /* identifier for options/others */
                 }
 
                 lexer->cur_tok = p;
@@ -284,15 +420,14 @@ int lex(Lexer* lexer) {
 
             /* Leading tabs inside a table row represent leading empty cells. */
             if (*lexer->cur_tok == '\t') {
-                char* nov = _strdup("NO_VALUE");
-                add_token(lexer, tok_keyword, nov);
+                add_no_value_token(lexer);
                 lexer->cur_tok++;
                 continue;
             }
 
             /* Grab the entire cell up to '\t', '\n', or '!' (spaces/punct are data). */
             {
-                char* cell_start = lexer->cur_tok;
+                const char* cell_start = lexer->cur_tok;
                 while (*lexer->cur_tok != '\0'
                     && *lexer->cur_tok != '\t'
                     && *lexer->cur_tok != '\n'
@@ -309,18 +444,9 @@ int lex(Lexer* lexer) {
 
                 /* Empty cell mid-line: treat as NO_VALUE. */
                 if (cell_len == 0) {
-                    char* nov = _strdup("NO_VALUE");
-                    add_token(lexer, tok_keyword, nov);
+                    add_no_value_token(lexer);
                 }
                 else {
-                    char* cell = (char*)malloc(cell_len + 1);
-                    if (!cell) {
-                        ProPrintfChar("%zu:%zu: Memory allocation failed for table cell\n",
-                            lexer->line_number, (size_t)(cell_start - lexer->line_start));
-                        return 1;
-                    }
-                    memcpy(cell, cell_start, cell_len);
-                    cell[cell_len] = '\0';
 
                     /* Context flags for classification refinements */
                     int at_line_start_cell = (cell_start == lexer->line_start);
@@ -335,33 +461,35 @@ int lex(Lexer* lexer) {
                     }
 
                     /* Classify the cell. */
-                    if (is_keyword(cell)) {
-                        add_token(lexer, tok_keyword, cell);
-                        if (strcmp(cell, "BEGIN_TABLE") == 0 || strcmp(cell, "BEGIN_SUBTABLE") == 0) {
+                    LexWord word = lex_word(cell_start, cell_len);
+                    unsigned char classes = word_classes(word);
+                    if (classes & WORD_KEYWORD) {
+                        add_word_token(lexer, tok_keyword, cell_start, cell_len, word);
+                        if (word == WORD_BEGIN_TABLE || word == WORD_BEGIN_SUBTABLE) {
                             lexer->pending_table_start = 1;
                         }
-                        else if (strcmp(cell, "END_TABLE") == 0 || strcmp(cell, "END_SUBTABLE") == 0) {
+                        else if (word == WORD_END_TABLE || word == WORD_END_SUBTABLE) {
                             lexer->in_table = 0;
                             lexer->pending_table_start = 0;
                         }
                     }
-                    else if (is_type_specifier(cell)) {
-                        add_token(lexer, tok_type, cell);
+                    else if (classes & WORD_TYPE) {
+                        add_word_token(lexer, tok_type, cell_start, cell_len, word);
                     }
-                    else if (is_option(cell)) {
-                        add_token(lexer, tok_option, cell);
+                    else if (classes & WORD_OPTION) {
+                        add_word_token(lexer, tok_option, cell_start, cell_len, word);
                     }
-                    else if (is_number(cell)) {
-                        add_token(lexer, tok_number, cell);
+                    else if (is_number(cell_start, cell_len)) {
+                        add_token(lexer, tok_number, cell_start, cell_len);
                     }
                     else if (sel_line && !at_line_start_cell) {
-                        add_token(lexer, tok_identifier, cell); /* headers after SEL_STRING */
+                        add_token(lexer, tok_identifier, cell_start, cell_len); /* headers after SEL_STRING */
                     }
                     else if (at_line_start_cell) {
-                        add_token(lexer, tok_identifier, cell); /* row label */
+                        add_token(lexer, tok_identifier, cell_start, cell_len); /* row label */
                     }
                     else {
-                        add_token(lexer, tok_string, cell);     /* default for data */
+                        add_token(lexer, tok_string, cell_start, cell_len);     /* default for data */
                     }
                 }
 
@@ -376,8 +504,7 @@ int lex(Lexer* lexer) {
                 if (*lexer->cur_tok == '\t') {
                     lexer->cur_tok++; /* separator tab */
                     while (*lexer->cur_tok == '\t') {
-                        char* nov = _strdup("NO_VALUE");
-                        add_token(lexer, tok_keyword, nov);
+                        add_no_value_token(lexer);
                         lexer->cur_tok++;
                     }
                 }
@@ -388,26 +515,26 @@ int lex(Lexer* lexer) {
 
         /* Logical words */
         if (strncmp(lexer->cur_tok, "AND", 3) == 0 && !isalnum(lexer->cur_tok[3])) {
-            add_token(lexer, tok_and, "AND");
+            add_token(lexer, tok_and, lexer->cur_tok, 3);
             lexer->cur_tok += 3;
             continue;
         }
         else if (strncmp(lexer->cur_tok, "OR", 2) == 0 && !isalnum(lexer->cur_tok[2])) {
-            add_token(lexer, tok_or, "OR");
+            add_token(lexer, tok_or, lexer->cur_tok, 2);
             lexer->cur_tok += 2;
             continue;
         }
 
         /* Minus: always tokenize as an operator */
         if (*lexer->cur_tok == '-') {
-            add_token(lexer, tok_minus, "-");
+            add_token(lexer, tok_minus, lexer->cur_tok, 1);
             lexer->cur_tok++;
             continue;
         }
 
         /* Identifiers (and filenames): allow '-' only if followed by alpha/_; allow '.' for extensions */
         if (isalpha(*lexer->cur_tok) || *lexer->cur_tok == '_') {
-            char* str_start = lexer->cur_tok;
+            const char* str_start = lexer->cur_tok;
             lexer->cur_tok++;
             for (;;) {
                 char c = *lexer->cur_tok;
@@ -425,36 +552,29 @@ int lex(Lexer* lexer) {
             }
             size_t str_len = (size_t)(lexer->cur_tok - str_start);
             if (str_len > 0) {
-                char* token_str = (char*)malloc(str_len + 1);
-                if (!token_str) {
-                    ProPrintfChar("%zu:%zu: Memory allocation failed for token\n",
-                        lexer->line_number, (size_t)(str_start - lexer->line_start));
-                    return 1;
-                }
-                memcpy(token_str, str_start, str_len);
-                token_str[str_len] = '\0';
-
-                if (is_keyword(token_str)) {
-                    add_token(lexer, tok_keyword, token_str);
-                    if (strcmp(token_str, "BEGIN_TABLE") == 0 || strcmp(token_str, "BEGIN_SUBTABLE") == 0) {
+                LexWord word = lex_word(str_start, str_len);
+                unsigned char classes = word_classes(word);
+                if (classes & WORD_KEYWORD) {
+                    add_word_token(lexer, tok_keyword, str_start, str_len, word);
+                    if (word == WORD_BEGIN_TABLE || word == WORD_BEGIN_SUBTABLE) {
                         lexer->pending_table_start = 1;
                     }
-                    else if (strcmp(token_str, "END_TABLE") == 0 || strcmp(token_str, "END_SUBTABLE") == 0) {
+                    else if (word == WORD_END_TABLE || word == WORD_END_SUBTABLE) {
                         lexer->in_table = 0;
                         lexer->pending_table_start = 0;
                     }
                 }
-                else if (is_type_specifier(token_str)) {
-                    add_token(lexer, tok_type, token_str);
+                else if (classes & WORD_TYPE) {
+                    add_word_token(lexer, tok_type, str_start, str_len, word);
                 }
-                else if (is_option(token_str)) {
-                    add_token(lexer, tok_option, token_str);
+                else if (classes & WORD_OPTION) {
+                    add_word_token(lexer, tok_option, str_start, str_len, word);
                 }
-                else if (is_number(token_str)) {
-                    add_token(lexer, tok_number, token_str);
+                else if (is_number(str_start, str_len)) {
+                    add_token(lexer, tok_number, str_start, str_len);
                 }
                 else {
-                    add_token(lexer, tok_identifier, token_str);
+                    add_token(lexer, tok_identifier, str_start, str_len);
                 }
             }
             continue;
@@ -462,107 +582,98 @@ int lex(Lexer* lexer) {
 
         /* Unsigned numbers (no leading sign; sign is an operator) */
         if (isdigit(*lexer->cur_tok) || (*lexer->cur_tok == '.' && isdigit(*(lexer->cur_tok + 1)))) {
-            char* str_start = lexer->cur_tok;
+            const char* str_start = lexer->cur_tok;
             while (isdigit(*lexer->cur_tok) || *lexer->cur_tok == '.') {
                 lexer->cur_tok++;
             }
-            size_t str_len = (size_t)(lexer->cur_tok - str_start);
-            char* num_str = (char*)malloc(str_len + 1);
-            if (!num_str) {
-                ProPrintfChar("%zu:%zu: Memory allocation failed for number\n",
-                    lexer->line_number, (size_t)(str_start - lexer->line_start));
-                return 1;
-            }
-            memcpy(num_str, str_start, str_len);
-            num_str[str_len] = '\0';
-            add_token(lexer, tok_number, num_str);
+            add_token(lexer, tok_number, str_start, (size_t)(lexer->cur_tok - str_start));
             continue;
         }
 
         /* Operators and punctuation */
         if (!lexer->in_table && (is_operator_char(*lexer->cur_tok) || *lexer->cur_tok == '(' || *lexer->cur_tok == ')' || *lexer->cur_tok == ',')) {
             if (*lexer->cur_tok == '=' && *(lexer->cur_tok + 1) == '=') {
-                add_token(lexer, tok_eq, "==");
+                add_token(lexer, tok_eq, lexer->cur_tok, 2);
                 lexer->cur_tok += 2;
             }
             else if (*lexer->cur_tok == '<' && *(lexer->cur_tok + 1) == '>') {
-                add_token(lexer, tok_ne, "<>");
+                add_token(lexer, tok_ne, lexer->cur_tok, 2);
                 lexer->cur_tok += 2;
             }
             else if (*lexer->cur_tok == '<' && *(lexer->cur_tok + 1) == '=') {
-                add_token(lexer, tok_le, "<=");
+                add_token(lexer, tok_le, lexer->cur_tok, 2);
                 lexer->cur_tok += 2;
             }
             else if (*lexer->cur_tok == '>' && *(lexer->cur_tok + 1) == '=') {
-                add_token(lexer, tok_ge, ">=");
+                add_token(lexer, tok_ge, lexer->cur_tok, 2);
                 lexer->cur_tok += 2;
             }
             else if (*lexer->cur_tok == '<') {
-                add_token(lexer, tok_lt, "<");
+                add_token(lexer, tok_lt, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '>') {
-                add_token(lexer, tok_gt, ">");
+                add_token(lexer, tok_gt, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '=') {
-                add_token(lexer, tok_equal, "=");
+                add_token(lexer, tok_equal, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '+') {
-                add_token(lexer, tok_plus, "+");
+                add_token(lexer, tok_plus, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '*') {
-                add_token(lexer, tok_star, "*");
+                add_token(lexer, tok_star, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '/') {
-                add_token(lexer, tok_slash, "/");
+                add_token(lexer, tok_slash, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '\\') {
-                add_token(lexer, tok_backslash, "\\");
+                add_token(lexer, tok_backslash, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '|') {
-                add_token(lexer, tok_bar, "|");
+                add_token(lexer, tok_bar, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '&') {
-                add_token(lexer, tok_ampersand, "&");
+                add_token(lexer, tok_ampersand, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '(') {
-                add_token(lexer, tok_lparen, "(");
+                add_token(lexer, tok_lparen, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == ')') {
-                add_token(lexer, tok_rparen, ")");
+                add_token(lexer, tok_rparen, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == ',') {
-                add_token(lexer, tok_comma, ",");
+                add_token(lexer, tok_comma, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '{') {
-                add_token(lexer, tok_lbrace, "{");
+                add_token(lexer, tok_lbrace, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '}') {
-                add_token(lexer, tok_rbrace, "}");
+                add_token(lexer, tok_rbrace, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == '[') {
-                add_token(lexer, tok_lbracket, "[");
+                add_token(lexer, tok_lbracket, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == ']') {
-                add_token(lexer, tok_rbracket, "]");
+                add_token(lexer, tok_rbracket, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             else if (*lexer->cur_tok == ':') {
-                add_token(lexer, tok_colon, ":");
+                add_token(lexer, tok_colon, lexer->cur_tok, 1);
                 lexer->cur_tok++;
             }
             continue;
@@ -570,7 +681,7 @@ int lex(Lexer* lexer) {
 
         /* Fallback tokenization (non-table bare words) */
         {
-            char* str_start = lexer->cur_tok;
+            const char* str_start = lexer->cur_tok;
             while (*lexer->cur_tok != '\0'
                 && !isspace(*lexer->cur_tok)
                 && *lexer->cur_tok != '\t'
@@ -581,36 +692,29 @@ int lex(Lexer* lexer) {
             }
             size_t str_len = (size_t)(lexer->cur_tok - str_start);
             if (str_len > 0) {
-                char* token_str = (char*)malloc(str_len + 1);
-                if (!token_str) {
-                    ProPrintfChar("%zu:%zu: Memory allocation failed for token\n",
-                        lexer->line_number, (size_t)(str_start - lexer->line_start));
-                    return 1;
-                }
-                memcpy(token_str, str_start, str_len);
-                token_str[str_len] = '\0';
-
-                if (is_keyword(token_str)) {
-                    add_token(lexer, tok_keyword, token_str);
-                    if (strcmp(token_str, "BEGIN_TABLE") == 0 || strcmp(token_str, "BEGIN_SUBTABLE") == 0) {
+                LexWord word = lex_word(str_start, str_len);
+                unsigned char classes = word_classes(word);
+                if (classes & WORD_KEYWORD) {
+                    add_word_token(lexer, tok_keyword, str_start, str_len, word);
+                    if (word == WORD_BEGIN_TABLE || word == WORD_BEGIN_SUBTABLE) {
                         lexer->pending_table_start = 1;
                     }
-                    else if (strcmp(token_str, "END_TABLE") == 0 || strcmp(token_str, "END_SUBTABLE") == 0) {
+                    else if (word == WORD_END_TABLE || word == WORD_END_SUBTABLE) {
                         lexer->in_table = 0;
                         lexer->pending_table_start = 0;
                     }
                 }
-                else if (is_type_specifier(token_str)) {
-                    add_token(lexer, tok_type, token_str);
+                else if (classes & WORD_TYPE) {
+                    add_word_token(lexer, tok_type, str_start, str_len, word);
                 }
-                else if (is_option(token_str)) {
-                    add_token(lexer, tok_option, token_str);
+                else if (classes & WORD_OPTION) {
+                    add_word_token(lexer, tok_option, str_start, str_len, word);
                 }
-                else if (is_number(token_str)) {
-                    add_token(lexer, tok_number, token_str);
+                else if (is_number(str_start, str_len)) {
+                    add_token(lexer, tok_number, str_start, str_len);
                 }
                 else {
-                    add_token(lexer, tok_identifier, token_str);
+                    add_token(lexer, tok_identifier, str_start, str_len);
                 }
             }
             /* Note: we intentionally do NOT advance past '!' here.
@@ -619,12 +723,12 @@ int lex(Lexer* lexer) {
         }
     }
 
-    add_token(lexer, tok_eof, NULL);
+    add_token(lexer, tok_eof, lexer->cur_tok, 0);
     LogOnlyPrintfChar("Reached EOF at line %zu\n", lexer->line_number);
     return 0;
 }
 
-static void add_token(Lexer* lexer, Token type, char* val) {
+static TokenData* push_token(Lexer* lexer, Token type) {
     if (lexer->token_count >= lexer->capacity) {
         size_t new_capacity = lexer->capacity == 0 ? 8 : lexer->capacity * 2;
         TokenData* new_tokens = realloc(lexer->tokens, new_capacity * sizeof(TokenData));
@@ -637,45 +741,73 @@ static void add_token(Lexer* lexer, Token type, char* val) {
         lexer->capacity = new_capacity;
     }
 
-    lexer->tokens[lexer->token_count].type = type;
-    lexer->tokens[lexer->token_count].val = val;
-    lexer->tokens[lexer->token_count].loc.line = lexer->line_number;
-    lexer->tokens[lexer->token_count].loc.col = (size_t)(lexer->cur_tok - lexer->line_start);
-    lexer->token_count++;
+    TokenData* tok = &lexer->tokens[lexer->token_count++];
+    tok->type = (uint16_t)type;
+    tok->word = WORD_NONE;
+    tok->line = (uint32_t)lexer->line_number;
+    return tok;
+}
+
+// Token whose text is the len bytes at start in the source buffer
+static void add_token(Lexer* lexer, Token type, const char* start, size_t len) {
+    TokenData* tok = push_token(lexer, type);
+    tok->offset = (uint32_t)(start - lexer->source);
+    tok->length = (uint32_t)len;
+}
+
+// Token whose text lives in the side table (decoded literals, NO_VALUE).
+// Side offsets follow the source and its terminating NUL.
+static void add_side_token(Lexer* lexer, Token type, size_t side_offset, size_t len) {
+    TokenData* tok = push_token(lexer, type);
+    tok->offset = (uint32_t)(lexer->source_length + 1 + side_offset);
+    tok->length = (uint32_t)len;
+}
+
+// Token for a reserved word (word != WORD_NONE)
+static void add_word_token(Lexer* lexer, Token type, const char* start, size_t len, LexWord word) {
+    add_token(lexer, type, start, len);
+    lexer->tokens[lexer->token_count - 1].word = (uint16_t)word;
+}
+
+// Empty table cell
+static void add_no_value_token(Lexer* lexer) {
+    add_side_token(lexer, tok_keyword, SIDE_NO_VALUE, 8);
+    lexer->tokens[lexer->token_count - 1].word = WORD_NO_VALUE;
 }
 
-static int is_keyword(const char* str) {
-    static const char* keywords[] = {
-        "BEGIN_GUI_DESCR", "END_GUI_DESCR", "BEGIN_TAB_DESCR", "END_TAB_DESCR",
-        "BEGIN_TABLE", "END_TABLE", "DECLARE_VARIABLE", "GLOBAL_PICTURE",
-        "SUB_PICTURE", "SHOW_PARAM", "USER_SELECT", "USER_INPUT_PARAM",
-        "RADIOBUTTON_PARAM", "CHECKBOX_PARAM", "IF", "ELSE_IF", "ELSE", "END_IF",
-        "TABLE_OPTION", "SEL_STRING", "BEGIN_ASM_DESCR", "END_ASM_DESCR", "CONFIG_ELEM",
-        "NO_VALUE", "BEGIN_SUBTABLE", "END_SUBTABLE", "INVALIDATE_PARAM", "USER_SELECT_MULTIPLE", "USER_SELECT_OPTIONAL",
-        "USER_SELECT_MULTIPLE_OPTIONAL", "MEASURE_DISTANCE", "SEARCH_MDL_REFS", "SEARCH_MDL_REF", "BEGIN_CATCH_ERROR",
-        "END_CATCH_ERROR", "MEASURE_LENGTH",
-    };
-    size_t num_keywords = sizeof(keywords) / sizeof(keywords[0]);
-    for (size_t i = 0; i < num_keywords; i++) {
-        if (strcmp(str, keywords[i]) == 0) return 1;
+// Append raw bytes to the side table; returns 0 on success
+static int side_append(Lexer* lexer, const char* text, size_t len) {
+    if (lexer->strings_length + len > lexer->strings_capacity) {
+        size_t new_capacity = lexer->strings_capacity == 0 ? 64 : lexer->strings_capacity * 2;
+        while (new_capacity < lexer->strings_length + len) new_capacity *= 2;
+        char* new_strings = realloc(lexer->strings, new_capacity);
+        if (!new_strings) {
+            ProPrintfChar("%zu: Memory allocation failed for string table\n", lexer->line_number);
+            return 1;
+        }
+        lexer->strings = new_strings;
+        lexer->strings_capacity = new_capacity;
     }
+    memcpy(lexer->strings + lexer->strings_length, text, len);
+    lexer->strings_length += len;
     return 0;
 }
 
-static int is_number(const char* str) {
+static int is_number(const char* str, size_t len) {
     const char* p = str;
+    const char* end = str + len;
     int dot_count = 0;
     int has_digits = 0;
 
-    if (*p == '\0') return 0;
+    if (p == end) return 0;
     if (*p == '-') p++;  // Skip optional negative sign (already supported, but confirm)
 
-    for (; *p != '\0'; p++) {
+    for (; p < end; p++) {
         if (*p == '.') {
             dot_count++;
             if (dot_count > 1) return 0;
         }
-        else if (isdigit(*p)) {
+        else if (*p >= '0' && *p <= '9') {
             has_digits = 1;
         }
         else {
@@ -692,19 +824,36 @@ static int is_operator_char(char c) {
         c == ',' || c == '{' || c == '}' || c == '[' || c == ']' || c == ':';
 }
 void free_lexer(Lexer* lexer) {
-    for (size_t i = 0; i < lexer->token_count; i++) {
-        if (lexer->tokens[i].val &&
-            (lexer->tokens[i].type == tok_keyword ||
-                lexer->tokens[i].type == tok_identifier ||
-                lexer->tokens[i].type == tok_string ||
-                lexer->tokens[i].type == tok_number ||
-                lexer->tokens[i].type == tok_option ||
-                lexer->tokens[i].type == tok_field ||
-                lexer->tokens[i].type == tok_backslash)) {
-            free(lexer->tokens[i].val);
-        }
-    }
     free(lexer->tokens);
+    free(lexer->strings);
+    lexer->tokens = NULL;
+    lexer->strings = NULL;
+    lexer->token_count = lexer->capacity = 0;
+    lexer->strings_length = lexer->strings_capacity = 0;
+}
+
+// Start of a token's text (tok->length bytes; not NUL-terminated)
+const char* token_text(const Lexer* lexer, const TokenData* tok) {
+    if (tok->offset <= lexer->source_length) return lexer->source + tok->offset;
+    return lexer->strings + (tok->offset - lexer->source_length - 1);
+}
+
+// Non-zero if the token's text is exactly s
+int token_is(const Lexer* lexer, const TokenData* tok, const char* s) {
+    return strncmp(token_text(lexer, tok), s, tok->length) == 0 && s[tok->length] == '\0';
+}
+
+// Case-insensitive token_is
+int token_is_ci(const Lexer* lexer, const TokenData* tok, const char* s) {
+    return _strnicmp(token_text(lexer, tok), s, tok->length) == 0 && s[tok->length] == '\0';
+}
+
+// Copy the token's text into buf as a C string (truncated to size - 1); returns buf
+char* token_cstr(const Lexer* lexer, const TokenData* tok, char* buf, size_t size) {
+    size_t n = tok->length < size - 1 ? tok->length : size - 1;
+    memcpy(buf, token_text(lexer, tok), n);
+    buf[n] = '\0';
+    return buf;
 }
 
 char* token_to_string(Token token) {
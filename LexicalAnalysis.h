@@ -44,33 +44,138 @@ typedef enum {
     tok_newline
 } Token;
 
-typedef struct {
-    size_t line;
-    size_t col;
-} Location;
+// Reserved words (keywords, type specifiers and options) known to the lexer.
+// Tokens carry the ID in TokenData.word so the parser can dispatch on an integer.
+typedef enum {
+    WORD_NONE = 0,
+    WORD_BEGIN_GUI_DESCR,
+    WORD_END_GUI_DESCR,
+    WORD_BEGIN_TAB_DESCR,
+    WORD_END_TAB_DESCR,
+    WORD_BEGIN_TABLE,
+    WORD_END_TABLE,
+    WORD_DECLARE_VARIABLE,
+    WORD_GLOBAL_PICTURE,
+    WORD_SUB_PICTURE,
+    WORD_SHOW_PARAM,
+    WORD_USER_SELECT,
+    WORD_USER_INPUT_PARAM,
+    WORD_RADIOBUTTON_PARAM,
+    WORD_CHECKBOX_PARAM,
+    WORD_IF,
+    WORD_ELSE_IF,
+    WORD_ELSE,
+    WORD_END_IF,
+    WORD_TABLE_OPTION,
+    WORD_SEL_STRING,
+    WORD_BEGIN_ASM_DESCR,
+    WORD_END_ASM_DESCR,
+    WORD_CONFIG_ELEM,
+    WORD_NO_VALUE,
+    WORD_BEGIN_SUBTABLE,
+    WORD_END_SUBTABLE,
+    WORD_INVALIDATE_PARAM,
+    WORD_USER_SELECT_MULTIPLE,
+    WORD_USER_SELECT_OPTIONAL,
+    WORD_USER_SELECT_MULTIPLE_OPTIONAL,
+    WORD_MEASURE_DISTANCE,
+    WORD_SEARCH_MDL_REFS,
+    WORD_SEARCH_MDL_REF,
+    WORD_BEGIN_CATCH_ERROR,
+    WORD_END_CATCH_ERROR,
+    WORD_MEASURE_LENGTH,
+    WORD_STRING,
+    WORD_INTEGER,
+    WORD_DOUBLE,
+    WORD_BOOL,
+    WORD_PLANE,
+    WORD_SURFACE,
+    WORD_POINT,
+    WORD_AXIS,
+    WORD_CURVE,
+    WORD_EDGE,
+    WORD_SUBTABLE,
+    WORD_SUBCOMP,
+    WORD_CONFIG_DELETE_IDS,
+    WORD_CONFIG_STATE,
+    WORD_NO_TABLES,
+    WORD_NO_GUI,
+    WORD_AUTO_COMMIT,
+    WORD_AUTO_CLOSE,
+    WORD_SHOW_GUI_FOR_EXISTING,
+    WORD_NO_AUTO_UPDATE,
+    WORD_CONTINUE_ON_CANCEL,
+    WORD_SCREEN_LOCATION,
+    WORD_ON_PICTURE,
+    WORD_TOOLTIP,
+    WORD_NO_AUTOSEL,
+    WORD_NO_FILTER,
+    WORD_DEPEND_ON_INPUT,
+    WORD_DEFAULT_FOR,
+    WORD_WIDTH,
+    WORD_DECIMAL_PLACES,
+    WORD_MODEL,
+    WORD_REQUIRED,
+    WORD_NO_UPDATE,
+    WORD_DISPLAY_ORDER,
+    WORD_MIN_VALUE,
+    WORD_MAX_VALUE,
+    WORD_INVALIDATE_ON_UNSELECT,
+    WORD_SHOW_AUTOSEL,
+    WORD_FILTER_RIGID,
+    WORD_FILTER_ONLY_COLUMN,
+    WORD_FILTER_COLUMN,
+    WORD_TABLE_HEIGHT,
+    WORD_ARRAY,
+    WORD_RECURSIVE,
+    WORD_ALLOW_SUPPRESSED,
+    WORD_ALLOW_SIMPREP_SUPPRESSED,
+    WORD_EXCLUDE_INHERITED,
+    WORD_EXCLUDE_FOOTER,
+    WORD_INCLUDE_MULTI_CAD,
+    WORD_STRUCTURE,
+    WORD_COUNT
+} LexWord;
 
+// A token is a slice of the source buffer. Offsets past the source (and its
+// terminating NUL) index the lexer's side table instead, which holds decoded
+// string literals and the shared NO_VALUE spelling. Read text via token_text.
 typedef struct {
-    Token type;
-    char* val;
-    Location loc;
+    uint16_t type;    // Token
+    uint16_t word;    // LexWord, WORD_NONE unless the lexer classified a reserved word
+    uint32_t line;
+    uint32_t offset;
+    uint32_t length;
 } TokenData;
 
 typedef struct {
-    char* start_tok;
-    char* cur_tok;
+    const char* start_tok;
+    const char* cur_tok;
     TokenData* tokens;
     size_t token_count;
     size_t capacity;
     size_t line_number;
-    char* line_start;
+    const char* line_start;
     int in_table; // Flag for table mode
     int pending_table_start;
     Token last_token;
+    const char* source;      // Buffer the tokens slice into (set by lex)
+    size_t source_length;
+    char* strings;           // Side table for text not present verbatim in the source
+    size_t strings_length;
+    size_t strings_capacity;
 } Lexer;
 
+void lexer_init(Lexer* lexer, const char* text, size_t length);
 int lex(Lexer* lexer);
 void free_lexer(Lexer* lexer);
 char* token_to_string(Token token);
+const char* token_text(const Lexer* lexer, const TokenData* tok);
+int token_is(const Lexer* lexer, const TokenData* tok, const char* s);
+int token_is_ci(const Lexer* lexer, const TokenData* tok, const char* s);
+char* token_cstr(const Lexer* lexer, const TokenData* tok, char* buf, size_t size);
+LexWord lex_word(const char* str, size_t len);
+const char* lex_word_text(LexWord word);
 
 
 
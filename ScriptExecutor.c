@@ -6,6 +6,8 @@
 #include "semantic_analysis.h"
 #include "GuiLogic.h"
 #include "assemblycomponent.h"
+#include "depgraph.h"
+#include "tablestore.h"
 
 
 // --- Reactive context (file-scope) ---
@@ -20,7 +22,6 @@ ProError execute_assignment(AssignmentNode* node, SymbolTable* st, BlockList* bl
 ProError execute_declare_variable(DeclareVariableNode* node, SymbolTable* st);
 ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata);
 static void colplan_scan_command(CommandNode* c, ColumnPlan* p);
-void EPA_MarkDirty(SymbolTable* st, const char* param_name);
 
 const char* pro_error_to_string(ProError e)
 {
@@ -35,86 +36,118 @@ const char* pro_error_to_string(ProError e)
 	}
 }
 
-static inline ProError abort_script(SymbolTable* st, ProError code) {
-	st_put_int(st, "__GLOBAL_ABORT", 1);
+static inline ProError abort_script(ExecState* es, ProError code) {
+	if (es) es->global_abort = 1;
 	return code == PRO_TK_NO_ERROR ? PRO_TK_ABORT : code;
 }
 
 static ProError escalate_if_uncaught(ExecContext* ctx, ProError s) {
-	if (s == PRO_TK_NO_ERROR || !ctx || !ctx->st) return s;
-	int catching = 0; (void)st_get_int(ctx->st, "__CATCH_ACTIVE", &catching);
-	return catching ? s : abort_script(ctx->st, PRO_TK_ABORT);
+	if (s == PRO_TK_NO_ERROR || !ctx || !ctx->exec) return s;
+	return ctx->exec->catch_active ? s : abort_script(ctx->exec, PRO_TK_ABORT);
 }
 
-/* unchanged helpers, but kept here for completeness */
-int st_get_int(SymbolTable* st, const char* key, int* out)
+/*=================================================*
+ * IF winner cache
+ * EPA_ReactiveRefresh opens an epoch; the sub-picture, gate, assignment and
+ * SHOW_PARAM walkers then share one evaluation of each IF's conditions. A
+ * cached winner is only reused while st->change_count is the one it was
+ * evaluated at, so a walker that writes a symbol (a disabled checkbox zeroed
+ * by the gate pass, an assignment) makes later lookups re-evaluate.
+ *=================================================*/
+static unsigned int s_if_epoch = 0;        /* current epoch, 0 outside a refresh */
+static unsigned int s_if_epoch_seq = 0;
+static int s_if_epoch_depth = 0;           /* refreshes can nest through callbacks */
+static IfWinnerStats s_if_stats;
+static IfWinnerStats s_if_stats_at_begin;
+
+unsigned int if_winner_begin_epoch(void)
 {
-	if (!st || !key || !out) return 0;
-	Variable* v = get_symbol(st, (char*)key);
-	if (!v || v->type != TYPE_INTEGER) return 0;
-	*out = v->data.int_value;
-	return 1;
+	unsigned int outer = s_if_epoch;
+	if (++s_if_epoch_seq == 0) s_if_epoch_seq = 1;   /* 0 means "not cached" */
+	s_if_epoch = s_if_epoch_seq;
+	s_if_stats.epochs++;
+	if (s_if_epoch_depth++ == 0) s_if_stats_at_begin = s_if_stats;
+	return outer;
 }
 
-void st_put_int(SymbolTable* st, const char* key, int value)
+void if_winner_end_epoch(unsigned int outer)
 {
-	if (!st || !key) return;
-	Variable* v = get_symbol(st, (char*)key);
-	if (v && v->type == TYPE_INTEGER) { v->data.int_value = value; return; }
-	Variable* nv = (Variable*)malloc(sizeof(Variable));
-	if (!nv) return;
-	nv->type = TYPE_INTEGER;
-	nv->data.int_value = value;
-	set_symbol(st, (char*)key, nv);
+	if (s_if_epoch_depth == 0) return;
+	/* Winners cached by the nested epoch carry its number, so the outer
+	   refresh re-evaluates them rather than trusting them */
+	s_if_epoch = outer;
+	if (--s_if_epoch_depth > 0) return;
+	LOG_DEBUG("Refresh epoch %u: %llu IF winner lookup(s), %llu condition evaluation(s), %llu saved by the cache",
+		s_if_epoch_seq,
+		s_if_stats.lookups - s_if_stats_at_begin.lookups,
+		s_if_stats.evaluations - s_if_stats_at_begin.evaluations,
+		s_if_stats.evaluations_saved - s_if_stats_at_begin.evaluations_saved);
 }
 
-/* REVISED: prefer canonical parser/semantic ID, sync legacy slot for compatibility */
-int if_gate_id_of(IfNode* n, SymbolTable* st)
+int if_winner(IfNode* node, SymbolTable* st, size_t* winner)
 {
-	if (!n) return 0;
+	*winner = (size_t)-1;
+	if (!node || !st) return -1;
+	s_if_stats.lookups++;
 
-	/* 1) Canonical path: semantic analysis assigns stable ids (node->id > 0) */
-	if (n->id > 0) {                               /* canonical id exists */
-		if (st) {
-			char k[64];
-			snprintf(k, sizeof(k), "IF_ID.%p", (void*)n);
-
-			/* Back-fill legacy slot if missing or wrong */
-			int have = 0, old = 0;
-			have = st_get_int(st, k, &old);
-			if (!have || old != n->id) {
-				st_put_int(st, k, n->id);
-			}
+	if (s_if_epoch != 0 && node->winner_epoch == s_if_epoch && node->winner_change == st->change_count) {
+		s_if_stats.evaluations_saved += (unsigned long long)node->winner_evals;
+		if (node->winner >= 0) *winner = (size_t)node->winner;
+		return node->winner_status;
+	}
 
-			/* Ensure IF_ID_SEQ never hands out something <= canonical id */
-			int seq = 0;
-			if (st_get_int(st, "IF_ID_SEQ", &seq) && seq <= n->id) {
-				st_put_int(st, "IF_ID_SEQ", n->id + 1);
-			}
+	int status = 0;
+	int evals = 0;
+	for (size_t b = 0; b < node->branch_count; ++b) {
+		EpaValue cv;
+		evals++;
+		if (evaluate_value(node->branches[b]->condition, st, &cv) != 0) {
+			status = -1;
+			continue;
 		}
-		return n->id;
+		/* numeric/bool truthiness; strings never select a branch here */
+		int truth = 0;
+		if (cv.type == TYPE_BOOL || cv.type == TYPE_INTEGER) truth = (cv.data.int_value != 0);
+		else if (cv.type == TYPE_DOUBLE) truth = (cv.data.double_value != 0.0);
+		if (truth) { *winner = b; break; }
 	}
+	s_if_stats.evaluations += (unsigned long long)evals;
 
-	/* 2) Fallback (legacy): no canonical id present. Keep old behavior. */
-	if (!st) {
-		/* Last-resort: pointer hash (keeps existing behavior if st unavailable) */
-		return (int)(((uintptr_t)n) & 0x7fffffff);
+	if (s_if_epoch != 0) {
+		node->winner_epoch = s_if_epoch;
+		node->winner_change = st->change_count;
+		node->winner = (*winner == (size_t)-1) ? -1 : (int)*winner;
+		node->winner_status = status;
+		node->winner_evals = evals;
 	}
+	return status;
+}
+
+void if_winner_get_stats(IfWinnerStats* out)
+{
+	if (out) *out = s_if_stats;
+}
 
-	char key[64];
-	snprintf(key, sizeof(key), "IF_ID.%p", (void*)n);
+/* Gate id of an IF: the canonical id from semantic analysis, or for an IF that
+   has none, the next free id of the run (written back so it stays stable). */
+int if_gate_id_of(IfNode* n, SymbolTable* st)
+{
+	if (!n) return 0;
+	ExecState* es = st ? st->exec : NULL;
 
-	int have = 0, id = 0;
-	have = st_get_int(st, key, &id);
-	if (have) return id;
+	if (n->id > 0) {
+		/* Never hand out an id at or below a canonical one */
+		if (es && es->next_if_id <= n->id) es->next_if_id = n->id + 1;
+		return n->id;
+	}
 
-	/* Not assigned yet: take next value from IF_ID_SEQ (legacy path) */
-	int next = 0;
-	if (!st_get_int(st, "IF_ID_SEQ", &next) || next <= 0) next = 1;
+	if (!es) {
+		/* Last-resort: pointer hash (keeps existing behavior if st unavailable) */
+		return (int)(((uintptr_t)n) & 0x7fffffff);
+	}
 
-	st_put_int(st, key, next);
-	st_put_int(st, "IF_ID_SEQ", next + 1);
-	return next;
+	n->id = es->next_if_id++;
+	return n->id;
 }
 
 
@@ -1314,28 +1347,21 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 	}
 
 	double x_val = 0.0, y_val = 0.0;
-	Variable* vx = NULL;
-	Variable* vy = NULL;
+	EpaValue vx, vy;
 
-	if (evaluate_expression(node->posX_expr, st, &vx) != 0 || !vx) {
+	if (evaluate_value(node->posX_expr, st, &vx) != 0) {
 		ProPrintfChar("Runtime Error: SUB_PICTURE posX could not be evaluated\n");
 		free(filename);
 		return PRO_TK_GENERAL_ERROR;
 	}
-	if (vx->type == TYPE_DOUBLE) x_val = vx->data.double_value;
-	else if (vx->type == TYPE_INTEGER || vx->type == TYPE_BOOL) x_val = (double)vx->data.int_value;
-	else { free_variable(vx); free(filename); ProPrintfChar("Type error: posX not numeric\n"); return PRO_TK_GENERAL_ERROR; }
-	free_variable(vx);
+	if (epa_to_double(&vx, &x_val) != 0) { free(filename); ProPrintfChar("Type error: posX not numeric\n"); return PRO_TK_GENERAL_ERROR; }
 
-	if (evaluate_expression(node->posY_expr, st, &vy) != 0 || !vy) {
+	if (evaluate_value(node->posY_expr, st, &vy) != 0) {
 		ProPrintfChar("Runtime Error: SUB_PICTURE posY could not be evaluated\n");
 		free(filename);
 		return PRO_TK_GENERAL_ERROR;
 	}
-	if (vy->type == TYPE_DOUBLE) y_val = vy->data.double_value;
-	else if (vy->type == TYPE_INTEGER || vy->type == TYPE_BOOL) y_val = (double)vy->data.int_value;
-	else { free_variable(vy); free(filename); ProPrintfChar("Type error: posY not numeric\n"); return PRO_TK_GENERAL_ERROR; }
-	free_variable(vy);
+	if (epa_to_double(&vy, &y_val) != 0) { free(filename); ProPrintfChar("Type error: posY not numeric\n"); return PRO_TK_GENERAL_ERROR; }
 
 	/* Ensure SUB_PICTURES array exists */
 	Variable* array_var = get_symbol(st, "SUB_PICTURES");
@@ -1360,7 +1386,7 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 	Variable* filename_expr_var = (Variable*)malloc(sizeof(Variable));
 	if (!filename_expr_var) { free_hash_table(sub_map); free(filename); return PRO_TK_GENERAL_ERROR; }
 	filename_expr_var->type = TYPE_EXPR;
-	filename_expr_var->data.expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+	filename_expr_var->data.expr = (ExpressionNode*)calloc(1, sizeof(ExpressionNode));
 	if (!filename_expr_var->data.expr) { free_variable(filename_expr_var); free_hash_table(sub_map); free(filename); return PRO_TK_GENERAL_ERROR; }
 	filename_expr_var->data.expr->type = EXPR_LITERAL_STRING;
 	filename_expr_var->data.expr->data.string_val = filename; /* take ownership */
@@ -1375,7 +1401,7 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 	Variable* posX_expr_var = (Variable*)malloc(sizeof(Variable));
 	if (!posX_expr_var) { free_hash_table(sub_map); return PRO_TK_GENERAL_ERROR; }
 	posX_expr_var->type = TYPE_EXPR;
-	posX_expr_var->data.expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+	posX_expr_var->data.expr = (ExpressionNode*)calloc(1, sizeof(ExpressionNode));
 	if (!posX_expr_var->data.expr) { free_variable(posX_expr_var); free_hash_table(sub_map); return PRO_TK_GENERAL_ERROR; }
 	posX_expr_var->data.expr->type = EXPR_LITERAL_DOUBLE;
 	posX_expr_var->data.expr->data.double_val = x_val;
@@ -1390,7 +1416,7 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 	Variable* posY_expr_var = (Variable*)malloc(sizeof(Variable));
 	if (!posY_expr_var) { free_hash_table(sub_map); return PRO_TK_GENERAL_ERROR; }
 	posY_expr_var->type = TYPE_EXPR;
-	posY_expr_var->data.expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+	posY_expr_var->data.expr = (ExpressionNode*)calloc(1, sizeof(ExpressionNode));
 	if (!posY_expr_var->data.expr) { free_variable(posY_expr_var); free_hash_table(sub_map); return PRO_TK_GENERAL_ERROR; }
 	posY_expr_var->data.expr->type = EXPR_LITERAL_DOUBLE;
 	posY_expr_var->data.expr->data.double_val = y_val;
@@ -1401,21 +1427,12 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 		return PRO_TK_GENERAL_ERROR;
 	}
 
-	/* --- IF TAGGING: prefer live __CURRENT_IF_ID, else fall back to prepare tag --- */
+	/* --- IF TAGGING: prefer the IF being walked, else fall back to prepare tag --- */
 	{
-		int cur_if = 0;
-		if (st_get_int(st, "__CURRENT_IF_ID", &cur_if) && cur_if > 0) {
+		int gid = (st->exec && st->exec->current_if_id > 0) ? st->exec->current_if_id : node->if_gate_id;
+		if (gid > 0) {
 			set_bool_in_map(sub_map, "if_gated", 1);
-			add_int_to_map(sub_map, "if_gate_id", cur_if);
-		}
-		else {
-			int gid = 0;
-			char key[64];
-			snprintf(key, sizeof(key), "SUBPIC_IF_TAGS.%p", (void*)node);
-			if (st_get_int(st, key, &gid) && gid > 0) {
-				set_bool_in_map(sub_map, "if_gated", 1);
-				add_int_to_map(sub_map, "if_gate_id", gid);
-			}
+			add_int_to_map(sub_map, "if_gate_id", gid);
 		}
 	}
 
@@ -1426,7 +1443,7 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 	map_var->data.map = sub_map;
 
 	size_t new_size = array_var->data.array.size + 1;
-	Variable** new_elements = (Variable**)realloc(array_var->data.array.elements, new_size * sizeof(Variable*));
+	Variable** new_elements = variable_make_unique(array_var) != 0 ? NULL : (Variable**)realloc(array_var->data.array.elements, new_size * sizeof(Variable*));
 	if (!new_elements) { free_variable(map_var); return PRO_TK_GENERAL_ERROR; }
 	array_var->data.array.elements = new_elements;
 	array_var->data.array.elements[array_var->data.array.size] = map_var;
@@ -1438,9 +1455,7 @@ ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st)
 static void tag_subpicture_for_if(SymbolTable* st, SubPictureNode* sp, int gate_id)
 {
 	if (!st || !sp || gate_id <= 0) return;
-	char key[64];
-	snprintf(key, sizeof(key), "SUBPIC_IF_TAGS.%p", (void*)sp);
-	st_put_int(st, key, gate_id);
+	sp->if_gate_id = gate_id;
 }
 
 /* --- Prepare pass for SUB_PICTURE inside an IF tree --- */
@@ -1567,18 +1582,6 @@ static const char* get_filter_column_key(Variable* wrapper, int idx_after_visibl
 	return (s && s->type == TYPE_STRING && s->data.string_value) ? s->data.string_value : NULL;
 }
 
-/* Compare two cells by type (ints, doubles, strings). Extend as needed. */
-static int cell_equals(Variable* a, Variable* b) {
-	if (!a || !b || a->type != b->type) return 0;
-	switch (a->type) {
-	case TYPE_INTEGER: return a->data.int_value == b->data.int_value;
-	case TYPE_DOUBLE:  return a->data.double_value == b->data.double_value;
-	case TYPE_STRING:  return (a->data.string_value && b->data.string_value) &&
-		strcmp(a->data.string_value, b->data.string_value) == 0;
-	default: return 0;
-	}
-}
-
 /* Prefer newly exported alias <key>_SELECTED, else fall back to key (and optional FILTER_key) */
 static Variable* lookup_selected_or_key(SymbolTable* st, const char* key) {
 	char buf[256];
@@ -1592,127 +1595,105 @@ static Variable* lookup_selected_or_key(SymbolTable* st, const char* key) {
 }
 
 
-/* Decide if a row passes the active context filter for this table. */
-static int row_passes_filter(SymbolTable* st, Variable* wrapper, HashTable* row_map)
-{
-	if (!row_map) return 0;
-
-	/* NEW: if no explicit filter flags were provided, don't filter at all. */
-	if (!wrapper || wrapper->type != TYPE_MAP) return 1;
-	{
-		Variable* fc = hash_table_lookup(wrapper->data.map, "filter_column");
-		Variable* foc = hash_table_lookup(wrapper->data.map, "filter_only_column");
-		int has_fc = (fc && fc->type == TYPE_INTEGER && fc->data.int_value >= 0);
-		int has_foc = (foc && foc->type == TYPE_INTEGER && foc->data.int_value >= 0);
-		if (!has_fc && !has_foc) {
-			return 1; /* No filtering requested => show every row */
-		}
-	}
+/* Active context filter of a table, resolved once per build: a row is shown when
+   its cell in column equals expect. No expect shows every row. */
+typedef struct {
+	size_t column;
+	Variable* expect;
+} RowFilter;
 
-	/* Optional: obey NO_FILTER if you persist it; otherwise just proceed. */
-	/* Example:
-	Variable* nf = hash_table_lookup(wrapper->data.map, "NO_FILTER");
-	if (nf && nf->type == TYPE_BOOL && nf->data.int_value) return 1;
-	*/
+static void resolve_row_filter(SymbolTable* st, Variable* wrapper, const TableStore* store, RowFilter* f)
+{
+	f->column = TABLE_NO_COLUMN;
+	f->expect = NULL;
+	if (!wrapper || wrapper->type != TYPE_MAP) return;
+
+	/* Prefer strict FILTER_ONLY_COLUMN, else the softer FILTER_COLUMN; without
+	   either flag (or with an invalid one, or nothing selected yet) show every row */
+	Variable* flag = hash_table_lookup(wrapper->data.map, "filter_only_column");
+	if (!flag || flag->type != TYPE_INTEGER || flag->data.int_value < 0) {
+		flag = hash_table_lookup(wrapper->data.map, "filter_column");
+		if (!flag || flag->type != TYPE_INTEGER || flag->data.int_value < 0) return;
+	}
+	const char* key = get_filter_column_key(wrapper, flag->data.int_value);
+	if (!key) return;
+	Variable* expect = lookup_selected_or_key(st, key);
+	if (!expect) return;
+	f->column = table_store_column(store, key);
+	f->expect = expect;
+}
 
-	/* Prefer strict FILTER_ONLY_COLUMN if present */
-	int idx = -1;
-	Variable* foc = wrapper ? hash_table_lookup(wrapper->data.map, "filter_only_column") : NULL;
-	if (foc && foc->type == TYPE_INTEGER && foc->data.int_value >= 0) {
-		idx = foc->data.int_value;
-		const char* key = get_filter_column_key(wrapper, idx);
-		if (!key) return 1; /* invalid config -> show all */
-		Variable* expect = lookup_selected_or_key(st, key);
-		if (!expect) return 1; /* nothing selected yet -> show all */
-		Variable* cell = hash_table_lookup(row_map, key);
-		return cell_equals(cell, expect);
-	}
-
-	/* Softer FILTER_COLUMN: if present, filter by that one column;
-	   otherwise fall back to your multi-key matching behavior. */
-	Variable* fc = wrapper ? hash_table_lookup(wrapper->data.map, "filter_column") : NULL;
-	if (fc && fc->type == TYPE_INTEGER && fc->data.int_value >= 0) {
-		idx = fc->data.int_value;
-		const char* key = get_filter_column_key(wrapper, idx);
-		if (!key) return 1;
-		Variable* expect = lookup_selected_or_key(st, key);
-		if (!expect) return 1;
-		Variable* cell = hash_table_lookup(row_map, key);
-		return cell_equals(cell, expect);
-	}
-
-	/* Fallback: original behavior — require all matching context keys to match.
-	   NOTE: Because of the early-exit above, this block now runs ONLY when a
-	   filter flag exists but neither strict nor soft branch returned yet. */
-	for (size_t k = 0; k < row_map->key_count; ++k) {
-		const char* key = row_map->key_order[k];
-		if (!key || strcmp(key, "SEL_STRING") == 0 || strcmp(key, "SUBTABLE") == 0) continue;
-		Variable* expect = lookup_selected_or_key(st, key);
-		if (!expect) continue; /* no constraint on this key */
-		Variable* cell = hash_table_lookup(row_map, key);
-		if (!cell_equals(cell, expect)) return 0;
+/* Rows passing the active context filter, ascending, into rows (room for every
+   row). The column's equality index answers directly: no per-row scan. */
+static size_t filter_table_rows(TableStore* store, const RowFilter* f, size_t* rows)
+{
+	if (!f->expect) {
+		for (size_t r = 0; r < store->row_count; r++) rows[r] = r;
+		return store->row_count;
 	}
-	return 1;
+	return table_store_match(store, f->column, f->expect, rows);
 }
 
-static Variable* get_table_rows(SymbolTable* st, const char* table_id)
+/* Column-wise rows of a table symbol (see tablestore.h), NULL if table_id is not one */
+static TableStore* get_table_store(SymbolTable* st, const char* table_id)
 {
 	if (!st || !table_id || !*table_id) return NULL;
-	Variable* v = get_symbol(st, (char*)table_id);
-	if (!v) return NULL;
-	if (v->type == TYPE_ARRAY) return v;
-	if (v->type == TYPE_MAP && v->data.map) {
-		Variable* rows = hash_table_lookup(v->data.map, "rows");
-		if (rows && rows->type == TYPE_ARRAY) return rows;
-	}
-	return NULL;
+	return table_store_of(get_symbol(st, (char*)table_id));
+}
+
+/* True when name is a table id. A plain array still counts, as it did when
+   tables were stored as arrays of row maps. */
+static int is_table_id(SymbolTable* st, const char* name)
+{
+	if (get_table_store(st, name)) return 1;
+	Variable* v = (name && *name) ? get_symbol(st, (char*)name) : NULL;
+	return v && v->type == TYPE_ARRAY;
 }
 
 // Helper: Remove all dynamic (propagatable) keys for a specific table from the symbol table
 void remove_dynamic_keys_for_table(const char* table_id, SymbolTable* st)
 {
-	Variable* rows = get_table_rows(st, table_id);
-	if (!rows) {
-		LogOnlyPrintfChar("Debug: No table rows for '%s' found for dynamic key removal\n", table_id);
+	TableStore* store = get_table_store(st, table_id);
+	if (!store) {
+		LOG_DEBUG("Debug: No table rows for '%s' found for dynamic key removal\n", table_id);
 		return;
 	}
 
 	char** dynamic_keys = NULL;
 	size_t dk_count = 0, dk_capacity = 0;
 
-	for (size_t r = 0; r < rows->data.array.size; r++) {
-		Variable* rv = rows->data.array.elements[r];
-		if (rv && rv->type == TYPE_MAP) {
-			HashTable* rm = rv->data.map;
-			for (size_t k = 0; k < rm->key_count; k++) {
-				const char* key = rm->key_order[k];
-				if (strcmp(key, "SEL_STRING") == 0) continue;
-				/* --- NEW: never remove/revert symbols that name tables --- */
-				if (_stricmp(key, table_id) == 0) continue;            /* do not touch our own table id */
-				if (get_table_rows(st, key) != NULL) continue;         /* key matches any table id */
-				Variable* cell = hash_table_lookup(rm, key);
-				if (!cell || cell->type == TYPE_UNKNOWN || cell->type == TYPE_SUBTABLE) continue;
-
-				int found = 0;
-				for (size_t d = 0; d < dk_count; d++) {
-					if (strcmp(dynamic_keys[d], key) == 0) { found = 1; break; }
-				}
-				if (!found) {
-					if (dk_count >= dk_capacity) {
-						size_t new_cap = dk_capacity ? dk_capacity * 2 : 8;
-						char** new_dk = (char**)realloc(dynamic_keys, new_cap * sizeof(char*));
-						if (!new_dk) {
-							LogOnlyPrintfChar("Error: Realloc failed for dynamic keys in '%s'\n", table_id);
-							goto cleanup;
-						}
-						dynamic_keys = new_dk;
-						dk_capacity = new_cap;
-					}
-					dynamic_keys[dk_count] = _strdup(key);
-					if (dynamic_keys[dk_count]) dk_count++;
-				}
+	/* Every row holds every column, so a key is dynamic when some row of its column
+	   holds a non-SUBTABLE cell (an empty cell counts): decided per column */
+	for (size_t c = 0; store->row_count > 0 && c < store->column_count; c++) {
+		const TableColumn* col = &store->columns[c];
+		const char* key = col->name;
+		if (!key || col->shadowed) continue;
+		if (strcmp(key, "SEL_STRING") == 0) continue;
+		/* --- NEW: never remove/revert symbols that name tables --- */
+		if (_stricmp(key, table_id) == 0) continue;            /* do not touch our own table id */
+		if (is_table_id(st, key)) continue;                    /* key matches any table id */
+		if (col->type == TYPE_SUBTABLE) {
+			size_t r = 0;
+			Variable cell;
+			for (; r < store->row_count; r++) {
+				table_store_cell(store, r, c, &cell);
+				if (cell.type != TYPE_SUBTABLE) break;
 			}
+			if (r == store->row_count) continue;
 		}
+
+		if (dk_count >= dk_capacity) {
+			size_t new_cap = dk_capacity ? dk_capacity * 2 : 8;
+			char** new_dk = (char**)realloc(dynamic_keys, new_cap * sizeof(char*));
+			if (!new_dk) {
+				LogOnlyPrintfChar("Error: Realloc failed for dynamic keys in '%s'\n", table_id);
+				goto cleanup;
+			}
+			dynamic_keys = new_dk;
+			dk_capacity = new_cap;
+		}
+		dynamic_keys[dk_count] = _strdup(key);
+		if (dynamic_keys[dk_count]) dk_count++;
 	}
 
 cleanup:
@@ -1726,6 +1707,7 @@ cleanup:
 			remove_symbol(st, key);
 			LogOnlyPrintfChar("Removed dynamic key '%s' from table '%s'\n", key, table_id);
 		}
+		EPA_MarkDirty(st, key);
 		free(dynamic_keys[d]);
 	}
 	free(dynamic_keys);
@@ -1758,7 +1740,7 @@ ProError clear_chain(char* table_id, SymbolTable* st, char* dialog) {
 		ProPrintfChar("Warning: Failed to hide drawing area '%s' for table '%s' (error: %d)\n", da_name, table_id, status);
 	}
 	else {
-		LogOnlyPrintfChar("Debug: Successfully hid drawing area '%s'\n", da_name);
+		LOG_DEBUG("Debug: Successfully hid drawing area '%s'\n", da_name);
 	}
 
 
@@ -1768,16 +1750,16 @@ ProError clear_chain(char* table_id, SymbolTable* st, char* dialog) {
 	// Get the sub_key for this table's downstream SUBTABLE (if any)
 	char sub_key[256];
 	snprintf(sub_key, sizeof(sub_key), "_subtable_of_%s", table_id);
-	LogOnlyPrintfChar("Debug: Looking for next subtable using key '%s'\n", sub_key);
+	LOG_DEBUG("Debug: Looking for next subtable using key '%s'\n", sub_key);
 
 	char* next_sub_id = NULL;
 	Variable* sub_var = get_symbol(st, sub_key);
 	if (sub_var && sub_var->type == TYPE_STRING && sub_var->data.string_value && strlen(sub_var->data.string_value) > 0) {
 		next_sub_id = _strdup(sub_var->data.string_value);
-		LogOnlyPrintfChar("Debug: Found next subtable '%s' for '%s'\n", next_sub_id, table_id);
+		LOG_DEBUG("Debug: Found next subtable '%s' for '%s'\n", next_sub_id, table_id);
 	}
 	else {
-		LogOnlyPrintfChar("Debug: No next subtable found for '%s'\n", table_id);
+		LOG_DEBUG("Debug: No next subtable found for '%s'\n", table_id);
 	}
 
 	// Remove the tracking symbol
@@ -1797,8 +1779,8 @@ ProError build_table_from_sym(char* dialog, char* table_id, SymbolTable* st)
 {
 	ProError status;
 
-	Variable* rows = get_table_rows(st, table_id);
-	if (!rows || rows->data.array.size == 0) {
+	TableStore* store = get_table_store(st, table_id);
+	if (!store || store->row_count == 0) {
 		ProPrintfChar("Error: Table '%s' not found or empty in symbol table\n", table_id);
 		return PRO_TK_BAD_INPUTS;
 	}
@@ -1831,7 +1813,7 @@ ProError build_table_from_sym(char* dialog, char* table_id, SymbolTable* st)
 				da_name, table_id, status);
 		}
 		else {
-			LogOnlyPrintfChar("Debug: Successfully showed drawing area '%s'\n", da_name);
+			LOG_DEBUG("Debug: Successfully showed drawing area '%s'\n", da_name);
 		}
 	}
 	else {
@@ -1885,22 +1867,13 @@ ProError build_table_from_sym(char* dialog, char* table_id, SymbolTable* st)
 	}
 
 	/* Compute visible row indices, honoring FILTER_COLUMN / FILTER_ONLY_COLUMN if present */
-	size_t total = rows->data.array.size;
+	size_t total = store->row_count;
 	size_t* vis_idx = (size_t*)malloc(total * sizeof(size_t));
 	if (!vis_idx) return PRO_TK_GENERAL_ERROR;
 
-	size_t vis_count = 0;
-	for (size_t r = 0; r < total; ++r) {
-		Variable* rv = rows->data.array.elements[r];
-		if (!rv || rv->type != TYPE_MAP) continue;
-		HashTable* row_map = rv->data.map;
-
-		if (wrapper) {
-			if (!row_passes_filter(st, wrapper, row_map)) continue; /* filtered out */
-		}
-		/* Keep this row */
-		vis_idx[vis_count++] = r;
-	}
+	RowFilter filter;
+	resolve_row_filter(st, wrapper, store, &filter);
+	size_t vis_count = filter_table_rows(store, &filter, vis_idx);
 
 	/* Create ROW_<original_index> names for only the visible rows */
 	char** row_ptrs = NULL;
@@ -1933,24 +1906,23 @@ ProError build_table_from_sym(char* dialog, char* table_id, SymbolTable* st)
 	}
 
 	/* Labels from SEL_STRING in each visible row */
+	size_t label_col = table_store_column(store, "SEL_STRING");
 	for (size_t i = 0; i < vis_count; i++) {
 		size_t r = vis_idx[i];
-		Variable* row_var = rows->data.array.elements[r];
-		if (row_var && row_var->type == TYPE_MAP) {
-			Variable* label_var = hash_table_lookup(row_var->data.map, "SEL_STRING");
-			char* label_utf8 = (label_var && label_var->type == TYPE_STRING && label_var->data.string_value)
-				? label_var->data.string_value : "";
-			wchar_t* label_w = char_to_wchar(label_utf8);
-			status = ProUITableCellLabelSet(dialog, table_id, row_ptrs[i], col0_buf,
-				label_w ? label_w : L"");
-			if (label_w) free(label_w);
-			if (status != PRO_TK_NO_ERROR) {
-				ProPrintfChar("Error: Failed to set cell label for row %zu in '%s'\n", r, table_id);
-				for (size_t j = 0; j < vis_count; j++) free(row_ptrs[j]);
-				free(row_ptrs);
-				free(vis_idx);
-				return status;
-			}
+		Variable label_var;
+		table_store_cell(store, r, label_col, &label_var);
+		char* label_utf8 = (label_var.type == TYPE_STRING && label_var.data.string_value)
+			? label_var.data.string_value : "";
+		wchar_t* label_w = char_to_wchar(label_utf8);
+		status = ProUITableCellLabelSet(dialog, table_id, row_ptrs[i], col0_buf,
+			label_w ? label_w : L"");
+		if (label_w) free(label_w);
+		if (status != PRO_TK_NO_ERROR) {
+			ProPrintfChar("Error: Failed to set cell label for row %zu in '%s'\n", r, table_id);
+			for (size_t j = 0; j < vis_count; j++) free(row_ptrs[j]);
+			free(row_ptrs);
+			free(vis_idx);
+			return status;
 		}
 	}
 
@@ -1970,6 +1942,57 @@ ProError build_table_from_sym(char* dialog, char* table_id, SymbolTable* st)
 	return PRO_TK_NO_ERROR;
 }
 
+/* Global a table cell is exported to: the column name, or <column>_SELECTED when
+   the column is named like a table (e.g., STYLE -> STYLE_SELECTED) */
+static const char* table_export_key(SymbolTable* st, const char* table, const char* key, char* buf, size_t size)
+{
+	if (_stricmp(key, table) == 0 || is_table_id(st, key)) {
+		snprintf(buf, size, "%s_SELECTED", key);
+		return buf;
+	}
+	return key;
+}
+
+/* True when every cell TableSelectCallback would export from row r already
+   holds the same value in its global and the tracked SUBTABLE is the row's own */
+static int table_row_already_exported(SymbolTable* st, const char* table, const TableStore* store, size_t r, const char* sub_key)
+{
+	Variable* sub_v = get_symbol(st, sub_key);
+	const char* tracked = (sub_v && sub_v->type == TYPE_STRING) ? sub_v->data.string_value : NULL;
+	const char* row_sub = NULL;
+	size_t exported = 0;
+
+	for (size_t c = 0; c < store->column_count; c++) {
+		const char* key = store->columns[c].name;
+		if (!key || store->columns[c].shadowed) continue;
+		Variable cell;
+		table_store_cell(store, r, c, &cell);
+		if (cell.type == TYPE_SUBTABLE) {
+			if (cell.data.string_value && cell.data.string_value[0]) row_sub = cell.data.string_value;
+			continue;
+		}
+		if (strcmp(key, "SEL_STRING") == 0) continue;
+		if (cell.type != TYPE_INTEGER && cell.type != TYPE_BOOL &&
+			cell.type != TYPE_DOUBLE && cell.type != TYPE_STRING) continue;   /* never exported */
+
+		char alias_buf[192];
+		Variable* global_var = get_symbol(st, table_export_key(st, table, key, alias_buf, sizeof(alias_buf)));
+		if (!global_var) return 0;
+		if (cell.type == TYPE_STRING) {
+			if (global_var->type != TYPE_STRING || !global_var->data.string_value ||
+				strcmp(global_var->data.string_value, cell.data.string_value) != 0) return 0;
+		}
+		else if (!variable_values_equal(global_var, &cell)) {
+			return 0;
+		}
+		exported++;
+	}
+
+	if ((row_sub == NULL) != (tracked == NULL)) return 0;
+	if (row_sub && strcmp(row_sub, tracked) != 0) return 0;
+	return exported > 0;
+}
+
 ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 {
 	SymbolTable* st = (SymbolTable*)appdata;
@@ -1994,7 +2017,7 @@ ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 
 	/* Deselection: clear chain and dynamic keys */
 	if (num_selected == 0) {
-		LogOnlyPrintfChar("Debug: Deselection in table '%s'; clearing chain\n", table);
+		LOG_DEBUG("Debug: Deselection in table '%s'; clearing chain\n", table);
 		char* old_sub = NULL;
 		Variable* old_v = get_symbol(st, sub_key);
 		if (old_v && old_v->type == TYPE_STRING && old_v->data.string_value) {
@@ -2021,11 +2044,11 @@ ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 		ProArrayFree((ProArray*)&selected_rows);
 		return PRO_TK_GENERAL_ERROR;
 	}
-	LogOnlyPrintfChar("Debug: Selected row in table '%s': %s\n", table, selected_row_name);
+	LOG_DEBUG("Debug: Selected row in table '%s': %s\n", table, selected_row_name);
 
-	/* Unified rows view (ARRAY or MAP{rows}) */
-	Variable* rows = get_table_rows(st, table);
-	if (!rows) {
+	/* Column-wise rows of the table */
+	TableStore* store = get_table_store(st, table);
+	if (!store) {
 		ProPrintfChar("Error: Table '%s' not found in symbol table or has no rows\n", table);
 		free(selected_row_name);
 		ProArrayFree((ProArray*)&selected_rows);
@@ -2062,23 +2085,23 @@ ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 		}
 	}
 
-	if (selected_row_index == (size_t)-1 || selected_row_index >= rows->data.array.size) {
+	if (selected_row_index == (size_t)-1 || selected_row_index >= store->row_count) {
 		ProPrintfChar("Error: Selected row '%s' resolved to invalid index\n", selected_row_name);
 		free(selected_row_name);
 		ProArrayFree((ProArray*)&selected_rows);
 		return PRO_TK_GENERAL_ERROR;
 	}
-	LogOnlyPrintfChar("Debug: Selected row index (data): %zu\n", selected_row_index);
+	LOG_DEBUG("Debug: Selected row index (data): %zu\n", selected_row_index);
 
 	/* Cleanup selection buffers from UI */
 	free(selected_row_name);
 	ProArrayFree((ProArray*)&selected_rows);
 
-	/* Use the ORIGINAL index to fetch the data row */
-	Variable* row_var = rows->data.array.elements[selected_row_index];
-	if (!row_var || row_var->type != TYPE_MAP) {
-		ProPrintfChar("Error: Row at index %zu in table '%s' is not a MAP\n", selected_row_index, table);
-		return PRO_TK_GENERAL_ERROR;
+	/* Reselecting the row that is already exported changes no symbol: skip the
+	   revert/re-export cycle, the downstream rebuild and the refresh */
+	if (table_row_already_exported(st, table, store, selected_row_index, sub_key)) {
+		LOG_DEBUG("Debug: Row %zu of table '%s' is already exported; nothing to update\n", selected_row_index, table);
+		return PRO_TK_NO_ERROR;
 	}
 
 	remove_dynamic_keys_for_table(table, st);
@@ -2094,17 +2117,19 @@ ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 		}
 	}
 
-	/* Scan row map: export non-SUBTABLE cells to globals; capture SUBTABLE id */
+	/* Scan the row: export non-SUBTABLE cells to globals; capture SUBTABLE id */
 	char* subtable_id = NULL;
 	char* subtable_key = NULL;
-	HashTable* row_map = row_var->data.map;
-	for (size_t i = 0; i < row_map->key_count; i++) {
-		const char* key = row_map->key_order[i];
-		Variable* cell = hash_table_lookup(row_map, key);
-		if (!cell) continue;
-
+	for (size_t c = 0; c < store->column_count; c++) {
+		const char* key = store->columns[c].name;
+		if (!key || store->columns[c].shadowed) continue;
+		Variable cell_value;
+		Variable* cell = &cell_value;
+		table_store_cell(store, selected_row_index, c, cell);
 		if (cell->type == TYPE_SUBTABLE) {
 			if (cell->data.string_value && cell->data.string_value[0]) {
+				free(subtable_id);
+				free(subtable_key);
 				subtable_id = _strdup(cell->data.string_value);
 				subtable_key = _strdup(key);
 			}
@@ -2112,13 +2137,8 @@ ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 		}
 
 		if (strcmp(key, "SEL_STRING") == 0) continue; /* label only */
-		const char* out_key = key;
 		char alias_buf[192];
-		if (_stricmp(out_key, table) == 0 || get_table_rows(st, out_key) != NULL) {
-			/* e.g., STYLE -> STYLE_SELECTED; also avoids collisions with any table id */
-			snprintf(alias_buf, sizeof(alias_buf), "%s_SELECTED", out_key);
-			out_key = alias_buf;
-		}
+		const char* out_key = table_export_key(st, table, key, alias_buf, sizeof(alias_buf));
 
 		Variable* global_var = (Variable*)malloc(sizeof(Variable));
 		if (!global_var) continue;
@@ -2166,10 +2186,9 @@ ProError TableSelectCallback(char* dialog, char* table, ProAppData appdata)
 		LogOnlyPrintfChar("Selection has no SUBTABLE; downstream cleared and tracking removed\n");
 	}
 
-	/* Build next table only if that id resolves to a rows array (ARRAY or MAP{rows}) */
+	/* Build next table only if that id names a table symbol */
 	if (subtable_id) {
-		Variable* next_rows = get_table_rows(st, subtable_id);
-		if (next_rows) {
+		if (get_table_store(st, subtable_id)) {
 			LogOnlyPrintfChar("SUBTABLE '%s' matches a table in symbol table; building dynamically.\n", subtable_id);
 			if (!dialog) {
 				ProPrintfChar("Error: No active DialogState for dynamic table build\n");
@@ -2376,29 +2395,29 @@ ProError execute_begin_table(TableNode* node, DialogState* state, SymbolTable* s
 		if (use_rows && node->rows[i] && node->rows[i][0]) {
 			if (evaluate_to_string(node->rows[i][0], st, &cell_utf8) != 0 || !cell_utf8) {
 				cell_utf8 = _strdup("");
-				LogOnlyPrintfChar("Debug: Failed to evaluate rows[%d][0] for cell label; using empty string\n", i);
+				LOG_DEBUG("Debug: Failed to evaluate rows[%d][0] for cell label; using empty string\n", i);
 			}
 		}
 		else if (!use_rows && node->sel_strings && node->sel_strings[i]) {
 			if (evaluate_to_string(node->sel_strings[i], st, &cell_utf8) != 0 || !cell_utf8) {
 				cell_utf8 = _strdup("");
-				LogOnlyPrintfChar("Debug: Failed to evaluate sel_strings[%d] for cell label; using empty string\n", i);
+				LOG_DEBUG("Debug: Failed to evaluate sel_strings[%d] for cell label; using empty string\n", i);
 			}
 			else {
-				LogOnlyPrintfChar("Debug: Evaluated sel_strings[%d] cell label: %s\n", i, cell_utf8);
+				LOG_DEBUG("Debug: Evaluated sel_strings[%d] cell label: %s\n", i, cell_utf8);
 			}
 		}
 		else if (title_utf8 && title_utf8[0] != '\0') {
 			cell_utf8 = _strdup(title_utf8);
-			LogOnlyPrintfChar("Debug: Using table title as fallback cell label for row %d: %s\n", i, cell_utf8);
+			LOG_DEBUG("Debug: Using table title as fallback cell label for row %d: %s\n", i, cell_utf8);
 		}
 		else if (table_id && table_id[0] != '\0') {
 			cell_utf8 = _strdup(table_id);
-			LogOnlyPrintfChar("Debug: Using table identifier as fallback cell label for row %d: %s\n", i, cell_utf8);
+			LOG_DEBUG("Debug: Using table identifier as fallback cell label for row %d: %s\n", i, cell_utf8);
 		}
 		else {
 			cell_utf8 = _strdup("");
-			LogOnlyPrintfChar("Debug: No sources available for cell label for row %d; using empty string\n", i);
+			LOG_DEBUG("Debug: No sources available for cell label for row %d; using empty string\n", i);
 		}
 		wchar_t* cell_w = cell_utf8 ? char_to_wchar(cell_utf8) : L"";
 		status = ProUITableCellLabelSet(state->dialog_name, table_id, row_ptrs[i], col0_buf, cell_w ? cell_w : L"");
@@ -2428,13 +2447,13 @@ ProError execute_begin_table(TableNode* node, DialogState* state, SymbolTable* s
 			if (use_rows && node->rows[i] && node->rows[i][1]) {
 				if (evaluate_to_string(node->rows[i][1], st, &sub_utf8) != PRO_TK_NO_ERROR) {
 					sub_utf8 = NULL;
-					LogOnlyPrintfChar("Debug: Failed to evaluate rows[%d][1] for subtable meta; skipping\n", i);
+					LOG_DEBUG("Debug: Failed to evaluate rows[%d][1] for subtable meta; skipping\n", i);
 				}
 			}
 			else if (!use_rows && node->sel_strings && i + 1 < node->sel_string_count && node->sel_strings[i + 1]) {
 				if (evaluate_to_string(node->sel_strings[i + 1], st, &sub_utf8) != PRO_TK_NO_ERROR) {
 					sub_utf8 = NULL;
-					LogOnlyPrintfChar("Debug: Failed to evaluate sel_strings[%d] for subtable meta; skipping\n", i + 1);
+					LOG_DEBUG("Debug: Failed to evaluate sel_strings[%d] for subtable meta; skipping\n", i + 1);
 				}
 			}
 			if (sub_utf8 && sub_utf8[0] != '\0') {
@@ -2454,7 +2473,7 @@ ProError execute_begin_table(TableNode* node, DialogState* state, SymbolTable* s
 						free(meta_dyn);
 					}
 					else {
-						LogOnlyPrintfChar("Debug: Memory allocation failed for subtable metadata string for row %d\n", i);
+						LOG_DEBUG("Debug: Memory allocation failed for subtable metadata string for row %d\n", i);
 					}
 				}
 			}
@@ -2739,6 +2758,9 @@ ProError execute_gui_block(Block* gui_block, SymbolTable* st, BlockList* block_l
 	}
 
 	ProUIDialogDestroy(state.dialog_name);
+	slot_watch_free(&state.refresh_watch);
+	slot_watch_free(&state.required_watch);
+	slot_watch_free(&state.redraw_watch);
 	return PRO_TK_NO_ERROR;
 
 }
@@ -2833,13 +2855,24 @@ ProError execute_declare_variable(DeclareVariableNode* node, SymbolTable* st) {
 			var->data.array.size = 0;
 			break;
 		case VAR_MAP:
-		case VAR_STRUCTURE:
 			var->data.map = create_hash_table(16);
 			if (!var->data.map) {
 				free(var);
 				return PRO_TK_GENERAL_ERROR;
 			}
 			break;
+		case VAR_STRUCTURE:
+			var->data.structure = create_hash_table(16);
+			if (!var->data.structure) {
+				free(var);
+				return PRO_TK_GENERAL_ERROR;
+			}
+			if (init_structure_members(var->data.structure, node, st) != 0) {
+				free_hash_table(var->data.structure);
+				free(var);
+				return PRO_TK_GENERAL_ERROR;
+			}
+			break;
 		default:
 			// Basic types: Set to zero/empty via set_default_value after creation
 			break;
@@ -3084,8 +3117,8 @@ ProError execute_search_mdl_ref(SearchMdlRefNode* node, SymbolTable* st)
 	ProMdl mdl = NULL; ProMdlName mdl_name = L"";
 	ProError status = EPA_ResolveModelArg(node->model, st, &mdl, mdl_name);
 	if (status != PRO_TK_NO_ERROR || !mdl) {
-		int catching = 0; (void)st_get_int(st, "__CATCH_ACTIVE", &catching);
-		st_put_int(st, "__LAST_ERROR", (int)(status ? status : PRO_TK_E_NOT_FOUND));
+		int catching = st->exec && st->exec->catch_active;
+		if (st->exec) st->exec->last_error = (int)(status ? status : PRO_TK_E_NOT_FOUND);
 		ProPrintfChar("SEARCH_MDL_REF: model could not be resolved; %s\n",
 			catching ? "continuing in CATCH" : "aborting");
 		return catching ? (status ? status : PRO_TK_E_NOT_FOUND) : PRO_TK_ABORT;
@@ -3142,8 +3175,8 @@ ProError execute_search_mdl_ref(SearchMdlRefNode* node, SymbolTable* st)
 	*/
 
 	if (found_status != PRO_TK_NO_ERROR) {
-		int catching = 0; (void)st_get_int(st, "__CATCH_ACTIVE", &catching);
-		st_put_int(st, "__LAST_ERROR", (int)PRO_TK_E_NOT_FOUND);
+		int catching = st->exec && st->exec->catch_active;
+		if (st->exec) st->exec->last_error = (int)PRO_TK_E_NOT_FOUND;
 		ProPrintfChar("SEARCH_MDL_REF: no match; %s\n",
 			catching ? "continuing in CATCH" : "aborting");
 		return catching ? PRO_TK_E_NOT_FOUND : PRO_TK_ABORT;
@@ -3333,24 +3366,20 @@ ProError execute_measure_length(MeasureLengthNode* node, SymbolTable* st)
 
 ProError execute_begin_catch_error_ctx(CatchErrorNode* node, ExecContext* ctx)
 {
-	if (!node || !ctx || !ctx->st) return PRO_TK_BAD_INPUTS;
+	if (!node || !ctx || !ctx->st || !ctx->exec) return PRO_TK_BAD_INPUTS;
+	ExecState* es = ctx->exec;
 
 	/* Save old flags */
-	int had_active = 0, old_active = 0;
-	int had_udf = 0, old_udf = 0;
-	int had_comp = 0, old_comp = 0;
-	int had_last = 0, old_last = 0;
-
-	had_active = st_get_int(ctx->st, "__CATCH_ACTIVE", &old_active);
-	had_udf = st_get_int(ctx->st, "__CATCH_FIX_FAIL_UDF", &old_udf);
-	had_comp = st_get_int(ctx->st, "__CATCH_FIX_FAIL_COMPONENT", &old_comp);
-	had_last = st_get_int(ctx->st, "__LAST_ERROR", &old_last);
+	const int old_active = es->catch_active;
+	const int old_udf = es->catch_fix_fail_udf;
+	const int old_comp = es->catch_fix_fail_component;
+	const int old_last = es->last_error;
 
 	/* Arm catch mode for this block */
-	st_put_int(ctx->st, "__CATCH_ACTIVE", 1);
-	st_put_int(ctx->st, "__CATCH_FIX_FAIL_UDF", node->fix_fail_udf ? 1 : 0);
-	st_put_int(ctx->st, "__CATCH_FIX_FAIL_COMPONENT", node->fix_fail_component ? 1 : 0);
-	st_put_int(ctx->st, "__LAST_ERROR", 0);
+	es->catch_active = 1;
+	es->catch_fix_fail_udf = node->fix_fail_udf ? 1 : 0;
+	es->catch_fix_fail_component = node->fix_fail_component ? 1 : 0;
+	es->last_error = 0;
 
 	/* Run nested commands; swallow runtime errors and continue */
 	ProError agg = PRO_TK_NO_ERROR;
@@ -3360,35 +3389,20 @@ ProError execute_begin_catch_error_ctx(CatchErrorNode* node, ExecContext* ctx)
 		ProError rc = exec_command_in_context(inner, ctx);
 		if (rc != PRO_TK_NO_ERROR) {
 			if (rc == PRO_TK_ABORT) {      // <-- make abort uncatchable
-				// restore flags before you leave
-				if (had_active) st_put_int(ctx->st, "__CATCH_ACTIVE", old_active);
-				else            remove_symbol(ctx->st, "__CATCH_ACTIVE");
-				if (had_udf)    st_put_int(ctx->st, "__CATCH_FIX_FAIL_UDF", old_udf);
-				else            remove_symbol(ctx->st, "__CATCH_FIX_FAIL_UDF");
-				if (had_comp)   st_put_int(ctx->st, "__CATCH_FIX_FAIL_COMPONENT", old_comp);
-				else            remove_symbol(ctx->st, "__CATCH_FIX_FAIL_COMPONENT");
-				if (had_last)   st_put_int(ctx->st, "__LAST_ERROR", old_last);
-				else            remove_symbol(ctx->st, "__LAST_ERROR");
-				return PRO_TK_ABORT;
+				agg = PRO_TK_ABORT;
+				break;
 			}
 			ProPrintfChar("BEGIN_CATCH_ERROR: caught error %d; continuing\n", (int)rc);
-			st_put_int(ctx->st, "__LAST_ERROR", (int)rc);
+			es->last_error = (int)rc;
 			agg = PRO_TK_NO_ERROR; // swallow non-fatal
 		}
 	}
 
 	/* Restore old flags */
-	if (had_active) st_put_int(ctx->st, "__CATCH_ACTIVE", old_active);
-	else            remove_symbol(ctx->st, "__CATCH_ACTIVE");
-
-	if (had_udf)    st_put_int(ctx->st, "__CATCH_FIX_FAIL_UDF", old_udf);
-	else            remove_symbol(ctx->st, "__CATCH_FIX_FAIL_UDF");
-
-	if (had_comp)   st_put_int(ctx->st, "__CATCH_FIX_FAIL_COMPONENT", old_comp);
-	else            remove_symbol(ctx->st, "__CATCH_FIX_FAIL_COMPONENT");
-
-	if (had_last)   st_put_int(ctx->st, "__LAST_ERROR", old_last);
-	else            remove_symbol(ctx->st, "__LAST_ERROR");
+	es->catch_active = old_active;
+	es->catch_fix_fail_udf = old_udf;
+	es->catch_fix_fail_component = old_comp;
+	es->last_error = old_last;
 
 	return agg;
 }
@@ -3419,10 +3433,8 @@ ProError execute_invalidate_param(InvalidateParamNode* node, SymbolTable* st) {
 /* Single source of truth for command dispatch. */
 ProError dispatch_core(CommandNode* node, ExecContext* ctx)
 {
-	int stop = 0; (void)st_get_int(ctx->st, "__GLOBAL_ABORT", &stop);
-	if (stop) return PRO_TK_ABORT;
-
 	if (!node || !ctx || !ctx->st) return PRO_TK_BAD_INPUTS;
+	if (ctx->exec && ctx->exec->global_abort) return PRO_TK_ABORT;
 
 	switch (node->type)
 	{
@@ -3521,133 +3533,27 @@ ProError execute_command(CommandNode* node, SymbolTable* st, BlockList* block_li
 	tmp.st = st;
 	tmp.block_list = block_list;
 	tmp.ui = NULL;   /* headless path */
+	tmp.exec = st ? st->exec : NULL;
 	tmp.reactive = 0;
 	return dispatch_core(node, &tmp);
 }
 
-/* ---------- helpers: symbol-table map access (local-only) ---------- */
-static HashTable* sym_lookup_map(SymbolTable* st, const char* key)
-{
-	if (!st || !key) return NULL;
-	Variable* v = get_symbol(st, (char*)key);
-	if (!v || v->type != TYPE_MAP || !v->data.map) return NULL;
-	return v->data.map;
-}
-
-static int map_get_int(HashTable* map, const char* key, int defv)
-{
-	if (!map || !key) return defv;
-	Variable* v = hash_table_lookup(map, key);
-	if (!v) return defv;
-	switch (v->type) {
-	case TYPE_INTEGER:
-	case TYPE_BOOL:   return v->data.int_value;
-	case TYPE_DOUBLE: return (int)v->data.double_value;
-	default:          return defv;
-	}
-}
-
-static const char* map_get_str(HashTable* map, const char* key)
-{
-	if (!map || !key) return NULL;
-	Variable* v = hash_table_lookup(map, key);
-	if (!v || v->type != TYPE_STRING) return NULL;
-	return v->data.string_value;
-}
-
-/* Find this assignment's (assign_id, if_id) by consulting ASSIGNMENTS.
-   Prefer an entry whose lhs_name == lhs_name and, if current_if_id>0,
-   whose if_id == current_if_id. Falls back to the first matching lhs. */
-static int scan_assign_registry_for(SymbolTable* st, const char* lhs_name, int current_if_id, int* out_assign_id, int* out_if_id)
-{
-	if (out_assign_id) *out_assign_id = 0;
-	if (out_if_id)     *out_if_id = 0;
-	if (!st || !lhs_name) return 0;
-
-	HashTable* reg = sym_lookup_map(st, "ASSIGNMENTS");
-	if (!reg) return 0;
-
-	int found_any = 0;
-	int found_id = 0;
-	int found_if = 0;
-
-	for (size_t k = 0; k < reg->key_count; ++k) {
-		const char* kname = reg->key_order[k];
-		if (!kname) continue;
-		if (strncmp(kname, "ASSIGN_", 7) != 0) continue;
-
-		Variable* v = hash_table_lookup(reg, kname);
-		if (!v || v->type != TYPE_MAP || !v->data.map) continue;
-
-		HashTable* m = v->data.map;
-		const char* lhs = map_get_str(m, "lhs_name");
-		if (!lhs || strcmp(lhs, lhs_name) != 0) continue;
-
-		int id = map_get_int(m, "assign_id", 0);
-		int ifid = map_get_int(m, "if_id", 0);
-
-		if (current_if_id > 0) {
-			if (ifid == current_if_id) {
-				if (out_assign_id) *out_assign_id = id;
-				if (out_if_id)     *out_if_id = ifid;
-				return 1; /* perfect match */
-			}
-			/* else keep scanning; we may still record a fallback */
-		}
-
-		if (!found_any) {
-			found_any = 1;
-			found_id = id;
-			found_if = ifid;
-		}
-	}
-
-	if (found_any) {
-		if (out_assign_id) *out_assign_id = found_id;
-		if (out_if_id)     *out_if_id = found_if;
-		return 1;
-	}
-	return 0;
-}
-
-/* Gate decision:
-   - __TARGET_ASSIGN_ID (optional): if set (>0), only run the matching assignment id.
-   - __CURRENT_IF_ID     (optional): if set (>0), prefer/limit to that IF's assignments.
-   If metadata is missing, we do not block execution. */
-static int should_gate_assignment(SymbolTable* st, int node_assign_id, int node_if_id)
+/* Gate decision, from the metadata semantic analysis put on the node:
+   - target assignment of the run (optional): if set (>0), only run that assignment id.
+   - current IF of the run (optional): if set (>0), only run assignments tied to it.
+   An assignment outside any IF is never blocked by the current IF. */
+static int should_gate_assignment(const AssignmentNode* node, const ExecState* es)
 {
-	int target_assign = 0;
-	{
-		Variable* v = get_symbol(st, "__TARGET_ASSIGN_ID");
-		if (v) {
-			if (v->type == TYPE_INTEGER || v->type == TYPE_BOOL)
-				target_assign = v->data.int_value;
-			else if (v->type == TYPE_DOUBLE)
-				target_assign = (int)v->data.double_value;
-		}
-	}
+	if (!es) return 1;
 
-	int current_if = 0;
-	{
-		Variable* v = get_symbol(st, "__CURRENT_IF_ID");
-		if (v) {
-			if (v->type == TYPE_INTEGER || v->type == TYPE_BOOL)
-				current_if = v->data.int_value;
-			else if (v->type == TYPE_DOUBLE)
-				current_if = (int)v->data.double_value;
-		}
-	}
-
-	if (target_assign > 0 && node_assign_id > 0 && node_assign_id != target_assign) {
-		LogOnlyPrintfChar("Skip assignment id=%d (target=%d)\n", node_assign_id, target_assign);
+	if (es->target_assign_id > 0 && node->assign_id > 0 && node->assign_id != es->target_assign_id) {
+		LOG_DEBUG("Skip assignment id=%d (target=%d)\n", node->assign_id, es->target_assign_id);
 		return 0;
 	}
 
-	/* If a current IF is declared, prefer to run only assignments tied to it.
-	   If the assignment has no known if_id, do not block. */
-	if (current_if > 0 && node_if_id > 0 && node_if_id != current_if) {
-		LogOnlyPrintfChar("Skip assignment id=%d (if_id=%d) due to __CURRENT_IF_ID=%d\n",
-			node_assign_id, node_if_id, current_if);
+	if (es->current_if_id > 0 && node->if_id > 0 && node->if_id != es->current_if_id) {
+		LOG_DEBUG("Skip assignment id=%d (if_id=%d) due to current IF %d\n",
+			node->assign_id, node->if_id, es->current_if_id);
 		return 0;
 	}
 
@@ -3670,29 +3576,13 @@ ProError execute_assignment(AssignmentNode* node, SymbolTable* st, BlockList* bl
 		return PRO_TK_GENERAL_ERROR;
 	}
 
-	Variable* dst = get_symbol(st, (char*)lhs_name);
+	Variable* dst = node->lhs_slot ? get_symbol_at(st, node->lhs_slot) : get_symbol(st, (char*)lhs_name);
 	if (!dst) {
 		ProPrintfChar("Error: Assignment to undeclared variable '%s'\n", lhs_name);
 		return PRO_TK_GENERAL_ERROR;
 	}
 
-	/* Resolve metadata from symbol table so we can gate */
-	int current_if_id = 0;
-	{
-		Variable* v = get_symbol(st, "__CURRENT_IF_ID");
-		if (v) {
-			if (v->type == TYPE_INTEGER || v->type == TYPE_BOOL)
-				current_if_id = v->data.int_value;
-			else if (v->type == TYPE_DOUBLE)
-				current_if_id = (int)v->data.double_value;
-		}
-	}
-
-	int meta_assign_id = 0;
-	int meta_if_id = 0;
-	(void)scan_assign_registry_for(st, lhs_name, current_if_id, &meta_assign_id, &meta_if_id); /* best effort */
-
-	if (!should_gate_assignment(st, meta_assign_id, meta_if_id)) {
+	if (!should_gate_assignment(node, st->exec)) {
 		/* Politely decline to run; not an error */
 		return PRO_TK_NO_ERROR;
 	}
@@ -3705,62 +3595,67 @@ ProError execute_assignment(AssignmentNode* node, SymbolTable* st, BlockList* bl
 			ProPrintfChar("Error: Failed to evaluate string RHS for '%s'\n", lhs_name);
 			return PRO_TK_GENERAL_ERROR;
 		}
+		int changed = !dst->data.string_value || strcmp(dst->data.string_value, sval) != 0;
 		if (dst->data.string_value) free(dst->data.string_value);
 		dst->data.string_value = sval; /* take ownership */
-		LogOnlyPrintfChar("Assignment[%d] (if=%d): %s := \"%s\"\n",
-			meta_assign_id, meta_if_id, lhs_name,
+		if (changed) touch_symbol(st, lhs_name);
+		LOG_DEBUG("Assignment[%d] (if=%d): %s := \"%s\"\n",
+			node->assign_id, node->if_id, lhs_name,
 			dst->data.string_value ? dst->data.string_value : "");
 		return PRO_TK_NO_ERROR;
 	}
 
-	/* General expression path */
-	Variable* rhs = NULL;
-	int est = evaluate_expression(node->rhs, st, &rhs);
-	if (est != 0 || !rhs) {
+	/* General expression path (no heap result) */
+	EpaValue rhs;
+	if (evaluate_value(node->rhs, st, &rhs) != 0) {
 		ProPrintfChar("Error: Failed to evaluate RHS for '%s'\n", lhs_name);
 		return PRO_TK_GENERAL_ERROR;
 	}
 
-	/* Type-compatible write with simple coercions */
+	/* Type-compatible write with simple coercions; dst is written in place, so
+	   the change is recorded below rather than by set_symbol */
+	Variable before = *dst;
 	switch (dst->type) {
 	case TYPE_INTEGER:
 	case TYPE_BOOL:
-		if (rhs->type == TYPE_INTEGER || rhs->type == TYPE_BOOL) {
-			dst->data.int_value = rhs->data.int_value;
+		if (rhs.type == TYPE_INTEGER || rhs.type == TYPE_BOOL) {
+			dst->data.int_value = rhs.data.int_value;
 		}
-		else if (rhs->type == TYPE_DOUBLE) {
-			dst->data.int_value = (int)rhs->data.double_value;
+		else if (rhs.type == TYPE_DOUBLE) {
+			dst->data.int_value = (int)rhs.data.double_value;
 		}
 		else {
-			free_variable(rhs);
 			ProPrintfChar("Error: Type mismatch assigning to '%s'\n", lhs_name);
 			return PRO_TK_GENERAL_ERROR;
 		}
 		break;
 
 	case TYPE_DOUBLE:
-		if (rhs->type == TYPE_DOUBLE) {
-			dst->data.double_value = rhs->data.double_value;
-		}
-		else if (rhs->type == TYPE_INTEGER || rhs->type == TYPE_BOOL) {
-			dst->data.double_value = (double)rhs->data.int_value;
+		if (epa_to_double(&rhs, &dst->data.double_value) != 0) {
+			ProPrintfChar("Error: Type mismatch assigning to '%s'\n", lhs_name);
+			return PRO_TK_GENERAL_ERROR;
 		}
-		else {
-			free_variable(rhs);
+		break;
+
+	case TYPE_ARRAY:
+	case TYPE_MAP:
+	case TYPE_STRUCTURE:
+		/* Aggregates are shared copy-on-write: O(1) whatever their size */
+		if (rhs.type != dst->type || !rhs.data.var || variable_share_into(dst, rhs.data.var) != 0) {
 			ProPrintfChar("Error: Type mismatch assigning to '%s'\n", lhs_name);
 			return PRO_TK_GENERAL_ERROR;
 		}
 		break;
 
 	default:
-		free_variable(rhs);
 		ProPrintfChar("Error: Unsupported LHS type for '%s'\n", lhs_name);
 		return PRO_TK_GENERAL_ERROR;
 	}
 
-	LogOnlyPrintfChar("Assignment[%d] (if=%d): %s := (type %d)\n",
-		meta_assign_id, meta_if_id, lhs_name, dst->type);
-	free_variable(rhs);
+	if (memcmp(&before.data, &dst->data, sizeof(dst->data)) != 0) touch_symbol(st, lhs_name);
+
+	LOG_DEBUG("Assignment[%d] (if=%d): %s := (type %d)\n",
+		node->assign_id, node->if_id, lhs_name, dst->type);
 	return PRO_TK_NO_ERROR;
 }
 
@@ -3846,18 +3741,14 @@ ProError apply_ui_gate_to_block(Block* blk, ExecContext* ctx, ProBoolean enabled
 
 /*=================================================*
  * recompute_if_gates_only (target-aware)
- * - If __TARGET_IF_ID == 0: behave exactly as before (all IFs).
- * - If __TARGET_IF_ID != 0: only recompute/gate that IF id.
+ * - If the run's target IF id is 0: behave exactly as before (all IFs).
+ * - Otherwise: only recompute/gate that IF id.
  *=================================================*/
 static ProError recompute_if_gates_only(Block* blk, ExecContext* ctx)
 {
-	if (!blk || !ctx || !ctx->st) return PRO_TK_NO_ERROR;
+	if (!blk || !ctx || !ctx->st || !ctx->exec) return PRO_TK_NO_ERROR;
 
-	int target_if_id = 0;
-	{
-		Variable* v = get_symbol(ctx->st, "__TARGET_IF_ID");
-		if (v && v->type == TYPE_INTEGER) target_if_id = v->data.int_value;
-	}
+	const int target_if_id = ctx->exec->target_if_id;
 
 	for (size_t i = 0; i < blk->command_count; ++i) {
 		CommandNode* cmd = blk->commands[i];
@@ -3865,7 +3756,7 @@ static ProError recompute_if_gates_only(Block* blk, ExecContext* ctx)
 
 		if (cmd->type == COMMAND_IF) {
 			IfNode* node = (IfNode*)cmd->data;
-			int gate_id = if_gate_id_of(node, g_active_st);
+			int gate_id = if_gate_id_of(node, ctx->st);
 
 			/* skip unrelated IFs when a target is requested */
 			if (target_if_id != 0 && gate_id != target_if_id) {
@@ -3873,49 +3764,12 @@ static ProError recompute_if_gates_only(Block* blk, ExecContext* ctx)
 				continue;
 			}
 
-			/* evaluate winner */
+			/* winner (shared with the other refresh walkers) */
 			size_t winning = (size_t)-1;
-			for (size_t b = 0; b < node->branch_count; ++b) {
-				Variable* cond_val = NULL;
-				int est = evaluate_expression(node->branches[b]->condition, ctx->st, &cond_val);
-				if (est != 0 || !cond_val) { return PRO_TK_GENERAL_ERROR; }
-
-				/* numeric/bool truthiness as in your engine */
-				{
-					int truth = 0;
-					if (cond_val->type == TYPE_BOOL || cond_val->type == TYPE_INTEGER)
-						truth = (cond_val->data.int_value != 0);
-					else if (cond_val->type == TYPE_DOUBLE)
-						truth = (cond_val->data.double_value != 0.0);
-					free_variable(cond_val);
-					if (truth) { winning = b; break; }
-				}
-			}
+			if (if_winner(node, ctx->st, &winning) != 0) { return PRO_TK_GENERAL_ERROR; }
 
-			/* read previous winner */
-			char key_prev[64]; snprintf(key_prev, sizeof(key_prev), "IF_STATE.%d.winner", gate_id);
-			Variable* prev_v = get_symbol(ctx->st, key_prev);
-			int prev = -1;
-			if (prev_v && prev_v->type == TYPE_INTEGER) prev = prev_v->data.int_value;
-
-			/* store current winner */
-			{
-				Variable* nv = (Variable*)malloc(sizeof(Variable));
-				if (!nv) return PRO_TK_GENERAL_ERROR;
-				nv->type = TYPE_INTEGER;
-				nv->data.int_value = (int)winning;
-				set_symbol(ctx->st, key_prev, nv);
-			}
-
-			/* mark dirty if changed */
-			if ((int)winning != prev) {
-				char key_dirty[64]; snprintf(key_dirty, sizeof(key_dirty), "IF_STATE.%d.dirty", gate_id);
-				Variable* dv = (Variable*)malloc(sizeof(Variable));
-				if (!dv) return PRO_TK_GENERAL_ERROR;
-				dv->type = TYPE_INTEGER;
-				dv->data.int_value = 1;
-				set_symbol(ctx->st, key_dirty, dv);
-			}
+			/* remember the winner; the IF is marked dirty when it changed */
+			if (exec_state_record_winner(ctx->exec, gate_id, (int)winning) < 0) return PRO_TK_GENERAL_ERROR;
 
 			/* NEW: gate OFF all branches (and ELSE), then gate ON only the winner */
 			if (ctx->ui) {
@@ -3975,7 +3829,7 @@ ProError exec_command_in_context(CommandNode* node, ExecContext* ctx)
 
 ProError execute_if_ctx(IfNode* node, ExecContext* ctx)
 {
-	if (!node || !ctx || !ctx->st) return PRO_TK_BAD_INPUTS;
+	if (!node || !ctx || !ctx->st || !ctx->exec) return PRO_TK_BAD_INPUTS;
 
 	// 0) GUI pre-pass: ensure USER_SELECT controls exist so gating can work. We keep the scope tight: only for this IF subtree. 
 	if (ctx->ui) {
@@ -4002,27 +3856,24 @@ ProError execute_if_ctx(IfNode* node, ExecContext* ctx)
 	// 1) Find the first true branch (single-pass, no duplicate evaluation). 
 	size_t winning = (size_t)-1;
 	for (size_t b = 0; b < node->branch_count; ++b) {
-		Variable* cond_val = NULL;
-		int est = evaluate_expression(node->branches[b]->condition, ctx->st, &cond_val);
-		if (est != 0 || !cond_val) {
+		EpaValue cond_val;
+		if (evaluate_value(node->branches[b]->condition, ctx->st, &cond_val) != 0) {
 			ProGenericMsg(L"Error: IF condition evaluation failed");
 			return PRO_TK_GENERAL_ERROR;
 		}
 
 		// Accept bool or numeric truthiness (unchanged semantics). 
 		bool truth = false;
-		if (cond_val->type == TYPE_BOOL || cond_val->type == TYPE_INTEGER) {
-			truth = (cond_val->data.int_value != 0);
+		if (cond_val.type == TYPE_BOOL || cond_val.type == TYPE_INTEGER) {
+			truth = (cond_val.data.int_value != 0);
 		}
-		else if (cond_val->type == TYPE_DOUBLE) {
-			truth = (cond_val->data.double_value != 0.0);
+		else if (cond_val.type == TYPE_DOUBLE) {
+			truth = (cond_val.data.double_value != 0.0);
 		}
 		else {
-			free_variable(cond_val);
 			ProGenericMsg(L"Error: IF condition must be bool or numeric");
 			return PRO_TK_GENERAL_ERROR;
 		}
-		free_variable(cond_val);
 
 		if (truth) { winning = b; break; }
 	}
@@ -4031,10 +3882,10 @@ ProError execute_if_ctx(IfNode* node, ExecContext* ctx)
 	if (winning != (size_t)-1) {
 		IfBranch* br = node->branches[winning];
 
-		/* NEW: push __CURRENT_IF_ID for this IF while we execute its branch */
+		/* NEW: make this IF current while we execute its branch */
 		int gate_id = if_gate_id_of(node, ctx->st);
-		int old_cur = 0, had_old = st_get_int(ctx->st, "__CURRENT_IF_ID", &old_cur);
-		st_put_int(ctx->st, "__CURRENT_IF_ID", gate_id);
+		const int old_cur = ctx->exec->current_if_id;
+		ctx->exec->current_if_id = gate_id;
 
 		if (ctx->ui) {
 			Block temp = { 0 };
@@ -4047,25 +3898,23 @@ ProError execute_if_ctx(IfNode* node, ExecContext* ctx)
 			ProError s = exec_command_in_context(br->commands[i], ctx);
 			if (s != PRO_TK_NO_ERROR) {
 				/* restore before returning */
-				if (had_old) st_put_int(ctx->st, "__CURRENT_IF_ID", old_cur);
-				else remove_symbol(ctx->st, "__CURRENT_IF_ID");
+				ctx->exec->current_if_id = old_cur;
 				return s;
 			}
 		}
 
-		/* restore previous __CURRENT_IF_ID */
-		if (had_old) st_put_int(ctx->st, "__CURRENT_IF_ID", old_cur);
-		else remove_symbol(ctx->st, "__CURRENT_IF_ID");
+		/* restore the previous current IF */
+		ctx->exec->current_if_id = old_cur;
 
 		return PRO_TK_NO_ERROR;
 	}
 
 	/* ELSE branch */
 	if (node->else_command_count > 0) {
-		/* NEW: push __CURRENT_IF_ID for this IF while we execute ELSE */
+		/* NEW: make this IF current while we execute ELSE */
 		int gate_id = if_gate_id_of(node, ctx->st);
-		int old_cur = 0, had_old = st_get_int(ctx->st, "__CURRENT_IF_ID", &old_cur);
-		st_put_int(ctx->st, "__CURRENT_IF_ID", gate_id);
+		const int old_cur = ctx->exec->current_if_id;
+		ctx->exec->current_if_id = gate_id;
 
 		if (ctx->ui) {
 			Block temp = { 0 };
@@ -4077,14 +3926,12 @@ ProError execute_if_ctx(IfNode* node, ExecContext* ctx)
 		for (size_t i = 0; i < node->else_command_count; ++i) {
 			ProError s = exec_command_in_context(node->else_commands[i], ctx);
 			if (s != PRO_TK_NO_ERROR) {
-				if (had_old) st_put_int(ctx->st, "__CURRENT_IF_ID", old_cur);
-				else remove_symbol(ctx->st, "__CURRENT_IF_ID");
+				ctx->exec->current_if_id = old_cur;
 				return s;
 			}
 		}
 
-		if (had_old) st_put_int(ctx->st, "__CURRENT_IF_ID", old_cur);
-		else remove_symbol(ctx->st, "__CURRENT_IF_ID");
+		ctx->exec->current_if_id = old_cur;
 	}
 
 	return PRO_TK_NO_ERROR;
@@ -4096,6 +3943,7 @@ ProError execute_if(IfNode* node, SymbolTable* st, BlockList* block_list, Dialog
 	ctx.st = st;
 	ctx.block_list = block_list;
 	ctx.ui = state;
+	ctx.exec = st ? st->exec : NULL;
 	return execute_if_ctx(node, &ctx);
 }
 
@@ -4104,16 +3952,16 @@ ProError execute_asm_block(Block* asm_block, SymbolTable* st, BlockList* block_l
 	if (!asm_block || !st) return PRO_TK_BAD_INPUTS;
 
 	/* optional: reset per-run markers */
-	st_put_int(st, "__CURRENT_IF_ID", 0);
+	if (st->exec) st->exec->current_if_id = 0;
 
 	ExecContext ctx = { 0 };
-	ctx.st = st; ctx.block_list = block_list; ctx.ui = NULL;
+	ctx.st = st; ctx.block_list = block_list; ctx.ui = NULL; ctx.exec = st->exec;
 
 	for (size_t i = 0; i < asm_block->command_count; ++i) {
 		ProError s = exec_command_in_context(asm_block->commands[i], &ctx);
 		if (s != PRO_TK_NO_ERROR) {
 			ProPrintfChar("Stopping due to error: %s\n", pro_error_to_string(s));
-			st_put_int(st, "__GLOBAL_ABORT", 1);   // <— flip kill-switch
+			(void)abort_script(st->exec, s);   // <— flip kill-switch
 			return s == PRO_TK_ABORT ? PRO_TK_ABORT : PRO_TK_GENERAL_ERROR;
 		}
 	}
@@ -4125,109 +3973,145 @@ ProError execute_asm_block(Block* asm_block, SymbolTable* st, BlockList* block_l
  * Dirty UI param journal and targeted reactive refresh
  * ------------------------------------------------------------------------- */
 
-static Variable* ensure_string_array(SymbolTable* st, const char* key)
+void EPA_MarkDirty(SymbolTable* st, const char* param_name)
 {
-	Variable* v = get_symbol(st, (char*)key);
-	if (!v) {
-		v = (Variable*)calloc(1, sizeof(Variable));
-		if (!v) return NULL;
-		v->type = TYPE_ARRAY;
-		v->data.array.size = 0;
-		v->data.array.elements = NULL;
-		set_symbol(st, (char*)key, v);
-	}
-	else if (v->type != TYPE_ARRAY) {
-		return NULL;
-	}
-	return v;
+	if (!st || !param_name || !param_name[0]) return;
+	/* A name the table has never bound is read by no node */
+	size_t slot = find_symbol_slot(st, param_name);
+	if (slot != 0) slot_set_add(&st->dirty, slot, st->table->entry_capacity);
 }
 
-static int string_array_contains(Variable* arr, const char* s)
+/* de-dupe small int set */
+static int contains_id(const int* ids, size_t n, int id)
 {
-	if (!arr || arr->type != TYPE_ARRAY || !s) return 0;
-	for (size_t i = 0; i < arr->data.array.size; ++i) {
-		Variable* it = arr->data.array.elements[i];
-		if (it && it->type == TYPE_STRING && it->data.string_value &&
-			strcmp(it->data.string_value, s) == 0) return 1;
-	}
+	for (size_t i = 0; i < n; ++i) if (ids[i] == id) return 1;
 	return 0;
 }
 
-void EPA_MarkDirty(SymbolTable* st, const char* param_name)
-{
-	if (!st || !param_name || !param_name[0]) return;
-	Variable* arr = ensure_string_array(st, "DIRTY_UI_PARAMS");
-	if (!arr) return;
-
-	if (!string_array_contains(arr, param_name)) {
-		Variable* sv = (Variable*)calloc(1, sizeof(Variable));
-		if (!sv) return;
-		sv->type = TYPE_STRING;
-		sv->data.string_value = _strdup(param_name);
-		if (!sv->data.string_value) { free(sv); return; }
-
-		size_t n = arr->data.array.size + 1;
-		Variable** grown = (Variable**)realloc(arr->data.array.elements, n * sizeof(*grown));
-		if (!grown) { free(sv->data.string_value); free(sv); return; }
-		arr->data.array.elements = grown;
-		arr->data.array.elements[n - 1] = sv;
-		arr->data.array.size = n;
-	}
-}
-
-/* fetch if_gate_id previously attached by pretag_if_gated(...) */
-static int gate_for_param(SymbolTable* st, const char* param_name)
+/* Turn the dirty slot set into refresh work using the dependency graph built by
+   semantic analysis: the root IF gates whose subtrees hold an affected node, in
+   topological order, and whether a REQUIRED_* check is affected. A change that
+   reaches a block-level command (or an empty set, or no graph) needs a full
+   pass. Returns the gate count; *gates_out is NULL for a full pass, otherwise it
+   is gates, the caller's buffer of gates_cap ids. The buffer belongs to one
+   refresh: a nested refresh from a UI callback plans into its own. */
+static size_t plan_reactive_refresh(SymbolTable* st, int* gates, size_t gates_cap, const int** gates_out, int* validate)
 {
-	Variable* v = get_symbol(st, (char*)param_name);
-	if (!v || v->type != TYPE_MAP || !v->data.map) return 0;
-
-	Variable* tag = hash_table_lookup(v->data.map, "if_gate_id");
-	if (tag && tag->type == TYPE_INTEGER && tag->data.int_value > 0) {
-		return tag->data.int_value;
+	*gates_out = NULL;
+	*validate = 1;
+
+	DepGraph* g = st->deps;
+	size_t dirty = st->dirty.count;
+	if (!g || dirty == 0 || !gates || gates_cap < g->node_count) return 0;
+
+	const size_t* affected = NULL;
+	size_t count = depgraph_affected(g, &st->dirty, &affected);
+	size_t gate_count = 0;
+	int full = 0;
+	*validate = 0;
+	for (size_t k = 0; k < count && !full; ++k) {
+		const DepNode* node = &g->nodes[affected[k]];
+		if (node->kind == DEP_REQUIRED) { *validate = 1; continue; }
+		if (node->kind == DEP_TABLE) continue;   /* tables rebuild from their own callbacks */
+		if (!node->root_if) { full = 1; break; }
+		int gid = if_gate_id_of(node->root_if, st);
+		if (!contains_id(gates, gate_count, gid)) gates[gate_count++] = gid;
+	}
+
+	LOG_DEBUG("Reactive refresh: %zu dirty slot(s) reach %zu node(s); %s\n", dirty, count,
+		full ? "full pass" : (gate_count ? "targeted gates" : "nothing to recompute"));
+	if (full) {
+		*validate = 1;
+		return 0;
 	}
-	return 0; /* unknown -> full fallback */
+	*gates_out = gates;
+	return gate_count;
 }
 
-/* de-dupe small int set */
-static int contains_id(const int* ids, size_t n, int id)
+/* (Re)build the dialog's slot watches from the dependency graph: everything the
+   graph reads, what the REQUIRED_* checks read (plus the lists themselves), and
+   what decides the draw area's content (IF conditions, SUB_PICTURE expressions,
+   GLOBAL_PICTURE). A change to a slot outside a watch cannot alter that work. */
+static void bind_refresh_watches(DialogState* state, SymbolTable* st)
 {
-	for (size_t i = 0; i < n; ++i) if (ids[i] == id) return 1;
-	return 0;
+	DepGraph* g = st->deps;
+	if (state->watch_graph == g) return;
+
+	slot_watch_free(&state->refresh_watch);
+	slot_watch_free(&state->required_watch);
+	slot_watch_free(&state->redraw_watch);
+	state->watch_graph = g;
+	if (!g) return;
+
+	for (size_t s = 1; s < g->slot_count; ++s) {
+		int read = 0, required = 0, drawn = 0;
+		for (size_t r = g->reader_start[s]; r < g->reader_start[s + 1]; ++r) {
+			DepNodeKind kind = g->nodes[g->readers[r]].kind;
+			read = 1;
+			if (kind == DEP_REQUIRED) required = 1;
+			else if (kind == DEP_IF || kind == DEP_SUB_PICTURE) drawn = 1;
+		}
+		if (read) (void)slot_watch_add(&state->refresh_watch, s);
+		if (required) (void)slot_watch_add(&state->required_watch, s);
+		if (drawn) (void)slot_watch_add(&state->redraw_watch, s);
+	}
+
+	static const char* const required_lists[] = {
+		"REQUIRED_RADIOS", "REQUIRED_SELECTS", "REQUIRED_CHECKBOXES", "REQUIRED_INPUTS"
+	};
+	for (size_t i = 0; i < sizeof(required_lists) / sizeof(required_lists[0]); ++i) {
+		(void)slot_watch_add(&state->required_watch, reserve_symbol_slot(st, required_lists[i]));
+	}
+	(void)slot_watch_add(&state->redraw_watch, reserve_symbol_slot(st, "GLOBAL_PICTURE"));
 }
 
-/* REPLACEMENT for EPA_ReactiveRefresh: targeted, multi-gate aware */
 void EPA_ReactiveRefresh(void)
 {
 	if (!g_active_state || !g_active_state->dialog_name || !g_active_st || !g_active_state->gui_block)
 		return;
 
-	/* Build target set from DIRTY_UI_PARAMS; fall back to {0} if empty. */
-	int targets[64]; size_t tcount = 0;
-
-	Variable* arr = get_symbol(g_active_st, "DIRTY_UI_PARAMS");
-	if (arr && arr->type == TYPE_ARRAY && arr->data.array.size > 0) {
-		for (size_t i = 0; i < arr->data.array.size; ++i) {
-			Variable* it = arr->data.array.elements[i];
-			if (!it || it->type != TYPE_STRING || !it->data.string_value) continue;
-			int gid = gate_for_param(g_active_st, it->data.string_value);
-			if (!contains_id(targets, tcount, gid) && tcount < (sizeof(targets) / sizeof(targets[0]))) {
-				targets[tcount++] = gid; /* gid==0 means “unknown” -> full pass */
-			}
-		}
-		/* Clear the journal so next refresh considers only new dirties */
-		remove_symbol(g_active_st, "DIRTY_UI_PARAMS");
+	/* Nothing the refresh reads changed since the last one: every walker would redo
+	   the same work. Without a graph any change counts. */
+	bind_refresh_watches(g_active_state, g_active_st);
+	int watched = g_active_st->deps != NULL;
+	if (watched ? !slot_watch_changed(g_active_st, &g_active_state->refresh_watch)
+		: g_active_st->change_count == g_active_state->refreshed_at_change) {
+		LOG_DEBUG("Reactive refresh skipped: no symbol it reads changed since the last one\n");
+		slot_set_clear(&g_active_st->dirty);
+		return;
 	}
 
-	if (tcount == 0) {
-		targets[tcount++] = 0; /* full pass */
+	ExecState* es = g_active_st->exec;
+	if (!es) return;
+
+	/* Every walker below reads IF winners from this epoch's cache */
+	unsigned int outer_epoch = if_winner_begin_epoch();
+
+	/* At most one gate per graph node; large graphs plan into the heap */
+	int gate_stack[64];
+	int* gate_buf = gate_stack;
+	size_t gate_cap = sizeof(gate_stack) / sizeof(gate_stack[0]);
+	if (g_active_st->deps && g_active_st->deps->node_count > gate_cap) {
+		gate_cap = g_active_st->deps->node_count;
+		gate_buf = (int*)malloc(gate_cap * sizeof(int));   /* NULL: plan a full pass */
 	}
 
-	/* Run one targeted pass per gate id */
+	int validate = 1;
+	const int* gates = NULL;
+	size_t gate_count = plan_reactive_refresh(g_active_st, gate_buf, gate_cap, &gates, &validate);
+	int full_pass = 0;   /* gate id 0 means "all IFs" to the walkers */
+	const int* targets = gates ? gates : &full_pass;
+	size_t tcount = gates ? gate_count : 1;
+
+	/* Clear the set so next refresh considers only new dirties */
+	slot_set_clear(&g_active_st->dirty);
+
+	/* Run one targeted pass per gate id, in dependency order */
 	for (size_t k = 0; k < tcount; ++k) {
 		const int target_if_id = targets[k];
 
 		/* Publish the target so your walkers can honor it */
-		st_put_int(g_active_st, "__TARGET_IF_ID", target_if_id);
+		es->target_if_id = target_if_id;
 
 		/* Pictures:
 		   - full pass: wipe all then re-emit
@@ -4237,27 +4121,40 @@ void EPA_ReactiveRefresh(void)
 		}
 		rebuild_sub_pictures_only(g_active_state->gui_block, g_active_st); /* targeted-aware walk */
 
-		/* Redraw backing area once per pass (cheap) */
-		addpicture(g_active_state->dialog_name, "draw_area", (ProAppData)g_active_st);
+		/* Redraw backing area once per pass, unless nothing it shows changed since the last redraw */
+		if (!watched || slot_watch_changed(g_active_st, &g_active_state->redraw_watch)) {
+			addpicture(g_active_state->dialog_name, "draw_area", (ProAppData)g_active_st);
+			if (watched) slot_watch_record(g_active_st, &g_active_state->redraw_watch);
+		}
 
 		/* Recompute active IF winners (reactive flag honored inside your exec ctx) */
 		ExecContext ctx = { 0 };
 		ctx.st = g_active_st;
 		ctx.ui = g_active_state;
+		ctx.exec = es;
 		ctx.reactive = 1;
 		recompute_if_gates_only(g_active_state->gui_block, &ctx); /* existing helper */  /* :contentReference[oaicite:7]{index=7} */
 
-		/* Re-apply assignments (winner-aware, targeted by __TARGET_IF_ID) */
+		/* Re-apply assignments (winner-aware, targeted by the run's target IF) */
 		update_assignments_only(g_active_state->gui_block, g_active_st);  /* :contentReference[oaicite:8]{index=8} */
 
 		/* Refresh bound readouts (winner-aware, targeted) */
 		refresh_all_show_params(g_active_state->gui_block, g_active_state->dialog_name, g_active_st); /* :contentReference[oaicite:9]{index=9} */
 	}
 
-	/* Validate once at the end */
-	validate_ok_button(g_active_state->dialog_name, g_active_st); /* same as before */  /* :contentReference[oaicite:10]{index=10} */
+	/* Validate once at the end, when a REQUIRED_* check may have changed and a
+	   slot it reads really did since the last validation */
+	if (validate && (!watched || slot_watch_changed(g_active_st, &g_active_state->required_watch))) {
+		validate_ok_button(g_active_state->dialog_name, g_active_st); /* same as before */  /* :contentReference[oaicite:10]{index=10} */
+		if (watched) slot_watch_record(g_active_st, &g_active_state->required_watch);
+	}
 
 	/* Optional: clear targeting after pass */
-	remove_symbol(g_active_st, "__TARGET_IF_ID");
+	es->target_if_id = 0;
+
+	if (gate_buf != gate_stack) free(gate_buf);
+	if_winner_end_epoch(outer_epoch);
+	g_active_state->refreshed_at_change = g_active_st->change_count;
+	if (watched) slot_watch_record(g_active_st, &g_active_state->refresh_watch);
 }
 
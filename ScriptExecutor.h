@@ -4,6 +4,7 @@
 #include "symboltable.h"
 #include "syntaxanalysis.h"
 #include "utility.h"
+#include "execstate.h"
 
 #define MAX_SUBTABLE_LEVELS 20
 
@@ -44,6 +45,12 @@ typedef struct
     ColumnPlan column_plan;
     char* root_drawarea_id;
     char* root_table_id;
+    unsigned long long refreshed_at_change;  /* st->change_count after the last reactive refresh (0 = never) */
+    /* Slot versions the reactive refresh last saw (see bind_refresh_watches), used while st->deps exists */
+    const struct DepGraph* watch_graph;      /* Graph the watches were built from */
+    SlotWatch refresh_watch;                 /* Every slot the graph reads */
+    SlotWatch required_watch;                /* Slots the REQUIRED_* checks of validate_ok_button read */
+    SlotWatch redraw_watch;                  /* Slots that decide what draw_area shows */
 
 
 
@@ -63,6 +70,7 @@ typedef struct {
     SymbolTable* st;
     BlockList* block_list;
     DialogState* ui;
+    ExecState* exec;  // Abort/CATCH flags and IF gate state of the run (st->exec)
     int reactive;  // 0 for initial execution (build UI + logic), 1 for reactive (logic only, skip UI creation)
 } ExecContext;
 
@@ -82,8 +90,27 @@ ProError execute_declare_variable(DeclareVariableNode* node, SymbolTable* st);
 ProError execute_assignment(AssignmentNode* node, SymbolTable* st, BlockList* block_list);
 ProError execute_sub_picture(SubPictureNode* node, SymbolTable* st);
 int if_gate_id_of(IfNode* n, SymbolTable* st);
-int st_get_int(SymbolTable* st, const char* key, int* out);
-void st_put_int(SymbolTable* st, const char* key, int value);
+
+/* IF winners are memoized per reactive refresh: inside an epoch every walker
+   reuses the first evaluation of an IF's conditions for as long as no symbol
+   changes (st->change_count). Outside an epoch if_winner always evaluates. */
+typedef struct {
+    unsigned long long epochs;
+    unsigned long long lookups;          // if_winner calls
+    unsigned long long evaluations;      // Conditions actually evaluated
+    unsigned long long evaluations_saved;// Conditions skipped thanks to the cache
+} IfWinnerStats;
+
+// Open a fresh epoch (a nested refresh never reuses the outer one's winners);
+// pass the returned value to if_winner_end_epoch to get back to the outer epoch.
+unsigned int if_winner_begin_epoch(void);
+void if_winner_end_epoch(unsigned int outer);
+// First true branch in *winner ((size_t)-1 = ELSE / none). Conditions that fail
+// to evaluate count as false; the return value is then -1.
+int if_winner(IfNode* node, SymbolTable* st, size_t* winner);
+void if_winner_get_stats(IfWinnerStats* out);
+// Journal a changed symbol; the next EPA_ReactiveRefresh recomputes only what reads it
+void EPA_MarkDirty(SymbolTable* st, const char* param_name);
 void EPA_ReactiveRefresh();
 
 #endif // !SCRIPT_EXECUTOR_H
@@ -1,10 +1,15 @@
 #include "symboltable.h"
 #include "utility.h"
 #include "syntaxanalysis.h"
+#include "depgraph.h"
+#include "execstate.h"
+#include "numfmt.h"
+#include "tablestore.h"
 
 
 /* Forward declaration to allow mutual recursion */
 void free_variable(Variable* var);
+static unsigned int array_share_release(Variable** elements);
 
 
 // Static hash function for strings using djb2 algoithm
@@ -19,31 +24,113 @@ static unsigned long hash_function(const char* str)
 	return hash;
 }
 
+/* Grow the index once occupied slots would exceed 3/4 of it */
+#define HASH_TABLE_MIN_SIZE 8
+#define HASH_TABLE_MAX_LOAD_NUM 3
+#define HASH_TABLE_MAX_LOAD_DEN 4
+
+// Round a requested capacity up to the next power of two
+static size_t round_up_pow2(size_t n)
+{
+	size_t p = HASH_TABLE_MIN_SIZE;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+// Find the index slot referring to key, or the empty slot where it would be inserted
+static size_t find_slot(const HashTable* ht, const char* key, unsigned long hash)
+{
+	size_t mask = ht->size - 1;
+	size_t i = (size_t)hash & mask;
+	while (ht->index[i] != 0)
+	{
+		const HashEntry* e = &ht->entries[ht->index[i] - 1];
+		if (e->hash == hash && strcmp(e->key, key) == 0)
+		{
+			return i;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+// Rebuild the probe index with new_size slots from every entry that still owns a key
+static int hash_table_reindex(HashTable* ht, size_t new_size)
+{
+	size_t* new_index = calloc(new_size, sizeof(size_t));
+	if (!new_index) return 0;
+
+	size_t mask = new_size - 1;
+	for (size_t e = 0; e < ht->entry_count; e++)
+	{
+		if (!ht->entries[e].key) continue;
+		size_t i = (size_t)ht->entries[e].hash & mask;
+		while (new_index[i] != 0) i = (i + 1) & mask;
+		new_index[i] = e + 1;
+	}
+	free(ht->index);
+	ht->index = new_index;
+	ht->size = new_size;
+	return 1;
+}
+
+// Squeeze removed entries out of an unpinned table, preserving insertion order
+static void hash_table_compact(HashTable* ht)
+{
+	size_t w = 0;
+	for (size_t r = 0; r < ht->entry_count; r++)
+	{
+		if (!ht->entries[r].value) continue;
+		ht->entries[w++] = ht->entries[r];
+	}
+	ht->entry_count = w;
+	(void)hash_table_reindex(ht, ht->size);
+}
+
+// Clear the index slot at hole using backward-shift deletion, so probes never need tombstones
+static void index_delete_slot(HashTable* ht, size_t hole)
+{
+	size_t mask = ht->size - 1;
+	size_t i = (hole + 1) & mask;
+	while (ht->index[i] != 0)
+	{
+		size_t home = (size_t)ht->entries[ht->index[i] - 1].hash & mask;
+		// Move the slot back if its home is not cyclically within (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask))
+		{
+			ht->index[hole] = ht->index[i];
+			hole = i;
+		}
+		i = (i + 1) & mask;
+	}
+	ht->index[hole] = 0;
+}
+
 // hash table creation
 HashTable* create_hash_table(size_t initial_size)
 {
 	HashTable* ht = malloc(sizeof(HashTable));
 	if (!ht) return NULL;
 
-	ht->buckets = calloc(initial_size, sizeof(HashEntry*));
-	if (!ht->buckets)
+	ht->entry_capacity = initial_size ? initial_size : HASH_TABLE_MIN_SIZE;
+	ht->entries = malloc(ht->entry_capacity * sizeof(HashEntry));
+	if (!ht->entries)
 	{
 		free(ht);
 		return NULL;
 	}
-	ht->size = initial_size;
-	ht->count = 0;
-
-	// New: Initialize key_order similarly to SymbolTable
-	ht->key_order = malloc(initial_size * sizeof(char*));
-	if (!ht->key_order)
+	ht->size = round_up_pow2(initial_size + initial_size / 2);
+	ht->index = calloc(ht->size, sizeof(size_t));
+	if (!ht->index)
 	{
-		free(ht->buckets);
+		free(ht->entries);
 		free(ht);
 		return NULL;
 	}
-	ht->key_count = 0;
-	ht->key_capacity = initial_size;
+	ht->entry_count = 0;
+	ht->count = 0;
+	ht->pinned = 0;
+	ht->refs = 1;
 
 	return ht;
 }
@@ -54,51 +141,53 @@ void hash_table_insert(HashTable* ht, const char* key, Variable* value)
 	if (!ht || !key || !value) return;
 
 	unsigned long hash = hash_function(key);
-	size_t index = hash % ht->size;
-	HashEntry* entry = ht->buckets[index];
+	size_t slot = find_slot(ht, key, hash);
+
+	// Check if key already exists (or, in a pinned table, was removed and can be revived)
+	if (ht->index[slot] != 0)
+	{
+		HashEntry* e = &ht->entries[ht->index[slot] - 1];
+		// Key found, update value (old value must be freed by caller if needed)
+		if (!e->value) ht->count++;
+		e->value = value;
+		return;
+	}
 
-	// Check if key already exists
-	while (entry != NULL)
+	// Make room in the entry array: reclaim removed entries first, then grow
+	if (ht->entry_count >= ht->entry_capacity)
 	{
-		if (strcmp(entry->key, key) == 0)
+		if (!ht->pinned && ht->count < ht->entry_count)
 		{
-			// Key found, update value (old value must be freed by caller if needed)
-			entry->value = value;
-			return;
+			hash_table_compact(ht);
+		}
+		if (ht->entry_count >= ht->entry_capacity)
+		{
+			size_t new_capacity = ht->entry_capacity * 2;
+			HashEntry* new_entries = realloc(ht->entries, new_capacity * sizeof(HashEntry));
+			if (!new_entries) return;
+			ht->entries = new_entries;
+			ht->entry_capacity = new_capacity;
 		}
-		entry = entry->next;
+		slot = find_slot(ht, key, hash);
 	}
-	// Key not found, create new entry
-	HashEntry* new_entry = malloc(sizeof(HashEntry));
-	if (!new_entry) return;
 
-	new_entry->key = _strdup(key);
-	if (!new_entry->key)
+	// Grow the index if the new slot would push it over the load limit
+	if ((ht->entry_count + 1) * HASH_TABLE_MAX_LOAD_DEN > ht->size * HASH_TABLE_MAX_LOAD_NUM)
 	{
-		free(new_entry);
-		return;
+		if (!hash_table_reindex(ht, ht->size << 1)) return;
+		slot = find_slot(ht, key, hash);
 	}
 
-	new_entry->value = value;
-	new_entry->next = ht->buckets[index];
-	ht->buckets[index] = new_entry;
-	ht->count++;
+	char* key_copy = _strdup(key);
+	if (!key_copy) return;
 
-	// New: Add to key_order only if new key
-	if (ht->key_count >= ht->key_capacity) {
-		size_t new_capacity = ht->key_capacity * 2;
-		char** new_key_order = realloc(ht->key_order, new_capacity * sizeof(char*));
-		if (!new_key_order) {
-			// Non-fatal: Proceed without updating order
-			return;
-		}
-		ht->key_order = new_key_order;
-		ht->key_capacity = new_capacity;
-	}
-	ht->key_order[ht->key_count] = _strdup(key);
-	if (ht->key_order[ht->key_count]) {
-		ht->key_count++;
-	}
+	HashEntry* e = &ht->entries[ht->entry_count];
+	e->key = key_copy;
+	e->value = value;
+	e->hash = hash;
+	e->version = 0;
+	ht->index[slot] = ++ht->entry_count;
+	ht->count++;
 }
 
 // Look up a value by key in the hash table
@@ -106,85 +195,71 @@ Variable* hash_table_lookup(HashTable* ht, const char* key)
 {
 	if (!ht || !key) return NULL;
 
-	unsigned long hash = hash_function(key);
-	size_t index = hash % ht->size;
-	HashEntry* entry = ht->buckets[index];
-
-	while (entry != NULL)
-	{
-		if (strcmp(entry->key, key) == 0)
-		{
-			return entry->value;
-		}
-		entry = entry->next;
-	}
-	return NULL;
+	size_t slot = find_slot(ht, key, hash_function(key));
+	return ht->index[slot] ? ht->entries[ht->index[slot] - 1].value : NULL;
 }
 
-// Remove a key-value pair from the hash table;
+// Remove a key-value pair from the hash table; O(1) apart from freeing the value
 void hash_table_remove(HashTable* ht, const char* key)
 {
 	if (!ht || !key) return;
 
-	unsigned long hash = hash_function(key);
-	size_t index = hash % ht->size;
-	HashEntry* entry = ht->buckets[index];
-	HashEntry* prev = NULL;
+	size_t slot = find_slot(ht, key, hash_function(key));
+	if (ht->index[slot] == 0) return;
+
+	HashEntry* e = &ht->entries[ht->index[slot] - 1];
+	if (!e->value) return; /* already removed (pinned table) */
+
+	Variable* old = e->value;
+	e->value = NULL;
+	ht->count--;
 
-	while (entry != NULL)
+	// Pinned tables keep key and index slot so the entry can be revived in place;
+	// otherwise drop the key now. Removed entries are reclaimed by the next insert
+	// that finds the entry array full, never here, so entries do not move under
+	// an iterator that removes as it goes.
+	if (!ht->pinned)
 	{
-		if (strcmp(entry->key, key) == 0)
-		{
-			if (prev == NULL)
-			{
-				ht->buckets[index] = entry->next;
-			}
-			else
-			{
-				prev->next = entry->next;
-			}
-			free(entry->key);
-			free_variable(entry->value);
-			free(entry);
-			ht->count--;
-
-			// New: Remove from key_order
-			for (size_t i = 0; i < ht->key_count; i++) {
-				if (strcmp(ht->key_order[i], key) == 0) {
-					free(ht->key_order[i]);
-					for (size_t j = i; j < ht->key_count - 1; j++) {
-						ht->key_order[j] = ht->key_order[j + 1];
-					}
-					ht->key_count--;
-					break;
-				}
-			}
-			return;
-		}
-		prev = entry;
-		entry = entry->next;
+		index_delete_slot(ht, slot);
+		free(e->key);
+		e->key = NULL;
 	}
+
+	free_variable(old);
+}
+
+// Advance an insertion-order iterator over live entries. Start with *iter = 0;
+// returns 0 when exhausted. Removing the current key while iterating is allowed
+// (removal never moves entries); inserting may compact the table and is not.
+int hash_table_next(const HashTable* ht, size_t* iter, const char** key, Variable** value)
+{
+	if (!ht || !iter) return 0;
+	while (*iter < ht->entry_count)
+	{
+		const HashEntry* e = &ht->entries[(*iter)++];
+		if (!e->value) continue;
+		if (key) *key = e->key;
+		if (value) *value = e->value;
+		return 1;
+	}
+	return 0;
+}
+
+static void bump_entry_version(SymbolTable* st, HashEntry* e)
+{
+	e->version++;
+	st->change_count++;
 }
 
 // Remove a symbol from the symbol table; frees the Variable if found
 void remove_symbol(SymbolTable* st, const char* name) {
 	if (!st || !name) return;
 
-	// Remove from hash table
-	hash_table_remove(st->table, name);
-
-	// Remove from key_order (linear search and shift)
-	for (size_t i = 0; i < st->key_count; i++) {
-		if (strcmp(st->key_order[i], name) == 0) {
-			free(st->key_order[i]);  // Free duplicated key
-			// Shift remaining keys
-			for (size_t j = i; j < st->key_count - 1; j++) {
-				st->key_order[j] = st->key_order[j + 1];
-			}
-			st->key_count--;
-			break;
-		}
+	size_t slot = find_symbol_slot(st, name);
+	if (slot != 0 && st->table->entries[slot - 1].value) {
+		bump_entry_version(st, &st->table->entries[slot - 1]);
 	}
+	hash_table_remove(st->table, name);
 }
 
 int add_var_to_map(HashTable* ht, const char* key, Variable* var)
@@ -204,31 +279,23 @@ int add_var_to_map(HashTable* ht, const char* key, Variable* var)
 }
 
 // Free the hash table and its contents
+// Drop one owner of the table; the last one frees it with every key and value
 void free_hash_table(HashTable* ht)
 {
 	if (!ht) return;
-
-	for (size_t i = 0; i < ht->size; i++)
+	if (ht->refs > 1)
 	{
-		HashEntry* entry = ht->buckets[i];
-		while (entry != NULL)
-		{
-			HashEntry* next = entry->next;
-			free(entry->key);
-			free_variable(entry->value);
-			free(entry);
-			entry = next;
-		}
+		ht->refs--;
+		return;
 	}
-	free(ht->buckets);
 
-	// New: Free key_order
-	if (ht->key_order) {
-		for (size_t i = 0; i < ht->key_count; i++) {
-			free(ht->key_order[i]);
-		}
-		free(ht->key_order);
+	for (size_t i = 0; i < ht->entry_count; i++)
+	{
+		free(ht->entries[i].key);
+		free_variable(ht->entries[i].value);
 	}
+	free(ht->entries);
+	free(ht->index);
 	free(ht);
 }
 
@@ -258,7 +325,7 @@ void free_variable(Variable* var) {
 		break;
 
 	case TYPE_ARRAY:
-		if (var->data.array.elements != NULL) {
+		if (var->data.array.elements != NULL && array_share_release(var->data.array.elements) == 0) {
 			for (size_t i = 0; i < var->data.array.size; i++) {
 				free_variable(var->data.array.elements[i]);
 			}
@@ -278,6 +345,10 @@ void free_variable(Variable* var) {
 		}
 		break;
 
+	case TYPE_TABLE:
+		table_store_release(var->data.table);
+		break;
+
 	default:
 		break;
 	}
@@ -285,6 +356,227 @@ void free_variable(Variable* var) {
 	free(var);
 }
 
+/*=================================================** 
+* Copy-on-write aggregates: a TYPE_ARRAY element buffer or a TYPE_MAP /
+* TYPE_STRUCTURE table may be owned by several Variables. variable_share adds
+* an owner in O(1), free_variable drops one and the last frees the payload.
+* 
+\*=================================================*/
+
+/* Owner counts of array element buffers held by more than one Variable. ArrayData
+   is filled in place all over the code base, so the count lives here, keyed by the
+   buffer (open addressing, power-of-two size); an unlisted buffer has one owner. */
+typedef struct {
+	Variable** elements;
+	unsigned int owners;
+} ArrayShare;
+
+static ArrayShare* s_array_shares = NULL;
+static size_t s_array_share_size = 0;
+static size_t s_array_share_count = 0;
+
+static size_t array_share_home(Variable** elements, size_t mask)
+{
+	uint64_t p = (uint64_t)(uintptr_t)elements >> 3;
+	return (size_t)((p * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+// Slot holding elements, or the empty slot where it would go
+static size_t array_share_find(Variable** elements)
+{
+	size_t mask = s_array_share_size - 1;
+	size_t i = array_share_home(elements, mask);
+	while (s_array_shares[i].elements && s_array_shares[i].elements != elements)
+	{
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+static unsigned int array_share_owners(Variable** elements)
+{
+	if (!elements || s_array_share_count == 0) return 1;
+	const ArrayShare* s = &s_array_shares[array_share_find(elements)];
+	return s->elements ? s->owners : 1;
+}
+
+static int array_share_add_owner(Variable** elements)
+{
+	if ((s_array_share_count + 1) * HASH_TABLE_MAX_LOAD_DEN > s_array_share_size * HASH_TABLE_MAX_LOAD_NUM)
+	{
+		size_t new_size = s_array_share_size ? s_array_share_size * 2 : HASH_TABLE_MIN_SIZE;
+		ArrayShare* grown = calloc(new_size, sizeof(ArrayShare));
+		if (!grown) return -1;
+		for (size_t k = 0; k < s_array_share_size; k++)
+		{
+			if (!s_array_shares[k].elements) continue;
+			size_t i = array_share_home(s_array_shares[k].elements, new_size - 1);
+			while (grown[i].elements) i = (i + 1) & (new_size - 1);
+			grown[i] = s_array_shares[k];
+		}
+		free(s_array_shares);
+		s_array_shares = grown;
+		s_array_share_size = new_size;
+	}
+	ArrayShare* s = &s_array_shares[array_share_find(elements)];
+	if (!s->elements)
+	{
+		s->elements = elements;
+		s->owners = 1;
+		s_array_share_count++;
+	}
+	s->owners++;
+	return 0;
+}
+
+// Drop one owner of an element buffer. Returns the owners left, 0 when the caller
+// was the only one and must free the buffer. A single owner left is unlisted again.
+static unsigned int array_share_release(Variable** elements)
+{
+	if (!elements || s_array_share_count == 0) return 0;
+	size_t hole = array_share_find(elements);
+	if (!s_array_shares[hole].elements) return 0;
+	if (--s_array_shares[hole].owners > 1) return s_array_shares[hole].owners;
+
+	// Backward-shift deletion, as for the hash table index
+	size_t mask = s_array_share_size - 1;
+	for (size_t i = (hole + 1) & mask; s_array_shares[i].elements; i = (i + 1) & mask)
+	{
+		size_t home = array_share_home(s_array_shares[i].elements, mask);
+		if (((i - home) & mask) >= ((i - hole) & mask))
+		{
+			s_array_shares[hole] = s_array_shares[i];
+			hole = i;
+		}
+	}
+	s_array_shares[hole].elements = NULL;
+	s_array_shares[hole].owners = 0;
+	s_array_share_count--;
+	return 1;
+}
+
+// New Variable holding the value of src: scalars are copied, aggregate payloads are
+// shared (O(1), copy-on-write). Values that cannot have two owners (references, file
+// descriptors, expressions) come out as TYPE_NULL. Returns NULL on allocation failure.
+Variable* variable_share(const Variable* src)
+{
+	if (!src) return NULL;
+	Variable* v = calloc(1, sizeof(Variable));
+	if (!v) return NULL;
+	v->type = src->type;
+	v->declaration_count = src->declaration_count;
+
+	switch (src->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		v->data.int_value = src->data.int_value;
+		break;
+	case TYPE_DOUBLE:
+		v->data.double_value = src->data.double_value;
+		break;
+	case TYPE_STRING:
+	case TYPE_SUBTABLE:
+		if (src->data.string_value) {
+			v->data.string_value = _strdup(src->data.string_value);
+			if (!v->data.string_value) { free(v); return NULL; }
+		}
+		break;
+	case TYPE_ARRAY:
+		if (src->data.array.elements && array_share_add_owner(src->data.array.elements) != 0) {
+			free(v);
+			return NULL;
+		}
+		v->data.array = src->data.array;
+		if (!v->data.array.elements) v->data.array.size = 0;
+		break;
+	case TYPE_MAP:
+	case TYPE_STRUCTURE:
+		if (src->data.map) src->data.map->refs++;
+		v->data.map = src->data.map;
+		break;
+	case TYPE_TABLE:
+		if (src->data.table) src->data.table->refs++;
+		v->data.table = src->data.table;
+		break;
+	default:
+		v->type = TYPE_NULL;
+		break;
+	}
+	return v;
+}
+
+// Make dst hold the value of src (see variable_share), releasing what it held before
+int variable_share_into(Variable* dst, const Variable* src)
+{
+	if (!dst || !src) return -1;
+	if (dst == src) return 0;
+	Variable* copy = variable_share(src);
+	if (!copy) return -1;
+	Variable held = *dst;
+	dst->type = copy->type;
+	dst->data = copy->data;
+	copy->type = held.type;
+	copy->data = held.data;
+	free_variable(copy);
+	return 0;
+}
+
+int variable_is_shared(const Variable* var)
+{
+	if (!var) return 0;
+	switch (var->type) {
+	case TYPE_ARRAY: return array_share_owners(var->data.array.elements) > 1;
+	case TYPE_MAP:
+	case TYPE_STRUCTURE: return var->data.map && var->data.map->refs > 1;
+	default: return 0;
+	}
+}
+
+// Give var its own copy of a shared aggregate before it is changed in place. The copy
+// is one level deep: elements and values are shared in turn, so nested aggregates
+// are only copied when they are themselves made unique. Returns 0, or -1 when out of
+// memory (var is left sharing).
+int variable_make_unique(Variable* var)
+{
+	if (!variable_is_shared(var)) return 0;
+
+	if (var->type == TYPE_ARRAY) {
+		ArrayData* a = &var->data.array;
+		Variable** copy = malloc((a->size ? a->size : 1) * sizeof(Variable*));
+		if (!copy) return -1;
+		for (size_t i = 0; i < a->size; i++) {
+			copy[i] = a->elements[i] ? variable_share(a->elements[i]) : NULL;
+			if (a->elements[i] && !copy[i]) {
+				while (i > 0) free_variable(copy[--i]);
+				free(copy);
+				return -1;
+			}
+		}
+		(void)array_share_release(a->elements);
+		a->elements = copy;
+		return 0;
+	}
+
+	HashTable* ht = var->data.map;
+	HashTable* copy = create_hash_table(ht->count);
+	if (!copy) return -1;
+	copy->pinned = ht->pinned;
+	const char* key;
+	Variable* value;
+	for (size_t it = 0; hash_table_next(ht, &it, &key, &value); ) {
+		Variable* shared = variable_share(value);
+		if (shared) hash_table_insert(copy, key, shared);
+		if (!shared || hash_table_lookup(copy, key) != shared) {
+			free_variable(shared);
+			free_hash_table(copy);
+			return -1;
+		}
+	}
+	ht->refs--;
+	var->data.map = copy;
+	return 0;
+}
+
 // Create a new Symbol Table
 SymbolTable* create_symbol_table(void) {
 	SymbolTable* st = malloc(sizeof(SymbolTable));
@@ -295,15 +587,16 @@ SymbolTable* create_symbol_table(void) {
 		free(st);
 		return NULL;
 	}
-
-	st->key_order = malloc(16 * sizeof(char*));
-	if (!st->key_order) {
+	st->table->pinned = 1;
+	st->deps = NULL;
+	st->change_count = 0;
+	memset(&st->dirty, 0, sizeof(st->dirty));
+	st->exec = exec_state_create();
+	if (!st->exec) {
 		free_hash_table(st->table);
 		free(st);
 		return NULL;
 	}
-	st->key_count = 0;
-	st->key_capacity = 16;
 
 	// Predefine GIF_DIR as a string variable 
 	Variable* gif_dir_var = malloc(sizeof(Variable));
@@ -317,41 +610,55 @@ SymbolTable* create_symbol_table(void) {
 	return st;
 }
 
-// Set a variable in the symbol table, overwriting and freeing old value if it exists
+// Scalar values compare by content; aggregates and handles only equal themselves
+int variable_values_equal(const Variable* a, const Variable* b)
+{
+	if (a == b) return 1;
+	if (!a || !b || a->type != b->type) return 0;
+	switch (a->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		return a->data.int_value == b->data.int_value;
+	case TYPE_DOUBLE:
+		return a->data.double_value == b->data.double_value;
+	case TYPE_STRING:
+		if (!a->data.string_value || !b->data.string_value) return a->data.string_value == b->data.string_value;
+		return strcmp(a->data.string_value, b->data.string_value) == 0;
+	case TYPE_NULL:
+		return 1;
+	case TYPE_ARRAY:
+		// Owners of one shared buffer hold the same value
+		return a->data.array.elements == b->data.array.elements && a->data.array.size == b->data.array.size;
+	case TYPE_MAP:
+	case TYPE_STRUCTURE:
+		return a->data.map == b->data.map;
+	case TYPE_TABLE:
+		return a->data.table == b->data.table;
+	default:
+		return 0;
+	}
+}
+
+// Set a variable in the symbol table, overwriting and freeing old value if it exists.
+// The slot's version moves only when the new value differs from the old one.
 void set_symbol(SymbolTable* st, const char* name, Variable* var) {
 	if (!st || !st->table || !name || !var) return;
 
-	// Check if the key already exists
-	Variable* old_var = hash_table_lookup(st->table, name);
-
-	// If the key is new, add it to key_order
-	if (!old_var) {
-		// Resize key_order if necessary
-		if (st->key_count >= st->key_capacity) {
-			size_t new_capacity = st->key_capacity * 2;
-			char** new_key_order = realloc(st->key_order, new_capacity * sizeof(char*));
-			if (!new_key_order) {
-				// On failure, proceed without adding to key_order (non-fatal)
-				goto insert;
-			}
-			st->key_order = new_key_order;
-			st->key_capacity = new_capacity;
-		}
-		// Duplicate the key and add it
-		st->key_order[st->key_count] = _strdup(name);
-		if (!st->key_order[st->key_count]) {
-			// On failure, proceed without adding (non-fatal)
-			goto insert;
-		}
-		st->key_count++;
+	// The symbol table is pinned: bind (or revive) the entry and swap its value in place
+	size_t slot = reserve_symbol_slot(st, name);
+	if (slot == 0) return;
+	HashEntry* e = &st->table->entries[slot - 1];
+	Variable* old_var = e->value;
+	if (!old_var) st->table->count++;
+	e->value = var;
+
+	// Re-setting the same pointer means it was edited in place: count it as a change
+	if (!old_var || old_var == var || !variable_values_equal(old_var, var)) {
+		bump_entry_version(st, e);
 	}
 
-insert:
-	// Insert or update the variable in the hash table
-	hash_table_insert(st->table, name, var);
-
 	// Free the old variable if it existed
-	if (old_var) {
+	if (old_var && old_var != var) {
 		free_variable(old_var);
 	}
 }
@@ -363,6 +670,199 @@ Variable *get_symbol(SymbolTable* st, const char* name)
 	return hash_table_lookup(st->table, name);
 }
 
+// Bind a name to its entry in the (pinned) symbol table, creating an empty entry if the
+// name has not been set yet. Returns entry position + 1, or 0 on failure. The handle stays
+// valid for the lifetime of the table: set_symbol/remove_symbol only swap the value.
+size_t reserve_symbol_slot(SymbolTable* st, const char* name)
+{
+	if (!st || !st->table || !name || !st->table->pinned) return 0;
+	HashTable* ht = st->table;
+
+	unsigned long hash = hash_function(name);
+	size_t slot = find_slot(ht, name, hash);
+	if (ht->index[slot] != 0) return ht->index[slot];
+
+	if (ht->entry_count >= ht->entry_capacity)
+	{
+		size_t new_capacity = ht->entry_capacity * 2;
+		HashEntry* new_entries = realloc(ht->entries, new_capacity * sizeof(HashEntry));
+		if (!new_entries) return 0;
+		ht->entries = new_entries;
+		ht->entry_capacity = new_capacity;
+	}
+	if ((ht->entry_count + 1) * HASH_TABLE_MAX_LOAD_DEN > ht->size * HASH_TABLE_MAX_LOAD_NUM)
+	{
+		if (!hash_table_reindex(ht, ht->size << 1)) return 0;
+		slot = find_slot(ht, name, hash);
+	}
+
+	char* key_copy = _strdup(name);
+	if (!key_copy) return 0;
+
+	HashEntry* e = &ht->entries[ht->entry_count];
+	e->key = key_copy;
+	e->value = NULL; /* reserved; revived by the first set_symbol */
+	e->hash = hash;
+	e->version = 0;
+	ht->index[slot] = ++ht->entry_count;
+	return ht->index[slot];
+}
+
+// Slot of a name already bound by reserve_symbol_slot or set_symbol, 0 if the table has never seen it
+size_t find_symbol_slot(SymbolTable* st, const char* name)
+{
+	if (!st || !st->table || !name || !st->table->pinned) return 0;
+	HashTable* ht = st->table;
+	return ht->index[find_slot(ht, name, hash_function(name))];
+}
+
+unsigned int symbol_version_at(SymbolTable* st, size_t slot)
+{
+	if (!st || !st->table || slot == 0 || slot > st->table->entry_count) return 0;
+	return st->table->entries[slot - 1].version;
+}
+
+unsigned int symbol_version(SymbolTable* st, const char* name)
+{
+	return symbol_version_at(st, find_symbol_slot(st, name));
+}
+
+// Record an in-place edit of a symbol's Variable (no-op for unknown names)
+void touch_symbol(SymbolTable* st, const char* name)
+{
+	size_t slot = find_symbol_slot(st, name);
+	if (slot != 0) bump_entry_version(st, &st->table->entries[slot - 1]);
+}
+
+static unsigned lowest_set_bit(uint64_t w)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, w);
+	return (unsigned)i;
+#else
+	return (unsigned)__builtin_ctzll(w);
+#endif
+}
+
+// Add slot to the set. The first add past the current storage sizes it for
+// capacity_hint slots (e.g. the table's entry capacity) so later adds stay in place.
+int slot_set_add(SlotSet* set, size_t slot, size_t capacity_hint)
+{
+	if (!set || slot == 0) return 0;
+	size_t word = slot / 64;
+	if (word >= set->word_count)
+	{
+		size_t want = (capacity_hint > slot ? capacity_hint : slot) / 64 + 1;
+		uint64_t* grown = realloc(set->words, want * sizeof(uint64_t));
+		if (!grown) return 0;
+		memset(grown + set->word_count, 0, (want - set->word_count) * sizeof(uint64_t));
+		set->words = grown;
+		set->word_count = want;
+	}
+	uint64_t bit = (uint64_t)1 << (slot % 64);
+	if (set->words[word] & bit) return 0;
+	set->words[word] |= bit;
+	set->count++;
+	return 1;
+}
+
+int slot_set_contains(const SlotSet* set, size_t slot)
+{
+	if (!set || slot / 64 >= set->word_count) return 0;
+	return (set->words[slot / 64] >> (slot % 64)) & 1;
+}
+
+// Smallest slot in the set greater than after, or 0 when there is none
+size_t slot_set_next(const SlotSet* set, size_t after)
+{
+	if (!set || set->count == 0) return 0;
+	size_t slot = after + 1;
+	size_t word = slot / 64;
+	if (word >= set->word_count) return 0;
+	uint64_t w = set->words[word] & (~(uint64_t)0 << (slot % 64));
+	for (;;)
+	{
+		if (w) return word * 64 + lowest_set_bit(w);
+		if (++word >= set->word_count) return 0;
+		w = set->words[word];
+	}
+}
+
+void slot_set_clear(SlotSet* set)
+{
+	if (!set || set->count == 0) return;
+	memset(set->words, 0, set->word_count * sizeof(uint64_t));
+	set->count = 0;
+}
+
+void slot_set_free(SlotSet* set)
+{
+	if (!set) return;
+	free(set->words);
+	set->words = NULL;
+	set->word_count = 0;
+	set->count = 0;
+}
+
+// Watch one more slot; returns 1 if it was added. A watch that grows counts as
+// changed until it is recorded again.
+int slot_watch_add(SlotWatch* w, size_t slot)
+{
+	if (!w || slot == 0) return 0;
+	if (w->count >= w->capacity)
+	{
+		size_t new_capacity = w->capacity ? w->capacity * 2 : 16;
+		size_t* slots = realloc(w->slots, new_capacity * sizeof(size_t));
+		if (!slots) return 0;
+		w->slots = slots;
+		unsigned int* seen = realloc(w->seen, new_capacity * sizeof(unsigned int));
+		if (!seen) return 0;
+		w->seen = seen;
+		w->capacity = new_capacity;
+	}
+	w->slots[w->count] = slot;
+	w->seen[w->count] = 0;
+	w->count++;
+	w->recorded = 0;
+	return 1;
+}
+
+int slot_watch_changed(SymbolTable* st, const SlotWatch* w)
+{
+	if (!w || !w->recorded) return 1;
+	for (size_t i = 0; i < w->count; ++i)
+	{
+		if (symbol_version_at(st, w->slots[i]) != w->seen[i]) return 1;
+	}
+	return 0;
+}
+
+void slot_watch_record(SymbolTable* st, SlotWatch* w)
+{
+	if (!w) return;
+	for (size_t i = 0; i < w->count; ++i)
+	{
+		w->seen[i] = symbol_version_at(st, w->slots[i]);
+	}
+	w->recorded = 1;
+}
+
+void slot_watch_free(SlotWatch* w)
+{
+	if (!w) return;
+	free(w->slots);
+	free(w->seen);
+	memset(w, 0, sizeof(*w));
+}
+
+// Retrieve the variable behind a handle from reserve_symbol_slot (NULL if currently unset)
+Variable* get_symbol_at(SymbolTable* st, size_t slot)
+{
+	if (!st || !st->table || slot == 0 || slot > st->table->entry_count) return NULL;
+	return st->table->entries[slot - 1].value;
+}
+
 
 // Free the symbol table and its contents
 void free_symbol_table(SymbolTable* st) {
@@ -370,14 +870,9 @@ void free_symbol_table(SymbolTable* st) {
 
 	// Free the hash table
 	free_hash_table(st->table);
-
-	// Free the key_order array
-	if (st->key_order) {
-		for (size_t i = 0; i < st->key_count; i++) {
-			free(st->key_order[i]); // Free duplicated strings
-		}
-		free(st->key_order);
-	}
+	depgraph_free(st->deps);
+	slot_set_free(&st->dirty);
+	exec_state_free(st->exec);
 
 	free(st);
 }
@@ -403,10 +898,13 @@ static void print_variable(const Variable* var, int indent) {
 	case TYPE_INTEGER:
 		LogOnlyPrintfChar("%sType: INTEGER, Value: %d\n", get_indent(indent), var->data.int_value);
 		break;
-	case TYPE_DOUBLE:
+	case TYPE_DOUBLE: {
 		// Revised: Use %.15g for higher precision to avoid rounding in output
-		LogOnlyPrintfChar("%sType: DOUBLE, Value: %.15g\n", get_indent(indent), var->data.double_value);
+		char text[32];
+		epa_format_double_g(var->data.double_value, 15, text, sizeof(text));
+		LogOnlyPrintfChar("%sType: DOUBLE, Value: %s\n", get_indent(indent), text);
 		break;
+	}
 	case TYPE_STRING:
 		LogOnlyPrintfChar("%sType: STRING, Value: %s\n", get_indent(indent),
 			var->data.string_value ? var->data.string_value : "NULL");
@@ -439,34 +937,49 @@ static void print_variable(const Variable* var, int indent) {
 	case TYPE_MAP: {
 		LogOnlyPrintfChar("%sType: MAP\n", get_indent(indent));
 		HashTable* map = var->data.map;
-		if (!map || map->key_count == 0) {
+		if (!map || map->count == 0) {
 			LogOnlyPrintfChar("%sMap is empty or not initialized\n", get_indent(indent + 1));
 			return;
 		}
-		// New: Iterate key_order for insertion-order printing
-		for (size_t i = 0; i < map->key_count; i++) {
-			const char* key = map->key_order[i];
-			Variable* value = hash_table_lookup(map, key);
-			if (value) {
-				LogOnlyPrintfChar("%sKey: %s\n", get_indent(indent + 1), key);
-				print_variable(value, indent + 2);
-			}
+		// Iterate in insertion order for printing
+		const char* key;
+		Variable* value;
+		for (size_t it = 0; hash_table_next(map, &it, &key, &value); ) {
+			LogOnlyPrintfChar("%sKey: %s\n", get_indent(indent + 1), key);
+			print_variable(value, indent + 2);
 		}
 		break;
 	}
 	case TYPE_STRUCTURE: {  // New case for structures, treated similarly to maps
 		LogOnlyPrintfChar("%sType: STRUCTURE\n", get_indent(indent));
 		HashTable* structure = var->data.structure;
-		if (!structure || structure->key_count == 0) {
+		if (!structure || structure->count == 0) {
 			LogOnlyPrintfChar("%sStructure is empty or not initialized\n", get_indent(indent + 1));
 			return;
 		}
-		for (size_t i = 0; i < structure->key_count; i++) {
-			const char* key = structure->key_order[i];
-			Variable* value = hash_table_lookup(structure, key);
-			if (value) {
-				LogOnlyPrintfChar("%sField: %s\n", get_indent(indent + 1), key);
-				print_variable(value, indent + 2);
+		const char* key;
+		Variable* value;
+		for (size_t it = 0; hash_table_next(structure, &it, &key, &value); ) {
+			LogOnlyPrintfChar("%sField: %s\n", get_indent(indent + 1), key);
+			print_variable(value, indent + 2);
+		}
+		break;
+	}
+	case TYPE_TABLE: {
+		const TableStore* ts = var->data.table;
+		if (!ts) {
+			LogOnlyPrintfChar("%sType: TABLE (not initialized)\n", get_indent(indent));
+			return;
+		}
+		LogOnlyPrintfChar("%sType: TABLE, Rows: %zu, Columns: %zu\n", get_indent(indent), ts->row_count, ts->column_count);
+		for (size_t r = 0; r < ts->row_count; r++) {
+			LogOnlyPrintfChar("%sRow %zu:\n", get_indent(indent + 1), r);
+			for (size_t c = 0; c < ts->column_count; c++) {
+				if (ts->columns[c].shadowed) continue;
+				Variable cell;
+				table_store_cell(ts, r, c, &cell);
+				LogOnlyPrintfChar("%sKey: %s\n", get_indent(indent + 2), ts->columns[c].name ? ts->columns[c].name : "NULL");
+				print_variable(&cell, indent + 3);
 			}
 		}
 		break;
@@ -485,12 +998,10 @@ void print_symbol_table(const SymbolTable* st) {
 	}
 
 	ProPrintf(L"Symbol Table Contents:\n");
-	for (size_t i = 0; i < st->key_count; i++) {
-		const char* key = st->key_order[i];
-		Variable* var = hash_table_lookup(st->table, key);
-		if (var) {
-			LogOnlyPrintfChar("Key: %s\n", key);
-			print_variable(var, 1);
-		}
+	const char* key;
+	Variable* var;
+	for (size_t it = 0; hash_table_next(st->table, &it, &key, &var); ) {
+		LogOnlyPrintfChar("Key: %s\n", key);
+		print_variable(var, 1);
 	}
 }
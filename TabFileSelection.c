@@ -29,55 +29,32 @@ const char* get_command_type_str(CommandType type) {
 ProError ProcessTabFile(const wchar_t* tabFilePath) {
     ProGenericMsg(L"Starting ProcessTabFile");
 
-    FILE* file;
-    errno_t err = _wfopen_s(&file, tabFilePath, L"r");
-    if (err != 0 || file == NULL) {
+    // Map the script read-only; the lexer slices tokens straight out of the view
+    MappedFile file;
+    if (map_file_readonly(tabFilePath, &file) != 0) {
         ProGenericMsg(L"Failed to open the tab file");
         return PRO_TK_CANT_ACCESS;
     }
 
-    if (fseek(file, 0, SEEK_END) != 0) {
-        fclose(file);
-        ProGenericMsg(L"Failed to seek to end of file");
-        return PRO_TK_GENERAL_ERROR;
-    }
-    long size = ftell(file);
-    if (size == -1) {
-        fclose(file);
-        ProGenericMsg(L"Failed to determine file size");
-        return PRO_TK_GENERAL_ERROR;
-    }
-    rewind(file);
-
-    char* buffer = (char*)malloc((size_t)size + 1);
-    if (buffer == NULL) {
-        fclose(file);
-        ProGenericMsg(L"Memory allocation failed");
-        return PRO_TK_CANT_ACCESS;
-    }
+    ProError status = ProcessTabBuffer(file.data, file.size);
+    unmap_file(&file);
+    return status;
+}
 
-    size_t read_size = fread(buffer, 1, (size_t)size, file);
-    buffer[read_size] = '\0';
-    if (read_size == 0) {
+// Run the lex/parse/analyse/execute pipeline over an in-memory script.
+// text[length] must be '\0'; the text is not modified or copied.
+ProError ProcessTabBuffer(const char* text, size_t length) {
+    if (!text || length == 0) {
         ProGenericMsg(L"File is empty or read failed");
-        free(buffer);
-        fclose(file);
         return PRO_TK_GENERAL_ERROR;
     }
 
-    Lexer lexer = {
-        .cur_tok = buffer,
-        .tokens = NULL,
-        .token_count = 0,
-        .capacity = 0,
-        .line_number = 1,
-        .line_start = buffer
-    };
+    Lexer lexer;
+    lexer_init(&lexer, text, length);
 
     int lex_result = lex(&lexer);
     if (lex_result != 0) {
-        free(buffer);
-        fclose(file);
+        free_lexer(&lexer);
         ProGenericMsg(L"Lexing error");
         return PRO_TK_GENERAL_ERROR;
     }
@@ -87,28 +64,20 @@ ProError ProcessTabFile(const wchar_t* tabFilePath) {
         ProGenericMsg(L"No tokens generated");
     }
 
-    // Optional: Log all tokens (unchanged)
-    for (size_t i = 0; i < lexer.token_count; i++) {
-        TokenData* token = &lexer.tokens[i];
-        wchar_t wval[1024] = { 0 };
-        if (token->val) {
-            int wideSize = MultiByteToWideChar(CP_UTF8, 0, token->val, -1, NULL, 0);
-            if (wideSize == 0 || wideSize > 1024) {
-                ProPrintf(L"Token: %d, Value: (conversion failed), Line: %zu, Col: %zu",
-                    token->type, token->loc.line, token->loc.col);
-                continue;
-            }
-            MultiByteToWideChar(CP_UTF8, 0, token->val, -1, wval, wideSize);
+    // Token dump: debug level only, skipped entirely unless enabled
+    if (log_enabled(LOG_LEVEL_DEBUG)) {
+        for (size_t i = 0; i < lexer.token_count; i++) {
+            TokenData* token = &lexer.tokens[i];
+            log_write(LOG_LEVEL_DEBUG, "Token: %d, Value: %.*s, Line: %zu",
+                token->type, (int)token->length, token->length > 0 ? token_text(&lexer, token) : "",
+                (size_t)token->line);
         }
-        LogOnlyPrintf(L"Token: %d, Value: %ls, Line: %zu, Col: %zu",
-            token->type, wval, token->loc.line, token->loc.col);
     }
 
     SymbolTable* st = create_symbol_table();
     if (!st) {
         ProGenericMsg(L"Failed to create symbol table");
-        free(buffer);
-        fclose(file);
+        free_lexer(&lexer);
         return PRO_TK_GENERAL_ERROR;
     }
 
@@ -163,8 +132,6 @@ ProError ProcessTabFile(const wchar_t* tabFilePath) {
     free_symbol_table(st);
     free_block_list(&blocks);
     free_lexer(&lexer);
-    free(buffer);
-    fclose(file);
     return PRO_TK_NO_ERROR;
 }
 
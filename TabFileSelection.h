@@ -6,6 +6,8 @@
 
 
 ProError esMenu();
+ProError ProcessTabFile(const wchar_t* tabFilePath);
+ProError ProcessTabBuffer(const char* text, size_t length);
 
 
 
@@ -0,0 +1,283 @@
+#include "utility.h"
+#include "builtins.h"
+#include "numfmt.h"
+#include <math.h>
+#include <ctype.h>
+#include <limits.h>
+
+// Trigonometric functions work in degrees, as in Creo relations.
+#define DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+/*=================================================*\
+*
+* Result helpers
+*
+*
+\*=================================================*/
+static int ret_double(EpaValue* out, double d) {
+	if (!isfinite(d)) return -1;   /* domain errors (sqrt(-1), log(0)...) fail the expression */
+	out->type = TYPE_DOUBLE;
+	out->data.double_value = d;
+	return 0;
+}
+
+static int ret_int(EpaValue* out, int i) {
+	out->type = TYPE_INTEGER;
+	out->data.int_value = i;
+	return 0;
+}
+
+static int ret_bool(EpaValue* out, int b) {
+	out->type = TYPE_BOOL;
+	out->data.int_value = (b != 0);
+	return 0;
+}
+
+#define D(n) (args[n].data.double_value)
+#define I(n) (args[n].data.int_value)
+#define S(n) (epa_string(&args[n]))
+
+/*=================================================*\
+*
+* Math
+*
+*
+\*=================================================*/
+static int bi_sin(const EpaValue* args, EpaValue* out) { return ret_double(out, sin(D(0) * DEG_TO_RAD)); }
+static int bi_asin(const EpaValue* args, EpaValue* out) { return ret_double(out, asin(D(0)) / DEG_TO_RAD); }
+static int bi_cos(const EpaValue* args, EpaValue* out) { return ret_double(out, cos(D(0) * DEG_TO_RAD)); }
+static int bi_acos(const EpaValue* args, EpaValue* out) { return ret_double(out, acos(D(0)) / DEG_TO_RAD); }
+static int bi_tan(const EpaValue* args, EpaValue* out) { return ret_double(out, tan(D(0) * DEG_TO_RAD)); }
+static int bi_atan(const EpaValue* args, EpaValue* out) { return ret_double(out, atan(D(0)) / DEG_TO_RAD); }
+static int bi_sinh(const EpaValue* args, EpaValue* out) { return ret_double(out, sinh(D(0))); }
+static int bi_cosh(const EpaValue* args, EpaValue* out) { return ret_double(out, cosh(D(0))); }
+static int bi_tanh(const EpaValue* args, EpaValue* out) { return ret_double(out, tanh(D(0))); }
+static int bi_log(const EpaValue* args, EpaValue* out) { return ret_double(out, log10(D(0))); }
+static int bi_ln(const EpaValue* args, EpaValue* out) { return ret_double(out, log(D(0))); }
+static int bi_exp(const EpaValue* args, EpaValue* out) { return ret_double(out, exp(D(0))); }
+static int bi_ceil(const EpaValue* args, EpaValue* out) { return ret_double(out, ceil(D(0))); }
+static int bi_floor(const EpaValue* args, EpaValue* out) { return ret_double(out, floor(D(0))); }
+static int bi_abs(const EpaValue* args, EpaValue* out) { return ret_double(out, fabs(D(0))); }
+static int bi_sqrt(const EpaValue* args, EpaValue* out) { return ret_double(out, sqrt(D(0))); }
+static int bi_sqr(const EpaValue* args, EpaValue* out) { return ret_double(out, D(0) * D(0)); }
+static int bi_pow(const EpaValue* args, EpaValue* out) { return ret_double(out, pow(D(0), D(1))); }
+static int bi_mod(const EpaValue* args, EpaValue* out) { return D(1) == 0.0 ? -1 : ret_double(out, fmod(D(0), D(1))); }
+
+/* Round half away from zero to the given number of decimals */
+static double round_to(double value, int decimals) {
+	double scale = pow(10.0, (double)decimals);
+	return round(value * scale) / scale;
+}
+
+static int bi_round(const EpaValue* args, EpaValue* out) { return ret_double(out, round_to(D(0), I(1))); }
+
+/*=================================================*\
+*
+* Strings
+*
+*
+\*=================================================*/
+/* Index of needle in hay (0-based), or -1 */
+static int find_index(const char* hay, const char* needle, int case_sensitive) {
+	if (!hay || !needle) return -1;
+	size_t n = strlen(needle);
+	for (const char* p = hay; ; ++p) {
+		size_t k = 0;
+		while (k < n && p[k] &&
+			(case_sensitive ? p[k] == needle[k]
+				: tolower((unsigned char)p[k]) == tolower((unsigned char)needle[k])))
+			++k;
+		if (k == n) return (int)(p - hay);
+		if (!*p) return -1;
+	}
+}
+
+static int sign_of(int c) { return (c > 0) - (c < 0); }
+
+static int bi_strfind(const EpaValue* args, EpaValue* out) { return ret_int(out, find_index(S(0), S(1), 0)); }
+static int bi_strfindcs(const EpaValue* args, EpaValue* out) { return ret_int(out, find_index(S(0), S(1), 1)); }
+static int bi_strlen(const EpaValue* args, EpaValue* out) { return ret_int(out, S(0) ? (int)strlen(S(0)) : 0); }
+static int bi_strcmp(const EpaValue* args, EpaValue* out) { return ret_int(out, sign_of(_stricmp(S(0) ? S(0) : "", S(1) ? S(1) : ""))); }
+static int bi_strcmpcs(const EpaValue* args, EpaValue* out) { return ret_int(out, sign_of(strcmp(S(0) ? S(0) : "", S(1) ? S(1) : ""))); }
+static int bi_asc(const EpaValue* args, EpaValue* out) { return ret_int(out, S(0) ? (unsigned char)S(0)[0] : 0); }
+
+/* Whole-string numeric parsing; surrounding blanks are allowed */
+static int parse_long_text(const char* s, long* out) {
+	if (!s) return -1;
+	char* end = NULL;
+	long v = epa_strtol(s, &end);
+	if (end == s) return -1;
+	while (isspace((unsigned char)*end)) ++end;
+	if (*end) return -1;
+	*out = v;
+	return 0;
+}
+
+static int parse_double_text(const char* s, double* out) {
+	if (!s) return -1;
+	char* end = NULL;
+	double v = epa_strtod(s, &end);
+	if (end == s) return -1;
+	while (isspace((unsigned char)*end)) ++end;
+	if (*end || !isfinite(v)) return -1;
+	*out = v;
+	return 0;
+}
+
+static int bi_stof(const EpaValue* args, EpaValue* out) {
+	double v;
+	if (parse_double_text(S(0), &v) != 0) return -1;
+	return ret_double(out, v);
+}
+
+static int bi_stoi(const EpaValue* args, EpaValue* out) {
+	long v;
+	if (parse_long_text(S(0), &v) != 0 || v < INT_MIN || v > INT_MAX) return -1;
+	return ret_int(out, (int)v);
+}
+
+static int bi_stob(const EpaValue* args, EpaValue* out) {
+	const char* s = S(0);
+	if (!s) return -1;
+	if (_stricmp(s, "TRUE") == 0 || _stricmp(s, "YES") == 0 || strcmp(s, "1") == 0) return ret_bool(out, 1);
+	if (_stricmp(s, "FALSE") == 0 || _stricmp(s, "NO") == 0 || strcmp(s, "0") == 0) return ret_bool(out, 0);
+	return -1;
+}
+
+static int bi_isinteger(const EpaValue* args, EpaValue* out) {
+	long v;
+	return ret_bool(out, parse_long_text(S(0), &v) == 0);
+}
+
+/* A number that is not written as an integer (has a fraction or exponent) */
+static int bi_isdouble(const EpaValue* args, EpaValue* out) {
+	double d;
+	long l;
+	return ret_bool(out, parse_double_text(S(0), &d) == 0 && parse_long_text(S(0), &l) != 0);
+}
+
+static int bi_isnumber(const EpaValue* args, EpaValue* out) {
+	double d;
+	return ret_bool(out, parse_double_text(S(0), &d) == 0);
+}
+
+/*=================================================*\
+*
+* Comparisons to a number of decimals: equal when the difference is below
+* half a unit of the last decimal
+*
+\*=================================================*/
+static int near_equal(const EpaValue* args) {
+	return fabs(D(0) - D(1)) < 0.5 * pow(10.0, -(double)I(2));
+}
+
+static int bi_equal(const EpaValue* args, EpaValue* out) { return ret_bool(out, near_equal(args)); }
+static int bi_less(const EpaValue* args, EpaValue* out) { return ret_bool(out, D(0) < D(1) && !near_equal(args)); }
+static int bi_lessorequal(const EpaValue* args, EpaValue* out) { return ret_bool(out, D(0) < D(1) || near_equal(args)); }
+static int bi_greater(const EpaValue* args, EpaValue* out) { return ret_bool(out, D(0) > D(1) && !near_equal(args)); }
+static int bi_greaterorequal(const EpaValue* args, EpaValue* out) { return ret_bool(out, D(0) > D(1) || near_equal(args)); }
+
+#undef D
+#undef I
+#undef S
+
+/*=================================================*\
+*
+* Registry (indexed by FunctionType)
+*
+*
+\*=================================================*/
+#define MATH1(name, fn) { name, 1, { TYPE_DOUBLE }, TYPE_DOUBLE, fn }
+#define STR1(name, ret, fn) { name, 1, { TYPE_STRING }, ret, fn }
+#define STR2(name, fn) { name, 2, { TYPE_STRING, TYPE_STRING }, TYPE_INTEGER, fn }
+#define CMP3(name, fn) { name, 3, { TYPE_DOUBLE, TYPE_DOUBLE, TYPE_INTEGER }, TYPE_BOOL, fn }
+
+const BuiltinInfo g_builtins[FUNC_COUNT] = {
+	[FUNC_SIN] = MATH1("sin", bi_sin),
+	[FUNC_ASIN] = MATH1("asin", bi_asin),
+	[FUNC_COS] = MATH1("cos", bi_cos),
+	[FUNC_ACOS] = MATH1("acos", bi_acos),
+	[FUNC_TAN] = MATH1("tan", bi_tan),
+	[FUNC_ATAN] = MATH1("atan", bi_atan),
+	[FUNC_SINH] = MATH1("sinh", bi_sinh),
+	[FUNC_COSH] = MATH1("cosh", bi_cosh),
+	[FUNC_TANH] = MATH1("tanh", bi_tanh),
+	[FUNC_LOG] = MATH1("log", bi_log),
+	[FUNC_LN] = MATH1("ln", bi_ln),
+	[FUNC_EXP] = MATH1("exp", bi_exp),
+	[FUNC_CEIL] = MATH1("ceil", bi_ceil),
+	[FUNC_FLOOR] = MATH1("floor", bi_floor),
+	[FUNC_ABS] = MATH1("abs", bi_abs),
+	[FUNC_SQRT] = MATH1("sqrt", bi_sqrt),
+	[FUNC_SQR] = MATH1("sqr", bi_sqr),
+	[FUNC_POW] = { "pow", 2, { TYPE_DOUBLE, TYPE_DOUBLE }, TYPE_DOUBLE, bi_pow },
+	[FUNC_MOD] = { "mod", 2, { TYPE_DOUBLE, TYPE_DOUBLE }, TYPE_DOUBLE, bi_mod },
+	[FUNC_ROUND] = { "round", 2, { TYPE_DOUBLE, TYPE_INTEGER }, TYPE_DOUBLE, bi_round },
+	[FUNC_STRFIND] = STR2("strfind", bi_strfind),
+	[FUNC_STRFINDCS] = STR2("strfindcs", bi_strfindcs),
+	[FUNC_STRLEN] = STR1("strlen", TYPE_INTEGER, bi_strlen),
+	[FUNC_STRCMP] = STR2("strcmp", bi_strcmp),
+	[FUNC_STRCMPCS] = STR2("strcmpcs", bi_strcmpcs),
+	[FUNC_STOF] = STR1("stof", TYPE_DOUBLE, bi_stof),
+	[FUNC_STOI] = STR1("stoi", TYPE_INTEGER, bi_stoi),
+	[FUNC_STOB] = STR1("stob", TYPE_BOOL, bi_stob),
+	[FUNC_ASC] = STR1("asc", TYPE_INTEGER, bi_asc),
+	[FUNC_ISNUMBER] = STR1("isnumber", TYPE_BOOL, bi_isnumber),
+	[FUNC_ISINTEGER] = STR1("isinteger", TYPE_BOOL, bi_isinteger),
+	[FUNC_ISDOUBLE] = STR1("isdouble", TYPE_BOOL, bi_isdouble),
+	[FUNC_EQUAL] = CMP3("equal", bi_equal),
+	[FUNC_LESS] = CMP3("less", bi_less),
+	[FUNC_LESSOREQUAL] = CMP3("lessorequal", bi_lessorequal),
+	[FUNC_GREATER] = CMP3("greater", bi_greater),
+	[FUNC_GREATEROREQUAL] = CMP3("greaterorequal", bi_greaterorequal),
+};
+
+FunctionType builtin_lookup(const char* name) {
+	if (!name) return (FunctionType)-1;
+	for (int f = 0; f < FUNC_COUNT; ++f) {
+		if (g_builtins[f].name && _stricmp(g_builtins[f].name, name) == 0) return (FunctionType)f;
+	}
+	return (FunctionType)-1;
+}
+
+/* Runtime counterpart of the static check: numbers (and unset/empty strings,
+   which read as 0 in operators too) for numeric parameters, strings for strings */
+static int coerce_arg(EpaValue* v, VariableType want) {
+	if (v->type == TYPE_STRING && want != TYPE_STRING) {
+		const char* s = epa_string(v);
+		if (s && s[0]) return -1;
+		v->type = TYPE_INTEGER;
+		v->data.int_value = 0;
+	}
+	switch (want) {
+	case TYPE_DOUBLE: {
+		double d;
+		if (epa_to_double(v, &d) != 0) return -1;
+		v->type = TYPE_DOUBLE;
+		v->data.double_value = d;
+		return 0;
+	}
+	case TYPE_INTEGER:
+		if (v->type == TYPE_DOUBLE) {
+			v->data.int_value = (int)v->data.double_value;
+			v->type = TYPE_INTEGER;
+		}
+		return (v->type == TYPE_INTEGER || v->type == TYPE_BOOL) ? 0 : -1;
+	case TYPE_STRING:
+		return v->type == TYPE_STRING ? 0 : -1;
+	default:
+		return -1;
+	}
+}
+
+int builtin_call(FunctionType func, const EpaValue* args, EpaValue* out) {
+	if ((unsigned)func >= FUNC_COUNT || !g_builtins[func].fn) return -1;
+	const BuiltinInfo* bi = &g_builtins[func];
+
+	EpaValue a[BUILTIN_MAX_ARGS];
+	for (int i = 0; i < bi->arity; ++i) {
+		a[i] = args[i];
+		if (coerce_arg(&a[i], (VariableType)bi->arg_types[i]) != 0) return -1;
+	}
+	return bi->fn(a, out);
+}
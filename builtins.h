@@ -0,0 +1,30 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "bytecode.h"
+
+// Builtin function registry: one entry per FunctionType, in enum order.
+// Arity and argument types are checked once by get_expression_type; a call at
+// runtime is an indexed jump to a native implementation that never allocates.
+
+#define BUILTIN_MAX_ARGS 3
+
+// args are already coerced to the declared argument types
+typedef int (*BuiltinFn)(const EpaValue* args, EpaValue* out);
+
+typedef struct {
+    const char* name;                       // Script spelling (case-insensitive)
+    uint8_t arity;
+    uint8_t arg_types[BUILTIN_MAX_ARGS];    // VariableType of each argument
+    uint8_t return_type;                    // VariableType
+    BuiltinFn fn;
+} BuiltinInfo;
+
+extern const BuiltinInfo g_builtins[FUNC_COUNT];
+
+// FunctionType for a script name, or -1 if it is not a builtin
+FunctionType builtin_lookup(const char* name);
+// Coerce args to the declared types and run the builtin. out may alias args[0].
+int builtin_call(FunctionType func, const EpaValue* args, EpaValue* out);
+
+#endif // !BUILTINS_H
@@ -0,0 +1,646 @@
+#include "utility.h"
+#include "syntaxanalysis.h"
+#include "bytecode.h"
+#include "builtins.h"
+#include "numfmt.h"
+#include "tablestore.h"
+
+/*=================================================*\
+*
+* Compiler: ExpressionNode tree -> ExprProgram
+*
+*
+\*=================================================*/
+typedef struct {
+	ExprInstr* code;
+	size_t code_count, code_cap;
+	double* numbers;
+	size_t number_count, number_cap;
+	const char** strings;
+	size_t string_count, string_cap;
+	const ExpressionNode** fields;
+	size_t field_count, field_cap;
+	size_t depth, max_depth;   // Stack depth along the fall-through path
+	SymbolTable* st;
+} ExprBuilder;
+
+static int grow_array(void** arr, size_t* cap, size_t need, size_t elem_size) {
+	if (need <= *cap) return 0;
+	size_t new_cap = *cap ? *cap * 2 : 16;
+	while (new_cap < need) new_cap *= 2;
+	void* p = realloc(*arr, new_cap * elem_size);
+	if (!p) return -1;
+	*arr = p;
+	*cap = new_cap;
+	return 0;
+}
+
+/* Stack effect of each opcode on the fall-through path */
+static int op_stack_effect(ExprOpcode op, int32_t arg) {
+	switch (op) {
+	case EOP_PUSH_INT: case EOP_PUSH_BOOL: case EOP_PUSH_DOUBLE:
+	case EOP_PUSH_STRING: case EOP_LOAD:
+		return 1;
+	case EOP_TRUTH: case EOP_NEG: case EOP_LOOKUP: case EOP_FIELD:
+		return 0;
+	case EOP_CALL:
+		return 1 - (int)g_builtins[arg].arity;
+	default:
+		return -1;  /* binary ops, EOP_INDEX and conditional jumps (pop when not taken) */
+	}
+}
+
+/* Append an instruction; returns its index or -1 */
+static long emit(ExprBuilder* b, ExprOpcode op, int32_t arg) {
+	if (grow_array((void**)&b->code, &b->code_cap, b->code_count + 1, sizeof(ExprInstr)) != 0) return -1;
+	ExprInstr* in = &b->code[b->code_count];
+	in->op = (uint16_t)op;
+	in->reserved = 0;
+	in->arg = arg;
+
+	int effect = op_stack_effect(op, arg);
+	b->depth = (size_t)((long)b->depth + effect);
+	if (b->depth > b->max_depth) b->max_depth = b->depth;
+	return (long)b->code_count++;
+}
+
+static long pool_number(ExprBuilder* b, double value) {
+	for (size_t i = 0; i < b->number_count; i++) {
+		if (memcmp(&b->numbers[i], &value, sizeof(double)) == 0) return (long)i;
+	}
+	if (grow_array((void**)&b->numbers, &b->number_cap, b->number_count + 1, sizeof(double)) != 0) return -1;
+	b->numbers[b->number_count] = value;
+	return (long)b->number_count++;
+}
+
+static long pool_string(ExprBuilder* b, const char* value) {
+	for (size_t i = 0; i < b->string_count; i++) {
+		if (strcmp(b->strings[i], value) == 0) return (long)i;
+	}
+	if (grow_array((void**)&b->strings, &b->string_cap, b->string_count + 1, sizeof(const char*)) != 0) return -1;
+	b->strings[b->string_count] = value;
+	return (long)b->string_count++;
+}
+
+static int compile_node(ExprBuilder* b, ExpressionNode* e) {
+	long idx;
+	if (!e) return -1;
+
+	switch (e->type) {
+	case EXPR_LITERAL_INT:
+		return emit(b, EOP_PUSH_INT, (int32_t)(int)e->data.int_val) < 0 ? -1 : 0;
+
+	case EXPR_LITERAL_BOOL:
+		return emit(b, EOP_PUSH_BOOL, (int32_t)(int)e->data.int_val) < 0 ? -1 : 0;
+
+	case EXPR_LITERAL_DOUBLE:
+		idx = pool_number(b, e->data.double_val);
+		if (idx < 0) return -1;
+		return emit(b, EOP_PUSH_DOUBLE, (int32_t)idx) < 0 ? -1 : 0;
+
+	case EXPR_LITERAL_STRING:
+		if (!e->data.string_val) return -1;
+		idx = pool_string(b, e->data.string_val);
+		if (idx < 0) return -1;
+		return emit(b, EOP_PUSH_STRING, (int32_t)idx) < 0 ? -1 : 0;
+
+	case EXPR_VARIABLE_REF:
+		if (!e->data.string_val) return -1;
+		if (e->slot == 0) e->slot = reserve_symbol_slot(b->st, e->data.string_val);
+		if (e->slot == 0 || e->slot > INT32_MAX) return -1;
+		return emit(b, EOP_LOAD, (int32_t)e->slot) < 0 ? -1 : 0;
+
+	case EXPR_BINARY_OP: {
+		BinaryOpType op = e->data.binary.op;
+		if (op == BINOP_AND || op == BINOP_OR) {
+			/* left TRUTH JUMP_IF_x(end) right TRUTH end: -- the jump keeps the deciding BOOL */
+			if (compile_node(b, e->data.binary.left) != 0) return -1;
+			if (emit(b, EOP_TRUTH, 0) < 0) return -1;
+			long jump = emit(b, op == BINOP_AND ? EOP_JUMP_IF_FALSE : EOP_JUMP_IF_TRUE, 0);
+			if (jump < 0) return -1;
+			if (compile_node(b, e->data.binary.right) != 0) return -1;
+			if (emit(b, EOP_TRUTH, 0) < 0) return -1;
+			b->code[jump].arg = (int32_t)b->code_count;
+			return 0;
+		}
+		if (op < BINOP_ADD || op > BINOP_GE) return -1;
+		if (compile_node(b, e->data.binary.left) != 0) return -1;
+		if (compile_node(b, e->data.binary.right) != 0) return -1;
+		return emit(b, (ExprOpcode)(EOP_ADD + (op - BINOP_ADD)), 0) < 0 ? -1 : 0;
+	}
+
+	case EXPR_UNARY_OP:
+		if (e->data.unary.op != UNOP_NEG) return -1;
+		if (compile_node(b, e->data.unary.operand) != 0) return -1;
+		return emit(b, EOP_NEG, 0) < 0 ? -1 : 0;
+
+	case EXPR_FUNCTION_CALL: {
+		FunctionType func = e->data.func_call.func;
+		if ((unsigned)func >= FUNC_COUNT || e->data.func_call.arg_count != g_builtins[func].arity) return -1;
+		for (size_t k = 0; k < e->data.func_call.arg_count; ++k) {
+			if (compile_node(b, e->data.func_call.args[k]) != 0) return -1;
+		}
+		return emit(b, EOP_CALL, (int32_t)func) < 0 ? -1 : 0;
+	}
+
+	case EXPR_ARRAY_INDEX:
+		if (compile_node(b, e->data.array_index.base) != 0) return -1;
+		if (compile_node(b, e->data.array_index.index) != 0) return -1;
+		return emit(b, EOP_INDEX, 0) < 0 ? -1 : 0;
+
+	case EXPR_MAP_LOOKUP:
+		if (!e->data.map_lookup.key) return -1;
+		if (compile_node(b, e->data.map_lookup.map) != 0) return -1;
+		idx = pool_string(b, e->data.map_lookup.key);
+		if (idx < 0) return -1;
+		return emit(b, EOP_LOOKUP, (int32_t)idx) < 0 ? -1 : 0;
+
+	case EXPR_STRUCT_ACCESS:
+		if (!e->data.struct_access.member) return -1;
+		if (compile_node(b, e->data.struct_access.structure) != 0) return -1;
+		if (grow_array((void**)&b->fields, &b->field_cap, b->field_count + 1, sizeof(const ExpressionNode*)) != 0) return -1;
+		b->fields[b->field_count] = e;
+		return emit(b, EOP_FIELD, (int32_t)b->field_count++) < 0 ? -1 : 0;
+
+	default:
+		/* Constants are not handled by evaluate_expression either; leave
+		   those trees to the walker */
+		return -1;
+	}
+}
+
+ExprProgram* expr_compile(Arena* arena, ExpressionNode* expr, SymbolTable* st) {
+	if (!arena || !expr || !st) return NULL;
+
+	ExprBuilder b = { 0 };
+	b.st = st;
+	ExprProgram* prog = NULL;
+
+	if (compile_node(&b, expr) != 0 || b.depth != 1 || b.max_depth > EXPR_VM_STACK_MAX) goto done;
+
+	/* Copy the finished program into the script arena, sized exactly */
+	prog = (ExprProgram*)arena_alloc(arena, sizeof(ExprProgram));
+	if (!prog) goto done;
+	prog->code = (ExprInstr*)arena_alloc(arena, b.code_count * sizeof(ExprInstr));
+	prog->numbers = b.number_count ? (double*)arena_alloc(arena, b.number_count * sizeof(double)) : NULL;
+	prog->strings = b.string_count ? (const char**)arena_alloc(arena, b.string_count * sizeof(const char*)) : NULL;
+	prog->fields = b.field_count ? (const ExpressionNode**)arena_alloc(arena, b.field_count * sizeof(const ExpressionNode*)) : NULL;
+	if (!prog->code || (b.number_count && !prog->numbers) || (b.string_count && !prog->strings) ||
+		(b.field_count && !prog->fields)) {
+		prog = NULL;
+		goto done;
+	}
+	memcpy(prog->code, b.code, b.code_count * sizeof(ExprInstr));
+	if (b.number_count) memcpy(prog->numbers, b.numbers, b.number_count * sizeof(double));
+	if (b.string_count) memcpy((void*)prog->strings, b.strings, b.string_count * sizeof(const char*));
+	if (b.field_count) memcpy((void*)prog->fields, b.fields, b.field_count * sizeof(const ExpressionNode*));
+	prog->code_count = b.code_count;
+	prog->number_count = b.number_count;
+	prog->string_count = b.string_count;
+	prog->field_count = b.field_count;
+	prog->max_stack = b.max_depth;
+
+done:
+	free(b.code);
+	free(b.numbers);
+	free((void*)b.strings);
+	free((void*)b.fields);
+	return prog;
+}
+
+/*=================================================*\
+*
+* EpaValue operations (shared by the VM and the tree evaluator)
+*
+*
+\*=================================================*/
+#define EXPR_EPSILON 1e-9
+
+static void set_inline_string(EpaValue* v, const char* text) {
+	v->type = TYPE_STRING;
+	v->storage = EPA_STR_INLINE;
+	strncpy_s(v->data.small, sizeof(v->data.small), text, _TRUNCATE);
+}
+
+void epa_load(EpaValue* v, const Variable* var) {
+	v->storage = EPA_STR_BORROWED;
+	if (!var || var->type == TYPE_UNKNOWN) {
+		/* Unset names read as an empty string */
+		set_inline_string(v, "");
+		return;
+	}
+	v->type = (uint8_t)var->type;
+	switch (var->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		v->data.int_value = var->data.int_value;
+		break;
+	case TYPE_DOUBLE:
+		v->data.double_value = var->data.double_value;
+		break;
+	case TYPE_STRING:
+		v->data.string_value = var->data.string_value;
+		break;
+	default:
+		v->data.var = var;
+		break;
+	}
+}
+
+const char* epa_string(const EpaValue* v) {
+	if (v->type != TYPE_STRING) return NULL;
+	return v->storage == EPA_STR_INLINE ? v->data.small : v->data.string_value;
+}
+
+int epa_to_double(const EpaValue* v, double* out) {
+	switch (v->type) {
+	case TYPE_DOUBLE: *out = v->data.double_value; return 0;
+	case TYPE_INTEGER:
+	case TYPE_BOOL: *out = (double)v->data.int_value; return 0;
+	default: return -1;
+	}
+}
+
+int epa_index(EpaValue* v, const EpaValue* index) {
+	long i;
+	if (v->type != TYPE_ARRAY || !v->data.var) return -1;
+	const ArrayData* arr = &v->data.var->data.array;
+	switch (index->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL: i = index->data.int_value; break;
+	case TYPE_DOUBLE:
+		/* Range-check before the cast: NaN, infinities and out-of-range values
+		   have no defined conversion to long */
+		if (!(index->data.double_value >= 0.0 && index->data.double_value < (double)arr->size)) return -1;
+		i = (long)index->data.double_value;
+		break;
+	default: return -1;
+	}
+	if (i < 0 || (size_t)i >= arr->size || !arr->elements) return -1;
+	epa_load(v, arr->elements[i]);
+	return 0;
+}
+
+/* A key the map does not hold reads as an empty string, like an unset name */
+int epa_lookup(EpaValue* v, const char* key) {
+	HashTable* ht;
+	if (!v->data.var || !key) return -1;
+	if (v->type == TYPE_MAP) ht = v->data.var->data.map;
+	else if (v->type == TYPE_STRUCTURE) ht = v->data.var->data.structure;
+	else return -1;
+	epa_load(v, ht ? table_wrapper_lookup(ht, key) : NULL);
+	return 0;
+}
+
+/* Members sit at fixed positions of the structure's (pinned) table; the position
+   resolved by semantic analysis is used when the entry there still carries the
+   member's key, else (unresolved, or another layout) the member is found by name */
+int epa_field(EpaValue* v, const ExpressionNode* access) {
+	if (v->type != TYPE_STRUCTURE || !v->data.var || !v->data.var->data.structure) return -1;
+	HashTable* ht = v->data.var->data.structure;
+	size_t field = access->data.struct_access.field;
+	if (field && field <= ht->entry_count) {
+		const HashEntry* e = &ht->entries[field - 1];
+		if (e->value && e->key && e->hash == access->data.struct_access.field_hash
+			&& strcmp(e->key, access->data.struct_access.member) == 0) {
+			epa_load(v, e->value);
+			return 0;
+		}
+	}
+	Variable* member = hash_table_lookup(ht, access->data.struct_access.member);
+	if (!member) return -1;
+	epa_load(v, member);
+	return 0;
+}
+
+/* Undefined/empty strings act as integer 0 in operators */
+static void coerce_empty(EpaValue* v) {
+	const char* s = epa_string(v);
+	if (v->type == TYPE_STRING && (!s || !s[0])) {
+		v->type = TYPE_INTEGER;
+		v->data.int_value = 0;
+	}
+}
+
+static void set_bool(EpaValue* v, int b) {
+	v->type = TYPE_BOOL;
+	v->data.int_value = b;
+}
+
+int epa_truth(EpaValue* v) {
+	coerce_empty(v);
+	int t;
+	switch (v->type) {
+	case TYPE_BOOL:
+	case TYPE_INTEGER: t = (v->data.int_value != 0); break;
+	case TYPE_DOUBLE:  t = (v->data.double_value != 0.0); break;
+	case TYPE_STRING:  t = 1; break;  /* non-empty after coercion */
+	default: return -1;
+	}
+	set_bool(v, t);
+	return 0;
+}
+
+/* Integer/double promotion used by arithmetic and ordered comparisons */
+static int promote_numeric(EpaValue* l, EpaValue* r) {
+	if (l->type == r->type) return 0;
+	if (l->type == TYPE_INTEGER && r->type == TYPE_DOUBLE) {
+		l->data.double_value = (double)l->data.int_value;
+		l->type = TYPE_DOUBLE;
+		return 0;
+	}
+	if (l->type == TYPE_DOUBLE && r->type == TYPE_INTEGER) {
+		r->data.double_value = (double)r->data.int_value;
+		r->type = TYPE_DOUBLE;
+		return 0;
+	}
+	return -1;
+}
+
+static int arith(EpaValue* l, EpaValue* r, BinaryOpType op) {
+	if (promote_numeric(l, r) != 0) return -1;
+	if (l->type != TYPE_INTEGER && l->type != TYPE_DOUBLE) return -1;
+
+	int is_double = (l->type == TYPE_DOUBLE);
+	double a = is_double ? l->data.double_value : (double)l->data.int_value;
+	double c = is_double ? r->data.double_value : (double)r->data.int_value;
+	double res;
+	switch (op) {
+	case BINOP_ADD: res = a + c; break;
+	case BINOP_SUB: res = a - c; break;
+	case BINOP_MUL: res = a * c; break;
+	case BINOP_DIV:
+		if (c == 0.0) return -1;
+		res = a / c;
+		break;
+	default: return -1;
+	}
+
+	if (is_double || op == BINOP_DIV) {
+		l->type = TYPE_DOUBLE;
+		l->data.double_value = res;
+	}
+	else {
+		l->type = TYPE_INTEGER;
+		l->data.int_value = (int)res;
+	}
+	return 0;
+}
+
+static int ordered(EpaValue* l, EpaValue* r, BinaryOpType op) {
+	if (promote_numeric(l, r) != 0) return -1;
+	int b;
+	if (l->type == TYPE_DOUBLE) {
+		double a = l->data.double_value, c = r->data.double_value;
+		switch (op) {
+		case BINOP_LT: b = a < c - EXPR_EPSILON; break;
+		case BINOP_GT: b = a > c + EXPR_EPSILON; break;
+		case BINOP_LE: b = a <= c + EXPR_EPSILON; break;
+		default:       b = a >= c - EXPR_EPSILON; break;
+		}
+	}
+	else if (l->type == TYPE_INTEGER) {
+		int a = l->data.int_value, c = r->data.int_value;
+		switch (op) {
+		case BINOP_LT: b = a < c; break;
+		case BINOP_GT: b = a > c; break;
+		case BINOP_LE: b = a <= c; break;
+		default:       b = a >= c; break;
+		}
+	}
+	else {
+		return -1;
+	}
+	set_bool(l, b);
+	return 0;
+}
+
+/* Does s read exactly like "%d" of value? Formats by hand, no printf. */
+static int int_text_equals(int value, const char* s) {
+	char digits[16];
+	size_t n = 0;
+	unsigned int u = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+	do {
+		digits[n++] = (char)('0' + u % 10);
+		u /= 10;
+	} while (u);
+	if (value < 0) {
+		if (*s++ != '-') return 0;
+	}
+	while (n > 0) {
+		if (*s++ != digits[--n]) return 0;
+	}
+	return *s == '\0';
+}
+
+/* Does s read exactly like "%.15g" of value? Text that does not even parse as a
+   number is rejected before formatting. */
+static int double_text_equals(double value, const char* s) {
+	char* end = NULL;
+	(void)epa_strtod(s, &end);
+	if (end == s || *end != '\0') return 0;
+
+	char buf[64];
+	epa_format_double_g(value, 15, buf, sizeof(buf));
+	return strcmp(buf, s) == 0;
+}
+
+/* ==/<>: text comparison when either side is a string, else numeric */
+static int equality(EpaValue* l, EpaValue* r, BinaryOpType op) {
+	int equal;
+	if (l->type == TYPE_STRING || r->type == TYPE_STRING) {
+		EpaValue* str = (l->type == TYPE_STRING) ? l : r;
+		EpaValue* other = (str == l) ? r : l;
+		const char* s = epa_string(str);
+		if (!s) s = "";
+		switch (other->type) {
+		case TYPE_STRING: {
+			const char* o = epa_string(other);
+			equal = (strcmp(s, o ? o : "") == 0);
+			break;
+		}
+		case TYPE_INTEGER:
+		case TYPE_BOOL:
+			equal = int_text_equals(other->data.int_value, s);
+			break;
+		case TYPE_DOUBLE:
+			equal = double_text_equals(other->data.double_value, s);
+			break;
+		default:
+			return -1;
+		}
+	}
+	else if (l->type == TYPE_DOUBLE || r->type == TYPE_DOUBLE) {
+		double a, c;
+		if (epa_to_double(l, &a) != 0 || epa_to_double(r, &c) != 0) return -1;
+		equal = (fabs(a - c) <= EXPR_EPSILON);
+	}
+	else if ((l->type == TYPE_INTEGER || l->type == TYPE_BOOL) &&
+		(r->type == TYPE_INTEGER || r->type == TYPE_BOOL)) {
+		equal = (l->data.int_value == r->data.int_value);
+	}
+	else {
+		return -1;
+	}
+	set_bool(l, op == BINOP_EQ ? equal : !equal);
+	return 0;
+}
+
+int epa_binary(BinaryOpType op, EpaValue* l, EpaValue* r) {
+	coerce_empty(l);
+	coerce_empty(r);
+	switch (op) {
+	case BINOP_ADD: case BINOP_SUB: case BINOP_MUL: case BINOP_DIV:
+		return arith(l, r, op);
+	case BINOP_EQ: case BINOP_NE:
+		return equality(l, r, op);
+	case BINOP_LT: case BINOP_GT: case BINOP_LE: case BINOP_GE:
+		return ordered(l, r, op);
+	default:
+		return -1;
+	}
+}
+
+int epa_negate(EpaValue* v) {
+	coerce_empty(v);
+	switch (v->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		v->type = TYPE_INTEGER;
+		v->data.int_value = -v->data.int_value;
+		return 0;
+	case TYPE_DOUBLE:
+		v->data.double_value = -v->data.double_value;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+int epa_to_variable(const EpaValue* v, Variable** result) {
+	*result = NULL;
+	if (v->type == TYPE_ARRAY || v->type == TYPE_MAP || v->type == TYPE_STRUCTURE || v->type == TYPE_TABLE) {
+		/* Aggregates: a copy-on-write share of the symbol's payload */
+		if (!v->data.var) return -1;
+		*result = variable_share(v->data.var);
+		return *result ? 0 : -1;
+	}
+
+	Variable* var = (Variable*)calloc(1, sizeof(Variable));
+	if (!var) return -1;
+
+	switch (v->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		var->type = (VariableType)v->type;
+		var->data.int_value = v->data.int_value;
+		break;
+	case TYPE_DOUBLE:
+		var->type = TYPE_DOUBLE;
+		var->data.double_value = v->data.double_value;
+		break;
+	case TYPE_STRING: {
+		const char* s = epa_string(v);
+		var->type = TYPE_STRING;
+		if (s) {
+			var->data.string_value = _strdup(s);
+			if (!var->data.string_value) { free(var); return -1; }
+		}
+		break;
+	}
+	default:
+		/* References and the like: shallow copy of the symbol, as evaluate_expression always returned */
+		if (!v->data.var) { free(var); return -1; }
+		memcpy(var, v->data.var, sizeof(Variable));
+		break;
+	}
+	*result = var;
+	return 0;
+}
+
+/*=================================================*\
+*
+* VM: fixed-size value stack, no heap allocation
+*
+*
+\*=================================================*/
+int expr_execute(const ExprProgram* prog, SymbolTable* st, EpaValue* out) {
+	if (!prog || !out || prog->max_stack > EXPR_VM_STACK_MAX) return -1;
+
+	EpaValue stack[EXPR_VM_STACK_MAX];
+	size_t sp = 0;
+	size_t pc = 0;
+
+	while (pc < prog->code_count) {
+		const ExprInstr* in = &prog->code[pc++];
+		EpaValue* v;
+		switch ((ExprOpcode)in->op) {
+		case EOP_PUSH_INT:
+			v = &stack[sp++];
+			v->type = TYPE_INTEGER;
+			v->data.int_value = in->arg;
+			break;
+		case EOP_PUSH_BOOL:
+			v = &stack[sp++];
+			v->type = TYPE_BOOL;
+			v->data.int_value = in->arg;
+			break;
+		case EOP_PUSH_DOUBLE:
+			v = &stack[sp++];
+			v->type = TYPE_DOUBLE;
+			v->data.double_value = prog->numbers[in->arg];
+			break;
+		case EOP_PUSH_STRING:
+			v = &stack[sp++];
+			v->type = TYPE_STRING;
+			v->storage = EPA_STR_BORROWED;
+			v->data.string_value = prog->strings[in->arg];
+			break;
+		case EOP_LOAD:
+			epa_load(&stack[sp++], get_symbol_at(st, (size_t)in->arg));
+			break;
+		case EOP_ADD: case EOP_SUB: case EOP_MUL: case EOP_DIV:
+		case EOP_EQ: case EOP_NE:
+		case EOP_LT: case EOP_GT: case EOP_LE: case EOP_GE:
+			sp--;
+			if (epa_binary((BinaryOpType)(BINOP_ADD + (in->op - EOP_ADD)), &stack[sp - 1], &stack[sp]) != 0) return -1;
+			break;
+		case EOP_NEG:
+			if (epa_negate(&stack[sp - 1]) != 0) return -1;
+			break;
+		case EOP_TRUTH:
+			if (epa_truth(&stack[sp - 1]) != 0) return -1;
+			break;
+		case EOP_JUMP_IF_FALSE:
+			if (!stack[sp - 1].data.int_value) pc = (size_t)in->arg;
+			else sp--;
+			break;
+		case EOP_JUMP_IF_TRUE:
+			if (stack[sp - 1].data.int_value) pc = (size_t)in->arg;
+			else sp--;
+			break;
+		case EOP_CALL:
+			/* Arguments sit on top of the stack in order; the result replaces them */
+			sp -= g_builtins[in->arg].arity;
+			if (builtin_call((FunctionType)in->arg, &stack[sp], &stack[sp]) != 0) return -1;
+			sp++;
+			break;
+		case EOP_INDEX:
+			sp--;
+			if (epa_index(&stack[sp - 1], &stack[sp]) != 0) return -1;
+			break;
+		case EOP_LOOKUP:
+			if (epa_lookup(&stack[sp - 1], prog->strings[in->arg]) != 0) return -1;
+			break;
+		case EOP_FIELD:
+			if (epa_field(&stack[sp - 1], prog->fields[in->arg]) != 0) return -1;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	if (sp != 1) return -1;
+	*out = stack[0];
+	return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "utility.h"
+#include "syntaxanalysis.h"
+
+// Expression bytecode: an ExpressionNode tree lowered once into a flat
+// instruction array with pooled constants, run by a small stack VM that never
+// allocates. Semantics match the tree walker in evaluate_expression (numeric
+// promotion, empty-string-as-zero, epsilon comparisons, AND/OR short-circuit,
+// builtin calls).
+
+#define EXPR_VM_STACK_MAX 32    // Deeper expressions stay on the tree walker
+
+typedef enum {
+    EOP_PUSH_INT,       // arg: int literal
+    EOP_PUSH_BOOL,      // arg: 0/1
+    EOP_PUSH_DOUBLE,    // arg: index into numbers[]
+    EOP_PUSH_STRING,    // arg: index into strings[]
+    EOP_LOAD,           // arg: symbol slot
+    EOP_ADD,
+    EOP_SUB,
+    EOP_MUL,
+    EOP_DIV,
+    EOP_EQ,
+    EOP_NE,
+    EOP_LT,
+    EOP_GT,
+    EOP_LE,
+    EOP_GE,
+    EOP_NEG,            // Negate the numeric top
+    EOP_TRUTH,          // Replace top with its truthiness as a BOOL
+    EOP_JUMP_IF_FALSE,  // arg: target; jumps keeping the top, else pops it
+    EOP_JUMP_IF_TRUE,   // arg: target; jumps keeping the top, else pops it
+    EOP_CALL,           // arg: FunctionType; pops its arity, pushes the result
+    EOP_INDEX,          // Pop the index, replace the array on top with that element
+    EOP_LOOKUP,         // arg: index into strings[]; replace the map on top with that key's value
+    EOP_FIELD           // arg: index into fields[]; replace the structure on top with that member
+} ExprOpcode;
+
+typedef struct {
+    uint16_t op;        // ExprOpcode
+    uint16_t reserved;
+    int32_t arg;
+} ExprInstr;
+
+typedef struct ExprProgram {
+    ExprInstr* code;
+    size_t code_count;
+    double* numbers;        // Pooled double constants
+    size_t number_count;
+    const char** strings;   // Pooled string constants (point into the AST)
+    size_t string_count;
+    const ExpressionNode** fields;  // EXPR_STRUCT_ACCESS nodes read by EOP_FIELD (their resolved layout)
+    size_t field_count;
+    size_t max_stack;       // Deepest stack the program reaches
+} ExprProgram;
+
+// Storage of a TYPE_STRING EpaValue
+typedef enum {
+    EPA_STR_BORROWED = 0,   // data.string_value points into the AST or symbol table
+    EPA_STR_INLINE          // data.small holds the text (up to 7 chars + '\0')
+} EpaStringStorage;
+
+#define EPA_INLINE_MAX 7
+
+// Scalar evaluation result: a 16-byte tagged union that never owns memory.
+// Strings are borrowed or inline; aggregates (arrays, maps, references...)
+// are represented by the symbol they were read from.
+typedef struct {
+    uint8_t type;                   // VariableType
+    uint8_t storage;                // EpaStringStorage (TYPE_STRING only)
+    uint8_t reserved[6];
+    union {
+        int int_value;              // TYPE_INTEGER, TYPE_BOOL
+        double double_value;        // TYPE_DOUBLE
+        const char* string_value;   // TYPE_STRING, EPA_STR_BORROWED (may be NULL)
+        char small[8];              // TYPE_STRING, EPA_STR_INLINE
+        const Variable* var;        // Any other type: the symbol itself
+    } data;
+} EpaValue;
+
+typedef char epa_value_is_16_bytes[sizeof(EpaValue) == 16 ? 1 : -1];
+
+// Compile expr into arena memory. Returns NULL when the tree uses a node kind
+// the VM does not cover (callers keep using the tree walker for it).
+ExprProgram* expr_compile(Arena* arena, ExpressionNode* expr, SymbolTable* st);
+// Run without allocating; out borrows any string it holds. 0 on success, -1 on failure.
+int expr_execute(const ExprProgram* prog, SymbolTable* st, EpaValue* out);
+
+// Value helpers shared by the VM and the tree evaluator
+void epa_load(EpaValue* v, const Variable* var);
+int epa_truth(EpaValue* v);
+int epa_binary(BinaryOpType op, EpaValue* l, EpaValue* r);   // Result in l
+int epa_negate(EpaValue* v);
+const char* epa_string(const EpaValue* v);                   // NULL unless TYPE_STRING with text
+int epa_to_double(const EpaValue* v, double* out);           // INTEGER/BOOL/DOUBLE only
+// Accessors: replace an aggregate value with one of its elements. 0 on success,
+// -1 for a wrong base type, an out-of-range index or a missing key/member.
+int epa_index(EpaValue* v, const EpaValue* index);           // TYPE_ARRAY, zero-based
+int epa_lookup(EpaValue* v, const char* key);                // TYPE_MAP or TYPE_STRUCTURE
+int epa_field(EpaValue* v, const ExpressionNode* access);    // EXPR_STRUCT_ACCESS on TYPE_STRUCTURE
+// New heap Variable holding v, as evaluate_expression returns it
+int epa_to_variable(const EpaValue* v, Variable** result);
+
+#endif // !BYTECODE_H
@@ -0,0 +1,414 @@
+#include "utility.h"
+#include "syntaxanalysis.h"
+#include "semantic_analysis.h"
+#include "symboltable.h"
+#include "depgraph.h"
+
+// Nodes are appended in program order (an IF before the commands it gates), so
+// the commands gated by IF node i are exactly the nodes (i, nodes[i].end).
+// Ranks are computed per unit (top-level command): the reactive walkers
+// recompute a whole top-level IF at a time, so units are what must be ordered.
+
+typedef struct {
+	DepGraph* g;
+	SymbolTable* st;
+	size_t node_cap;
+	size_t read_cap;
+	size_t unit;
+	int failed;
+} DepBuild;
+
+static int dep_reserve(void** arr, size_t* cap, size_t need, size_t elem)
+{
+	if (need <= *cap) return 1;
+	size_t n = *cap ? *cap * 2 : 16;
+	while (n < need) n *= 2;
+	void* grown = realloc(*arr, n * elem);
+	if (!grown) return 0;
+	*arr = grown;
+	*cap = n;
+	return 1;
+}
+
+static size_t dep_add_node(DepBuild* b, DepNodeKind kind, CommandNode* cmd, int parent, IfNode* root_if)
+{
+	DepGraph* g = b->g;
+	if (!dep_reserve((void**)&g->nodes, &b->node_cap, g->node_count + 1, sizeof(DepNode))) {
+		b->failed = 1;
+		return (size_t)-1;
+	}
+	DepNode* n = &g->nodes[g->node_count];
+	memset(n, 0, sizeof(*n));
+	n->kind = kind;
+	n->cmd = cmd;
+	n->root_if = root_if;
+	n->parent = parent;
+	n->unit = b->unit;
+	n->first_read = g->read_total;
+	return g->node_count++;
+}
+
+// Record a read of slot by the node being built (the last one), once
+static void dep_add_read(DepBuild* b, size_t slot)
+{
+	DepGraph* g = b->g;
+	if (slot == 0 || g->node_count == 0) return;
+	DepNode* n = &g->nodes[g->node_count - 1];
+	for (size_t k = 0; k < n->read_count; ++k) {
+		if (g->reads[n->first_read + k] == slot) return;
+	}
+	if (!dep_reserve((void**)&g->reads, &b->read_cap, g->read_total + 1, sizeof(size_t))) {
+		b->failed = 1;
+		return;
+	}
+	g->reads[g->read_total++] = slot;
+	n->read_count++;
+}
+
+static void dep_add_name_read(DepBuild* b, const char* name)
+{
+	if (name && name[0]) dep_add_read(b, reserve_symbol_slot(b->st, name));
+}
+
+static void dep_collect_reads(DepBuild* b, const ExpressionNode* expr)
+{
+	if (!expr) return;
+	switch (expr->type) {
+	case EXPR_VARIABLE_REF:
+		if (expr->slot != 0) dep_add_read(b, expr->slot);
+		else dep_add_name_read(b, expr->data.string_val);
+		break;
+	case EXPR_UNARY_OP:
+		dep_collect_reads(b, expr->data.unary.operand);
+		break;
+	case EXPR_BINARY_OP:
+		dep_collect_reads(b, expr->data.binary.left);
+		dep_collect_reads(b, expr->data.binary.right);
+		break;
+	case EXPR_FUNCTION_CALL:
+		for (size_t k = 0; k < expr->data.func_call.arg_count; ++k) {
+			dep_collect_reads(b, expr->data.func_call.args[k]);
+		}
+		break;
+	case EXPR_ARRAY_INDEX:
+		dep_collect_reads(b, expr->data.array_index.base);
+		dep_collect_reads(b, expr->data.array_index.index);
+		break;
+	case EXPR_MAP_LOOKUP:
+		dep_collect_reads(b, expr->data.map_lookup.map);
+		break;
+	case EXPR_STRUCT_ACCESS:
+		dep_collect_reads(b, expr->data.struct_access.structure);
+		break;
+	case EXPR_CONCAT:
+		for (size_t k = 0; k < expr->data.concat.part_count; ++k) {
+			dep_collect_reads(b, expr->data.concat.parts[k]);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void dep_collect_visitor(ExpressionNode** expr, void* ctx)
+{
+	dep_collect_reads((DepBuild*)ctx, *expr);
+}
+
+// Slot of the variable an assignment target ultimately names (a, a[i], a.k)
+static size_t dep_target_slot(DepBuild* b, const ExpressionNode* lhs)
+{
+	while (lhs) {
+		switch (lhs->type) {
+		case EXPR_VARIABLE_REF:
+			if (lhs->slot != 0) return lhs->slot;
+			return lhs->data.string_val ? reserve_symbol_slot(b->st, lhs->data.string_val) : 0;
+		case EXPR_ARRAY_INDEX: lhs = lhs->data.array_index.base; break;
+		case EXPR_MAP_LOOKUP: lhs = lhs->data.map_lookup.map; break;
+		case EXPR_STRUCT_ACCESS: lhs = lhs->data.struct_access.structure; break;
+		default: return 0;
+		}
+	}
+	return 0;
+}
+
+static void dep_walk_commands(DepBuild* b, CommandNode** cmds, size_t count, int parent, IfNode* root_if, int top_level);
+
+static void dep_add_required(DepBuild* b, CommandNode* cmd, int parent, IfNode* root_if, const char* name)
+{
+	if (dep_add_node(b, DEP_REQUIRED, cmd, parent, root_if) != (size_t)-1) dep_add_name_read(b, name);
+}
+
+static void dep_walk_command(DepBuild* b, CommandNode* cmd, int parent, IfNode* root_if)
+{
+	if (!cmd || !cmd->data) return;
+	CommandData* d = cmd->data;
+
+	switch (cmd->type) {
+	case COMMAND_IF: {
+		IfNode* n = &d->ifcommand;
+		size_t idx = dep_add_node(b, DEP_IF, cmd, parent, root_if);
+		if (idx == (size_t)-1) return;
+		for (size_t k = 0; n->branches && k < n->branch_count; ++k) {
+			if (n->branches[k]) dep_collect_reads(b, n->branches[k]->condition);
+		}
+		IfNode* root = root_if ? root_if : n;
+		b->g->nodes[idx].root_if = root;
+		for (size_t k = 0; n->branches && k < n->branch_count; ++k) {
+			IfBranch* br = n->branches[k];
+			if (br) dep_walk_commands(b, br->commands, br->command_count, (int)idx, root, 0);
+		}
+		dep_walk_commands(b, n->else_commands, n->else_command_count, (int)idx, root, 0);
+		b->g->nodes[idx].end = b->g->node_count;
+		break;
+	}
+	case COMMAND_ASSIGNMENT: {
+		AssignmentNode* a = &d->assignment;
+		if (dep_add_node(b, DEP_ASSIGN, cmd, parent, root_if) == (size_t)-1) return;
+		b->g->nodes[b->g->node_count - 1].write_slot = dep_target_slot(b, a->lhs);
+		if (a->lhs && a->lhs->type != EXPR_VARIABLE_REF) dep_collect_reads(b, a->lhs);  /* index/key expressions */
+		dep_collect_reads(b, a->rhs);
+		break;
+	}
+	case COMMAND_SHOW_PARAM: {
+		ShowParamNode* n = &d->show_param;
+		if (dep_add_node(b, DEP_SHOW_PARAM, cmd, parent, root_if) == (size_t)-1) return;
+		dep_add_name_read(b, n->parameter);
+		walk_command_expressions(cmd, dep_collect_visitor, b);
+		break;
+	}
+	case COMMAND_SUB_PICTURE:
+		if (dep_add_node(b, DEP_SUB_PICTURE, cmd, parent, root_if) == (size_t)-1) return;
+		walk_command_expressions(cmd, dep_collect_visitor, b);
+		break;
+	case COMMAND_BEGIN_TABLE:
+		if (dep_add_node(b, DEP_TABLE, cmd, parent, root_if) == (size_t)-1) return;
+		walk_command_expressions(cmd, dep_collect_visitor, b);
+		break;
+	case COMMAND_USER_INPUT_PARAM:
+		if (d->user_input_param.required) dep_add_required(b, cmd, parent, root_if, d->user_input_param.parameter);
+		break;
+	case COMMAND_CHECKBOX_PARAM:
+		if (d->checkbox_param.required) dep_add_required(b, cmd, parent, root_if, d->checkbox_param.parameter);
+		break;
+	case COMMAND_RADIOBUTTON_PARAM:
+		if (d->radiobutton_param.required) dep_add_required(b, cmd, parent, root_if, d->radiobutton_param.parameter);
+		break;
+	case COMMAND_USER_SELECT:
+	case COMMAND_USER_SELECT_OPTIONAL:
+		/* UserSelectOptionalNode shares the UserSelectNode layout */
+		if (d->user_select.is_required == PRO_B_TRUE) dep_add_required(b, cmd, parent, root_if, d->user_select.reference);
+		break;
+	case COMMAND_USER_SELECT_MULTIPLE:
+		dep_add_required(b, cmd, parent, root_if, d->user_select_multiple.array);
+		break;
+	case COMMAND_FOR:
+		dep_walk_commands(b, d->forcommand.commands, d->forcommand.command_count, parent, root_if, 0);
+		break;
+	case COMMAND_WHILE:
+		dep_walk_commands(b, d->whilecommand.commands, d->whilecommand.command_count, parent, root_if, 0);
+		break;
+	case COMMAND_BEGIN_CATCH_ERROR:
+		dep_walk_commands(b, d->begin_catch_error.commands, d->begin_catch_error.command_count, parent, root_if, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+static void dep_walk_commands(DepBuild* b, CommandNode** cmds, size_t count, int parent, IfNode* root_if, int top_level)
+{
+	for (size_t i = 0; cmds && i < count && !b->failed; ++i) {
+		size_t before = b->g->node_count;
+		dep_walk_command(b, cmds[i], parent, root_if);
+		if (top_level && b->g->node_count > before) b->unit++;
+	}
+}
+
+// CSR index of the nodes reading each slot
+static int dep_index_readers(DepGraph* g)
+{
+	for (size_t k = 0; k < g->read_total; ++k) {
+		if (g->reads[k] + 1 > g->slot_count) g->slot_count = g->reads[k] + 1;
+	}
+	g->reader_start = (size_t*)calloc(g->slot_count + 1, sizeof(size_t));
+	g->readers = (size_t*)malloc((g->read_total ? g->read_total : 1) * sizeof(size_t));
+	if (!g->reader_start || !g->readers) return 0;
+
+	for (size_t k = 0; k < g->read_total; ++k) g->reader_start[g->reads[k] + 1]++;
+	for (size_t s = 0; s < g->slot_count; ++s) g->reader_start[s + 1] += g->reader_start[s];
+
+	size_t* fill = (size_t*)malloc((g->slot_count ? g->slot_count : 1) * sizeof(size_t));
+	if (!fill) return 0;
+	memcpy(fill, g->reader_start, g->slot_count * sizeof(size_t));
+	for (size_t i = 0; i < g->node_count; ++i) {
+		const DepNode* n = &g->nodes[i];
+		for (size_t k = 0; k < n->read_count; ++k) {
+			g->readers[fill[g->reads[n->first_read + k]]++] = i;
+		}
+	}
+	free(fill);
+	return 1;
+}
+
+// Kahn's algorithm over units: an assignment feeding a reader in another unit
+// orders the two units. Units left on a cycle keep program order after the rest.
+static int dep_rank_units(DepGraph* g)
+{
+	size_t units = g->unit_count;
+	size_t edge_count = 0, edge_cap = 0;
+	size_t* edges = NULL;   /* pairs (from, to) */
+
+	for (size_t i = 0; i < g->node_count; ++i) {
+		const DepNode* w = &g->nodes[i];
+		if (w->kind != DEP_ASSIGN || w->write_slot == 0 || w->write_slot >= g->slot_count) continue;
+		for (size_t r = g->reader_start[w->write_slot]; r < g->reader_start[w->write_slot + 1]; ++r) {
+			size_t to = g->nodes[g->readers[r]].unit;
+			if (to == w->unit) continue;
+			if (!dep_reserve((void**)&edges, &edge_cap, 2 * (edge_count + 1), sizeof(size_t))) { free(edges); return 0; }
+			edges[2 * edge_count] = w->unit;
+			edges[2 * edge_count + 1] = to;
+			edge_count++;
+		}
+	}
+
+	size_t* indegree = (size_t*)calloc(units + 1, sizeof(size_t));
+	size_t* out_start = (size_t*)calloc(units + 1, sizeof(size_t));
+	size_t* out = (size_t*)malloc((edge_count ? edge_count : 1) * sizeof(size_t));
+	size_t* rank = (size_t*)malloc((units ? units : 1) * sizeof(size_t));
+	size_t* ready = (size_t*)malloc((units ? units : 1) * sizeof(size_t));
+	int ok = indegree && out_start && out && rank && ready;
+	if (ok) {
+		for (size_t e = 0; e < edge_count; ++e) {
+			out_start[edges[2 * e] + 1]++;
+			indegree[edges[2 * e + 1]]++;
+		}
+		for (size_t u = 0; u < units; ++u) out_start[u + 1] += out_start[u];
+		size_t* fill = ready;   /* borrowed as fill cursors before the queue is used */
+		memcpy(fill, out_start, units * sizeof(size_t));
+		for (size_t e = 0; e < edge_count; ++e) out[fill[edges[2 * e]]++] = edges[2 * e + 1];
+
+		size_t head = 0, tail = 0, next_rank = 0;
+		for (size_t u = 0; u < units; ++u) {
+			rank[u] = (size_t)-1;
+			if (indegree[u] == 0) ready[tail++] = u;
+		}
+		while (head < tail) {
+			size_t u = ready[head++];
+			rank[u] = next_rank++;
+			for (size_t e = out_start[u]; e < out_start[u + 1]; ++e) {
+				if (--indegree[out[e]] == 0) ready[tail++] = out[e];
+			}
+		}
+		for (size_t u = 0; u < units; ++u) {
+			if (rank[u] == (size_t)-1) {
+				rank[u] = next_rank++;
+				g->cyclic_units++;
+			}
+		}
+		for (size_t i = 0; i < g->node_count; ++i) g->nodes[i].rank = rank[g->nodes[i].unit];
+
+		/* by_rank: counting sort of the nodes on their unit rank (stable) */
+		size_t* start = indegree;   /* reused */
+		memset(start, 0, (units + 1) * sizeof(size_t));
+		for (size_t i = 0; i < g->node_count; ++i) start[g->nodes[i].rank + 1]++;
+		for (size_t u = 0; u < units; ++u) start[u + 1] += start[u];
+		for (size_t i = 0; i < g->node_count; ++i) g->by_rank[start[g->nodes[i].rank]++] = i;
+	}
+	free(edges);
+	free(indegree);
+	free(out_start);
+	free(out);
+	free(rank);
+	free(ready);
+	return ok;
+}
+
+DepGraph* depgraph_build(BlockList* block_list, SymbolTable* st)
+{
+	if (!block_list || !st) return NULL;
+	DepGraph* g = (DepGraph*)calloc(1, sizeof(DepGraph));
+	if (!g) return NULL;
+
+	DepBuild b = { 0 };
+	b.g = g;
+	b.st = st;
+
+	BlockType order[] = { BLOCK_GUI, BLOCK_TAB };
+	for (size_t k = 0; k < sizeof(order) / sizeof(order[0]) && !b.failed; ++k) {
+		Block* block = find_block(block_list, order[k]);
+		if (block) dep_walk_commands(&b, block->commands, block->command_count, -1, NULL, 1);
+	}
+	g->unit_count = b.unit;
+
+	if (!b.failed) {
+		g->by_rank = (size_t*)malloc((g->node_count ? g->node_count : 1) * sizeof(size_t));
+		g->mark = (unsigned int*)calloc(g->node_count ? g->node_count : 1, sizeof(unsigned int));
+		g->queue = (size_t*)malloc((g->node_count ? g->node_count : 1) * sizeof(size_t));
+		b.failed = !g->by_rank || !g->mark || !g->queue || !dep_index_readers(g) || !dep_rank_units(g);
+	}
+	if (b.failed) {
+		depgraph_free(g);
+		return NULL;
+	}
+	return g;
+}
+
+void depgraph_free(DepGraph* g)
+{
+	if (!g) return;
+	free(g->nodes);
+	free(g->reads);
+	free(g->reader_start);
+	free(g->readers);
+	free(g->by_rank);
+	free(g->mark);
+	free(g->queue);
+	free(g);
+}
+
+size_t depgraph_affected(DepGraph* g, const SlotSet* changed, const size_t** out)
+{
+	if (out) *out = NULL;
+	if (!g || !changed || !out || g->node_count == 0) return 0;
+
+	if (++g->mark_epoch == 0) {
+		memset(g->mark, 0, g->node_count * sizeof(unsigned int));
+		g->mark_epoch = 1;
+	}
+	const unsigned int epoch = g->mark_epoch;
+	size_t head = 0, tail = 0;
+
+#define DEP_VISIT(i) do { size_t _i = (i); if (g->mark[_i] != epoch) { g->mark[_i] = epoch; g->queue[tail++] = _i; } } while (0)
+#define DEP_VISIT_READERS(s) do { size_t _s = (s); \
+		if (_s != 0 && _s < g->slot_count) \
+			for (size_t _r = g->reader_start[_s]; _r < g->reader_start[_s + 1]; ++_r) DEP_VISIT(g->readers[_r]); \
+	} while (0)
+
+	for (size_t s = slot_set_next(changed, 0); s != 0; s = slot_set_next(changed, s)) {
+		if (s >= g->slot_count) break;
+		DEP_VISIT_READERS(s);
+	}
+	while (head < tail) {
+		const DepNode* n = &g->nodes[g->queue[head++]];
+		if (n->kind == DEP_ASSIGN) {
+			DEP_VISIT_READERS(n->write_slot);
+		}
+		else if (n->kind == DEP_IF) {
+			/* A new winner changes which gated commands apply */
+			for (size_t i = (size_t)(n - g->nodes) + 1; i < n->end; ++i) DEP_VISIT(i);
+		}
+	}
+
+#undef DEP_VISIT
+#undef DEP_VISIT_READERS
+
+	if (tail == 0) return 0;
+	/* The queue is drained; reuse it for the ranked result (count never passes tail) */
+	size_t count = 0;
+	for (size_t k = 0; k < g->node_count && count < tail; ++k) {
+		if (g->mark[g->by_rank[k]] == epoch) g->queue[count++] = g->by_rank[k];
+	}
+	*out = g->queue;
+	return count;
+}
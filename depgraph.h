@@ -0,0 +1,61 @@
+#ifndef DEPGRAPH_H
+#define DEPGRAPH_H
+
+#include "utility.h"
+#include "syntaxanalysis.h"
+
+// Read/write dependency graph of the GUI and TAB blocks, built once by semantic
+// analysis. A node is a command the reactive refresh recomputes (IF condition,
+// assignment, SHOW_PARAM readout, SUB_PICTURE, table, REQUIRED_* check) with the
+// symbol slots it reads; an assignment also writes its LHS slot. Edges run from
+// an assignment to every reader of its slot and from an IF to the commands it
+// gates, so a set of changed slots maps to the nodes that must be recomputed.
+
+typedef enum {
+    DEP_IF,
+    DEP_ASSIGN,
+    DEP_SHOW_PARAM,
+    DEP_SUB_PICTURE,
+    DEP_TABLE,
+    DEP_REQUIRED
+} DepNodeKind;
+
+typedef struct {
+    DepNodeKind kind;
+    CommandNode* cmd;
+    IfNode* root_if;        // Outermost IF of the block containing it, or itself (NULL at block level)
+    int parent;             // Innermost enclosing DEP_IF node, -1 if none
+    size_t end;             // DEP_IF: nodes (index, end) are nested inside it
+    size_t unit;            // Top-level command the node belongs to
+    size_t rank;            // Topological rank of its unit
+    size_t write_slot;      // DEP_ASSIGN: slot of the assigned variable (0 = none)
+    size_t first_read;      // Slots read: reads[first_read .. first_read + read_count)
+    size_t read_count;
+} DepNode;
+
+typedef struct DepGraph {
+    DepNode* nodes;
+    size_t node_count;
+    size_t* reads;
+    size_t read_total;
+    size_t slot_count;      // Slots below this may have readers
+    size_t* reader_start;   // Readers of slot s: readers[reader_start[s] .. reader_start[s + 1])
+    size_t* readers;
+    size_t* by_rank;        // Node indices ordered by (rank, program order)
+    size_t unit_count;
+    size_t cyclic_units;    // Units left on a cycle (ranked in program order)
+    unsigned int* mark;     // Scratch for depgraph_affected
+    unsigned int mark_epoch;
+    size_t* queue;          // BFS queue, then the result of depgraph_affected
+} DepGraph;
+
+// Build the graph for the GUI and TAB blocks. Variable references must already
+// be bound to slots (resolve_variable_refs). Returns NULL on allocation failure.
+DepGraph* depgraph_build(BlockList* block_list, SymbolTable* st);
+void depgraph_free(DepGraph* g);
+// Nodes transitively affected by a change of the slots in changed, in topological
+// order. *out points into the graph's scratch and stays valid until the next call.
+// Returns their count; never allocates.
+size_t depgraph_affected(DepGraph* g, const SlotSet* changed, const size_t** out);
+
+#endif // !DEPGRAPH_H
@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <string.h>
+#include "execstate.h"
+
+ExecState* exec_state_create(void)
+{
+	ExecState* es = (ExecState*)calloc(1, sizeof(ExecState));
+	if (!es) return NULL;
+	es->next_if_id = 1;
+	return es;
+}
+
+void exec_state_free(ExecState* es)
+{
+	if (!es) return;
+	free(es->if_winner);
+	free(es->if_dirty);
+	free(es);
+}
+
+static int exec_state_reserve_if(ExecState* es, int if_id)
+{
+	size_t need = (size_t)if_id + 1;
+	if (need <= es->if_capacity) return 1;
+
+	size_t n = es->if_capacity ? es->if_capacity * 2 : 16;
+	while (n < need) n *= 2;
+	int* winners = (int*)realloc(es->if_winner, n * sizeof(int));
+	if (!winners) return 0;
+	es->if_winner = winners;
+	unsigned char* dirty = (unsigned char*)realloc(es->if_dirty, n);
+	if (!dirty) return 0;
+	es->if_dirty = dirty;
+
+	/* No pass has run for the new ids yet: same as an ELSE / no-branch winner */
+	for (size_t i = es->if_capacity; i < n; ++i) es->if_winner[i] = -1;
+	memset(es->if_dirty + es->if_capacity, 0, n - es->if_capacity);
+	es->if_capacity = n;
+	return 1;
+}
+
+int exec_state_record_winner(ExecState* es, int if_id, int winner)
+{
+	if (!es || if_id <= 0) return 0;
+	if (!exec_state_reserve_if(es, if_id)) return -1;
+	if (es->if_winner[if_id] == winner) return 0;
+	es->if_winner[if_id] = winner;
+	es->if_dirty[if_id] = 1;
+	return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef EXECSTATE_H
+#define EXECSTATE_H
+
+#include <stddef.h>
+
+// Executor bookkeeping for one run of a script: abort and CATCH flags, the IF
+// gate being walked or targeted, and per-IF state indexed by canonical IF id.
+// It lives as long as the run's symbol table (which owns it) and is reached
+// through ExecContext::exec, or st->exec where only the table is at hand.
+
+typedef struct ExecState {
+    int global_abort;               // Set once a command fails outside CATCH; dispatch stops
+    int catch_active;               // Inside BEGIN_CATCH_ERROR
+    int catch_fix_fail_udf;         // FIX_FAIL_UDF option of the innermost CATCH
+    int catch_fix_fail_component;   // FIX_FAIL_COMPONENT option of the innermost CATCH
+    int last_error;                 // Last error caught (ProError), 0 if none
+    int current_if_id;              // IF whose branch is being walked (0 = none)
+    int target_if_id;               // IF a targeted reactive pass recomputes (0 = all)
+    int target_assign_id;           // Only this assignment runs (0 = all)
+    int next_if_id;                 // Next id for an IF without a canonical one
+
+    int* if_winner;                 // By IF id: winner of the last gate pass (-1 = ELSE / none)
+    unsigned char* if_dirty;        // By IF id: the winner changed on some gate pass
+    size_t if_capacity;             // Entries in the by-id arrays
+} ExecState;
+
+ExecState* exec_state_create(void);
+void exec_state_free(ExecState* es);
+// Record the winner of a gate pass over IF if_id. Returns 1 if it differs from
+// the previous pass (the IF is marked dirty), 0 if not, -1 on allocation failure.
+int exec_state_record_winner(ExecState* es, int if_id, int winner);
+
+#endif // !EXECSTATE_H
@@ -4,6 +4,7 @@
 #include "semantic_analysis.h"
 #include "ScriptExecutor.h"
 #include "GuiLogic.h"
+#include "numfmt.h"
 
 
 
@@ -52,9 +53,11 @@ wchar_t* variable_value_to_wstring(const Variable* var) {
     case TYPE_BOOL:
         swprintf(buf, sizeof(buf) / sizeof(wchar_t), L"%d", var->data.int_value);
         return _wcsdup(buf);
-    case TYPE_DOUBLE:
-        swprintf(buf, sizeof(buf) / sizeof(wchar_t), L"%.2f", var->data.double_value);
-        return _wcsdup(buf);
+    case TYPE_DOUBLE: {
+        char text[64];
+        epa_format_double_fixed(var->data.double_value, 2, text, sizeof(text));
+        return char_to_wchar(text);
+    }
     case TYPE_STRING:
         // No quotes, per example
         return char_to_wchar(var->data.string_value ? var->data.string_value : "");
@@ -505,6 +508,57 @@ ProError addShowParam(char* dialog_name, char* parent_layout_name, ShowParamNode
     return PRO_TK_NO_ERROR;
 }
 
+/* Store an input value into its backing Variable (type-aware). Each returns 1
+   only when the stored value changed, so repaints and refreshes can be skipped. */
+static int store_input_text(Variable* var, const char* text)
+{
+    if (var->type != TYPE_STRING || !text) return 0;
+    if (var->data.string_value && strcmp(var->data.string_value, text) == 0) return 0;
+    char* copy = _strdup(text);
+    if (!copy) return 0;
+    free(var->data.string_value);
+    var->data.string_value = copy;
+    return 1;
+}
+
+static int store_input_double(Variable* var, double dv, const char* text)
+{
+    if (var->type == TYPE_DOUBLE) {
+        if (var->data.double_value == dv) return 0;
+        var->data.double_value = dv;
+        return 1;
+    }
+    if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) {
+        if (var->data.int_value == (int)dv) return 0;
+        var->data.int_value = (int)dv;
+        return 1;
+    }
+    return store_input_text(var, text);
+}
+
+static int store_input_int(Variable* var, int iv, const char* text)
+{
+    if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) {
+        if (var->data.int_value == iv) return 0;
+        var->data.int_value = iv;
+        return 1;
+    }
+    if (var->type == TYPE_DOUBLE) {
+        // critical: keep active slot in sync for DOUBLE backing
+        if (var->data.double_value == (double)iv) return 0;
+        var->data.double_value = (double)iv;
+        return 1;
+    }
+    return store_input_text(var, text);
+}
+
+/* Record an in-place edit: count it as a symbol change and journal it for the next refresh */
+static void note_param_changed(SymbolTable* st, const char* param)
+{
+    touch_symbol(st, param);
+    EPA_MarkDirty(st, param);
+}
+
 /*=================================================*\
 * 
 * CHECKBOX_PARAM command display executable
@@ -537,7 +591,11 @@ ProError CheckboxCallback(char* dialog, char* component, ProAppData app_data) {
         return PRO_TK_GENERAL_ERROR;
     }
     
-    var->data.int_value = (state == PRO_B_TRUE) ? 1 : 0;
+    const int checked = (state == PRO_B_TRUE) ? 1 : 0;
+    if (var->data.int_value != checked) {
+        var->data.int_value = checked;
+        note_param_changed(st, param);
+    }
     ProPrintfChar("Updated '%s' to %d (selected: %s)", param, var->data.int_value, state ? "true" : "false");
     
     // Optional: Re-validate OK button if this checkbox affects requirements
@@ -887,11 +945,11 @@ ProError InputFilterCallback(char* dialog, char* component, ProAppData app_data)
     int is_valid = 0; char* endptr = NULL; errno = 0;
     switch (filter_data->subtype) {
     case PARAM_STRING: is_valid = 1; break;
-    case PARAM_INT:    (void)strtol(current_str, &endptr, 10);
+    case PARAM_INT:    (void)epa_strtol(current_str, &endptr);
         is_valid = (endptr == current_str + strlen(current_str)) && (errno != ERANGE); break;
-    case PARAM_BOOL: { long v = strtol(current_str, &endptr, 10);
+    case PARAM_BOOL: { long v = epa_strtol(current_str, &endptr);
         is_valid = (endptr == current_str + strlen(current_str)) && (errno != ERANGE) && (v == 0 || v == 1); } break;
-    case PARAM_DOUBLE: (void)strtod(current_str, &endptr);
+    case PARAM_DOUBLE: (void)epa_strtod(current_str, &endptr);
         is_valid = (endptr == current_str + strlen(current_str)) && (errno != ERANGE); break;
     default:           is_valid = 0; break;
     }
@@ -902,53 +960,30 @@ ProError InputFilterCallback(char* dialog, char* component, ProAppData app_data)
         filter_data->last_valid = _strdup(current_str);
 
         // write symbol (type-aware) 
+        int changed = 0;
         Variable* var = get_symbol(filter_data->st, filter_data->parameter);
         if (var) {
             switch (filter_data->subtype) {
-            case PARAM_DOUBLE: {
-                double dv = strtod(current_str, NULL);
-                if (var->type == TYPE_DOUBLE) {
-                    var->data.double_value = dv;
-                }
-                else if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) {
-                    var->data.int_value = (int)dv;
-                }
-                else if (var->type == TYPE_STRING) {
-                    free(var->data.string_value);
-                    var->data.string_value = _strdup(current_str);
-                }
+            case PARAM_DOUBLE:
+                changed = store_input_double(var, epa_strtod(current_str, NULL), current_str);
                 break;
-            }
             case PARAM_INT:
-            case PARAM_BOOL: {
-                int iv = (int)strtol(current_str, NULL, 10);
-                if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) {
-                    var->data.int_value = iv;
-                }
-                else if (var->type == TYPE_DOUBLE) {
-                    // critical: keep active slot in sync for DOUBLE backing 
-                    var->data.double_value = (double)iv;
-                }
-                else if (var->type == TYPE_STRING) {
-                    free(var->data.string_value);
-                    var->data.string_value = _strdup(current_str);
-                }
+            case PARAM_BOOL:
+                changed = store_input_int(var, (int)epa_strtol(current_str, NULL), current_str);
                 break;
-            }
             case PARAM_STRING:
-                if (var->type == TYPE_STRING) {
-                    free(var->data.string_value);
-                    var->data.string_value = _strdup(current_str);
-                }
+                changed = store_input_text(var, current_str);
                 break;
             default: break;
             }
         }
 
-
-        // repaint + reactive IF rebuild 
-        (void)ProUIDrawingareaClear(dialog, "draw_area");
-        (void)addpicture(dialog, "draw_area", (ProAppData)filter_data->st);
+        // repaint only when the keystroke changed the stored value (e.g. not "1.50" -> "1.5")
+        if (changed) {
+            note_param_changed(filter_data->st, filter_data->parameter);
+            (void)ProUIDrawingareaClear(dialog, "draw_area");
+            (void)addpicture(dialog, "draw_area", (ProAppData)filter_data->st);
+        }
     }
     else {
         // revert to last valid 
@@ -980,37 +1015,30 @@ ProError ActivateCallback(char* dialog, char* component, ProAppData app_data) {
     }
 
     ProError status = PRO_TK_NO_ERROR;
+    int changed = 0;
     switch (filter_data->subtype) {
     case PARAM_DOUBLE: {
         double val; status = ProUIInputpanelDoubleGet(dialog, component, &val);
-        if (status == PRO_TK_NO_ERROR) {
-            if (var->type == TYPE_DOUBLE) var->data.double_value = val;
-            else if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) var->data.int_value = (int)val;
-        }
+        if (status == PRO_TK_NO_ERROR) changed = store_input_double(var, val, NULL);
         break;
     }
     case PARAM_INT:
     case PARAM_BOOL: {
         int val; status = ProUIInputpanelIntegerGet(dialog, component, &val);
-        if (status == PRO_TK_NO_ERROR) {
-            if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) var->data.int_value = val;
-            else if (var->type == TYPE_DOUBLE) var->data.double_value = (double)val; /* critical sync */
-        }
+        if (status == PRO_TK_NO_ERROR) changed = store_input_int(var, val, NULL);
         break;
     }
     case PARAM_STRING: {
         char* sval = NULL; status = ProUIInputpanelStringGet(dialog, component, &sval);
         if (status == PRO_TK_NO_ERROR && sval) {
-            if (var->type == TYPE_STRING) {
-                free(var->data.string_value);
-                var->data.string_value = _strdup(sval);
-            }
+            changed = store_input_text(var, sval);
             ProStringFree(sval);
         }
         break;
     }
     default: break;
     }
+    if (changed) note_param_changed(filter_data->st, filter_data->parameter);
 
     // debug + SHOW_PARAM label update (if present) 
     Variable* after = get_symbol(filter_data->st, filter_data->parameter);
@@ -1020,7 +1048,7 @@ ProError ActivateCallback(char* dialog, char* component, ProAppData app_data) {
     }
 
     refresh_required_input_highlights(dialog, filter_data->st);
-    EPA_ReactiveRefresh();  // makes IF branches/picture choice/button gating react now
+    EPA_ReactiveRefresh();  // no-op unless a value changed since the last refresh
 
     filter_data->in_activate = PRO_B_FALSE;
     return status;
@@ -1045,37 +1073,30 @@ ProError OnPictureActivateCallback(char* dialog, char* component, ProAppData app
     }
 
     ProError status = PRO_TK_NO_ERROR;
+    int changed = 0;
     switch (filter_data->subtype) {
     case PARAM_DOUBLE: {
         double val; status = ProUIInputpanelDoubleGet(dialog, component, &val);
-        if (status == PRO_TK_NO_ERROR) {
-            if (var->type == TYPE_DOUBLE) var->data.double_value = val;
-            else if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) var->data.int_value = (int)val;
-        }
+        if (status == PRO_TK_NO_ERROR) changed = store_input_double(var, val, NULL);
         break;
     }
     case PARAM_INT:
     case PARAM_BOOL: {
         int val; status = ProUIInputpanelIntegerGet(dialog, component, &val);
-        if (status == PRO_TK_NO_ERROR) {
-            if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) var->data.int_value = val;
-            else if (var->type == TYPE_DOUBLE) var->data.double_value = (double)val; /* critical sync */
-        }
+        if (status == PRO_TK_NO_ERROR) changed = store_input_int(var, val, NULL);
         break;
     }
     case PARAM_STRING: {
         char* sval = NULL; status = ProUIInputpanelStringGet(dialog, component, &sval);
         if (status == PRO_TK_NO_ERROR && sval) {
-            if (var->type == TYPE_STRING) {
-                free(var->data.string_value);
-                var->data.string_value = _strdup(sval);
-            }
+            changed = store_input_text(var, sval);
             ProStringFree(sval);
         }
         break;
     }
     default: break;
     }
+    if (changed) note_param_changed(filter_data->st, filter_data->parameter);
 
     // debug + SHOW_PARAM label update (if present) 
     Variable* after = get_symbol(filter_data->st, filter_data->parameter);
@@ -1085,7 +1106,7 @@ ProError OnPictureActivateCallback(char* dialog, char* component, ProAppData app
     }
 
     refresh_required_input_highlights(dialog, filter_data->st);
-    EPA_ReactiveRefresh();  // makes IF branches/picture choice/button gating react now
+    EPA_ReactiveRefresh();  // no-op unless a value changed since the last refresh
 
     filter_data->in_activate = PRO_B_FALSE;
     return status;
@@ -1252,7 +1273,7 @@ ProError OnPictureUserInputParam(char* dialog, char* draw_area_name, UserInputPa
         double val;
         status = ProUIInputpanelDoubleGet(dialog, input_id, &val);
         if (status == PRO_TK_NO_ERROR) {
-            snprintf(buf, sizeof(buf), "%.2f", val);  // Adjust precision as needed
+            epa_format_double_fixed(val, 2, buf, sizeof(buf));  // Adjust precision as needed
             init_str = buf;
         }
         break;
@@ -1581,7 +1602,7 @@ ProError addUserInputParam(char* dialog_name, char* parent_layout_name, UserInpu
         double val;
         status = ProUIInputpanelDoubleGet(dialog_name, input_id, &val);
         if (status == PRO_TK_NO_ERROR) {
-            snprintf(buf, sizeof(buf), "%.2f", val);  // Adjust precision as needed
+            epa_format_double_fixed(val, 2, buf, sizeof(buf));  // Adjust precision as needed
             init_str = buf;
         }
         break;
@@ -1875,16 +1896,16 @@ ProError RadioSelectCallback(char* dialog, char* component, ProAppData app_data)
                 return PRO_TK_GENERAL_ERROR;
             }
         }
-        var->data.int_value = index;
+        if (var->data.int_value != index) {
+            var->data.int_value = index;
+            note_param_changed(data->st, data->parameter);
+        }
+        free(sel_name);
         ProPrintfChar("Selected radio index: %d for parameter %s\n", index, data->parameter);
     }
     else if (var->type == TYPE_STRING) {
-        free(var->data.string_value);
-        var->data.string_value = sel_name;
-        if (!var->data.string_value) {
-            ProPrintfChar("Error: Memory allocation failed for selected value in '%s'", data->parameter);
-            return PRO_TK_GENERAL_ERROR;
-        }
+        if (store_input_text(var, sel_name)) note_param_changed(data->st, data->parameter);
+        free(sel_name);
         ProPrintfChar("Selected radio: %s for parameter %s\n", var->data.string_value, data->parameter);
     }
     else {
@@ -2026,7 +2047,7 @@ ProError OnPictureRadioButtonParam(char* dialog, char* draw_area_name, RadioButt
         }
 
         size_t new_size = req_var->data.array.size + 1;
-        Variable** new_elements = realloc(req_var->data.array.elements, new_size * sizeof(Variable*));
+        Variable** new_elements = variable_make_unique(req_var) != 0 ? NULL : realloc(req_var->data.array.elements, new_size * sizeof(Variable*));
         if (!new_elements) {
             free(param_name_var->data.string_value);
             free(param_name_var);
@@ -2150,7 +2171,10 @@ ProError OnPictureRadioButtonParam(char* dialog, char* draw_area_name, RadioButt
             ProPrintfChar("Error: Could not set initial selection for radio group '%s'.\n", node->parameter);
             goto cleanup;
         }
-        var->data.int_value = 0;  // Ensure variable matches UI
+        if (var->data.int_value != 0) {
+            var->data.int_value = 0;  // Ensure variable matches UI
+            note_param_changed(st, node->parameter);
+        }
 
         // Log the default selection
         LogOnlyPrintfChar("Default Selection Index: %d ", var->data.int_value);
@@ -2287,7 +2311,7 @@ ProError addRadioButtonParam(char* dialog_name, char* parent_layout_name, RadioB
         if (!param_name_var->data.string_value) { free(param_name_var); free(w_parameter); return PRO_TK_GENERAL_ERROR; }
 
         size_t new_size = req_var->data.array.size + 1;
-        Variable** new_elements = (Variable**)realloc(req_var->data.array.elements, new_size * sizeof(Variable*));
+        Variable** new_elements = variable_make_unique(req_var) != 0 ? NULL : (Variable**)realloc(req_var->data.array.elements, new_size * sizeof(Variable*));
         if (!new_elements) {
             free(param_name_var->data.string_value);
             free(param_name_var);
@@ -2392,7 +2416,10 @@ ProError addRadioButtonParam(char* dialog_name, char* parent_layout_name, RadioB
             ProPrintfChar("Error: Could not set initial selection for radio group '%s'.\n", node->parameter);
             goto cleanup;
         }
-        var->data.int_value = 0;
+        if (var->data.int_value != 0) {
+            var->data.int_value = 0;
+            note_param_changed(st, node->parameter);
+        }
         LogOnlyPrintfChar("Default Selection Index: %d ", var->data.int_value);
     }
 
@@ -0,0 +1,248 @@
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Asynchronous logger: callers format into a fixed ring of slots (bounded
+// multi-producer queue, one sequence number per slot) and a background thread
+// appends published slots to the log file, which stays open. Nothing on the
+// calling thread touches the file system.
+
+#define LOG_RING_MASK (LOG_RING_SLOTS - 1)
+#define LOG_WAKE_EVERY (LOG_RING_SLOTS / 4)  // Wake the flusher early every N messages
+#define LOG_FULL_RETRIES 64                  // Spins on a full ring before dropping
+
+typedef struct {
+	volatile LONG sequence;  // == position when free, position + 1 once published (MSVC volatile: acquire/release)
+	LONG level;
+	int length;
+	char text[LOG_LINE_SIZE];
+} LogSlot;
+
+enum { LOG_STOPPED = 0, LOG_STARTING, LOG_RUNNING, LOG_STOPPING };
+
+volatile LONG g_log_level = LOG_LEVEL_INFO;
+
+static LogSlot s_ring[LOG_RING_SLOTS];
+static volatile LONG s_write_pos = 0;   // Next position a producer claims
+static LONG s_read_pos = 0;             // Next position to drain (under s_drain_lock)
+static volatile LONG s_dropped = 0;     // Messages lost to a full ring since last drain
+static volatile LONG s_state = LOG_STOPPED;
+static volatile LONG s_stop = 0;
+static volatile LONG s_users = 0;      // Calls past the LOG_RUNNING check in log_flush/log_writev
+static CRITICAL_SECTION s_drain_lock;
+static HANDLE s_wake = NULL;
+static HANDLE s_thread = NULL;
+static FILE* s_file = NULL;
+static char s_path[MAX_PATH] = "log.txt";
+
+static void log_start(void);
+
+static LogLevel parse_level(const char* text)
+{
+	if (_stricmp(text, "DEBUG") == 0) return LOG_LEVEL_DEBUG;
+	if (_stricmp(text, "INFO") == 0) return LOG_LEVEL_INFO;
+	if (_stricmp(text, "WARN") == 0 || _stricmp(text, "WARNING") == 0) return LOG_LEVEL_WARN;
+	if (_stricmp(text, "ERROR") == 0) return LOG_LEVEL_ERROR;
+	if (_stricmp(text, "OFF") == 0) return LOG_LEVEL_OFF;
+	return LOG_LEVEL_INFO;
+}
+
+// Caller holds s_drain_lock
+static void drain_locked(void)
+{
+	int wrote = 0;
+	for (;;) {
+		LogSlot* slot = &s_ring[s_read_pos & LOG_RING_MASK];
+		if (slot->sequence != s_read_pos + 1)
+			break;  // Not yet published
+
+		if (s_file && slot->length > 0) {
+			fwrite(slot->text, 1, (size_t)slot->length, s_file);
+			if (slot->text[slot->length - 1] != '\n')
+				fputc('\n', s_file);
+			wrote = 1;
+		}
+		// Hand the slot back to producers for the next lap
+		InterlockedExchange(&slot->sequence, s_read_pos + LOG_RING_SLOTS);
+		s_read_pos++;
+	}
+
+	LONG dropped = InterlockedExchange(&s_dropped, 0);
+	if (dropped > 0 && s_file) {
+		fprintf(s_file, "[log] %ld message(s) dropped: ring buffer full\n", (long)dropped);
+		wrote = 1;
+	}
+	if (wrote && s_file)
+		fflush(s_file);
+}
+
+static DWORD WINAPI log_thread_proc(LPVOID param)
+{
+	(void)param;
+	while (!s_stop) {
+		WaitForSingleObject(s_wake, LOG_FLUSH_INTERVAL_MS);
+		log_flush();
+	}
+	return 0;
+}
+
+static void log_start(void)
+{
+	if (InterlockedCompareExchange(&s_state, LOG_STARTING, LOG_STOPPED) != LOG_STOPPED) {
+		// Another thread is starting the logger; wait until it is usable
+		while (s_state == LOG_STARTING)
+			Sleep(0);
+		return;
+	}
+
+	for (LONG i = 0; i < LOG_RING_SLOTS; i++)
+		s_ring[i].sequence = i;
+	s_write_pos = 0;
+	s_read_pos = 0;
+	s_dropped = 0;
+	s_stop = 0;
+
+	char level[16];
+	DWORD n = GetEnvironmentVariableA("EMJAC_LOG_LEVEL", level, sizeof(level));
+	if (n > 0 && n < sizeof(level))
+		g_log_level = parse_level(level);
+
+	InitializeCriticalSection(&s_drain_lock);
+	if (fopen_s(&s_file, s_path, "a") != 0)
+		s_file = NULL;
+
+	// Without a flush thread, log_write drains synchronously
+	s_wake = CreateEventW(NULL, FALSE, FALSE, NULL);
+	if (s_wake)
+		s_thread = CreateThread(NULL, 0, log_thread_proc, NULL, 0, NULL);
+
+	InterlockedExchange(&s_state, LOG_RUNNING);
+}
+
+void log_init(const char* path)
+{
+	if (path && *path && s_state == LOG_STOPPED)
+		strncpy_s(s_path, sizeof(s_path), path, _TRUNCATE);
+	log_start();
+}
+
+void log_shutdown(void)
+{
+	// Leave LOG_RUNNING first so no new caller touches the ring or the lock,
+	// then wait out the ones already past the check
+	if (InterlockedCompareExchange(&s_state, LOG_STOPPING, LOG_RUNNING) != LOG_RUNNING)
+		return;
+	while (s_users > 0)
+		Sleep(0);
+
+	if (s_thread) {
+		InterlockedExchange(&s_stop, 1);
+		SetEvent(s_wake);
+		WaitForSingleObject(s_thread, INFINITE);
+		CloseHandle(s_thread);
+		s_thread = NULL;
+	}
+	if (s_wake) {
+		CloseHandle(s_wake);
+		s_wake = NULL;
+	}
+
+	EnterCriticalSection(&s_drain_lock);
+	drain_locked();
+	LeaveCriticalSection(&s_drain_lock);
+	if (s_file) {
+		fclose(s_file);
+		s_file = NULL;
+	}
+	DeleteCriticalSection(&s_drain_lock);
+	InterlockedExchange(&s_state, LOG_STOPPED);
+}
+
+void log_set_level(LogLevel level)
+{
+	InterlockedExchange(&g_log_level, (LONG)level);
+}
+
+LogLevel log_get_level(void)
+{
+	return (LogLevel)g_log_level;
+}
+
+void log_flush(void)
+{
+	InterlockedIncrement(&s_users);
+	if (s_state == LOG_RUNNING) {
+		EnterCriticalSection(&s_drain_lock);
+		drain_locked();
+		LeaveCriticalSection(&s_drain_lock);
+	}
+	InterlockedDecrement(&s_users);
+}
+
+void log_writev(LogLevel level, const char* format, va_list args)
+{
+	if ((LONG)level < g_log_level || level >= LOG_LEVEL_OFF || !format)
+		return;
+	if (s_state == LOG_STOPPED || s_state == LOG_STARTING)
+		log_start();
+	InterlockedIncrement(&s_users);
+	if (s_state != LOG_RUNNING) {
+		// Shutting down: the final drain may already have run
+		InterlockedDecrement(&s_users);
+		return;
+	}
+
+	// Claim a slot: its sequence equals the position while it is free
+	LogSlot* slot;
+	LONG pos;
+	int attempts = 0;
+	for (;;) {
+		pos = s_write_pos;
+		slot = &s_ring[pos & LOG_RING_MASK];
+		LONG diff = slot->sequence - pos;
+		if (diff == 0) {
+			if (InterlockedCompareExchange(&s_write_pos, pos + 1, pos) == pos)
+				break;
+		}
+		else if (diff < 0) {
+			// Ring full: let the consumer catch up, then give up on this message
+			if (++attempts > LOG_FULL_RETRIES) {
+				InterlockedIncrement(&s_dropped);
+				InterlockedDecrement(&s_users);
+				return;
+			}
+			if (s_thread) {
+				SetEvent(s_wake);
+				Sleep(attempts < 8 ? 0 : 1);
+			}
+			else {
+				log_flush();
+			}
+		}
+		// diff > 0: another producer took this position; reload and retry
+	}
+
+	int len = vsnprintf(slot->text, LOG_LINE_SIZE, format, args);
+	if (len < 0)
+		len = 0;
+	else if (len >= LOG_LINE_SIZE)
+		len = LOG_LINE_SIZE - 1;
+	slot->length = len;
+	slot->level = (LONG)level;
+	InterlockedExchange(&slot->sequence, pos + 1);  // Publish
+
+	if (!s_thread)
+		log_flush();
+	else if ((pos & (LOG_WAKE_EVERY - 1)) == 0)
+		SetEvent(s_wake);
+	InterlockedDecrement(&s_users);
+}
+
+void log_write(LogLevel level, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	log_writev(level, format, args);
+	va_end(args);
+}
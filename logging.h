@@ -0,0 +1,59 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <windows.h>
+#include <stdarg.h>
+
+// Log severities, lowest first. A message is written when its level is at or
+// above both the compile-time floor and the runtime threshold.
+typedef enum {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF
+} LogLevel;
+
+// Compile-time floor: call sites below it fold to nothing. Release builds keep
+// INFO and above; define LOG_COMPILE_LEVEL to override.
+#ifndef LOG_COMPILE_LEVEL
+#ifdef _DEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+#define LOG_RING_SLOTS 512      // Pending messages (power of two)
+#define LOG_LINE_SIZE 1024      // Bytes per message, including '\0'
+#define LOG_FLUSH_INTERVAL_MS 100
+
+// Runtime threshold (LogLevel); read without locking on every call site
+extern volatile LONG g_log_level;
+
+#define log_enabled(level) \
+    ((level) >= LOG_COMPILE_LEVEL && (LONG)(level) >= g_log_level)
+
+// Level macros. Arguments are only evaluated when the level is enabled, so
+// expensive formatting helpers can be passed directly.
+#define LOG_AT(level, ...) \
+    do { if (log_enabled(level)) log_write((level), __VA_ARGS__); } while (0)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Opens the log file and starts the flush thread. Optional: the first
+// log_write starts the logger with the default path ("log.txt").
+void log_init(const char* path);
+// Stops the flush thread, drains pending messages and closes the file
+void log_shutdown(void);
+void log_set_level(LogLevel level);
+LogLevel log_get_level(void);
+// Formats straight into a ring slot; never blocks on file I/O
+void log_write(LogLevel level, const char* format, ...);
+void log_writev(LogLevel level, const char* format, va_list args);
+// Writes every message queued so far before returning
+void log_flush(void);
+
+#endif // !LOGGING_H
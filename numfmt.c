@@ -0,0 +1,454 @@
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "numfmt.h"
+
+/* Powers of ten that are exact doubles, and the 2^53 bound below which every
+   integer is one */
+#define EXACT_POW10_MAX 22
+#define TWO_POW_53 9007199254740992.0
+
+static const double pow10_exact[EXACT_POW10_MAX + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t pow10_int[20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+	1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static size_t copy_out(const char* text, size_t len, char* buf, size_t size)
+{
+	if (!buf || len >= size) {
+		if (buf && size) buf[0] = '\0';
+		return 0;
+	}
+	memcpy(buf, text, len);
+	buf[len] = '\0';
+	return len;
+}
+
+/* Decimal digits of n; returns the end of the written text */
+static char* put_digits(uint64_t n, char* out)
+{
+	char rev[20];
+	int len = 0;
+	do {
+		rev[len++] = (char)('0' + n % 10);
+		n /= 10;
+	} while (n);
+	while (len) *out++ = rev[--len];
+	return out;
+}
+
+static const char* locale_point(void)
+{
+	const struct lconv* lc = localeconv();
+	return (lc && lc->decimal_point && lc->decimal_point[0]) ? lc->decimal_point : ".";
+}
+
+/* Slow path: the CRT formatter, with the locale decimal point put back to '.' */
+static size_t crt_format(const char* fmt, int precision, double v, char* buf, size_t size)
+{
+	char tmp[352];  /* %.17f of DBL_MAX */
+	int len = snprintf(tmp, sizeof(tmp), fmt, precision, v);
+	if (len < 0 || (size_t)len >= sizeof(tmp)) return copy_out("", 0, buf, size);
+
+	const char* point = locale_point();
+	size_t point_len = strlen(point);
+	if (strcmp(point, ".") != 0) {
+		char* at = strstr(tmp, point);
+		if (at) {
+			*at = '.';
+			memmove(at + 1, at + point_len, strlen(at + point_len) + 1);
+			len -= (int)(point_len - 1);
+		}
+	}
+	return copy_out(tmp, (size_t)len, buf, size);
+}
+
+/* Exact product a * b == *hi + *lo (Dekker); no overflow for the operands used here */
+static void two_product(double a, double b, double* hi, double* lo)
+{
+	const double split = 134217729.0;  /* 2^27 + 1 */
+	double t, ah, al, bh, bl;
+
+	*hi = a * b;
+	t = split * a;
+	ah = t - (t - a);
+	al = a - ah;
+	t = split * b;
+	bh = t - (t - b);
+	bl = b - bh;
+	*lo = ((ah * bh - *hi) + ah * bl + al * bh) + al * bl;
+}
+
+/* a * 10^s (a >= 0, 0 <= s <= 22) split into its integer part and whether the
+   exact product rounds up from it. -1 when the product is 2^53 or more or lies
+   exactly halfway, where the CRT's tie rule decides. */
+static int scaled_round(double a, int s, uint64_t* whole, int* up)
+{
+	double p, err, f, d;
+
+	two_product(a, pow10_exact[s], &p, &err);
+	if (!(p < TWO_POW_53)) return -1;
+	f = floor(p);
+	if (p == f && err < 0) {
+		/* exact product is just below the integer p */
+		f -= 1.0;
+		d = 0.5 + err;
+	}
+	else {
+		d = (p - f - 0.5) + err;
+	}
+	if (d == 0) return -1;
+	*whole = (uint64_t)f;
+	*up = d > 0;
+	return 0;
+}
+
+/* %.*g digits of a > 0 via a * 10^s; 0 when the fast path does not apply */
+static int put_g_scaled(double a, int precision, char** out)
+{
+	int s = precision - 1 - (int)floor(log10(a));
+	uint64_t whole = 0;
+	int up = 0;
+
+	for (int tries = 0;; ++tries) {
+		if (s < 0 || s > EXACT_POW10_MAX || tries > 2) return 0;
+		if (scaled_round(a, s, &whole, &up) != 0) return 0;
+		if (whole >= pow10_int[precision]) --s;
+		else if (whole < pow10_int[precision - 1]) ++s;
+		else break;
+	}
+
+	uint64_t n = whole + (uint64_t)up;
+	int x = precision - 1 - s;  /* decimal exponent of the leading digit */
+	if (n == pow10_int[precision]) {
+		n /= 10;
+		++x;
+	}
+
+	char dig[20];
+	int len = (int)(put_digits(n, dig) - dig);
+	while (len > 1 && dig[len - 1] == '0') --len;
+
+	char* p = *out;
+	if (x < -4 || x >= precision) {
+		*p++ = dig[0];
+		if (len > 1) {
+			*p++ = '.';
+			memcpy(p, dig + 1, (size_t)(len - 1));
+			p += len - 1;
+		}
+		*p++ = 'e';
+		*p++ = x < 0 ? '-' : '+';
+		if (x < 0) x = -x;
+		if (x < 10) *p++ = '0';
+		p = put_digits((uint64_t)x, p);
+	}
+	else if (x < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		for (int i = -1; i > x; --i) *p++ = '0';
+		memcpy(p, dig, (size_t)len);
+		p += len;
+	}
+	else {
+		int int_len = x + 1;
+		for (int i = 0; i < int_len; ++i) *p++ = i < len ? dig[i] : '0';
+		if (len > int_len) {
+			*p++ = '.';
+			memcpy(p, dig + int_len, (size_t)(len - int_len));
+			p += len - int_len;
+		}
+	}
+	*out = p;
+	return 1;
+}
+
+static size_t format_special(double v, char* buf, size_t size)
+{
+	const char* text = isnan(v) ? "nan" : (v < 0 ? "-inf" : "inf");
+	return copy_out(text, strlen(text), buf, size);
+}
+
+size_t epa_format_double_g(double v, int precision, char* buf, size_t size)
+{
+	char tmp[40];
+	char* p = tmp;
+	double a = fabs(v);
+
+	if (precision < 1) precision = 1;
+	if (precision > 17) precision = 17;
+	if (!isfinite(v)) return format_special(v, buf, size);
+
+	if (signbit(v)) *p++ = '-';
+	if (a == 0) {
+		*p++ = '0';
+	}
+	else if (a < TWO_POW_53 && a == floor(a) && a < (double)pow10_int[precision]) {
+		p = put_digits((uint64_t)a, p);
+	}
+	else if (!put_g_scaled(a, precision, &p)) {
+		return crt_format("%.*g", precision, v, buf, size);
+	}
+	return copy_out(tmp, (size_t)(p - tmp), buf, size);
+}
+
+size_t epa_format_double(double v, char* buf, size_t size)
+{
+	char tmp[40];
+	for (int precision = 15; precision < 17; ++precision) {
+		size_t len = epa_format_double_g(v, precision, tmp, sizeof(tmp));
+		if (len && epa_strtod(tmp, NULL) == v) return copy_out(tmp, len, buf, size);
+	}
+	return epa_format_double_g(v, 17, buf, size);
+}
+
+size_t epa_format_double_fixed(double v, int decimals, char* buf, size_t size)
+{
+	char tmp[64];
+	char* p = tmp;
+	uint64_t whole;
+	int up;
+
+	if (decimals < 0) decimals = 0;
+	if (decimals > 17) decimals = 17;
+	if (!isfinite(v)) return format_special(v, buf, size);
+	if (scaled_round(fabs(v), decimals, &whole, &up) != 0)
+		return crt_format("%.*f", decimals, v, buf, size);
+
+	char dig[24];
+	int len = (int)(put_digits(whole + (uint64_t)up, dig) - dig);
+	if (len <= decimals) {
+		/* left-pad so there is one integer digit */
+		int pad = decimals + 1 - len;
+		memmove(dig + pad, dig, (size_t)len);
+		memset(dig, '0', (size_t)pad);
+		len += pad;
+	}
+
+	if (signbit(v)) *p++ = '-';
+	memcpy(p, dig, (size_t)(len - decimals));
+	p += len - decimals;
+	if (decimals) {
+		*p++ = '.';
+		memcpy(p, dig + len - decimals, (size_t)decimals);
+		p += decimals;
+	}
+	return copy_out(tmp, (size_t)(p - tmp), buf, size);
+}
+
+size_t epa_format_long(long v, char* buf, size_t size)
+{
+	char tmp[24];
+	char* p = tmp;
+	unsigned long long magnitude = (unsigned long long)v;
+
+	if (v < 0) {
+		*p++ = '-';
+		magnitude = 0ULL - magnitude;
+	}
+	p = put_digits(magnitude, p);
+	return copy_out(tmp, (size_t)(p - tmp), buf, size);
+}
+
+static int is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static int is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/* Slow path: strtod on a copy of [start, stop) spelled with the locale decimal point.
+   *end (if not NULL) receives the source position matching where strtod stopped. */
+static double crt_parse(const char* start, const char* stop, char** end)
+{
+	const char* point = locale_point();
+	size_t point_len = strlen(point);
+	size_t len = (size_t)(stop - start);
+	char local[128];
+	char* copy = local;
+	char* q;
+	double v;
+
+	if (len + point_len + 1 > sizeof(local)) {
+		copy = (char*)malloc(len + point_len + 1);
+		if (!copy) {
+			errno = ENOMEM;
+			return 0.0;
+		}
+	}
+	q = copy;
+	for (const char* p = start; p < stop; ++p) {
+		if (*p == '.') {
+			memcpy(q, point, point_len);
+			q += point_len;
+		}
+		else {
+			*q++ = *p;
+		}
+	}
+	*q = '\0';
+	v = strtod(copy, &q);
+	if (end) {
+		const char* p = start;
+		for (size_t used = 0; used < (size_t)(q - copy); ++p)
+			used += *p == '.' ? point_len : 1;
+		*end = (char*)p;
+	}
+	if (copy != local) free(copy);
+	return v;
+}
+
+/* Hex floats, INF and NAN are left to the CRT. Only characters those forms can
+   hold are copied; the CRT decides how much of them is the number. */
+static double crt_parse_special(const char* start, char** end)
+{
+	const char* stop = start;
+
+	if (*stop == '+' || *stop == '-') ++stop;
+	while ((*stop >= '0' && *stop <= '9') || (*stop >= 'a' && *stop <= 'z') || (*stop >= 'A' && *stop <= 'Z')
+		|| *stop == '.' || *stop == '_' || *stop == '(' || *stop == ')'
+		|| ((*stop == '+' || *stop == '-') && (stop[-1] == 'p' || stop[-1] == 'P')))
+		++stop;
+	return crt_parse(start, stop, end);
+}
+
+double epa_strtod(const char* s, char** end)
+{
+	const char* p = s;
+	const char* start;
+	uint64_t mantissa = 0;
+	int digits = 0;     /* significant digits held in mantissa */
+	int dropped = 0;    /* a nonzero digit did not fit in mantissa */
+	int exp10 = 0;
+	int any = 0;
+	int negative = 0;
+	double v;
+
+	while (is_blank(*p)) ++p;
+	start = p;
+	if (*p == '+' || *p == '-') negative = *p++ == '-';
+	if ((p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) || *p == 'i' || *p == 'I' || *p == 'n' || *p == 'N') {
+		v = crt_parse_special(start, end);
+		if (end && *end == start) *end = (char*)s;
+		return v;
+	}
+
+	for (; is_digit(*p); ++p) {
+		int d = *p - '0';
+		any = 1;
+		if (mantissa == 0 && d == 0) continue;
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (uint64_t)d;
+			++digits;
+		}
+		else {
+			++exp10;
+			dropped |= d != 0;
+		}
+	}
+	if (*p == '.') {
+		for (++p; is_digit(*p); ++p) {
+			int d = *p - '0';
+			any = 1;
+			if (mantissa == 0 && d == 0) {
+				--exp10;
+			}
+			else if (digits < 19) {
+				mantissa = mantissa * 10 + (uint64_t)d;
+				++digits;
+				--exp10;
+			}
+			else {
+				dropped |= d != 0;
+			}
+		}
+	}
+	if (!any) {
+		if (end) *end = (char*)s;
+		return 0.0;
+	}
+	if (*p == 'e' || *p == 'E') {
+		const char* q = p + 1;
+		int exp_negative = 0;
+		int e = 0;
+		if (*q == '+' || *q == '-') exp_negative = *q++ == '-';
+		if (is_digit(*q)) {
+			for (; is_digit(*q); ++q) {
+				if (e < 100000) e = e * 10 + (*q - '0');
+			}
+			exp10 += exp_negative ? -e : e;
+			p = q;
+		}
+	}
+	if (end) *end = (char*)p;
+
+	/* Exact mantissa times an exact power of ten rounds once (Clinger) */
+	if (mantissa == 0) return negative ? -0.0 : 0.0;
+	if (!dropped && mantissa <= (uint64_t)TWO_POW_53) {
+		if (exp10 >= 0 && exp10 <= EXACT_POW10_MAX) {
+			v = (double)mantissa * pow10_exact[exp10];
+			return negative ? -v : v;
+		}
+		if (exp10 < 0 && exp10 >= -EXACT_POW10_MAX) {
+			v = (double)mantissa / pow10_exact[-exp10];
+			return negative ? -v : v;
+		}
+		if (exp10 > EXACT_POW10_MAX && exp10 - EXACT_POW10_MAX < 16) {
+			/* move the excess into the mantissa while it stays exact */
+			uint64_t scale = pow10_int[exp10 - EXACT_POW10_MAX];
+			if (mantissa <= (uint64_t)TWO_POW_53 / scale) {
+				v = (double)(mantissa * scale) * pow10_exact[EXACT_POW10_MAX];
+				return negative ? -v : v;
+			}
+		}
+	}
+	return crt_parse(start, p, NULL);
+}
+
+long epa_strtol(const char* s, char** end)
+{
+	const char* p = s;
+	unsigned long acc = 0;
+	unsigned long limit;
+	int negative = 0;
+	int any = 0;
+	int overflow = 0;
+
+	while (is_blank(*p)) ++p;
+	if (*p == '+' || *p == '-') negative = *p++ == '-';
+	limit = negative ? (unsigned long)LONG_MAX + 1UL : (unsigned long)LONG_MAX;
+
+	for (; is_digit(*p); ++p) {
+		unsigned long d = (unsigned long)(*p - '0');
+		any = 1;
+		if (overflow || acc > (limit - d) / 10) overflow = 1;
+		else acc = acc * 10 + d;
+	}
+	if (!any) {
+		if (end) *end = (char*)s;
+		return 0;
+	}
+	if (end) *end = (char*)p;
+	if (overflow) {
+		errno = ERANGE;
+		return negative ? LONG_MIN : LONG_MAX;
+	}
+	if (!negative) return (long)acc;
+	return acc ? -(long)(acc - 1) - 1 : 0;
+}
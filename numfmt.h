@@ -0,0 +1,30 @@
+#ifndef NUMFMT_H
+#define NUMFMT_H
+
+#include <stddef.h>
+
+// Number <-> text conversion for the evaluator and the UI. Output always uses
+// '.' as the decimal point and input is read the same way, whatever the C
+// locale of the host process. Common values take exact integer fast paths;
+// the rest go through the CRT with the locale decimal point swapped out, so
+// every result is identical to the printf/strtod one in the "C" locale.
+
+// %.*g of v (precision 1..17). Returns the length written, 0 if buf is too small.
+size_t epa_format_double_g(double v, int precision, char* buf, size_t size);
+// Shortest of the %.15g, %.16g and %.17g texts that reads back as exactly v.
+size_t epa_format_double(double v, char* buf, size_t size);
+// %.*f of v (decimals 0..17).
+size_t epa_format_double_fixed(double v, int decimals, char* buf, size_t size);
+// %ld of v.
+size_t epa_format_long(long v, char* buf, size_t size);
+
+// strtod replacement reading '.' as the decimal point. Decimal text (leading
+// blanks, optional sign, digits with an optional '.' fraction and an optional
+// exponent) is parsed here; hex floats, INF and NAN go to the CRT as strtod
+// reads them. *end (if not NULL) receives the first unread character, or s when
+// nothing was read; out of range values set errno to ERANGE.
+double epa_strtod(const char* s, char** end);
+// strtol(s, end, 10) replacement with the same conventions.
+long epa_strtol(const char* s, char** end);
+
+#endif // !NUMFMT_H
@@ -2,6 +2,11 @@
 #include "syntaxanalysis.h"
 #include "semantic_analysis.h"
 #include "symboltable.h"
+#include "bytecode.h"
+#include "builtins.h"
+#include "depgraph.h"
+#include "numfmt.h"
+#include "tablestore.h"
 
 // Forward declaration for recursive helper
 static int analyze_command(CommandNode* cmd, SymbolTable* st);
@@ -62,8 +67,8 @@ int is_integer(const char* str) {
 	char* endptr;
 	// Reset errno to detect overflow from this call
 	errno = 0;
-	// Call strtol; cast to void to suppress warning since we use errno and endptr
-	(void)strtol(str, &endptr, 10);
+	// Call epa_strtol; cast to void to suppress warning since we use errno and endptr
+	(void)epa_strtol(str, &endptr);
 
 	// Check if the entire string was consumed
 	if (*endptr != '\0') {
@@ -197,118 +202,318 @@ static Variable* create_default_variable(VariableType type) {
 	return var;
 }
 
-// evaluate_to_int (add binary op handling)
-int evaluate_to_int(ExpressionNode* expr, SymbolTable* st, long* result) {
-	if (!expr) return -1;
+/* Fill a new STRUCTURE's table with its members in declaration order. The table is
+   pinned, so a member keeps the entry position struct accesses were resolved to. */
+int init_structure_members(HashTable* fields, const DeclareVariableNode* node, SymbolTable* st) {
+	if (!fields || !node) return -1;
+	fields->pinned = 1;
+	for (size_t k = 0; k < node->data.structure.member_count; ++k) {
+		const StructMember* m = &node->data.structure.members[k];
+		if (!m->member_name) continue;
+		Variable* member = calloc(1, sizeof(Variable));
+		if (!member) return -1;
+		member->declaration_count = 1;
+		int status = 0;
+		switch (m->member_type) {
+		case VAR_PARAMETER:
+			member->type = map_variable_type(VAR_PARAMETER, m->member_subtype);
+			if (member->type == (VariableType)-1) member->type = TYPE_INTEGER;
+			set_default_value(member);
+			if (!m->default_expr) break;
+			if (member->type == TYPE_DOUBLE) {
+				status = evaluate_to_double(m->default_expr, st, &member->data.double_value);
+			}
+			else if (member->type == TYPE_STRING) {
+				char* sval = NULL;
+				status = evaluate_to_string(m->default_expr, st, &sval);
+				if (status == 0 && sval) {
+					free(member->data.string_value);
+					member->data.string_value = sval;
+				}
+			}
+			else {
+				long ival;
+				status = evaluate_to_int(m->default_expr, st, &ival);
+				if (status == 0) member->data.int_value = (int)ival;
+			}
+			break;
+		case VAR_ARRAY:
+			member->type = TYPE_ARRAY;
+			break;
+		case VAR_MAP:
+		case VAR_STRUCTURE:
+			member->type = (m->member_type == VAR_MAP ? TYPE_MAP : TYPE_STRUCTURE);
+			member->data.map = create_hash_table(16);
+			if (!member->data.map) status = -1;
+			break;
+		default:
+			member->type = TYPE_NULL;
+			break;
+		}
+		if (status != 0) {
+			ProPrintfChar("Error: Failed to initialize member '%s' of structure '%s'\n", m->member_name, node->name);
+			free_variable(member);
+			return -1;
+		}
+		hash_table_insert(fields, m->member_name, member);
+		if (hash_table_lookup(fields, m->member_name) != member) {
+			free_variable(member);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Variable behind an EXPR_VARIABLE_REF node. Nodes are bound to a symbol slot by
+   resolve_variable_refs (or lazily here on first use), so the hot path is an array
+   read instead of hashing the name. Unset names yield NULL exactly like get_symbol. */
+Variable* lookup_variable_ref(ExpressionNode* expr, SymbolTable* st) {
+	if (!expr || !expr->data.string_val) return NULL;
+	if (expr->slot == 0) {
+		expr->slot = reserve_symbol_slot(st, expr->data.string_val);
+		if (expr->slot == 0) return get_symbol(st, expr->data.string_val);
+	}
+	return get_symbol_at(st, expr->slot);
+}
+
+/* Value an accessor chain (symbol, member, key, element) reads in the symbol table
+   as it stands, for typing and field binding; NULL when it is not known. Elements
+   of an array are taken to share the first one's layout, as table rows do. */
+static Variable* static_value_of(ExpressionNode* expr, SymbolTable* st) {
+	Variable* base;
+	if (!expr) return NULL;
 	switch (expr->type) {
-	case EXPR_LITERAL_INT:
-	case EXPR_LITERAL_BOOL:
-		*result = expr->data.int_val;
+	case EXPR_VARIABLE_REF:
+		return lookup_variable_ref(expr, st);
+	case EXPR_STRUCT_ACCESS:
+		base = static_value_of(expr->data.struct_access.structure, st);
+		return (base && base->type == TYPE_STRUCTURE && base->data.structure && expr->data.struct_access.member)
+			? hash_table_lookup(base->data.structure, expr->data.struct_access.member) : NULL;
+	case EXPR_MAP_LOOKUP:
+		base = static_value_of(expr->data.map_lookup.map, st);
+		return (base && (base->type == TYPE_MAP || base->type == TYPE_STRUCTURE) && base->data.map && expr->data.map_lookup.key)
+			? table_wrapper_lookup(base->data.map, expr->data.map_lookup.key) : NULL;
+	case EXPR_ARRAY_INDEX:
+		base = static_value_of(expr->data.array_index.base, st);
+		return (base && base->type == TYPE_ARRAY && base->data.array.size > 0) ? base->data.array.elements[0] : NULL;
+	default:
+		return NULL;
+	}
+}
+
+/*=================================================*\
+* 
+* Evaluator sinks: every expression is walked once by evaluate_value and the
+* result is converted only here (integer, double or text). The node's static
+* type from get_expression_type picks concatenation over arithmetic for + and
+* the text of numbers: 7/2 is typed INTEGER and reads as "3", as in the integer
+* sink.
+* 
+\*=================================================*/
+typedef struct {
+	char* data;
+	size_t len;
+	size_t cap;
+} TextBuf;
+
+/* Room for extra more bytes plus '\0'; the first reservation is exact */
+static int text_reserve(TextBuf* tb, size_t extra) {
+	size_t need = tb->len + extra + 1;
+	if (need <= tb->cap) return 0;
+	size_t cap = tb->cap ? tb->cap * 2 : need;
+	if (cap < need) cap = need;
+	char* grown = (char*)realloc(tb->data, cap);
+	if (!grown) return -1;
+	tb->data = grown;
+	tb->cap = cap;
+	return 0;
+}
+
+static int text_append_n(TextBuf* tb, const char* s, size_t n) {
+	if (text_reserve(tb, n) != 0) return -1;
+	memcpy(tb->data + tb->len, s, n);
+	tb->len += n;
+	tb->data[tb->len] = '\0';
+	return 0;
+}
+
+static int is_typed_integer(const ExpressionNode* expr) {
+	return expr->has_static_type && expr->static_type == TYPE_INTEGER;
+}
+
+static int value_to_long(const EpaValue* v, long* result) {
+	switch (v->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		*result = v->data.int_value;
 		return 0;
-	case EXPR_LITERAL_DOUBLE:  // Coerce double to int (with warning if needed)
-		*result = (long)expr->data.double_val;
+	case TYPE_DOUBLE:
+		*result = (long)v->data.double_value;
+		return 0;
+	case TYPE_STRING: {
+		/* Empty strings read as 0, as in the operators */
+		const char* s = epa_string(v);
+		if (s && s[0]) return -1;
+		*result = 0;
 		return 0;
-	case EXPR_VARIABLE_REF: {
-		Variable* var = get_symbol(st, expr->data.string_val);
-		if (!var) return -1;
-		if (var->type == TYPE_INTEGER || var->type == TYPE_BOOL) {
-			*result = var->data.int_value;
-			return 0;
-		}
-		else if (var->type == TYPE_DOUBLE) {  // Coerce
-			*result = (long)var->data.double_value;
-			return 0;
-		}
-		return -1;
 	}
-	case EXPR_ARRAY_INDEX: {
-		// Existing code...
+	default:
+		return -1;
 	}
-	case EXPR_UNARY_OP: {
-		if (expr->data.unary.op == UNOP_NEG) {
-			long v;
-			if (evaluate_to_int(expr->data.unary.operand, st, &v) != 0) return -1;
-			*result = -v;
-			return 0;
-		}
-		return -1; /* unsupported unary op for int */
-	}
-	case EXPR_BINARY_OP: {  // New: Handle arithmetic ops recursively
-		long left_val, right_val;
-		int status = evaluate_to_int(expr->data.binary.left, st, &left_val);
-		if (status != 0) return -1;
-		status = evaluate_to_int(expr->data.binary.right, st, &right_val);
-		if (status != 0) return -1;
-		switch (expr->data.binary.op) {
-		case BINOP_ADD: *result = left_val + right_val; break;
-		case BINOP_SUB: *result = left_val - right_val; break;
-		case BINOP_MUL: *result = left_val * right_val; break;
-		case BINOP_DIV:
-			if (right_val == 0) return -1;  // Div by zero
-			*result = left_val / right_val; break;
-		default: return -1;  // Unsupported op for int
-		}
+}
+
+static int value_to_double(const EpaValue* v, double* result) {
+	long iv;
+	if (v->type == TYPE_DOUBLE) {
+		*result = v->data.double_value;
 		return 0;
 	}
-	default: return -1;
+	if (value_to_long(v, &iv) != 0) return -1;
+	*result = (double)iv;
+	return 0;
+}
+
+/* Text of a scalar value; buf holds formatted numbers. NULL if not a scalar. */
+static const char* value_to_text(const ExpressionNode* expr, const EpaValue* v, char* buf, size_t size) {
+	switch (v->type) {
+	case TYPE_STRING: {
+		const char* s = epa_string(v);
+		return s ? s : "";
+	}
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		epa_format_long(v->data.int_value, buf, size);
+		return buf;
+	case TYPE_DOUBLE:
+		if (is_typed_integer(expr))
+			epa_format_long((long)v->data.double_value, buf, size);
+		else
+			epa_format_double_g(v->data.double_value, 15, buf, size);
+		return buf;
+	default:
+		return NULL;
 	}
 }
 
-// Basic expression evaluator for double (with coercion from int)
-int evaluate_to_double(ExpressionNode* expr, SymbolTable* st, double* result) {
-	if (!expr) return -1;
-	switch (expr->type) {
-	case EXPR_LITERAL_DOUBLE:
-		*result = expr->data.double_val;
+/* Text of a variable reference. Names that are not set, references and tables
+   read as the identifier itself (unquoted file names, selection targets). A
+   TYPE_NULL symbol yields *text == NULL. */
+static int variable_ref_text(ExpressionNode* expr, SymbolTable* st, char* buf, size_t size, const char** text) {
+	Variable* var = lookup_variable_ref(expr, st);
+	*text = NULL;
+	if (!var) {
+		*text = expr->data.string_val;
+		return *text ? 0 : -1;
+	}
+	switch (var->type) {
+	case TYPE_STRING:
+	case TYPE_SUBTABLE:  /* subtable refs stringify to their target id */
+		*text = var->data.string_value ? var->data.string_value : "";
 		return 0;
-	case EXPR_LITERAL_INT:
-		*result = (double)expr->data.int_val;
+	case TYPE_INTEGER:
+		epa_format_long(var->data.int_value, buf, size);
+		*text = buf;
 		return 0;
-	case EXPR_VARIABLE_REF: {
-		Variable* var = get_symbol(st, expr->data.string_val);
-		if (!var) return -1;
-		if (var->type == TYPE_DOUBLE) {
-			*result = var->data.double_value;
-			return 0;
-		}
-		else if (var->type == TYPE_INTEGER) {
-			*result = (double)var->data.int_value;
-			return 0;
-		}
+	case TYPE_DOUBLE:
+		epa_format_double_g(var->data.double_value, 15, buf, size);
+		*text = buf;
+		return 0;
+	case TYPE_BOOL:
+		*text = var->data.int_value ? "1" : "0";
+		return 0;
+	case TYPE_NULL:
+		return 0;
+	case TYPE_REFERENCE:
+	case TYPE_ARRAY:
+		*text = expr->data.string_val;
+		return *text ? 0 : -1;
+	default:
 		return -1;
 	}
-	case EXPR_UNARY_OP: {
-		if (expr->data.unary.op == UNOP_NEG) {
-			double v;
-			if (evaluate_to_double(expr->data.unary.operand, st, &v) != 0) return -1;
-			*result = -v;
-			return 0;
-		}
-		return -1; /* unsupported unary op for double */
-	}
-		 // ... (add EXPR_ARRAY_INDEX if needed)
-	case EXPR_BINARY_OP: {  // New: Handle recursively
-		double left_val, right_val;
-		int status = evaluate_to_double(expr->data.binary.left, st, &left_val);
-		if (status != 0) return -1;
-		status = evaluate_to_double(expr->data.binary.right, st, &right_val);
-		if (status != 0) return -1;
-		switch (expr->data.binary.op) {
-		case BINOP_ADD: *result = left_val + right_val; break;
-		case BINOP_SUB: *result = left_val - right_val; break;
-		case BINOP_MUL: *result = left_val * right_val; break;
-		case BINOP_DIV:
-			if (right_val == 0.0) return -1;
-			*result = left_val / right_val; break;
-		default: return -1;
-		}
-		return 0;
+}
+
+/* + is concatenation when it is typed STRING; untyped trees (built at runtime)
+   keep treating every + as concatenation */
+static int is_concatenation(const ExpressionNode* expr) {
+	return expr->type == EXPR_BINARY_OP && expr->data.binary.op == BINOP_ADD &&
+		(!expr->has_static_type || expr->static_type == TYPE_STRING);
+}
+
+/* Text of one operand. value and buf back the returned text; *text is NULL for a
+   TYPE_NULL symbol. */
+static int operand_text(ExpressionNode* expr, SymbolTable* st, EpaValue* value, char* buf, size_t size, const char** text) {
+	if (expr->type == EXPR_VARIABLE_REF) return variable_ref_text(expr, st, buf, size, text);
+	if (evaluate_value(expr, st, value) != 0) return -1;
+	*text = value_to_text(expr, value, buf, size);
+	return *text ? 0 : -1;
+}
+
+#define CONCAT_BATCH 32
+
+typedef struct {
+	EpaValue value;
+	char buf[32];
+	const char* text;
+	size_t len;
+} ConcatPart;
+
+/* EXPR_CONCAT: texts of up to CONCAT_BATCH parts are collected first, so the
+   output grows once per batch by the exact length */
+static int append_concat(ExpressionNode* expr, SymbolTable* st, TextBuf* out) {
+	ConcatPart parts[CONCAT_BATCH];
+	size_t count = expr->data.concat.part_count;
+
+	for (size_t first = 0; first < count; first += CONCAT_BATCH) {
+		size_t n = count - first < CONCAT_BATCH ? count - first : CONCAT_BATCH;
+		size_t total = 0;
+		for (size_t k = 0; k < n; ++k) {
+			ConcatPart* part = &parts[k];
+			if (operand_text(expr->data.concat.parts[first + k], st, &part->value,
+				part->buf, sizeof(part->buf), &part->text) != 0) return -1;
+			if (!part->text) part->text = "";
+			part->len = strlen(part->text);
+			total += part->len;
+		}
+		if (text_reserve(out, total) != 0) return -1;
+		for (size_t k = 0; k < n; ++k) {
+			memcpy(out->data + out->len, parts[k].text, parts[k].len);
+			out->len += parts[k].len;
+		}
+		out->data[out->len] = '\0';
 	}
-	default: return -1;
+	return 0;
+}
+
+static int append_expression_text(ExpressionNode* expr, SymbolTable* st, TextBuf* out) {
+	char buf[64];
+	const char* text;
+	EpaValue value;
+
+	if (expr->type == EXPR_CONCAT) return append_concat(expr, st, out);
+	if (is_concatenation(expr)) {
+		if (append_expression_text(expr->data.binary.left, st, out) != 0) return -1;
+		return append_expression_text(expr->data.binary.right, st, out);
 	}
+	if (operand_text(expr, st, &value, buf, sizeof(buf), &text) != 0) return -1;
+	if (!text) text = "";
+	return text_append_n(out, text, strlen(text));
+}
+
+int evaluate_to_int(ExpressionNode* expr, SymbolTable* st, long* result) {
+	EpaValue value;
+	if (!expr || !result) return -1;
+	if (evaluate_value(expr, st, &value) != 0) return -1;
+	return value_to_long(&value, result);
+}
+
+int evaluate_to_double(ExpressionNode* expr, SymbolTable* st, double* result) {
+	EpaValue value;
+	if (!expr || !result) return -1;
+	if (evaluate_value(expr, st, &value) != 0) return -1;
+	return value_to_double(&value, result);
 }
 
-// Basic expression evaluators (for string)
+// Text sink: a new heap string (caller frees); NULL with status 0 for an empty expression or TYPE_NULL symbol
 int evaluate_to_string(ExpressionNode* expr, SymbolTable* st, char** result) {
 	if (!result) return -1;
 	*result = NULL;
@@ -318,107 +523,22 @@ int evaluate_to_string(ExpressionNode* expr, SymbolTable* st, char** result) {
 		return 0;
 	}
 
-	switch (expr->type) {
-	case EXPR_LITERAL_STRING:
-		*result = _strdup(expr->data.string_val);
+	if (expr->type == EXPR_VARIABLE_REF) {
+		char buf[64];
+		const char* text;
+		if (variable_ref_text(expr, st, buf, sizeof(buf), &text) != 0) return -1;
+		if (!text) return 0;
+		*result = _strdup(text);
 		return *result ? 0 : -1;
-
-	case EXPR_VARIABLE_REF: {
-		Variable* var = get_symbol(st, expr->data.string_val);
-		if (var && var->type == TYPE_STRING) {
-			*result = _strdup(var->data.string_value);
-			return *result ? 0 : -1;
-		}
-		else if (var && var->type == TYPE_SUBTABLE) {
-			/* Allow stringification of subtable refs to their target id */
-			*result = _strdup(var->data.string_value);
-			return *result ? 0 : -1;
-		}
-		else if (var) {
-			/* allow numeric/bool to be stringified */
-			char buf[64];
-			switch (var->type) {
-			case TYPE_INTEGER:
-				snprintf(buf, sizeof(buf), "%ld", (long)var->data.int_value);
-				*result = _strdup(buf);
-				return *result ? 0 : -1;
-			case TYPE_DOUBLE:
-				snprintf(buf, sizeof(buf), "%.15g", var->data.double_value);
-				*result = _strdup(buf);
-				return *result ? 0 : -1;
-			case TYPE_BOOL:
-				*result = _strdup(var->data.int_value ? "1" : "0");
-				return *result ? 0 : -1;
-			case TYPE_NULL:
-				*result = NULL;
-				return 0;
-			case TYPE_REFERENCE:
-				/* Treat reference variables as identifier-like when stringified */
-				*result = _strdup(expr->data.string_val);
-				return *result ? 0 : -1;
-			case TYPE_ARRAY:
-				/* Treat references to tables (TYPE_ARRAY) as literal identifiers */
-				*result = _strdup(expr->data.string_val);
-				return *result ? 0 : -1;
-			default:
-				return -1;
-			}
-		}
-		else {
-			/* Undeclared identifier literal string (unquoted filenames, etc.) */
-			*result = _strdup(expr->data.string_val);
-			return *result ? 0 : -1;
-		}
 	}
 
-	case EXPR_BINARY_OP: {
-		if (expr->data.binary.op != BINOP_ADD) {
-			return -1; /* Only + is concatenation */
-		}
-		char* left_str = NULL;
-		if (evaluate_to_string(expr->data.binary.left, st, &left_str) != 0) return -1;
-
-		char* right_str = NULL;
-		if (evaluate_to_string(expr->data.binary.right, st, &right_str) != 0) {
-			free(left_str);
-			return -1;
-		}
-
-		size_t len = (left_str ? strlen(left_str) : 0)
-			+ (right_str ? strlen(right_str) : 0) + 1;
-		*result = (char*)malloc(len);
-		if (!*result) {
-			free(left_str);
-			free(right_str);
-			return -1;
-		}
-		snprintf(*result, len, "%s%s",
-			left_str ? left_str : "",
-			right_str ? right_str : "");
-		free(left_str);
-		free(right_str);
-		return 0;
-	}
-
-	default: {
-		long iv;
-		if (evaluate_to_int(expr, st, &iv) == 0) {
-			char buf[32];
-			snprintf(buf, sizeof(buf), "%ld", iv);
-			*result = _strdup(buf);
-			return *result ? 0 : -1;
-		}
-		double dv;
-		if (evaluate_to_double(expr, st, &dv) == 0) {
-			char buf[64];
-			snprintf(buf, sizeof(buf), "%.15g", dv);
-			*result = _strdup(buf);
-			return *result ? 0 : -1;
-		}
-		*result = NULL;
+	TextBuf out = { NULL, 0, 0 };
+	if (append_expression_text(expr, st, &out) != 0) {
+		free(out.data);
 		return -1;
 	}
-	}
+	*result = out.data ? out.data : _strdup("");
+	return *result ? 0 : -1;
 }
 
 void coerce_empty_string_to_zero(Variable* v) {
@@ -429,10 +549,13 @@ void coerce_empty_string_to_zero(Variable* v) {
 	}
 }
 
-// Infer the static type of an expression (returns VariableType or -1 on error)
-VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
-	if (!expr) return -1;
+/* Type errors are only printed for get_expression_type; the annotation pass
+   types every expression quietly */
+#define TYPE_ERROR(...) do { if (report) ProPrintfChar(__VA_ARGS__); } while (0)
 
+static VariableType infer_expression_type(ExpressionNode* expr, SymbolTable* st, int report);
+
+static VariableType infer_node_type(ExpressionNode* expr, SymbolTable* st, int report) {
 	switch (expr->type) {
 	case EXPR_LITERAL_INT:
 	case EXPR_LITERAL_BOOL:
@@ -446,7 +569,7 @@ VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
 		return TYPE_DOUBLE;  // PI is double
 	}
 	case EXPR_VARIABLE_REF: {
-		Variable* var = get_symbol(st, expr->data.string_val);
+		Variable* var = lookup_variable_ref(expr, st);
 		if (var) {
 			return var->type;
 		}
@@ -454,21 +577,21 @@ VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
 			return TYPE_STRING;
 		}
 		else {
-			ProPrintfChar("Error: Undeclared variable '%s' in expression\n", expr->data.string_val);
+			TYPE_ERROR("Error: Undeclared variable '%s' in expression\n", expr->data.string_val);
 			return -1;
 		}
 	}
 	case EXPR_UNARY_OP: {
-		VariableType operand_type = get_expression_type(expr->data.unary.operand, st);
+		VariableType operand_type = infer_expression_type(expr->data.unary.operand, st, report);
 		if (expr->data.unary.op == UNOP_NEG && (operand_type == TYPE_INTEGER || operand_type == TYPE_DOUBLE)) {
 			return operand_type;
 		}
-		ProPrintfChar("Error: Invalid operand type for unary operator\n");
+		TYPE_ERROR("Error: Invalid operand type for unary operator\n");
 		return -1;
 	}
 	case EXPR_BINARY_OP: {
-		VariableType left_type = get_expression_type(expr->data.binary.left, st);
-		VariableType right_type = get_expression_type(expr->data.binary.right, st);
+		VariableType left_type = infer_expression_type(expr->data.binary.left, st, report);
+		VariableType right_type = infer_expression_type(expr->data.binary.right, st, report);
 		if (left_type == -1 || right_type == -1) return -1;
 
 		/*  treat + as string concatenation if either side is a string */
@@ -481,7 +604,7 @@ VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
 		if (expr->data.binary.op >= BINOP_ADD && expr->data.binary.op <= BINOP_DIV) {
 			if ((left_type != TYPE_INTEGER && left_type != TYPE_DOUBLE) ||
 				(right_type != TYPE_INTEGER && right_type != TYPE_DOUBLE)) {
-				ProPrintfChar("Error: Arithmetic operands must be numeric\n");
+				TYPE_ERROR("Error: Arithmetic operands must be numeric\n");
 				return -1;
 			}
 			return (left_type == TYPE_DOUBLE || right_type == TYPE_DOUBLE) ? TYPE_DOUBLE : TYPE_INTEGER;
@@ -489,8 +612,13 @@ VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
 
 		// Comparisons: return bool; numerics or strings for ==/<>
 		if (expr->data.binary.op >= BINOP_EQ && expr->data.binary.op <= BINOP_GE) {
+			// int and double compare after promotion (e.g. sqrt(X) > 2)
+			if ((left_type == TYPE_INTEGER && right_type == TYPE_DOUBLE) ||
+				(left_type == TYPE_DOUBLE && right_type == TYPE_INTEGER)) {
+				return TYPE_BOOL;
+			}
 			if (left_type != right_type) {
-				ProPrintfChar("Error: Incompatible types for comparison\n");
+				TYPE_ERROR("Error: Incompatible types for comparison\n");
 				return -1;
 			}
 			if (expr->data.binary.op == BINOP_EQ || expr->data.binary.op == BINOP_NE) {
@@ -503,7 +631,7 @@ VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
 					return TYPE_BOOL;
 				}
 			}
-			ProPrintfChar("Error: Invalid types for comparison\n");
+			TYPE_ERROR("Error: Invalid types for comparison\n");
 			return -1;
 		}
 
@@ -513,488 +641,249 @@ VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
 				(right_type == TYPE_BOOL || right_type == TYPE_INTEGER || right_type == TYPE_DOUBLE)) {
 				return TYPE_BOOL;
 			}
-			ProPrintfChar("Error: Logical operands must be boolean or coercible\n");
+			TYPE_ERROR("Error: Logical operands must be boolean or coercible\n");
 			return -1;
 		}
 
-		ProPrintfChar("Error: Unknown binary operator\n");
+		TYPE_ERROR("Error: Unknown binary operator\n");
 		return -1;
 	}
 	case EXPR_FUNCTION_CALL: {
-		size_t expected_args = 0;
-		VariableType return_type = -1;
-		VariableType arg_types[3] = { -1, -1, -1 };  // Max 3 args
-
-		switch (expr->data.func_call.func) {
-			// Math functions (1 arg, double -> double)
-		case FUNC_SIN: case FUNC_ASIN: case FUNC_COS: case FUNC_ACOS:
-		case FUNC_TAN: case FUNC_ATAN: case FUNC_SINH: case FUNC_COSH:
-		case FUNC_TANH: case FUNC_LOG: case FUNC_LN: case FUNC_EXP:
-		case FUNC_CEIL: case FUNC_FLOOR: case FUNC_ABS: case FUNC_SQRT:
-		case FUNC_SQR:
-			expected_args = 1;
-			arg_types[0] = TYPE_DOUBLE;
-			return_type = TYPE_DOUBLE;
-			break;
-
-			// 2-arg math (double, double -> double)
-		case FUNC_POW: case FUNC_MOD:
-			expected_args = 2;
-			arg_types[0] = TYPE_DOUBLE;
-			arg_types[1] = TYPE_DOUBLE;
-			return_type = TYPE_DOUBLE;
-			break;
-
-			// round (double, int -> double)
-		case FUNC_ROUND:
-			expected_args = 2;
-			arg_types[0] = TYPE_DOUBLE;
-			arg_types[1] = TYPE_INTEGER;
-			return_type = TYPE_DOUBLE;
-			break;
-
-			// String functions
-		case FUNC_STRFIND: case FUNC_STRFINDCS: case FUNC_STRCMP: case FUNC_STRCMPCS:
-			expected_args = 2;
-			arg_types[0] = TYPE_STRING;
-			arg_types[1] = TYPE_STRING;
-			return_type = TYPE_INTEGER;
-			break;
-		case FUNC_STRLEN: case FUNC_ASC:
-			expected_args = 1;
-			arg_types[0] = TYPE_STRING;
-			return_type = TYPE_INTEGER;
-			break;
-		case FUNC_STOF:
-			expected_args = 1;
-			arg_types[0] = TYPE_STRING;
-			return_type = TYPE_DOUBLE;
-			break;
-		case FUNC_STOI:
-			expected_args = 1;
-			arg_types[0] = TYPE_STRING;
-			return_type = TYPE_INTEGER;
-			break;
-		case FUNC_STOB:
-			expected_args = 1;
-			arg_types[0] = TYPE_STRING;
-			return_type = TYPE_BOOL;
-			break;
-		case FUNC_ISNUMBER: case FUNC_ISINTEGER: case FUNC_ISDOUBLE:
-			expected_args = 1;
-			arg_types[0] = TYPE_STRING;
-			return_type = TYPE_BOOL;
-			break;
-
-			// Comparison functions (double, double, int -> bool)
-		case FUNC_EQUAL: case FUNC_LESS: case FUNC_LESSOREQUAL:
-		case FUNC_GREATER: case FUNC_GREATEROREQUAL:
-			expected_args = 3;
-			arg_types[0] = TYPE_DOUBLE;
-			arg_types[1] = TYPE_DOUBLE;
-			arg_types[2] = TYPE_INTEGER;
-			return_type = TYPE_BOOL;
-			break;
-
-		default:
-			ProPrintfChar("Error: Unknown function return type\n");
+		FunctionType func = expr->data.func_call.func;
+		if ((unsigned)func >= FUNC_COUNT) {
+			TYPE_ERROR("Error: Unknown function return type\n");
 			return -1;
 		}
+		const BuiltinInfo* bi = &g_builtins[func];
 
-		if (expr->data.func_call.arg_count != expected_args) {
-			ProPrintfChar("Error: Function expects %zu args, got %zu\n", expected_args, expr->data.func_call.arg_count);
+		if (expr->data.func_call.arg_count != bi->arity) {
+			TYPE_ERROR("Error: Function '%s' expects %d args, got %zu\n", bi->name, bi->arity, expr->data.func_call.arg_count);
 			return -1;
 		}
 
-		for (size_t a = 0; a < expected_args; a++) {
-			VariableType arg_type = get_expression_type(expr->data.func_call.args[a], st);
+		for (size_t a = 0; a < bi->arity; a++) {
+			VariableType arg_type = infer_expression_type(expr->data.func_call.args[a], st, report);
 			if (arg_type == -1) return -1;
-			if (arg_type != arg_types[a]) {
+			if (arg_type != (VariableType)bi->arg_types[a]) {
 				// Allow int -> double coercion
-				if (arg_types[a] == TYPE_DOUBLE && arg_type == TYPE_INTEGER) {
+				if (bi->arg_types[a] == TYPE_DOUBLE && arg_type == TYPE_INTEGER) {
 					continue;
 				}
-				ProPrintfChar("Error: Arg %zu type mismatch: expected %d, got %d\n", a, arg_types[a], arg_type);
+				TYPE_ERROR("Error: Arg %zu of '%s' type mismatch: expected %d, got %d\n", a, bi->name, bi->arg_types[a], arg_type);
 				return -1;
 			}
 		}
 
-		return return_type;
+		return (VariableType)bi->return_type;
 	}
 	case EXPR_ARRAY_INDEX: {
-		VariableType base_type = get_expression_type(expr->data.array_index.base, st);
+		VariableType base_type = infer_expression_type(expr->data.array_index.base, st, report);
 		if (base_type != TYPE_ARRAY) {
-			ProPrintfChar("Error: Array index on non-array type\n");
+			TYPE_ERROR("Error: Array index on non-array type\n");
 			return -1;
 		}
-		VariableType index_type = get_expression_type(expr->data.array_index.index, st);
+		VariableType index_type = infer_expression_type(expr->data.array_index.index, st, report);
 		if (index_type != TYPE_INTEGER) {
-			ProPrintfChar("Error: Array index must be integer\n");
+			TYPE_ERROR("Error: Array index must be integer\n");
 			return -1;
 		}
-		// Infer element type from symbol table (assume base is variable ref)
-		if (expr->data.array_index.base->type == EXPR_VARIABLE_REF) {
-			Variable* arr_var = get_symbol(st, expr->data.array_index.base->data.string_val);
-			if (arr_var && arr_var->type == TYPE_ARRAY && arr_var->data.array.size > 0) {
-				return arr_var->data.array.elements[0]->type;  // Assume homogeneous array
-			}
+		// Infer element type from symbol table (assume homogeneous array)
+		Variable* element = static_value_of(expr, st);
+		if (element) {
+			return element->type;
 		}
-		ProPrintfChar("Error: Unable to infer array element type\n");
+		TYPE_ERROR("Error: Unable to infer array element type\n");
 		return -1;
 	}
 	case EXPR_MAP_LOOKUP: {
-		VariableType map_type = get_expression_type(expr->data.map_lookup.map, st);
-		if (map_type != TYPE_MAP) {
-			ProPrintfChar("Error: Map lookup on non-map type\n");
+		VariableType map_type = infer_expression_type(expr->data.map_lookup.map, st, report);
+		if (map_type != TYPE_MAP && map_type != TYPE_STRUCTURE) {
+			TYPE_ERROR("Error: Map lookup on non-map type\n");
 			return -1;
 		}
-		// Values in map can vary; return general or require specific check (for simplicity, assume TYPE_GENERAL)
-		return -1;  // Adjust if map values are typed uniformly
+		// Values in a map can vary: type the lookup by the key's current value when the
+		// map is known (a symbol, or a row of a table symbol), else leave it untyped
+		Variable* value = static_value_of(expr, st);
+		return value ? value->type : (VariableType)-1;
 	}
 	case EXPR_STRUCT_ACCESS: {
-		VariableType struct_type = get_expression_type(expr->data.struct_access.structure, st);
+		VariableType struct_type = infer_expression_type(expr->data.struct_access.structure, st, report);
 		if (struct_type != TYPE_STRUCTURE) {
-			ProPrintfChar("Error: Struct access on non-struct type\n");
+			TYPE_ERROR("Error: Struct access on non-struct type\n");
 			return -1;
 		}
 		// Lookup member type from symbol table
-		if (expr->data.struct_access.structure->type == EXPR_VARIABLE_REF) {
-			Variable* struct_var = get_symbol(st, expr->data.struct_access.structure->data.string_val);
-			if (struct_var && struct_var->type == TYPE_STRUCTURE) {
-				Variable* member_var = hash_table_lookup(struct_var->data.structure, expr->data.struct_access.member);
-				if (member_var) {
-					return member_var->type;
-				}
-			}
+		Variable* member_var = static_value_of(expr, st);
+		if (member_var) {
+			return member_var->type;
 		}
-		ProPrintfChar("Error: Unable to infer struct member type\n");
+		TYPE_ERROR("Error: Unable to infer struct member type\n");
 		return -1;
 	}
+	case EXPR_CONCAT: {
+		for (size_t k = 0; k < expr->data.concat.part_count; ++k) {
+			if (infer_expression_type(expr->data.concat.parts[k], st, report) == -1) return -1;
+		}
+		return TYPE_STRING;
+	}
 	default:
-		ProPrintfChar("Error: Unknown expression type\n");
+		TYPE_ERROR("Error: Unknown expression type\n");
 		return -1;
 	}
 }
 
-// General evaluator: Returns a new Variable* from expression (updated for binary ops)
-int evaluate_expression(ExpressionNode* expr, SymbolTable* st, Variable** result) {
-	if (!expr) {
-		*result = NULL;
-		return -1;
-	}
-	*result = (Variable*)malloc(sizeof(Variable));
-	if (!*result) return -1;
+#undef TYPE_ERROR
+
+/* Infer and record the static type of expr and of every subexpression */
+static VariableType infer_expression_type(ExpressionNode* expr, SymbolTable* st, int report) {
+	if (!expr) return -1;
+	VariableType type = infer_node_type(expr, st, report);
+	expr->has_static_type = (type != (VariableType)-1);
+	expr->static_type = expr->has_static_type ? (uint8_t)type : 0;
+	return type;
+}
+
+// Infer the static type of an expression (returns VariableType or -1 on error)
+VariableType get_expression_type(ExpressionNode* expr, SymbolTable* st) {
+	return infer_expression_type(expr, st, 1);
+}
+
+// Tree-walking evaluator over EpaValue: the reference semantics of the bytecode VM
+// and the path for trees that were not compiled. Never allocates.
+static int evaluate_value_tree(ExpressionNode* expr, SymbolTable* st, EpaValue* out) {
+	if (!expr) return -1;
 
 	switch (expr->type) {
 	case EXPR_LITERAL_INT:
 	case EXPR_LITERAL_BOOL:
-		(*result)->type = (expr->type == EXPR_LITERAL_BOOL ? TYPE_BOOL : TYPE_INTEGER);
-		(*result)->data.int_value = (int)expr->data.int_val;
+		out->type = (expr->type == EXPR_LITERAL_BOOL ? TYPE_BOOL : TYPE_INTEGER);
+		out->data.int_value = (int)expr->data.int_val;
 		return 0;
 
 	case EXPR_LITERAL_DOUBLE:
-		(*result)->type = TYPE_DOUBLE;
-		(*result)->data.double_value = expr->data.double_val;
+		out->type = TYPE_DOUBLE;
+		out->data.double_value = expr->data.double_val;
 		return 0;
 
 	case EXPR_LITERAL_STRING:
-		(*result)->type = TYPE_STRING;
-		(*result)->data.string_value = _strdup(expr->data.string_val);
-		if (!(*result)->data.string_value) { free(*result); return -1; }
+		if (!expr->data.string_val) return -1;
+		out->type = TYPE_STRING;
+		out->storage = EPA_STR_BORROWED;
+		out->data.string_value = expr->data.string_val;
 		return 0;
 
-	case EXPR_VARIABLE_REF: {
-		Variable* src = get_symbol(st, expr->data.string_val);
-		if (!src || src->type == TYPE_UNKNOWN) {
-			(*result)->type = TYPE_STRING;
-			(*result)->data.string_value = _strdup("");
-			return 0;
-		}
-		/* shallow copy + fixup for strings */
-		memcpy(*result, src, sizeof(Variable));
-		if (src->type == TYPE_STRING && src->data.string_value) {
-			(*result)->data.string_value = _strdup(src->data.string_value);
-		}
+	case EXPR_VARIABLE_REF:
+		epa_load(out, lookup_variable_ref(expr, st));
 		return 0;
-	}
 
 	case EXPR_BINARY_OP: {
-		/* logical AND / OR short-circuit */
-		if (expr->data.binary.op == BINOP_AND || expr->data.binary.op == BINOP_OR) {
-			Variable* l = NULL;
-			if (evaluate_expression(expr->data.binary.left, st, &l) != 0 || !l) {
-				free(*result);
-				return -1;
-			}
-			coerce_empty_string_to_zero(l);  // Coerce undefined/empty to 0
-			/* coerce left to truthiness */
-			int l_true = 0;
-			if (l->type == TYPE_BOOL || l->type == TYPE_INTEGER) {
-				l_true = (l->data.int_value != 0);
-			}
-			else if (l->type == TYPE_DOUBLE) {
-				l_true = (l->data.double_value != 0.0);
-			}
-			else if (l->type == TYPE_STRING) {
-				l_true = (l->data.string_value && strlen(l->data.string_value) > 0);
-			}
-			else {
-				free_variable(l);
-				free(*result);
-				return -1;
-			}
-			if (expr->data.binary.op == BINOP_AND && !l_true) {
-				(*result)->type = TYPE_BOOL;
-				(*result)->data.int_value = 0;
-				free_variable(l);
-				return 0;
-			}
-			if (expr->data.binary.op == BINOP_OR && l_true) {
-				(*result)->type = TYPE_BOOL;
-				(*result)->data.int_value = 1;
-				free_variable(l);
-				return 0;
-			}
-			free_variable(l);
-			Variable* r = NULL;
-			if (evaluate_expression(expr->data.binary.right, st, &r) != 0 || !r) {
-				free(*result);
-				return -1;
-			}
-			coerce_empty_string_to_zero(r);  // Coerce undefined/empty to 0
-			{
-				int r_true = 0;
-				if (r->type == TYPE_BOOL || r->type == TYPE_INTEGER) {
-					r_true = (r->data.int_value != 0);
-				}
-				else if (r->type == TYPE_DOUBLE) {
-					r_true = (r->data.double_value != 0.0);
-				}
-				else if (r->type == TYPE_STRING) {
-					r_true = (r->data.string_value && strlen(r->data.string_value) > 0);
-				}
-				else {
-					free_variable(r);
-					free(*result);
-					return -1;
-				}
-				(*result)->type = TYPE_BOOL;
-				(*result)->data.int_value = r_true;
-			}
-			free_variable(r);
-			return 0;
+		BinaryOpType op = expr->data.binary.op;
+		/* logical AND / OR short-circuit on the truthiness of the left side */
+		if (op == BINOP_AND || op == BINOP_OR) {
+			if (evaluate_value_tree(expr->data.binary.left, st, out) != 0) return -1;
+			if (epa_truth(out) != 0) return -1;
+			if ((op == BINOP_AND) != (out->data.int_value != 0)) return 0;
+			if (evaluate_value_tree(expr->data.binary.right, st, out) != 0) return -1;
+			return epa_truth(out);
 		}
 
 		/* evaluate both sides once */
-		Variable* left_val = NULL;
-		Variable* right_val = NULL;
-		if (evaluate_expression(expr->data.binary.left, st, &left_val) != 0 || !left_val) {
-			free(*result);
-			return -1;
-		}
-		if (evaluate_expression(expr->data.binary.right, st, &right_val) != 0 || !right_val) {
-			free_variable(left_val);
-			free(*result);
-			return -1;
-		}
-
-		coerce_empty_string_to_zero(left_val);  // Coerce undefined/empty to 0
-		coerce_empty_string_to_zero(right_val); // Coerce undefined/empty to 0
+		EpaValue right;
+		if (evaluate_value_tree(expr->data.binary.left, st, out) != 0) return -1;
+		if (evaluate_value_tree(expr->data.binary.right, st, &right) != 0) return -1;
+		return epa_binary(op, out, &right);
+	}
 
-		/* operator categories */
-		const int is_arith =
-			(expr->data.binary.op >= BINOP_ADD && expr->data.binary.op <= BINOP_DIV);
-		const int is_ordered =
-			(expr->data.binary.op == BINOP_LT || expr->data.binary.op == BINOP_LE ||
-				expr->data.binary.op == BINOP_GT || expr->data.binary.op == BINOP_GE);
+	case EXPR_UNARY_OP:
+		if (expr->data.unary.op != UNOP_NEG) return -1;
+		if (evaluate_value_tree(expr->data.unary.operand, st, out) != 0) return -1;
+		return epa_negate(out);
 
-		/* numeric coercion ONLY for arithmetic and ordered compares */
-		if ((is_arith || is_ordered) && left_val->type != right_val->type) {
-			if (left_val->type == TYPE_INTEGER && right_val->type == TYPE_DOUBLE) {
-				left_val->data.double_value = (double)left_val->data.int_value;
-				left_val->type = TYPE_DOUBLE;
-			}
-			else if (left_val->type == TYPE_DOUBLE && right_val->type == TYPE_INTEGER) {
-				right_val->data.double_value = (double)right_val->data.int_value;
-				right_val->type = TYPE_DOUBLE;
-			}
-			else {
-				free_variable(left_val);
-				free_variable(right_val);
-				free(*result);
-				return -1;
-			}
+	case EXPR_FUNCTION_CALL: {
+		/* Arity and argument types were checked by get_expression_type */
+		FunctionType func = expr->data.func_call.func;
+		size_t argc = expr->data.func_call.arg_count;
+		if ((unsigned)func >= FUNC_COUNT || argc != g_builtins[func].arity) return -1;
+		EpaValue args[BUILTIN_MAX_ARGS];
+		for (size_t k = 0; k < argc; ++k) {
+			if (evaluate_value_tree(expr->data.func_call.args[k], st, &args[k]) != 0) return -1;
 		}
+		return builtin_call(func, args, out);
+	}
 
-		/* arithmetic */
-		if (is_arith) {
-			if ((left_val->type != TYPE_INTEGER && left_val->type != TYPE_DOUBLE) ||
-				(right_val->type != TYPE_INTEGER && right_val->type != TYPE_DOUBLE)) {
-				free_variable(left_val); free_variable(right_val); free(*result); return -1;
-			}
-			double l = (left_val->type == TYPE_DOUBLE ? left_val->data.double_value : (double)left_val->data.int_value);
-			double r = (right_val->type == TYPE_DOUBLE ? right_val->data.double_value : (double)right_val->data.int_value);
-			double dres = 0.0;
-			switch (expr->data.binary.op) {
-			case BINOP_ADD: dres = l + r; break;
-			case BINOP_SUB: dres = l - r; break;
-			case BINOP_MUL: dres = l * r; break;
-			case BINOP_DIV:
-				if (r == 0.0) { free_variable(left_val); free_variable(right_val); free(*result); return -1; }
-				dres = l / r; break;
-			default: free_variable(left_val); free_variable(right_val); free(*result); return -1;
-			}
-			if (left_val->type == TYPE_DOUBLE || right_val->type == TYPE_DOUBLE || expr->data.binary.op == BINOP_DIV) {
-				(*result)->type = TYPE_DOUBLE;
-				(*result)->data.double_value = dres;
-			}
-			else {
-				(*result)->type = TYPE_INTEGER;
-				(*result)->data.int_value = (int)dres;
-			}
-			free_variable(left_val);
-			free_variable(right_val);
-			return 0;
-		}
+	case EXPR_ARRAY_INDEX: {
+		EpaValue index;
+		if (evaluate_value_tree(expr->data.array_index.base, st, out) != 0) return -1;
+		if (evaluate_value_tree(expr->data.array_index.index, st, &index) != 0) return -1;
+		return epa_index(out, &index);
+	}
 
-		/* comparisons -> boolean */
-		(*result)->type = TYPE_BOOL;
-		{
-			const double eps = 1e-9;
-
-			switch (expr->data.binary.op) {
-			case BINOP_EQ:
-			case BINOP_NE: {
-				int equal = 0;
-
-				/* if either side is a string, compare as text */
-				if (left_val->type == TYPE_STRING || right_val->type == TYPE_STRING) {
-					const char* ls = NULL;
-					const char* rs = NULL;
-					char lbuf[64]; lbuf[0] = '\0';
-					char rbuf[64]; rbuf[0] = '\0';
-
-					/* left -> text */
-					if (left_val->type == TYPE_STRING) {
-						ls = left_val->data.string_value ? left_val->data.string_value : "";
-					}
-					else if (left_val->type == TYPE_INTEGER || left_val->type == TYPE_BOOL) {
-						_snprintf_s(lbuf, sizeof(lbuf), _TRUNCATE, "%d", left_val->data.int_value);
-						lbuf[sizeof(lbuf) - 1] = '\0';
-						ls = lbuf;
-					}
-					else if (left_val->type == TYPE_DOUBLE) {
-						_snprintf_s(lbuf, sizeof(lbuf), _TRUNCATE, "%.15g", left_val->data.double_value);
-						lbuf[sizeof(lbuf) - 1] = '\0';
-						ls = lbuf;
-					}
-					else {
-						free_variable(left_val); free_variable(right_val); free(*result); return -1;
-					}
+	case EXPR_MAP_LOOKUP:
+		if (evaluate_value_tree(expr->data.map_lookup.map, st, out) != 0) return -1;
+		return epa_lookup(out, expr->data.map_lookup.key);
 
-					/* right -> text */
-					if (right_val->type == TYPE_STRING) {
-						rs = right_val->data.string_value ? right_val->data.string_value : "";
-					}
-					else if (right_val->type == TYPE_INTEGER || right_val->type == TYPE_BOOL) {
-						_snprintf_s(rbuf, sizeof(rbuf), _TRUNCATE, "%d", right_val->data.int_value);
-						rbuf[sizeof(rbuf) - 1] = '\0';
-						rs = rbuf;
-					}
-					else if (right_val->type == TYPE_DOUBLE) {
-						_snprintf_s(rbuf, sizeof(rbuf), _TRUNCATE, "%.15g", right_val->data.double_value);
-						rbuf[sizeof(rbuf) - 1] = '\0';
-						rs = rbuf;
-					}
-					else {
-						free_variable(left_val); free_variable(right_val); free(*result); return -1;
-					}
+	case EXPR_STRUCT_ACCESS:
+		if (evaluate_value_tree(expr->data.struct_access.structure, st, out) != 0) return -1;
+		return epa_field(out, expr);
 
-					equal = (strcmp(ls, rs) == 0);
-				}
-				else {
-					/* numeric equality (int/bool/double) */
-					if ((left_val->type == TYPE_DOUBLE) || (right_val->type == TYPE_DOUBLE)) {
-						double l = (left_val->type == TYPE_DOUBLE ? left_val->data.double_value : (double)left_val->data.int_value);
-						double r = (right_val->type == TYPE_DOUBLE ? right_val->data.double_value : (double)right_val->data.int_value);
-						equal = (fabs(l - r) <= eps);
-					}
-					else if ((left_val->type == TYPE_INTEGER || left_val->type == TYPE_BOOL) &&
-						(right_val->type == TYPE_INTEGER || right_val->type == TYPE_BOOL)) {
-						equal = (left_val->data.int_value == right_val->data.int_value);
-					}
-					else {
-						free_variable(left_val); free_variable(right_val); free(*result); return -1;
-					}
-				}
+	default:
+		return -1;
+	}
+}
 
-				(*result)->data.int_value = (expr->data.binary.op == BINOP_EQ) ? equal : !equal;
+#ifdef EXPR_VM_VERIFY
+/* Differential check: the VM result must match the tree evaluator exactly.
+   tests/vm_difftest.c runs the same comparison over random expressions. */
+static void verify_vm_result(ExpressionNode* expr, SymbolTable* st, int vm_status, const EpaValue* vm) {
+	EpaValue ref;
+	int ref_status = evaluate_value_tree(expr, st, &ref);
+	int same = (vm_status == ref_status);
+	if (same && vm_status == 0) {
+		same = (vm->type == ref.type);
+		if (same) {
+			switch (vm->type) {
+			case TYPE_INTEGER: case TYPE_BOOL: same = (vm->data.int_value == ref.data.int_value); break;
+			case TYPE_DOUBLE: same = (memcmp(&vm->data.double_value, &ref.data.double_value, sizeof(double)) == 0); break;
+			case TYPE_STRING: {
+				const char* a = epa_string(vm);
+				const char* b = epa_string(&ref);
+				same = (!a == !b) && (!a || strcmp(a, b) == 0);
 				break;
 			}
-
-			case BINOP_LT:
-				if (left_val->type == TYPE_DOUBLE && right_val->type == TYPE_DOUBLE) {
-					(*result)->data.int_value = (left_val->data.double_value < right_val->data.double_value - eps);
-				}
-				else if (left_val->type == TYPE_INTEGER && right_val->type == TYPE_INTEGER) {
-					(*result)->data.int_value = (left_val->data.int_value < right_val->data.int_value);
-				}
-				else {
-					free_variable(left_val); free_variable(right_val); free(*result); return -1;
-				}
-				break;
-
-			case BINOP_GT:
-				if (left_val->type == TYPE_DOUBLE && right_val->type == TYPE_DOUBLE) {
-					(*result)->data.int_value = (left_val->data.double_value > right_val->data.double_value + eps);
-				}
-				else if (left_val->type == TYPE_INTEGER && right_val->type == TYPE_INTEGER) {
-					(*result)->data.int_value = (left_val->data.int_value > right_val->data.int_value);
-				}
-				else {
-					free_variable(left_val); free_variable(right_val); free(*result); return -1;
-				}
-				break;
-
-			case BINOP_LE:
-				if (left_val->type == TYPE_DOUBLE && right_val->type == TYPE_DOUBLE) {
-					(*result)->data.int_value = (left_val->data.double_value <= right_val->data.double_value + eps);
-				}
-				else if (left_val->type == TYPE_INTEGER && right_val->type == TYPE_INTEGER) {
-					(*result)->data.int_value = (left_val->data.int_value <= right_val->data.int_value);
-				}
-				else {
-					free_variable(left_val); free_variable(right_val); free(*result); return -1;
-				}
-				break;
-
-			case BINOP_GE:
-				if (left_val->type == TYPE_DOUBLE && right_val->type == TYPE_DOUBLE) {
-					(*result)->data.int_value = (left_val->data.double_value >= right_val->data.double_value - eps);
-				}
-				else if (left_val->type == TYPE_INTEGER && right_val->type == TYPE_INTEGER) {
-					(*result)->data.int_value = (left_val->data.int_value >= right_val->data.int_value);
-				}
-				else {
-					free_variable(left_val); free_variable(right_val); free(*result); return -1;
-				}
-				break;
-
-			default:
-				free_variable(left_val); free_variable(right_val); free(*result); return -1;
+			default: same = (vm->data.var == ref.data.var); break;
 			}
 		}
-
-		free_variable(left_val);
-		free_variable(right_val);
-		return 0;
 	}
-
-	default:
-		free(*result);
-		return -1;
+	if (!same) {
+		char* text = expression_to_string(expr);
+		LOG_WARN("Warning: bytecode/tree mismatch for '%s' (status %d vs %d)", text ? text : "?", vm_status, ref_status);
+		free(text);
 	}
 }
+#endif
+
+// Allocation-free evaluation: root expressions compiled by perform_semantic_analysis
+// run on the bytecode VM, anything else on the tree evaluator. Strings in *out are
+// borrowed from the AST or the symbol table and stay valid until either changes.
+int evaluate_value(ExpressionNode* expr, SymbolTable* st, EpaValue* out) {
+	if (!expr || !out) return -1;
+	if (expr->program) {
+		int status = expr_execute(expr->program, st, out);
+#ifdef EXPR_VM_VERIFY
+		verify_vm_result(expr, st, status, out);
+#endif
+		return status;
+	}
+	return evaluate_value_tree(expr, st, out);
+}
+
+// General evaluator: Returns a new Variable* from expression (wrapper over evaluate_value)
+int evaluate_expression(ExpressionNode* expr, SymbolTable* st, Variable** result) {
+	EpaValue value;
+	*result = NULL;
+	if (evaluate_value(expr, st, &value) != 0) return -1;
+	return epa_to_variable(&value, result);
+}
 
 /*=================================================*\
 * 
@@ -1572,6 +1461,11 @@ int check_declare_variable_semantics(DeclareVariableNode* node, SymbolTable* st)
 			free(var);
 			return 1;
 		}
+		if (init_structure_members(var->data.structure, node, st) != 0) {
+			free_hash_table(var->data.structure);
+			free(var);
+			return 1;
+		}
 		break;
 	default:
 		free(var);
@@ -2370,7 +2264,7 @@ int check_radiobutton_param_semantics(RadioButtonParamNode * node, SymbolTable *
 			return 1;
 		}
 		size_t new_size = req_radios->data.array.size + 1;
-		Variable** new_elements = realloc(req_radios->data.array.elements, new_size * sizeof(Variable*));
+		Variable** new_elements = variable_make_unique(req_radios) != 0 ? NULL : realloc(req_radios->data.array.elements, new_size * sizeof(Variable*));
 		if (!new_elements) {
 			free_variable(param_name_var);
 			free_hash_table(options_map);
@@ -2706,7 +2600,7 @@ int check_user_select_semantics(UserSelectNode* node, SymbolTable* st)
 		if (!ref_var->data.string_value) { free(ref_var); goto cleanup; }
 
 		size_t new_size = req_list->data.array.size + 1;
-		Variable** new_elems = realloc(req_list->data.array.elements, new_size * sizeof(Variable*));
+		Variable** new_elems = variable_make_unique(req_list) != 0 ? NULL : realloc(req_list->data.array.elements, new_size * sizeof(Variable*));
 		if (!new_elems) { free_variable(ref_var); goto cleanup; }
 		new_elems[new_size - 1] = ref_var;
 		req_list->data.array.elements = new_elems;
@@ -2938,7 +2832,7 @@ int check_user_select_optional_semantics(UserSelectOptionalNode* node, SymbolTab
 		if (!ref_var->data.string_value) { free(ref_var); goto cleanup; }
 
 		size_t new_size = req_list->data.array.size + 1;
-		Variable** new_elems = realloc(req_list->data.array.elements, new_size * sizeof(Variable*));
+		Variable** new_elems = variable_make_unique(req_list) != 0 ? NULL : realloc(req_list->data.array.elements, new_size * sizeof(Variable*));
 		if (!new_elems) { free_variable(ref_var); goto cleanup; }
 		new_elems[new_size - 1] = ref_var;
 		req_list->data.array.elements = new_elems;
@@ -3479,7 +3373,7 @@ int check_invalidate_param_semantics(InvalidateParamNode* node, SymbolTable* st)
 	}
 
 	size_t new_size = inv_list->data.array.size + 1;
-	Variable** new_elements = realloc(inv_list->data.array.elements, new_size * sizeof(Variable*));
+	Variable** new_elements = variable_make_unique(inv_list) != 0 ? NULL : realloc(inv_list->data.array.elements, new_size * sizeof(Variable*));
 	if (!new_elements) {
 		free_variable(param_var);
 		ProPrintfChar("Error: Reallocation failed for INVALIDATED_PARAMS array\n");
@@ -3646,7 +3540,9 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 					free(column_keys);
 					return -1;
 				}
-				LogOnlyPrintfChar("Note: DOUBLE cell in row %zu, column %zu evaluated to exact value %.15g\n", r, c, dv);
+				char dv_text[32];
+				epa_format_double(dv, dv_text, sizeof(dv_text));
+				LogOnlyPrintfChar("Note: DOUBLE cell in row %zu, column %zu evaluated to exact value %s\n", r, c, dv_text);
 			} break;
 			case TYPE_BOOL: {
 				long bv;
@@ -3707,53 +3603,23 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 			}
 		}
 	}
-	/* 4) Materialize table data as array (renamed to data_var for wrapping) */
-	Variable* data_var = (Variable*)malloc(sizeof(Variable));
-	if (!data_var) { ProPrintfChar("Error: Memory allocation failed for table variable\n"); free(column_types); for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]); free(column_keys); return -1; }
-	data_var->type = TYPE_ARRAY;
-	data_var->data.array.size = node->row_count;
-	data_var->data.array.elements = (node->row_count > 0)
-		? (Variable**)malloc(node->row_count * sizeof(Variable*))
-		: NULL;
-	if (node->row_count > 0 && !data_var->data.array.elements) { free(data_var); free(column_types); for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]); free(column_keys); return -1; }
+	/* 4) Materialize table data column-wise: one schema, one typed vector per column */
+	TableStore* store = table_store_create(node->column_count, node->row_count);
+	int store_failed = (store == NULL);
+	for (size_t c = 0; !store_failed && c < node->column_count; ++c) {
+		if (table_store_set_column(store, c, column_keys[c], column_types[c]) != 0) store_failed = 1;
+	}
+	if (store_failed) {
+		ProPrintfChar("Error: Memory allocation failed for table variable\n");
+		table_store_release(store);
+		free(column_types);
+		for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]);
+		free(column_keys);
+		return -1;
+	}
 	for (size_t r = 0; r < node->row_count; ++r) {
-		Variable* row_var = (Variable*)malloc(sizeof(Variable));
-		if (!row_var) {
-			for (size_t k = 0; k < r; ++k) free_variable(data_var->data.array.elements[k]);
-			free(data_var->data.array.elements);
-			free(data_var);
-			free(column_types);
-			for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]);
-			free(column_keys);
-			return -1;
-		}
-		row_var->type = TYPE_MAP;
-		row_var->data.map = create_hash_table(node->column_count);
-		if (!row_var->data.map) {
-			free(row_var);
-			for (size_t k = 0; k < r; ++k) free_variable(data_var->data.array.elements[k]);
-			free(data_var->data.array.elements);
-			free(data_var);
-			free(column_types);
-			for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]);
-			free(column_keys);
-			return -1;
-		}
 		for (size_t c = 0; c < node->column_count; ++c) {
 			ExpressionNode* cell_expr = node->rows[r][c];
-			Variable* v = (Variable*)malloc(sizeof(Variable));
-			if (!v) {
-				free_hash_table(row_var->data.map);
-				free(row_var);
-				for (size_t k = 0; k < r; ++k) free_variable(data_var->data.array.elements[k]);
-				free(data_var->data.array.elements);
-				free(data_var);
-				free(column_types);
-				for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]);
-				free(column_keys);
-				return -1;
-			}
-			v->type = TYPE_NULL;
 			int is_empty = (cell_expr == NULL);
 			char* probe = NULL;
 			if (!is_empty && evaluate_to_string(cell_expr, st, &probe) == 0) {
@@ -3766,27 +3632,26 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 				case TYPE_STRING: {
 					char* s = NULL;
 					if (evaluate_to_string(cell_expr, st, &s) == 0 && s && s[0] != '\0' && strcmp(s, "NO_VALUE") != 0) {
-						v->type = TYPE_STRING;
-						v->data.string_value = _strdup(s);
-						if (!v->data.string_value) { v->type = TYPE_NULL; }
+						table_store_set_string(store, r, c, s);
 					}
 					free(s);
 				} break;
 				case TYPE_INTEGER: {
 					long iv;
-					if (evaluate_to_int(cell_expr, st, &iv) == 0) { v->type = TYPE_INTEGER; v->data.int_value = (int)iv; }
+					if (evaluate_to_int(cell_expr, st, &iv) == 0) table_store_set_int(store, r, c, (int)iv);
 				} break;
 				case TYPE_DOUBLE: {
 					double dv;
 					if (evaluate_to_double(cell_expr, st, &dv) == 0) {
-						v->type = TYPE_DOUBLE;
-						v->data.double_value = dv;
-						LogOnlyPrintfChar("Note: Stored exact DOUBLE value %.15g in row %zu, column %zu\n", dv, r, c);
+						table_store_set_double(store, r, c, dv);
+						char dv_text[32];
+						epa_format_double(dv, dv_text, sizeof(dv_text));
+						LogOnlyPrintfChar("Note: Stored exact DOUBLE value %s in row %zu, column %zu\n", dv_text, r, c);
 					}
 				} break;
 				case TYPE_BOOL: {
 					long bv;
-					if (evaluate_to_int(cell_expr, st, &bv) == 0) { v->type = TYPE_BOOL; v->data.int_value = (bv != 0); }
+					if (evaluate_to_int(cell_expr, st, &bv) == 0) table_store_set_int(store, r, c, (bv != 0));
 				} break;
 				case TYPE_SUBTABLE: {
 					char* name = NULL;
@@ -3798,9 +3663,7 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 						}
 					}
 					if (name && name[0] != '\0' && strcmp(name, "NO_VALUE") != 0) {
-						v->type = TYPE_SUBTABLE;
-						v->data.string_value = _strdup(name);
-						if (!v->data.string_value) v->type = TYPE_NULL;
+						table_store_set_string(store, r, c, name);
 						LogOnlyPrintfChar("Note: Stored SUBTABLE ref '%s' as TYPE_SUBTABLE\n", name);
 					}
 					free(name);
@@ -3818,9 +3681,7 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 						}
 					}
 					if (ref && ref[0] != '\0' && strcmp(ref, "NO_VALUE") != 0) {
-						v->type = TYPE_STRING;
-						v->data.string_value = _strdup(ref);
-						if (!v->data.string_value) v->type = TYPE_NULL;
+						table_store_set_string(store, r, c, ref); /* stored as TYPE_STRING */
 					}
 					free(ref);
 				} break;
@@ -3828,10 +3689,27 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 				}
 			}
 			free(probe);
-			hash_table_insert(row_var->data.map, column_keys[c], v);
 		}
-		data_var->data.array.elements[r] = row_var;
 	}
+	table_store_seal(store);
+	/* Index the FILTER_COLUMN / FILTER_ONLY_COLUMN columns (0 == first AFTER visible) */
+	if (node->filter_column >= 0 && (size_t)node->filter_column + 1 < node->column_count) {
+		table_store_build_index(store, table_store_column(store, column_keys[1 + node->filter_column]));
+	}
+	if (node->filter_only_column >= 0 && (size_t)node->filter_only_column + 1 < node->column_count) {
+		table_store_build_index(store, table_store_column(store, column_keys[1 + node->filter_only_column]));
+	}
+	Variable* data_var = (Variable*)calloc(1, sizeof(Variable));
+	if (!data_var) {
+		ProPrintfChar("Error: Memory allocation failed for table variable\n");
+		table_store_release(store);
+		free(column_types);
+		for (size_t i = 0; i < node->column_count; ++i) free(column_keys[i]);
+		free(column_keys);
+		return -1;
+	}
+	data_var->type = TYPE_TABLE;
+	data_var->data.table = store;
 
 	/* 4.5) Wrap data in a map with options */
 	Variable* table_var = (Variable*)malloc(sizeof(Variable));
@@ -3844,7 +3722,7 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 		return -1;
 	}
 	table_var->type = TYPE_MAP;
-	table_var->data.map = create_hash_table(6); /* rows, options, columns, filter_column, filter_only_column */
+	table_var->data.map = create_hash_table(6); /* store, options, columns, filter_column, filter_only_column */
 	if (!table_var->data.map) {
 		free(table_var);
 		free_variable(data_var);
@@ -3853,7 +3731,7 @@ int check_begin_table_semantics(TableNode* node, SymbolTable* st) {
 		free(column_keys);
 		return -1;
 	}
-	hash_table_insert(table_var->data.map, "rows", data_var);
+	hash_table_insert(table_var->data.map, "store", data_var); /* read as "rows" through table_store_rows */
 
 	/* --- NEW: persist columns + filter options --- */
 	/* 1) columns[] (string keys; 0 = SEL_STRING, 1+ = data columns) */
@@ -4074,6 +3952,71 @@ static void collect_assignment_ids_from_command(CommandNode* cmd, AssignmentList
 	/* Other command types have no nested command blocks */
 }
 
+/* Record on every assignment in one branch of IF if_id (through FOR/WHILE/CATCH
+   bodies) which IF and branch own it. Nested IFs are skipped: they are checked
+   first and tag their own assignments, so each one ends up with its innermost IF. */
+static void tag_branch_assignments(CommandNode** cmds, size_t count, int if_id, int branch_index)
+{
+	for (size_t i = 0; cmds && i < count; ++i) {
+		CommandNode* cmd = cmds[i];
+		if (!cmd || !cmd->data) continue;
+		CommandData* d = (CommandData*)cmd->data;
+
+		switch (cmd->type) {
+		case COMMAND_ASSIGNMENT:
+			d->assignment.if_id = if_id;
+			d->assignment.branch_index = branch_index;
+			break;
+		case COMMAND_FOR:
+			tag_branch_assignments(d->forcommand.commands, d->forcommand.command_count, if_id, branch_index);
+			break;
+		case COMMAND_WHILE:
+			tag_branch_assignments(d->whilecommand.commands, d->whilecommand.command_count, if_id, branch_index);
+			break;
+		case COMMAND_BEGIN_CATCH_ERROR:
+			tag_branch_assignments(d->begin_catch_error.commands, d->begin_catch_error.command_count, if_id, branch_index);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* Tag the assignments of every branch of node, ELSE as branch -1 */
+static void tag_if_assignments(IfNode* node)
+{
+	for (size_t b = 0; b < node->branch_count; ++b) {
+		if (node->branches[b])
+			tag_branch_assignments(node->branches[b]->commands, node->branches[b]->command_count, node->id, (int)b);
+	}
+	tag_branch_assignments(node->else_commands, node->else_command_count, node->id, -1);
+}
+
+// Helper to materialize an AssignmentList as an array of integer ids (NULL on OOM)
+static Variable* assignment_list_to_array(const AssignmentList* lst)
+{
+	Variable* arr = (Variable*)malloc(sizeof(Variable));
+	if (!arr) return NULL;
+	arr->type = TYPE_ARRAY;
+	arr->display_options = NULL;
+	arr->declaration_count = 1;
+	arr->data.array.size = (int)lst->count;
+	arr->data.array.elements = (Variable**)calloc(lst->count > 0 ? lst->count : 1, sizeof(Variable*));
+	if (!arr->data.array.elements && lst->count > 0) {
+		free(arr); return NULL;
+	}
+	for (size_t i = 0; i < lst->count; ++i) {
+		Variable* iv = (Variable*)malloc(sizeof(Variable));
+		if (!iv) continue;
+		iv->type = TYPE_INTEGER;
+		iv->data.int_value = lst->ids[i];
+		iv->display_options = NULL;
+		iv->declaration_count = 1;
+		arr->data.array.elements[i] = iv;
+	}
+	return arr;
+}
+
 int check_if_semantics(IfNode* node, SymbolTable* st) {
 	if (!node) {
 		ProPrintfChar("Error: Invalid IF node\n");
@@ -4108,24 +4051,7 @@ int check_if_semantics(IfNode* node, SymbolTable* st) {
 		init_assignment_list(&branch_lists[i]);
 	}
 
-	/* 1) Validate each branch condition; set __CURRENT_IF_ID while recursing */
-	/*    We reuse a single integer variable for __CURRENT_IF_ID to avoid churn. */
-	Variable* cur_if_sym = get_symbol(st, "__CURRENT_IF_ID");
-	if (!cur_if_sym) {
-		cur_if_sym = (Variable*)malloc(sizeof(Variable));
-		if (!cur_if_sym) {
-			for (size_t i = 0; i < total_branches; ++i) free_assignment_list(&branch_lists[i]);
-			free(branch_lists);
-			ProPrintfChar("Error: OOM for __CURRENT_IF_ID\n"); return -1;
-		}
-		cur_if_sym->type = TYPE_INTEGER;
-		cur_if_sym->data.int_value = 0;
-		cur_if_sym->display_options = NULL;
-		cur_if_sym->declaration_count = 1;
-		set_symbol(st, "__CURRENT_IF_ID", cur_if_sym);
-	}
-	const int saved_if_id = cur_if_sym->data.int_value;
-
+	/* 1) Validate each branch condition and recurse into its commands */
 	for (size_t b = 0; b < node->branch_count; b++) {
 		IfBranch* branch = node->branches[b];
 		VariableType cond_type = get_expression_type(branch->condition, st);
@@ -4137,13 +4063,9 @@ int check_if_semantics(IfNode* node, SymbolTable* st) {
 			return -1;
 		}
 
-		/* Set current IF context for anything analyzed under this IF */
-		cur_if_sym->data.int_value = node->id;
-
 		/* Recurse */
 		for (size_t c = 0; c < branch->command_count; c++) {
 			if (analyze_command(branch->commands[c], st) != 0) {
-				cur_if_sym->data.int_value = saved_if_id;
 				for (size_t i = 0; i < total_branches; ++i) free_assignment_list(&branch_lists[i]);
 				free(branch_lists);
 				return -1;
@@ -4155,17 +4077,14 @@ int check_if_semantics(IfNode* node, SymbolTable* st) {
 
 	/* ELSE block */
 	if (node->else_command_count > 0) {
-		cur_if_sym->data.int_value = node->id;
 		for (size_t c = 0; c < node->else_command_count; c++) {
 			if (analyze_command(node->else_commands[c], st) != 0) {
-				cur_if_sym->data.int_value = saved_if_id;
 				for (size_t i = 0; i < total_branches; ++i) free_assignment_list(&branch_lists[i]);
 				free(branch_lists);
 				return -1;
 			}
 			collect_assignment_ids_from_command(node->else_commands[c], &branch_lists[node->branch_count]);
 		}
-		cur_if_sym->data.int_value = saved_if_id;
 	}
 
 	/* 2) Build the IF entry map and publish into IFS */
@@ -4220,25 +4139,8 @@ int check_if_semantics(IfNode* node, SymbolTable* st) {
 	size_t total_assigns = 0;
 	for (size_t b = 0; b < total_branches; ++b) {
 		AssignmentList* lst = &branch_lists[b];
-		Variable* sub_arr = (Variable*)malloc(sizeof(Variable));
+		Variable* sub_arr = assignment_list_to_array(lst);
 		if (!sub_arr) continue;
-		sub_arr->type = TYPE_ARRAY;
-		sub_arr->display_options = NULL;
-		sub_arr->declaration_count = 1;
-		sub_arr->data.array.size = (int)lst->count;
-		sub_arr->data.array.elements = (Variable**)calloc(lst->count > 0 ? lst->count : 1, sizeof(Variable*));
-		if (!sub_arr->data.array.elements && lst->count > 0) {
-			free(sub_arr); continue;
-		}
-		for (size_t i = 0; i < lst->count; ++i) {
-			Variable* iv = (Variable*)malloc(sizeof(Variable));
-			if (!iv) continue;
-			iv->type = TYPE_INTEGER;
-			iv->data.int_value = lst->ids[i];
-			iv->display_options = NULL;
-			iv->declaration_count = 1;
-			sub_arr->data.array.elements[i] = iv;
-		}
 		branch_arr->data.array.elements[b] = sub_arr;
 		total_assigns += lst->count;
 	}
@@ -4274,6 +4176,9 @@ int check_if_semantics(IfNode* node, SymbolTable* st) {
 		}
 	}
 
+	/* 4) The same facts on the nodes themselves, for the executor's gate */
+	tag_if_assignments(node);
+
 	/* Cleanup */
 	for (size_t i = 0; i < total_branches; ++i) free_assignment_list(&branch_lists[i]);
 	free(branch_lists);
@@ -4669,14 +4574,23 @@ int check_search_mdl_ref_semantics(SearchMdlRefNode* node, SymbolTable* st)
  * BEGIN_CATCH_ERROR semantic analysis
  *
  * Rules:
- *  - Create or reuse three integer flags in the symbol table:
- *      __CATCH_ACTIVE, __CATCH_FIX_FAIL_UDF, __CATCH_FIX_FAIL_COMPONENT
- *  - Set them for the duration of this block, analyze all nested
- *    commands, then restore previous values.
+ *  - The catch context of the block being analyzed lives in
+ *    analysis_catch, not in the user symbol table; the runtime keeps
+ *    its own copy in ExecState (catch_active, catch_fix_fail_*).
+ *  - Set it for the duration of this block, analyze all nested
+ *    commands, then restore the enclosing context.
  *  - This does not change the static types of nested statements; it
  *    only exposes context for rules that want to branch on "catch mode".
  *
 \*=================================================*/
+typedef struct {
+	int active;
+	int fix_fail_udf;
+	int fix_fail_component;
+} CatchContext;
+
+static CatchContext analysis_catch;
+
 static int check_begin_catch_error_semantics(CatchErrorNode* node, SymbolTable* st)
 {
 	if (!node) {
@@ -4684,78 +4598,25 @@ static int check_begin_catch_error_semantics(CatchErrorNode* node, SymbolTable*
 		return -1;
 	}
 
-	/* Acquire or create the three context flags as mutable integers. */
-	Variable* v_active = get_symbol(st, "__CATCH_ACTIVE");
-	if (!v_active) {
-		v_active = (Variable*)malloc(sizeof(Variable));
-		if (!v_active) { ProPrintfChar("Error: OOM for __CATCH_ACTIVE\n"); return -1; }
-		v_active->type = TYPE_INTEGER;
-		v_active->data.int_value = 0;
-		v_active->display_options = NULL;
-		v_active->declaration_count = 1;
-		set_symbol(st, "__CATCH_ACTIVE", v_active);
-	}
-	else if (v_active->type != TYPE_INTEGER) {
-		ProPrintfChar("Error: __CATCH_ACTIVE must be integer\n");
-		return -1;
-	}
-
-	Variable* v_udf = get_symbol(st, "__CATCH_FIX_FAIL_UDF");
-	if (!v_udf) {
-		v_udf = (Variable*)malloc(sizeof(Variable));
-		if (!v_udf) { ProPrintfChar("Error: OOM for __CATCH_FIX_FAIL_UDF\n"); return -1; }
-		v_udf->type = TYPE_INTEGER;
-		v_udf->data.int_value = 0;
-		v_udf->display_options = NULL;
-		v_udf->declaration_count = 1;
-		set_symbol(st, "__CATCH_FIX_FAIL_UDF", v_udf);
-	}
-	else if (v_udf->type != TYPE_INTEGER) {
-		ProPrintfChar("Error: __CATCH_FIX_FAIL_UDF must be integer\n");
-		return -1;
-	}
-
-	Variable* v_comp = get_symbol(st, "__CATCH_FIX_FAIL_COMPONENT");
-	if (!v_comp) {
-		v_comp = (Variable*)malloc(sizeof(Variable));
-		if (!v_comp) { ProPrintfChar("Error: OOM for __CATCH_FIX_FAIL_COMPONENT\n"); return -1; }
-		v_comp->type = TYPE_INTEGER;
-		v_comp->data.int_value = 0;
-		v_comp->display_options = NULL;
-		v_comp->declaration_count = 1;
-		set_symbol(st, "__CATCH_FIX_FAIL_COMPONENT", v_comp);
-	}
-	else if (v_comp->type != TYPE_INTEGER) {
-		ProPrintfChar("Error: __CATCH_FIX_FAIL_COMPONENT must be integer\n");
-		return -1;
-	}
-
-	/* Save prior state, then activate catch context. */
-	const int saved_active = v_active->data.int_value;
-	const int saved_udf = v_udf->data.int_value;
-	const int saved_comp = v_comp->data.int_value;
-
-	v_active->data.int_value = 1;
-	v_udf->data.int_value = node->fix_fail_udf ? 1 : 0;
-	v_comp->data.int_value = node->fix_fail_component ? 1 : 0;
+	/* Save the enclosing context, then activate this block's. */
+	const CatchContext saved = analysis_catch;
+	analysis_catch.active = 1;
+	analysis_catch.fix_fail_udf = node->fix_fail_udf ? 1 : 0;
+	analysis_catch.fix_fail_component = node->fix_fail_component ? 1 : 0;
 
 	/* Recurse over nested commands in this block. */
+	int result = 0;
 	for (size_t c = 0; c < node->command_count; ++c) {
 		if (analyze_command(node->commands[c], st) != 0) {
-			/* Restore and propagate error so caller can mark invalid. */
-			v_active->data.int_value = saved_active;
-			v_udf->data.int_value = saved_udf;
-			v_comp->data.int_value = saved_comp;
-			return -1;
+			/* Propagate error so caller can mark invalid. */
+			result = -1;
+			break;
 		}
 	}
 
 	/* Restore previous context. */
-	v_active->data.int_value = saved_active;
-	v_udf->data.int_value = saved_udf;
-	v_comp->data.int_value = saved_comp;
-
-	return 0;
+	analysis_catch = saved;
+	return result;
 }
 
 
@@ -4853,16 +4714,10 @@ int check_assignment_semantics(AssignmentNode* node, SymbolTable* st)
 	(void)add_int_to_map(entry->data.map, "rhs_type", (int)rhs_type);
 	if (node->lhs->type == EXPR_VARIABLE_REF && node->lhs->data.string_val) {
 		(void)add_string_to_map(entry->data.map, "lhs_name", _strdup(node->lhs->data.string_val));
+		node->lhs_slot = reserve_symbol_slot(st, node->lhs->data.string_val);
 	}
 
-	/* NEW: backlink to the IF we are currently inside, if any */
-	{
-		Variable* cur_if = get_symbol(st, "__CURRENT_IF_ID");
-		if (cur_if && cur_if->type == TYPE_INTEGER && cur_if->data.int_value > 0) {
-			(void)add_int_to_map(entry->data.map, "if_id", cur_if->data.int_value);
-			// branch_index will be back-filled during IF analysis (since it knows the branch)
-		}
-	}
+	/* if_id and branch_index are back-filled by the enclosing IF's analysis */
 
 	/* Insert entry under ASSIGN_#### */
 	{
@@ -4875,107 +4730,6 @@ int check_assignment_semantics(AssignmentNode* node, SymbolTable* st)
 	return 0;
 }
 
-/*=================================================*
- *
- * New: Watcher Index Builder
- * Builds a top-level map "WATCHER_INDEX" in the symbol table.
- * Key: variable name (string, from lhs_name if simple var)
- * Value: array of maps, each: {if_id: int, branch_index: int, assign_id: int}
- * Only includes assignments with lhs_name (simple variables) and inside IFs.
- * This allows tracking conditional assignments to variables for re-evaluation.
- *
- * Call this after all semantic analysis, e.g., at the end of perform_semantic_analysis.
- *
-\*=================================================*/
-int build_watcher_index(SymbolTable* st) {
-	Variable* areg = get_symbol(st, "ASSIGNMENTS");
-	if (!areg || areg->type != TYPE_MAP || !areg->data.map) {
-		ProPrintfChar("Warning: No ASSIGNMENTS registry; skipping watcher index\n");
-		return 0; // No error, just no index
-	}
-
-	Variable* watcher = (Variable*)malloc(sizeof(Variable));
-	if (!watcher) {
-		ProPrintfChar("Error: OOM for WATCHER_INDEX\n");
-		return -1;
-	}
-	watcher->type = TYPE_MAP;
-	watcher->data.map = create_hash_table(64); // Arbitrary initial size
-	watcher->display_options = NULL;
-	watcher->declaration_count = 1;
-	if (!watcher->data.map) {
-		free(watcher);
-		ProPrintfChar("Error: OOM for WATCHER_INDEX map\n");
-		return -1;
-	}
-
-	// Iterate over all ASSIGN_#### entries
-	HashTable* assign_map = areg->data.map;
-	for (size_t bucket = 0; bucket < assign_map->size; ++bucket) {
-		HashEntry* entry = assign_map->buckets[bucket];
-		while (entry) {
-			if (entry->value && entry->value->type == TYPE_MAP && entry->value->data.map) {
-				HashTable* a_map = entry->value->data.map;
-
-				// Check for lhs_name, if_id, branch_index
-				Variable* lhs_name_var = hash_table_lookup(a_map, "lhs_name");
-				Variable* if_id_var = hash_table_lookup(a_map, "if_id");
-				Variable* branch_idx_var = hash_table_lookup(a_map, "branch_index");
-				Variable* assign_id_var = hash_table_lookup(a_map, "assign_id");
-
-				if (lhs_name_var && lhs_name_var->type == TYPE_STRING && lhs_name_var->data.string_value &&
-					if_id_var && if_id_var->type == TYPE_INTEGER &&
-					branch_idx_var && branch_idx_var->type == TYPE_INTEGER &&
-					assign_id_var && assign_id_var->type == TYPE_INTEGER) {
-
-					const char* var_name = lhs_name_var->data.string_value;
-
-					// Get or create array for this var_name
-					Variable* var_list = hash_table_lookup(watcher->data.map, var_name);
-					if (!var_list) {
-						var_list = (Variable*)malloc(sizeof(Variable));
-						if (!var_list) goto next_entry; // OOM: skip
-						var_list->type = TYPE_ARRAY;
-						var_list->data.array.size = 0;
-						var_list->data.array.elements = NULL;
-						var_list->display_options = NULL;
-						var_list->declaration_count = 1;
-						(void)add_var_to_map(watcher->data.map, var_name, var_list);
-					}
-					if (var_list->type != TYPE_ARRAY) goto next_entry; // Corrupt: skip
-
-					// Append a map {if_id, branch_index, assign_id}
-					Variable* info = (Variable*)malloc(sizeof(Variable));
-					if (!info) goto next_entry;
-					info->type = TYPE_MAP;
-					info->data.map = create_hash_table(4);
-					info->display_options = NULL;
-					info->declaration_count = 1;
-					if (!info->data.map) { free(info); goto next_entry; }
-
-					(void)add_int_to_map(info->data.map, "if_id", if_id_var->data.int_value);
-					(void)add_int_to_map(info->data.map, "branch_index", branch_idx_var->data.int_value);
-					(void)add_int_to_map(info->data.map, "assign_id", assign_id_var->data.int_value);
-
-					// Append to array
-					size_t new_size = var_list->data.array.size + 1;
-					Variable** new_elems = (Variable**)realloc(var_list->data.array.elements, new_size * sizeof(Variable*));
-					if (!new_elems) { free_hash_table(info->data.map); free(info); goto next_entry; }
-					var_list->data.array.elements = new_elems;
-					var_list->data.array.elements[var_list->data.array.size] = info;
-					var_list->data.array.size = new_size;
-				}
-			}
-		next_entry:
-			entry = entry->next;
-		}
-	}
-
-	set_symbol(st, "WATCHER_INDEX", watcher);
-	ProPrintfChar("Note: WATCHER_INDEX built successfully\n");
-	return 0;
-}
-
 // Recursive helper to analyze a single CommandNode (handles nesting)
 static int analyze_command(CommandNode* cmd, SymbolTable* st) {
 	if (!cmd) return 0;  // Skip null nodes
@@ -5070,6 +4824,925 @@ static int analyze_command(CommandNode* cmd, SymbolTable* st) {
 }
 
 // Minor update to perform_semantic_analysis for better cleanup
+#define VISIT_EXPR(e) do { if (e) visit(&(e), ctx); } while (0)
+#define VISIT_EXPR_ARRAY(arr, n) do { for (size_t _k = 0; (arr) && _k < (size_t)(n); ++_k) VISIT_EXPR((arr)[_k]); } while (0)
+#define VISIT_COMMANDS(arr, n) do { for (size_t _k = 0; (arr) && _k < (size_t)(n); ++_k) walk_command_expressions((arr)[_k], visit, ctx); } while (0)
+
+/* Visit every root expression held by a command, recursing into nested command lists */
+void walk_command_expressions(CommandNode* cmd, ExpressionVisitor visit, void* ctx) {
+	if (!cmd || !cmd->data || !visit) return;
+	CommandData* d = cmd->data;
+
+	switch (cmd->type) {
+	case COMMAND_DECLARE_VARIABLE: {
+		DeclareVariableNode* dv = &d->declare_variable;
+		switch (dv->var_type) {
+		case VAR_PARAMETER: VISIT_EXPR(dv->data.parameter.default_expr); break;
+		case VAR_REFERENCE: VISIT_EXPR(dv->data.reference.default_ref); break;
+		case VAR_ARRAY: VISIT_EXPR_ARRAY(dv->data.array.initializers, dv->data.array.init_count); break;
+		case VAR_MAP:
+			for (size_t j = 0; dv->data.map.pairs && j < dv->data.map.pair_count; ++j) VISIT_EXPR(dv->data.map.pairs[j].value);
+			break;
+		case VAR_STRUCTURE:
+			for (size_t j = 0; dv->data.structure.members && j < dv->data.structure.member_count; ++j) VISIT_EXPR(dv->data.structure.members[j].default_expr);
+			break;
+		default: break;
+		}
+		break;
+	}
+	case COMMAND_CONFIG_ELEM:
+		VISIT_EXPR(d->config_elem.location_option);
+		VISIT_EXPR(d->config_elem.width);
+		VISIT_EXPR(d->config_elem.height);
+		break;
+	case COMMAND_SHOW_PARAM:
+		VISIT_EXPR(d->show_param.tooltip_message);
+		VISIT_EXPR(d->show_param.image_name);
+		VISIT_EXPR(d->show_param.posX);
+		VISIT_EXPR(d->show_param.posY);
+		break;
+	case COMMAND_GLOBAL_PICTURE:
+		VISIT_EXPR(d->global_picture.picture_expr);
+		break;
+	case COMMAND_SUB_PICTURE:
+		VISIT_EXPR(d->sub_picture.picture_expr);
+		VISIT_EXPR(d->sub_picture.posX_expr);
+		VISIT_EXPR(d->sub_picture.posY_expr);
+		break;
+	case COMMAND_USER_INPUT_PARAM: {
+		UserInputParamNode* n = &d->user_input_param;
+		VISIT_EXPR(n->default_expr);
+		VISIT_EXPR(n->width);
+		VISIT_EXPR(n->decimal_places);
+		VISIT_EXPR(n->model);
+		VISIT_EXPR(n->display_order);
+		VISIT_EXPR(n->min_value);
+		VISIT_EXPR(n->max_value);
+		VISIT_EXPR(n->tooltip_message);
+		VISIT_EXPR(n->image_name);
+		VISIT_EXPR(n->posX);
+		VISIT_EXPR(n->posY);
+		break;
+	}
+	case COMMAND_CHECKBOX_PARAM: {
+		CheckboxParamNode* n = &d->checkbox_param;
+		VISIT_EXPR(n->display_order);
+		VISIT_EXPR(n->tooltip_message);
+		VISIT_EXPR(n->image_name);
+		VISIT_EXPR(n->posX);
+		VISIT_EXPR(n->posY);
+		VISIT_EXPR(n->tag);
+		break;
+	}
+	case COMMAND_USER_SELECT:
+	case COMMAND_USER_SELECT_OPTIONAL: {
+		/* UserSelectOptionalNode shares the UserSelectNode layout */
+		UserSelectNode* n = &d->user_select;
+		VISIT_EXPR_ARRAY(n->types, n->type_count);
+		VISIT_EXPR(n->display_order);
+		VISIT_EXPR(n->filter_mdl);
+		VISIT_EXPR(n->filter_feat);
+		VISIT_EXPR(n->filter_geom);
+		VISIT_EXPR(n->filter_ref);
+		VISIT_EXPR(n->filter_identifier);
+		VISIT_EXPR(n->include_multi_cad);
+		VISIT_EXPR(n->tooltip_message);
+		VISIT_EXPR(n->image_name);
+		VISIT_EXPR(n->posX);
+		VISIT_EXPR(n->posY);
+		VISIT_EXPR(n->tag);
+		break;
+	}
+	case COMMAND_USER_SELECT_MULTIPLE:
+	case COMMAND_USER_SELECT_MULTIPLE_OPTIONAL: {
+		/* UserSelectMultipleOptionalNode shares the UserSelectMultipleNode layout */
+		UserSelectMultipleNode* n = &d->user_select_multiple;
+		VISIT_EXPR_ARRAY(n->types, n->type_count);
+		VISIT_EXPR(n->max_sel);
+		VISIT_EXPR(n->display_order);
+		VISIT_EXPR(n->filter_mdl);
+		VISIT_EXPR(n->filter_feat);
+		VISIT_EXPR(n->filter_geom);
+		VISIT_EXPR(n->filter_ref);
+		VISIT_EXPR(n->filter_identifier);
+		VISIT_EXPR(n->include_multi_cad);
+		VISIT_EXPR(n->tooltip_message);
+		VISIT_EXPR(n->image_name);
+		VISIT_EXPR(n->posX);
+		VISIT_EXPR(n->posY);
+		VISIT_EXPR(n->tag);
+		break;
+	}
+	case COMMAND_RADIOBUTTON_PARAM: {
+		RadioButtonParamNode* n = &d->radiobutton_param;
+		VISIT_EXPR_ARRAY(n->options, n->option_count);
+		VISIT_EXPR(n->display_order);
+		VISIT_EXPR(n->tooltip_message);
+		VISIT_EXPR(n->image_name);
+		VISIT_EXPR(n->posX);
+		VISIT_EXPR(n->posY);
+		break;
+	}
+	case COMMAND_BEGIN_TABLE: {
+		TableNode* n = &d->begin_table;
+		VISIT_EXPR(n->name);
+		VISIT_EXPR_ARRAY(n->options, n->option_count);
+		VISIT_EXPR_ARRAY(n->sel_strings, n->sel_string_count);
+		VISIT_EXPR_ARRAY(n->data_types, n->data_type_count);
+		for (int r = 0; n->rows && r < n->row_count; ++r) {
+			VISIT_EXPR_ARRAY(n->rows[r], n->column_count);
+		}
+		break;
+	}
+	case COMMAND_IF: {
+		IfNode* n = &d->ifcommand;
+		for (size_t b = 0; n->branches && b < n->branch_count; ++b) {
+			IfBranch* br = n->branches[b];
+			if (!br) continue;
+			VISIT_EXPR(br->condition);
+			VISIT_COMMANDS(br->commands, br->command_count);
+		}
+		VISIT_COMMANDS(n->else_commands, n->else_command_count);
+		break;
+	}
+	case COMMAND_FOR:
+		VISIT_EXPR_ARRAY(d->forcommand.args, d->forcommand.arg_count);
+		VISIT_EXPR_ARRAY(d->forcommand.excludes, d->forcommand.exclude_count);
+		VISIT_COMMANDS(d->forcommand.commands, d->forcommand.command_count);
+		break;
+	case COMMAND_WHILE:
+		VISIT_EXPR(d->whilecommand.condition);
+		VISIT_COMMANDS(d->whilecommand.commands, d->whilecommand.command_count);
+		break;
+	case COMMAND_ASSIGNMENT:
+		VISIT_EXPR(d->assignment.lhs);
+		VISIT_EXPR(d->assignment.rhs);
+		break;
+	case COMMAND_EXPRESSION:
+		VISIT_EXPR(d->expression);
+		break;
+	case COMMAND_MEASURE_DISTANCE:
+		VISIT_EXPR(d->measure_distance.reference1);
+		VISIT_EXPR(d->measure_distance.reference2);
+		VISIT_EXPR(d->measure_distance.parameterResult);
+		break;
+	case COMMAND_MEASURE_LENGTH:
+		VISIT_EXPR(d->measure_length.reference1);
+		VISIT_EXPR(d->measure_length.parameterResult);
+		break;
+	case COMMAND_SEARCH_MDL_REFS: {
+		SearchMdlRefsNode* n = &d->search_mdl_refs;
+		VISIT_EXPR(n->include_multi_cad);
+		VISIT_EXPR(n->model);
+		VISIT_EXPR(n->type_expr);
+		VISIT_EXPR(n->search_string);
+		VISIT_EXPR_ARRAY(n->with_content, n->with_content_count);
+		VISIT_EXPR_ARRAY(n->with_content_not, n->with_content_not_count);
+		VISIT_EXPR_ARRAY(n->with_identifier, n->with_identifier_count);
+		VISIT_EXPR_ARRAY(n->with_identifier_not, n->with_identifier_not_count);
+		break;
+	}
+	case COMMAND_SEARCH_MDL_REF: {
+		SearchMdlRefNode* n = &d->search_mdl_ref;
+		VISIT_EXPR(n->include_multi_cad);
+		VISIT_EXPR(n->model);
+		VISIT_EXPR(n->type_expr);
+		VISIT_EXPR(n->search_string);
+		VISIT_EXPR_ARRAY(n->with_content, n->with_content_count);
+		VISIT_EXPR_ARRAY(n->with_content_not, n->with_content_not_count);
+		VISIT_EXPR_ARRAY(n->with_identifier, n->with_identifier_count);
+		VISIT_EXPR_ARRAY(n->with_identifier_not, n->with_identifier_not_count);
+		break;
+	}
+	case COMMAND_BEGIN_CATCH_ERROR:
+		VISIT_COMMANDS(d->begin_catch_error.commands, d->begin_catch_error.command_count);
+		break;
+	default:
+		break;
+	}
+}
+
+#undef VISIT_EXPR
+#undef VISIT_EXPR_ARRAY
+#undef VISIT_COMMANDS
+
+typedef struct {
+	SymbolTable* st;
+	Arena* arena;
+	size_t bound;
+	size_t members;
+} ResolveRefsCtx;
+
+/* The lexer keeps '.' inside identifiers, so S.M arrives as one EXPR_VARIABLE_REF.
+   When no symbol has the full name but its first segment is a structure holding
+   the rest member by member, rewrite the node in place into a chain of
+   EXPR_STRUCT_ACCESS. Other dotted names (file names) are left alone. */
+static int split_member_ref(ExpressionNode* expr, ResolveRefsCtx* rc) {
+	const char* name = expr->data.string_val;
+	if (!rc->arena || !name || !strchr(name, '.') || get_symbol(rc->st, name)) return 0;
+
+	char seg[128];
+	Variable* v = NULL;
+	for (const char* p = name; ; ) {
+		const char* end = strchr(p, '.');
+		size_t len = end ? (size_t)(end - p) : strlen(p);
+		if (len == 0 || len >= sizeof(seg)) return 0;
+		memcpy(seg, p, len);
+		seg[len] = '\0';
+		v = (p == name) ? get_symbol(rc->st, seg) : hash_table_lookup(v->data.structure, seg);
+		if (!v) return 0;
+		if (!end) break;
+		if (v->type != TYPE_STRUCTURE || !v->data.structure) return 0;
+		p = end + 1;
+	}
+
+	char* path = arena_strdup(rc->arena, name);
+	ExpressionNode* base = (ExpressionNode*)arena_alloc(rc->arena, sizeof(ExpressionNode));
+	if (!path || !base) return 0;
+	char* member = strchr(path, '.');
+	*member++ = '\0';
+	base->type = EXPR_VARIABLE_REF;
+	base->data.string_val = path;
+	for (char* next; (next = strchr(member, '.')) != NULL; member = next) {
+		*next++ = '\0';
+		ExpressionNode* access = (ExpressionNode*)arena_alloc(rc->arena, sizeof(ExpressionNode));
+		if (!access) return 0;
+		access->type = EXPR_STRUCT_ACCESS;
+		access->data.struct_access.structure = base;
+		access->data.struct_access.member = member;
+		base = access;
+	}
+	expr->type = EXPR_STRUCT_ACCESS;
+	expr->slot = 0;
+	expr->program = NULL;
+	expr->has_static_type = 0;
+	expr->data.struct_access.structure = base;
+	expr->data.struct_access.member = member;
+	expr->data.struct_access.field = 0;
+	expr->data.struct_access.field_hash = 0;
+	return 1;
+}
+
+/* Bind every EXPR_VARIABLE_REF in an expression tree to its symbol slot and every
+   member access on a known structure to the member's entry position */
+static void resolve_expression_refs(ExpressionNode* expr, ResolveRefsCtx* rc) {
+	if (!expr) return;
+	switch (expr->type) {
+	case EXPR_VARIABLE_REF:
+		if (split_member_ref(expr, rc)) {
+			resolve_expression_refs(expr, rc);
+			break;
+		}
+		if (expr->slot == 0 && expr->data.string_val) {
+			expr->slot = reserve_symbol_slot(rc->st, expr->data.string_val);
+			if (expr->slot != 0) rc->bound++;
+		}
+		break;
+	case EXPR_UNARY_OP:
+		resolve_expression_refs(expr->data.unary.operand, rc);
+		break;
+	case EXPR_BINARY_OP:
+		resolve_expression_refs(expr->data.binary.left, rc);
+		resolve_expression_refs(expr->data.binary.right, rc);
+		break;
+	case EXPR_FUNCTION_CALL:
+		for (size_t k = 0; k < expr->data.func_call.arg_count; ++k) {
+			resolve_expression_refs(expr->data.func_call.args[k], rc);
+		}
+		break;
+	case EXPR_ARRAY_INDEX:
+		resolve_expression_refs(expr->data.array_index.base, rc);
+		resolve_expression_refs(expr->data.array_index.index, rc);
+		break;
+	case EXPR_MAP_LOOKUP:
+		resolve_expression_refs(expr->data.map_lookup.map, rc);
+		break;
+	case EXPR_STRUCT_ACCESS: {
+		resolve_expression_refs(expr->data.struct_access.structure, rc);
+		if (expr->data.struct_access.field != 0 || !expr->data.struct_access.member) break;
+		Variable* s = static_value_of(expr->data.struct_access.structure, rc->st);
+		if (!s || s->type != TYPE_STRUCTURE || !s->data.structure) break;
+		const HashTable* ht = s->data.structure;
+		for (size_t pos = 0; pos < ht->entry_count; ++pos) {
+			const HashEntry* e = &ht->entries[pos];
+			if (e->value && strcmp(e->key, expr->data.struct_access.member) == 0) {
+				expr->data.struct_access.field = pos + 1;
+				expr->data.struct_access.field_hash = e->hash;
+				rc->members++;
+				break;
+			}
+		}
+		break;
+	}
+	case EXPR_CONCAT:
+		for (size_t k = 0; k < expr->data.concat.part_count; ++k) {
+			resolve_expression_refs(expr->data.concat.parts[k], rc);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void resolve_refs_visitor(ExpressionNode** expr, void* ctx) {
+	resolve_expression_refs(*expr, (ResolveRefsCtx*)ctx);
+}
+
+/* Resolution pass: bind variable references in all blocks to stable symbol slots.
+   Names not set yet (forward SUBTABLE refs, bare file names) get an empty slot and
+   evaluate exactly as an unknown symbol until something assigns them. */
+static void resolve_variable_refs(BlockList* block_list, SymbolTable* st) {
+	ResolveRefsCtx ctx = { st, block_list->arena, 0, 0 };
+	for (size_t b = 0; b < block_list->block_count; ++b) {
+		Block* block = &block_list->blocks[b];
+		for (size_t j = 0; j < block->command_count; ++j) {
+			walk_command_expressions(block->commands[j], resolve_refs_visitor, &ctx);
+		}
+	}
+	LogOnlyPrintfChar("Note: Bound %zu variable references to symbol slots and %zu member accesses to fields\n",
+		ctx.bound, ctx.members);
+}
+
+typedef struct {
+	Arena* arena;
+	SymbolTable* st;
+	size_t roots;
+	size_t compiled;
+} CompileProgramsCtx;
+
+static void compile_program_visitor(ExpressionNode** expr, void* ctx) {
+	CompileProgramsCtx* cc = (CompileProgramsCtx*)ctx;
+	cc->roots++;
+	if ((*expr)->program) {
+		cc->compiled++;
+		return;
+	}
+	(*expr)->program = expr_compile(cc->arena, *expr, cc->st);
+	if ((*expr)->program) cc->compiled++;
+}
+
+/* Lower every root expression to bytecode once, into the script arena. Trees the
+   VM does not cover keep program == NULL and stay on the tree walker. */
+static void compile_expression_programs(BlockList* block_list, SymbolTable* st) {
+	CompileProgramsCtx ctx = { block_list->arena, st, 0, 0 };
+	if (!ctx.arena) return;
+	for (size_t b = 0; b < block_list->block_count; ++b) {
+		Block* block = &block_list->blocks[b];
+		for (size_t j = 0; j < block->command_count; ++j) {
+			walk_command_expressions(block->commands[j], compile_program_visitor, &ctx);
+		}
+	}
+	LogOnlyPrintfChar("Note: Compiled %zu of %zu root expressions to bytecode\n", ctx.compiled, ctx.roots);
+}
+
+/* Record which symbols each reactive GUI/TAB command reads and writes, so a
+   refresh recomputes only what a change reaches. Without a graph (allocation
+   failure) EPA_ReactiveRefresh falls back to full passes. */
+static void build_dependency_graph(BlockList* block_list, SymbolTable* st) {
+	depgraph_free(st->deps);
+	st->deps = depgraph_build(block_list, st);
+	if (!st->deps) {
+		ProPrintfChar("Warning: Could not build the reactive dependency graph; refreshes will be full passes\n");
+		return;
+	}
+	LogOnlyPrintfChar("Note: Dependency graph has %zu node(s) reading %zu slot(s) across %zu unit(s); %zu unit(s) on cycles\n",
+		st->deps->node_count, st->deps->read_total, st->deps->unit_count, st->deps->cyclic_units);
+}
+
+static int is_typed_concatenation(const ExpressionNode* expr) {
+	return expr && expr->type == EXPR_BINARY_OP && expr->data.binary.op == BINOP_ADD &&
+		expr->has_static_type && expr->static_type == TYPE_STRING;
+}
+
+static size_t count_concat_parts(const ExpressionNode* expr) {
+	if (!is_typed_concatenation(expr)) return 1;
+	return count_concat_parts(expr->data.binary.left) + count_concat_parts(expr->data.binary.right);
+}
+
+static void collect_concat_parts(ExpressionNode* expr, ExpressionNode** parts, size_t* n) {
+	if (!is_typed_concatenation(expr)) {
+		parts[(*n)++] = expr;
+		return;
+	}
+	collect_concat_parts(expr->data.binary.left, parts, n);
+	collect_concat_parts(expr->data.binary.right, parts, n);
+}
+
+/* Rewrite every typed string + chain into one EXPR_CONCAT node, in place so
+   pointers held by the registries stay valid. The text sink then sizes the
+   result once instead of joining two strings per +. */
+static void flatten_concatenations(ExpressionNode* expr, Arena* arena, size_t* flattened) {
+	if (!expr) return;
+	switch (expr->type) {
+	case EXPR_UNARY_OP:
+		flatten_concatenations(expr->data.unary.operand, arena, flattened);
+		return;
+	case EXPR_BINARY_OP: {
+		if (!is_typed_concatenation(expr)) {
+			flatten_concatenations(expr->data.binary.left, arena, flattened);
+			flatten_concatenations(expr->data.binary.right, arena, flattened);
+			return;
+		}
+		size_t count = count_concat_parts(expr);
+		ExpressionNode** parts = (ExpressionNode**)arena_alloc(arena, count * sizeof(ExpressionNode*));
+		if (!parts) return;
+		size_t n = 0;
+		collect_concat_parts(expr, parts, &n);
+		for (size_t k = 0; k < n; ++k) {
+			flatten_concatenations(parts[k], arena, flattened);
+		}
+		expr->type = EXPR_CONCAT;
+		expr->program = NULL;
+		expr->data.concat.parts = parts;
+		expr->data.concat.part_count = n;
+		(*flattened)++;
+		return;
+	}
+	case EXPR_FUNCTION_CALL:
+		for (size_t k = 0; k < expr->data.func_call.arg_count; ++k) {
+			flatten_concatenations(expr->data.func_call.args[k], arena, flattened);
+		}
+		return;
+	case EXPR_ARRAY_INDEX:
+		flatten_concatenations(expr->data.array_index.base, arena, flattened);
+		flatten_concatenations(expr->data.array_index.index, arena, flattened);
+		return;
+	case EXPR_MAP_LOOKUP:
+		flatten_concatenations(expr->data.map_lookup.map, arena, flattened);
+		return;
+	case EXPR_STRUCT_ACCESS:
+		flatten_concatenations(expr->data.struct_access.structure, arena, flattened);
+		return;
+	default:
+		return;
+	}
+}
+
+typedef struct {
+	Arena* arena;
+	SymbolTable* st;
+	size_t roots;
+	size_t typed;
+	size_t flattened;
+} AnnotateTypesCtx;
+
+static void annotate_types_visitor(ExpressionNode** expr, void* ctx) {
+	AnnotateTypesCtx* ac = (AnnotateTypesCtx*)ctx;
+	ac->roots++;
+	if (infer_expression_type(*expr, ac->st, 0) != (VariableType)-1) ac->typed++;
+	if (ac->arena) flatten_concatenations(*expr, ac->arena, &ac->flattened);
+}
+
+/* Record the static type on every expression node once folding has settled the
+   trees, then flatten string concatenations. Untyped nodes (undeclared names,
+   forward references) keep the dynamic conversions in the evaluator sinks. */
+static void annotate_expression_types(BlockList* block_list, SymbolTable* st) {
+	AnnotateTypesCtx ctx = { block_list->arena, st, 0, 0, 0 };
+	for (size_t b = 0; b < block_list->block_count; ++b) {
+		Block* block = &block_list->blocks[b];
+		for (size_t j = 0; j < block->command_count; ++j) {
+			walk_command_expressions(block->commands[j], annotate_types_visitor, &ctx);
+		}
+	}
+	LogOnlyPrintfChar("Note: Typed %zu of %zu root expressions; flattened %zu string concatenation(s)\n",
+		ctx.typed, ctx.roots, ctx.flattened);
+}
+
+/*=================================================*\
+* 
+* Optimization pass: constant folding and dead IF branch pruning
+* 
+* Runs once the whole script is analyzed. Constant subtrees become literals in
+* place (pointers held by the registries stay valid) and IF branches that can
+* never run are dropped together with their ASSIGNMENTS / IFS entries.
+* 
+\*=================================================*/
+typedef struct {
+	Arena* arena;
+	SymbolTable* st;
+	size_t folded;
+	size_t pruned;
+} FoldCtx;
+
+static int is_literal_node(const ExpressionNode* e) {
+	return e && (e->type == EXPR_LITERAL_INT || e->type == EXPR_LITERAL_DOUBLE ||
+		e->type == EXPR_LITERAL_STRING || e->type == EXPR_LITERAL_BOOL);
+}
+
+/* Rewrite expr into the literal holding v; its old children stay in the arena */
+static int store_folded_value(ExpressionNode* expr, const EpaValue* v, Arena* arena) {
+	switch (v->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		expr->type = (v->type == TYPE_BOOL ? EXPR_LITERAL_BOOL : EXPR_LITERAL_INT);
+		expr->data.int_val = v->data.int_value;
+		break;
+	case TYPE_DOUBLE:
+		expr->type = EXPR_LITERAL_DOUBLE;
+		expr->data.double_val = v->data.double_value;
+		break;
+	case TYPE_STRING: {
+		const char* s = epa_string(v);
+		char* copy = arena_strdup(arena, s ? s : "");
+		if (!copy) return -1;
+		expr->type = EXPR_LITERAL_STRING;
+		expr->data.string_val = copy;
+		break;
+	}
+	default:
+		return -1;
+	}
+	expr->slot = 0;
+	expr->program = NULL;
+	return 0;
+}
+
+/* Concatenate two string literals into one arena string */
+static char* concat_literals(Arena* arena, const char* a, const char* b) {
+	size_t la = strlen(a), lb = strlen(b);
+	char* s = (char*)arena_alloc(arena, la + lb + 1);
+	if (!s) return NULL;
+	memcpy(s, a, la);
+	memcpy(s + la, b, lb + 1);
+	return s;
+}
+
+/* A + that produces text: an operand is a string literal or the whole chain
+   types as STRING */
+static int is_string_add(ExpressionNode* expr, FoldCtx* fc) {
+	ExpressionNode* l = expr->data.binary.left;
+	ExpressionNode* r = expr->data.binary.right;
+	if ((l && l->type == EXPR_LITERAL_STRING) || (r && r->type == EXPR_LITERAL_STRING)) return 1;
+	return infer_expression_type(expr, fc->st, 0) == TYPE_STRING;
+}
+
+/* in_concat: expr is a + operand of a string + chain. Its own + operators are
+   left as written so the result cannot depend on whether the string sink reads
+   the chain as text or as arithmetic ("part" + (1 + 2)). */
+static void fold_expression(ExpressionNode* expr, FoldCtx* fc, int in_concat) {
+	if (!expr) return;
+
+	switch (expr->type) {
+	case EXPR_UNARY_OP: {
+		ExpressionNode* operand = expr->data.unary.operand;
+		fold_expression(operand, fc, 0);
+		if (expr->data.unary.op != UNOP_NEG || !operand) return;
+		if (operand->type == EXPR_LITERAL_INT) {
+			long v = operand->data.int_val;
+			expr->type = EXPR_LITERAL_INT;
+			expr->data.int_val = -v;
+		}
+		else if (operand->type == EXPR_LITERAL_DOUBLE) {
+			double v = operand->data.double_val;
+			expr->type = EXPR_LITERAL_DOUBLE;
+			expr->data.double_val = -v;
+		}
+		else {
+			return;
+		}
+		expr->program = NULL;
+		fc->folded++;
+		return;
+	}
+
+	case EXPR_BINARY_OP: {
+		ExpressionNode* l = expr->data.binary.left;
+		ExpressionNode* r = expr->data.binary.right;
+		BinaryOpType op = expr->data.binary.op;
+		int chain = 0;
+		if (op == BINOP_ADD) {
+			int numeric_add_operand =
+				(l && l->type == EXPR_BINARY_OP && l->data.binary.op == BINOP_ADD) ||
+				(r && r->type == EXPR_BINARY_OP && r->data.binary.op == BINOP_ADD);
+			chain = in_concat || (numeric_add_operand && is_string_add(expr, fc));
+		}
+		fold_expression(l, fc, chain);
+		fold_expression(r, fc, chain);
+		if (!l || !r) return;
+		if (in_concat && op == BINOP_ADD &&
+			l->type != EXPR_LITERAL_STRING && r->type != EXPR_LITERAL_STRING)
+			return;
+
+		EpaValue v;
+		if (op == BINOP_AND || op == BINOP_OR) {
+			/* A constant left side that decides the result makes the right side dead */
+			if (!is_literal_node(l)) return;
+			if (evaluate_value_tree(l, fc->st, &v) != 0 || epa_truth(&v) != 0) return;
+			if ((op == BINOP_AND) == (v.data.int_value != 0) &&
+				(!is_literal_node(r) || evaluate_value_tree(expr, fc->st, &v) != 0))
+				return;
+		}
+		else if (op == BINOP_ADD &&
+			(l->type == EXPR_LITERAL_STRING || r->type == EXPR_LITERAL_STRING)) {
+			/* Concatenation: "a" + "b", and x + "a" + "b" regrouped as x + "ab" */
+			if (r->type != EXPR_LITERAL_STRING || !r->data.string_val) return;
+			if (l->type == EXPR_LITERAL_STRING && l->data.string_val) {
+				char* s = concat_literals(fc->arena, l->data.string_val, r->data.string_val);
+				if (!s) return;
+				expr->type = EXPR_LITERAL_STRING;
+				expr->data.string_val = s;
+			}
+			else if (l->type == EXPR_BINARY_OP && l->data.binary.op == BINOP_ADD &&
+				l->data.binary.right && l->data.binary.right->type == EXPR_LITERAL_STRING &&
+				l->data.binary.right->data.string_val) {
+				ExpressionNode* lr = l->data.binary.right;
+				char* s = concat_literals(fc->arena, lr->data.string_val, r->data.string_val);
+				if (!s) return;
+				lr->data.string_val = s;
+				expr->data.binary.left = l->data.binary.left;
+				expr->data.binary.right = lr;
+			}
+			else {
+				return;   /* number + string: left to the string evaluator */
+			}
+			expr->slot = 0;
+			expr->program = NULL;
+			fc->folded++;
+			return;
+		}
+		else if (!is_literal_node(l) || !is_literal_node(r) ||
+			evaluate_value_tree(expr, fc->st, &v) != 0) {
+			return;   /* not constant, or an error that must surface at runtime */
+		}
+
+		if (store_folded_value(expr, &v, fc->arena) == 0) fc->folded++;
+		return;
+	}
+
+	case EXPR_FUNCTION_CALL: {
+		/* Builtins are pure: a call on literal arguments folds like an operator */
+		int constant = 1;
+		for (size_t i = 0; i < expr->data.func_call.arg_count; ++i) {
+			fold_expression(expr->data.func_call.args[i], fc, 0);
+			constant &= is_literal_node(expr->data.func_call.args[i]);
+		}
+		EpaValue v;
+		if (constant && evaluate_value_tree(expr, fc->st, &v) == 0 &&
+			store_folded_value(expr, &v, fc->arena) == 0)
+			fc->folded++;
+		return;
+	}
+	case EXPR_ARRAY_INDEX:
+		fold_expression(expr->data.array_index.base, fc, 0);
+		fold_expression(expr->data.array_index.index, fc, 0);
+		return;
+	case EXPR_MAP_LOOKUP:
+		fold_expression(expr->data.map_lookup.map, fc, 0);
+		return;
+	case EXPR_STRUCT_ACCESS:
+		fold_expression(expr->data.struct_access.structure, fc, 0);
+		return;
+	default:
+		return;
+	}
+}
+
+static void fold_expression_visitor(ExpressionNode** expr, void* ctx) {
+	fold_expression(*expr, (FoldCtx*)ctx, 0);
+}
+
+/* Truth of a literal IF condition, with the runtime's bool/numeric rules.
+   Returns 0 when the condition is not a compile-time constant. */
+static int constant_condition_truth(const ExpressionNode* cond, int* truth) {
+	if (!cond) return 0;
+	switch (cond->type) {
+	case EXPR_LITERAL_INT:
+	case EXPR_LITERAL_BOOL:
+		*truth = ((int)cond->data.int_val != 0);
+		return 1;
+	case EXPR_LITERAL_DOUBLE:
+		*truth = (cond->data.double_val != 0.0);
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Drop the ASSIGN_#### / IF_#### registry entries of commands that were pruned */
+static void unregister_pruned_commands(CommandNode** cmds, size_t count, HashTable* areg, HashTable* ifreg) {
+	char key[32];
+	for (size_t i = 0; cmds && i < count; ++i) {
+		CommandNode* cmd = cmds[i];
+		if (!cmd || !cmd->data) continue;
+		CommandData* d = (CommandData*)cmd->data;
+
+		switch (cmd->type) {
+		case COMMAND_ASSIGNMENT:
+			if (areg && d->assignment.assign_id > 0) {
+				snprintf(key, sizeof(key), "ASSIGN_%04d", d->assignment.assign_id);
+				hash_table_remove(areg, key);
+			}
+			break;
+		case COMMAND_IF: {
+			IfNode* in = &d->ifcommand;
+			if (ifreg) {
+				snprintf(key, sizeof(key), "IF_%04d", in->id);
+				hash_table_remove(ifreg, key);
+			}
+			for (size_t b = 0; b < in->branch_count; ++b) {
+				if (in->branches[b])
+					unregister_pruned_commands(in->branches[b]->commands, in->branches[b]->command_count, areg, ifreg);
+			}
+			unregister_pruned_commands(in->else_commands, in->else_command_count, areg, ifreg);
+			break;
+		}
+		case COMMAND_FOR:
+			unregister_pruned_commands(d->forcommand.commands, d->forcommand.command_count, areg, ifreg);
+			break;
+		case COMMAND_WHILE:
+			unregister_pruned_commands(d->whilecommand.commands, d->whilecommand.command_count, areg, ifreg);
+			break;
+		case COMMAND_BEGIN_CATCH_ERROR:
+			unregister_pruned_commands(d->begin_catch_error.commands, d->begin_catch_error.command_count, areg, ifreg);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void set_map_int(HashTable* map, const char* key, int value) {
+	Variable* v = hash_table_lookup(map, key);
+	if (v && v->type == TYPE_INTEGER) {
+		v->data.int_value = value;
+		return;
+	}
+	hash_table_remove(map, key);
+	(void)add_int_to_map(map, key, value);
+}
+
+/* Bring IF_#### and the branch_index of its ASSIGN_#### entries (and of the
+   assignment nodes) in line with the branches that survived pruning (here or in
+   a nested IF) */
+static void reindex_if_registry(IfNode* node, HashTable* areg, HashTable* ifreg) {
+	size_t total = node->branch_count + (node->else_command_count > 0 ? 1 : 0);
+	tag_if_assignments(node);
+
+	Variable* branch_arr = NULL;
+	size_t total_assigns = 0;
+
+	char key[32];
+	snprintf(key, sizeof(key), "IF_%04d", node->id);
+	Variable* entry = ifreg ? hash_table_lookup(ifreg, key) : NULL;
+	if (entry && (entry->type != TYPE_MAP || !entry->data.map)) entry = NULL;
+	if (entry) {
+		branch_arr = (Variable*)malloc(sizeof(Variable));
+		if (branch_arr) {
+			branch_arr->type = TYPE_ARRAY;
+			branch_arr->display_options = NULL;
+			branch_arr->declaration_count = 1;
+			branch_arr->data.array.size = (int)total;
+			branch_arr->data.array.elements = (Variable**)calloc(total > 0 ? total : 1, sizeof(Variable*));
+			if (!branch_arr->data.array.elements) { free(branch_arr); branch_arr = NULL; }
+		}
+	}
+
+	for (size_t b = 0; b < total; ++b) {
+		int is_else = (b == node->branch_count);
+		CommandNode** cmds = is_else ? node->else_commands : node->branches[b]->commands;
+		size_t count = is_else ? node->else_command_count : node->branches[b]->command_count;
+
+		AssignmentList ids;
+		init_assignment_list(&ids);
+		for (size_t c = 0; c < count; ++c)
+			collect_assignment_ids_from_command(cmds[c], &ids);
+
+		for (size_t i = 0; areg && i < ids.count; ++i) {
+			char akey[32];
+			snprintf(akey, sizeof(akey), "ASSIGN_%04d", ids.ids[i]);
+			Variable* aentry = hash_table_lookup(areg, akey);
+			if (!aentry || aentry->type != TYPE_MAP || !aentry->data.map) continue;
+			Variable* owner = hash_table_lookup(aentry->data.map, "if_id");
+			if (owner && owner->type == TYPE_INTEGER && owner->data.int_value == node->id)
+				set_map_int(aentry->data.map, "branch_index", is_else ? -1 : (int)b);
+		}
+		if (branch_arr) {
+			branch_arr->data.array.elements[b] = assignment_list_to_array(&ids);
+			total_assigns += ids.count;
+		}
+		free_assignment_list(&ids);
+	}
+
+	if (!entry) return;
+	set_map_int(entry->data.map, "branch_count", (int)node->branch_count);
+	set_map_int(entry->data.map, "else_command_count", (int)node->else_command_count);
+
+	hash_table_remove(entry->data.map, "if_condition");
+	if (node->branch_count > 0 && node->branches[0]->condition) {
+		char* cond = expression_to_string(node->branches[0]->condition);
+		if (cond) (void)add_string_to_map(entry->data.map, "if_condition", cond);
+	}
+
+	if (branch_arr) {
+		hash_table_remove(entry->data.map, "branch_assignments");
+		(void)add_var_to_map(entry->data.map, "branch_assignments", branch_arr);
+		set_map_int(entry->data.map, "has_assignments", (int)(total_assigns > 0));
+	}
+}
+
+/* Drop branches whose literal condition is false, and everything after a branch
+   whose literal condition is true. The IF node itself stays so its gate id and
+   UI gating are unchanged. Returns the number of branches dropped. */
+static size_t prune_if_branches(IfNode* node, HashTable* areg, HashTable* ifreg) {
+	size_t kept = 0, dropped = 0;
+	int decided = 0;   /* an earlier branch always wins */
+	for (size_t b = 0; b < node->branch_count; ++b) {
+		IfBranch* br = node->branches[b];
+		int truth = 0;
+		int drop = decided || !br;
+		if (!drop && constant_condition_truth(br->condition, &truth)) {
+			if (truth) decided = 1;
+			else drop = 1;
+		}
+		if (drop) {
+			if (br) unregister_pruned_commands(br->commands, br->command_count, areg, ifreg);
+			dropped++;
+			continue;
+		}
+		node->branches[kept++] = br;
+	}
+	if (decided && node->else_command_count > 0) {
+		unregister_pruned_commands(node->else_commands, node->else_command_count, areg, ifreg);
+		node->else_commands = NULL;
+		node->else_command_count = 0;
+		dropped++;
+	}
+	node->branch_count = kept;
+
+	if (dropped > 0) {
+		LogOnlyPrintfChar("Note: IF %d: pruned %zu constant branch(es), %zu remain\n",
+			node->id, dropped, kept + (node->else_command_count > 0 ? 1 : 0));
+	}
+	return dropped;
+}
+
+/* Post-order, so an IF sees its nested IFs already pruned when it re-indexes.
+   Returns nonzero when anything in the list changed. */
+static int prune_command_list(CommandNode** cmds, size_t count, FoldCtx* fc, HashTable* areg, HashTable* ifreg) {
+	int changed = 0;
+	for (size_t i = 0; cmds && i < count; ++i) {
+		CommandNode* cmd = cmds[i];
+		if (!cmd || !cmd->data) continue;
+		CommandData* d = (CommandData*)cmd->data;
+
+		switch (cmd->type) {
+		case COMMAND_IF: {
+			IfNode* in = &d->ifcommand;
+			int nested = 0;
+			for (size_t b = 0; b < in->branch_count; ++b) {
+				if (in->branches[b])
+					nested |= prune_command_list(in->branches[b]->commands, in->branches[b]->command_count, fc, areg, ifreg);
+			}
+			nested |= prune_command_list(in->else_commands, in->else_command_count, fc, areg, ifreg);
+
+			/* Registries of an IF that failed analysis are incomplete; leave it alone */
+			size_t dropped = cmd->semantic_valid ? prune_if_branches(in, areg, ifreg) : 0;
+			if (dropped > 0 || (nested && cmd->semantic_valid))
+				reindex_if_registry(in, areg, ifreg);
+			fc->pruned += dropped;
+			changed |= (dropped > 0 || nested);
+			break;
+		}
+		case COMMAND_FOR:
+			changed |= prune_command_list(d->forcommand.commands, d->forcommand.command_count, fc, areg, ifreg);
+			break;
+		case COMMAND_WHILE:
+			changed |= prune_command_list(d->whilecommand.commands, d->whilecommand.command_count, fc, areg, ifreg);
+			break;
+		case COMMAND_BEGIN_CATCH_ERROR:
+			changed |= prune_command_list(d->begin_catch_error.commands, d->begin_catch_error.command_count, fc, areg, ifreg);
+			break;
+		default:
+			break;
+		}
+	}
+	return changed;
+}
+
+/* Fold literal-only subtrees and prune constant IF branches across all blocks.
+   Variable references are never folded: any symbol may be reassigned at runtime. */
+static void optimize_analyzed_ast(BlockList* block_list, SymbolTable* st) {
+	FoldCtx ctx = { block_list->arena, st, 0, 0 };
+	if (!ctx.arena) return;
+
+	HashTable* areg = NULL;
+	HashTable* ifreg = NULL;
+	Variable* v = get_symbol(st, "ASSIGNMENTS");
+	if (v && v->type == TYPE_MAP) areg = v->data.map;
+	v = get_symbol(st, "IFS");
+	if (v && v->type == TYPE_MAP) ifreg = v->data.map;
+
+	for (size_t b = 0; b < block_list->block_count; ++b) {
+		Block* block = &block_list->blocks[b];
+		for (size_t j = 0; j < block->command_count; ++j) {
+			walk_command_expressions(block->commands[j], fold_expression_visitor, &ctx);
+		}
+		(void)prune_command_list(block->commands, block->command_count, &ctx, areg, ifreg);
+	}
+	LogOnlyPrintfChar("Note: Folded %zu constant expression nodes; pruned %zu dead IF branch(es)\n",
+		ctx.folded, ctx.pruned);
+}
+
 int perform_semantic_analysis(BlockList* block_list, SymbolTable* st) {
 	if (!block_list) {
 		ProPrintfChar("Error: No block list provided for semantic analysis\n");
@@ -5085,16 +5758,20 @@ int perform_semantic_analysis(BlockList* block_list, SymbolTable* st) {
 		if (!block) continue;  // Skip if block type not present
 
 		for (size_t j = 0; j < block->command_count; j++) {
+			/* Bind ahead so S.M is a member access of the structures declared so far */
+			ResolveRefsCtx refs = { st, block_list->arena, 0, 0 };
+			walk_command_expressions(block->commands[j], resolve_refs_visitor, &refs);
 			int cmd_result = analyze_command(block->commands[j], st);
 			if (cmd_result != 0) {
 				ProPrintfChar("Semantic error in block type %d, command %zu\n", order[ord], j);
 			}
 		}
 	}
-	if (build_watcher_index(st) != 0) {
-		ProPrintfChar("Error: Failed to build watcher index\n");
-		return -1;
-	}
+	optimize_analyzed_ast(block_list, st);
+	resolve_variable_refs(block_list, st);
+	annotate_expression_types(block_list, st);
+	compile_expression_programs(block_list, st);
+	build_dependency_graph(block_list, st);
 	print_symbol_table(st);
 	return 0;  // Always return success to proceed; invalid commands are flagged
 }
@@ -4,6 +4,7 @@
 
 #include "utility.h"
 #include "syntaxanalysis.h"
+#include "bytecode.h"
 
 
 // New struct for per-branch assignment collection
@@ -13,14 +14,21 @@ typedef struct {
     size_t cap;     // Capacity of ids array
 } AssignmentList;
 
+/* Called once per root expression slot of a command (slot may be rewritten by the visitor) */
+typedef void (*ExpressionVisitor)(ExpressionNode** expr, void* ctx);
+
 int perform_semantic_analysis(BlockList* block_list, SymbolTable* st);
+void walk_command_expressions(CommandNode* cmd, ExpressionVisitor visit, void* ctx);
+Variable* lookup_variable_ref(ExpressionNode* expr, SymbolTable* st);
 int evaluate_expression(ExpressionNode* expr, SymbolTable* st, Variable** result);
 int evaluate_expression(ExpressionNode* expr, SymbolTable* st, Variable** result);
+int evaluate_value(ExpressionNode* expr, SymbolTable* st, EpaValue* out);
 int evaluate_to_string(ExpressionNode* expr, SymbolTable* st, char** result);
 int evaluate_to_int(ExpressionNode* expr, SymbolTable* st, long* result);
 int evaluate_to_double(ExpressionNode* expr, SymbolTable* st, double* result);
 VariableType map_variable_type(VariableType vtype, ParameterSubType pstype);
 void set_default_value(Variable* var);
+int init_structure_members(HashTable* fields, const DeclareVariableNode* node, SymbolTable* st);
 
 
 
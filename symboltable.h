@@ -7,6 +7,7 @@
 // Forward declaration of Variable to resolve circular dependency
 typedef struct Variable Variable;
 typedef struct ExpressionNode ExpressionNode;
+typedef struct TableStore TableStore;
 
 // Named struct for array data
 typedef struct {
@@ -14,21 +15,26 @@ typedef struct {
     size_t size;
 } ArrayData;
 
-// Hash table entry structure for key-value pairs
+// Hash table entry: entries live in a dense array in insertion order.
+// A removed entry keeps its slot with value == NULL until the table is compacted.
 typedef struct HashEntry {
-    char* key;           // String key
-    Variable* value;     // Pointer to Variable
-    struct HashEntry* next; // Next entry for collision handling
+    char* key;           // String key (owned; the only copy of the key)
+    Variable* value;     // Pointer to Variable (NULL = removed)
+    unsigned long hash;  // Cached hash of key (avoids rehashing on probe/grow)
+    unsigned int version;// Symbol table: bumped on every real value change of this slot
 } HashEntry;
 
-// Custom hash table structure
+// Custom hash table structure: insertion-ordered entries plus an open-addressed
+// (linear probing, power-of-two) index of entry positions, grown at 3/4 load
 typedef struct HashTable {
-    HashEntry** buckets; // Array of pointers to entries
-    size_t size;         // Number of buckets
-    size_t count;        // Number of stored entries
-    char** key_order;    // New: Array to track keys in insertion order
-    size_t key_count;    // New: Number of keys in key_order
-    size_t key_capacity; // New: Allocated size of key_order
+    HashEntry* entries;    // Entries in insertion order (including removed ones)
+    size_t entry_count;    // Entries in use, live or removed
+    size_t entry_capacity; // Allocated size of entries
+    size_t* index;         // Probe array: 0 = empty, otherwise entry position + 1
+    size_t size;           // Number of index slots (always a power of two)
+    size_t count;          // Number of live entries
+    int pinned;            // Non-zero: entry positions never move (removed keys are revived in place)
+    unsigned int refs;     // Variables sharing the table (copy-on-write, see variable_share)
 } HashTable;
 
 // Variable type enumeration
@@ -44,6 +50,7 @@ typedef enum {
     TYPE_SUBTABLE,
     TYPE_STRUCTURE,
     TYPE_EXPR,
+    TYPE_TABLE,
     TYPE_NULL,
     TYPE_UNKNOWN
 } VariableType;
@@ -65,17 +72,37 @@ typedef struct Variable {
         HashTable* map;         // For TYPE_MAP
         HashTable* structure;   // For TYPE_STRUCTURE
         ExpressionNode* expr;
+        TableStore* table;      // For TYPE_TABLE (column-wise table rows, see tablestore.h)
     } data;
     HashTable* display_options; // New: Optional display options map (NULL if none)
     int declaration_count;
 } Variable;
 
-// Symbol table structure
+// Set of symbol slots, one bit per slot. Storage grows with the symbol table,
+// so adding, testing and clearing never allocate once it covers every slot.
+typedef struct {
+    uint64_t* words;
+    size_t word_count;
+    size_t count;           // Slots currently in the set
+} SlotSet;
+
+// Versions of a fixed list of slots as one consumer last saw them, so it can
+// skip work when none of the symbols it reads has changed since
+typedef struct {
+    size_t* slots;
+    unsigned int* seen;     // seen[i]: version of slots[i] at the last slot_watch_record
+    size_t count;
+    size_t capacity;
+    int recorded;           // 0 until the first slot_watch_record: everything counts as changed
+} SlotWatch;
+
+// Symbol table structure (its HashTable is pinned so entry positions stay stable)
 typedef struct {
     HashTable* table;
-    char** key_order;      // Array to store keys in order
-    size_t key_count;      // Number of keys in key_order
-    size_t key_capacity;   // Allocated size of key_order
+    struct DepGraph* deps;  // Reactive dependency graph from semantic analysis (owned, may be NULL)
+    unsigned long long change_count;  // Value changes across all slots; never decreases
+    SlotSet dirty;          // Slots changed since the last reactive refresh (EPA_MarkDirty)
+    struct ExecState* exec; // Executor bookkeeping for runs over this table (owned)
 } SymbolTable;
 
 // Function prototypes for hash table operations
@@ -84,13 +111,52 @@ HashTable* create_hash_table(size_t initial_size);
 void hash_table_insert(HashTable* ht, const char* key, Variable* value);
 Variable* hash_table_lookup(HashTable* ht, const char* key);
 void hash_table_remove(HashTable* ht, const char* key);
+int hash_table_next(const HashTable* ht, size_t* iter, const char** key, Variable** value);
 void free_hash_table(HashTable* ht);
 void free_variable(Variable* var);
 
+// Copy-on-write aggregates. variable_share copies scalars and shares TYPE_ARRAY,
+// TYPE_MAP and TYPE_STRUCTURE payloads in O(1); free_variable releases a share.
+// TYPE_TABLE stores are read-only and shared the same way.
+// Code that changes an aggregate in place (append, insert, remove, compact) calls
+// variable_make_unique on it first, which copies the payload only while shared.
+Variable* variable_share(const Variable* src);
+int variable_share_into(Variable* dst, const Variable* src);
+int variable_is_shared(const Variable* var);
+int variable_make_unique(Variable* var);
+
 // Function prototypes for symbol table operations
 SymbolTable* create_symbol_table(void);
 void set_symbol(SymbolTable* st, const char* name, Variable* var);
 Variable* get_symbol(SymbolTable* st, const char* name);
+size_t reserve_symbol_slot(SymbolTable* st, const char* name);
+size_t find_symbol_slot(SymbolTable* st, const char* name);
+// Change detection: a slot's version and change_count move only when a symbol's
+// value really changes (set_symbol with a different value, remove_symbol, or
+// touch_symbol after an in-place edit). Code that edits a Variable in place must
+// call touch_symbol, and EPA_MarkDirty when a reactive refresh has to pick the
+// edit up; callers remember the versions of the slots they read (SlotWatch) to
+// skip redundant work.
+unsigned int symbol_version(SymbolTable* st, const char* name);
+unsigned int symbol_version_at(SymbolTable* st, size_t slot);
+void touch_symbol(SymbolTable* st, const char* name);
+int variable_values_equal(const Variable* a, const Variable* b);
+
+// Slot sets. slot_set_add returns 1 if the slot was not in the set yet.
+// Iterate in slot order: for (s = slot_set_next(set, 0); s; s = slot_set_next(set, s))
+int slot_set_add(SlotSet* set, size_t slot, size_t capacity_hint);
+int slot_set_contains(const SlotSet* set, size_t slot);
+size_t slot_set_next(const SlotSet* set, size_t after);
+void slot_set_clear(SlotSet* set);
+void slot_set_free(SlotSet* set);
+
+// Slot watches. Add each slot once (slot 0 is ignored); slot_watch_changed
+// is 1 when a watched slot's version moved since slot_watch_record (or it never ran).
+int slot_watch_add(SlotWatch* w, size_t slot);
+int slot_watch_changed(SymbolTable* st, const SlotWatch* w);
+void slot_watch_record(SymbolTable* st, SlotWatch* w);
+void slot_watch_free(SlotWatch* w);
+Variable* get_symbol_at(SymbolTable* st, size_t slot);
 void remove_symbol(SymbolTable* st, const char* name);
 void free_symbol_table(SymbolTable* st);
 void print_symbol_table(const SymbolTable* st);
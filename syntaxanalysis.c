@@ -4,6 +4,8 @@
 #include "utility.h"
 #include "LexicalAnalysis.h"
 #include "syntaxanalysis.h"
+#include "builtins.h"
+#include "numfmt.h"
 
 static int s_if_id_counter = 0;
 static int s_assign_id_counter = 0; /* new: monotonically increasing assignment ids */
@@ -13,27 +15,22 @@ static int s_table_id_counter = 0;
 void free_command_node(CommandNode* node);
 void free_expression(ExpressionNode* expr);
 ExpressionNode* parse_expression(Lexer* lexer, size_t* i, SymbolTable* st);
+int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data);
 
-char* tokens_to_string(TokenData* tokens, size_t count) {
-    size_t len = 0;
+char* tokens_to_string(const Lexer* lexer, const TokenData* tokens, size_t count) {
+    size_t len = 1;
     for (size_t i = 0; i < count; i++) {
-        len += strlen(tokens[i].val) + 1; // +1 for space or null terminator
+        len += tokens[i].length + 1; // +1 for space or null terminator
     }
     char* str = malloc(len);
     if (!str) return NULL;
-    str[0] = '\0'; // Initialize as empty string
+    size_t pos = 0;
     for (size_t i = 0; i < count; i++) {
-        if (strcat_s(str, len, tokens[i].val) != 0) {
-            free(str);
-            return NULL; // Error handling
-        }
-        if (i < count - 1) {
-            if (strcat_s(str, len, " ") != 0) {
-                free(str);
-                return NULL; // Error handling
-            }
-        }
+        memcpy(str + pos, token_text(lexer, &tokens[i]), tokens[i].length);
+        pos += tokens[i].length;
+        if (i < count - 1) str[pos++] = ' ';
     }
+    str[pos] = '\0';
     return str;
 }
 
@@ -117,7 +114,7 @@ char* expression_to_string(ExpressionNode* expr) {
         snprintf(buf, sizeof(buf), "%ld", expr->data.int_val);
         return _strdup(buf);
     case EXPR_LITERAL_DOUBLE:
-        snprintf(buf, sizeof(buf), "%.4f", expr->data.double_val);
+        epa_format_double_fixed(expr->data.double_val, 4, buf, sizeof(buf));
         return _strdup(buf);
     case EXPR_LITERAL_STRING:
         snprintf(buf, sizeof(buf), "\"%s\"", expr->data.string_val);
@@ -165,18 +162,95 @@ char* expression_to_string(ExpressionNode* expr) {
         return _strdup(buf);
     }
     case EXPR_FUNCTION_CALL: {
-        // Basic: function name + arg count; extend for full args
-        char func_name[32];
-        snprintf(func_name, sizeof(func_name), "func(%zu args)", expr->data.func_call.arg_count);
-        return _strdup(func_name);
+        FunctionType func = expr->data.func_call.func;
+        const char* name = ((unsigned)func < FUNC_COUNT) ? g_builtins[func].name : "func";
+        int len = snprintf(buf, sizeof(buf), "%s(", name);
+        for (size_t a = 0; a < expr->data.func_call.arg_count && len < (int)sizeof(buf); ++a) {
+            char* arg_str = expression_to_string(expr->data.func_call.args[a]);
+            len += snprintf(buf + len, sizeof(buf) - len, "%s%s", a ? ", " : "", arg_str ? arg_str : "?");
+            free(arg_str);
+        }
+        if (len < (int)sizeof(buf)) snprintf(buf + len, sizeof(buf) - len, ")");
+        return _strdup(buf);
+    }
+    case EXPR_CONCAT: {
+        int len = 0;
+        buf[0] = '\0';
+        for (size_t k = 0; k < expr->data.concat.part_count && len < (int)sizeof(buf); ++k) {
+            char* part_str = expression_to_string(expr->data.concat.parts[k]);
+            len += snprintf(buf + len, sizeof(buf) - len, "%s%s", k ? " + " : "", part_str ? part_str : "?");
+            free(part_str);
+        }
+        return _strdup(buf);
+    }
+    case EXPR_ARRAY_INDEX: {
+        char* base_str = expression_to_string(expr->data.array_index.base);
+        char* index_str = expression_to_string(expr->data.array_index.index);
+        snprintf(buf, sizeof(buf), "%s[%s]", base_str ? base_str : "?", index_str ? index_str : "?");
+        free(base_str);
+        free(index_str);
+        return _strdup(buf);
+    }
+    case EXPR_MAP_LOOKUP: {
+        char* map_str = expression_to_string(expr->data.map_lookup.map);
+        snprintf(buf, sizeof(buf), "%s:%s", map_str ? map_str : "?", expr->data.map_lookup.key ? expr->data.map_lookup.key : "?");
+        free(map_str);
+        return _strdup(buf);
+    }
+    case EXPR_STRUCT_ACCESS: {
+        char* struct_str = expression_to_string(expr->data.struct_access.structure);
+        snprintf(buf, sizeof(buf), "%s.%s", struct_str ? struct_str : "?", expr->data.struct_access.member ? expr->data.struct_access.member : "?");
+        free(struct_str);
+        return _strdup(buf);
     }
-                           // Add cases for EXPR_ARRAY_INDEX, EXPR_MAP_LOOKUP, EXPR_STRUCT_ACCESS (e.g., "base[index]")
     default:
         return _strdup("unsupported_expr");
     }
 }
 
 // Static helper: Advance token index and return current token
+/*
+ * AST allocation. While parse_blocks runs, every node, array and string of the
+ * script comes from one bump arena (s_ast_arena) that free_block_list releases in
+ * a single call. ast_free only releases heap blocks (e.g. expression_to_string
+ * results); arena memory is left for the arena.
+ */
+static Arena* s_ast_arena = NULL;
+
+static void* ast_malloc(size_t size) {
+    return s_ast_arena ? arena_alloc(s_ast_arena, size) : malloc(size);
+}
+
+static void* ast_calloc(size_t count, size_t size) {
+    return s_ast_arena ? arena_alloc(s_ast_arena, count * size) : calloc(count, size);
+}
+
+static void* ast_realloc(void* ptr, size_t size) {
+    if (s_ast_arena && (!ptr || arena_owns(s_ast_arena, ptr))) return arena_realloc(s_ast_arena, ptr, size);
+    return realloc(ptr, size);
+}
+
+static char* ast_strdup(const char* s) {
+    return s_ast_arena ? arena_strdup(s_ast_arena, s) : _strdup(s);
+}
+
+/* NUL-terminated copy of a token's text (tokens are slices of the source) */
+static char* ast_token_strdup(const Lexer* lexer, const TokenData* tok) {
+    const char* text = token_text(lexer, tok);
+    if (s_ast_arena) return arena_strndup(s_ast_arena, text, tok->length);
+    char* d = (char*)malloc((size_t)tok->length + 1);
+    if (d) {
+        memcpy(d, text, tok->length);
+        d[tok->length] = '\0';
+    }
+    return d;
+}
+
+static void ast_free(void* ptr) {
+    if (!ptr || (s_ast_arena && arena_owns(s_ast_arena, ptr))) return;
+    free(ptr);
+}
+
 static TokenData* current_token(Lexer* lexer, size_t* i) {
     if (*i >= lexer->token_count) return NULL;
     return &lexer->tokens[*i];
@@ -213,44 +287,43 @@ static BinaryOpType token_to_binary_op(Token tok_type) {
 
 // Helper: Map string to FunctionType (for built-in functions)
 static FunctionType string_to_function(const char* name) {
-    if (strcmp(name, "sin") == 0) return FUNC_SIN;
-    if (strcmp(name, "asin") == 0) return FUNC_ASIN;
-    if (strcmp(name, "cos") == 0) return FUNC_COS;
-    if (strcmp(name, "acos") == 0) return FUNC_ACOS;
-    if (strcmp(name, "tan") == 0) return FUNC_TAN;
-    if (strcmp(name, "atan") == 0) return FUNC_ATAN;
-    if (strcmp(name, "sinh") == 0) return FUNC_SINH;
-    if (strcmp(name, "cosh") == 0) return FUNC_COSH;
-    if (strcmp(name, "tanh") == 0) return FUNC_TANH;
-    if (strcmp(name, "log") == 0) return FUNC_LOG;
-    if (strcmp(name, "ln") == 0) return FUNC_LN;
-    if (strcmp(name, "exp") == 0) return FUNC_EXP;
-    if (strcmp(name, "ceil") == 0) return FUNC_CEIL;
-    if (strcmp(name, "floor") == 0) return FUNC_FLOOR;
-    if (strcmp(name, "abs") == 0) return FUNC_ABS;
-    if (strcmp(name, "sqrt") == 0) return FUNC_SQRT;
-    if (strcmp(name, "sqr") == 0) return FUNC_SQR;
-    if (strcmp(name, "pow") == 0) return FUNC_POW;
-    if (strcmp(name, "mod") == 0) return FUNC_MOD;
-    if (strcmp(name, "round") == 0) return FUNC_ROUND;
-    if (strcmp(name, "strfind") == 0) return FUNC_STRFIND;
-    if (strcmp(name, "strfindcs") == 0) return FUNC_STRFINDCS;
-    if (strcmp(name, "strlen") == 0) return FUNC_STRLEN;
-    if (strcmp(name, "strcmp") == 0) return FUNC_STRCMP;
-    if (strcmp(name, "strcmpcs") == 0) return FUNC_STRCMPCS;
-    if (strcmp(name, "stof") == 0) return FUNC_STOF;
-    if (strcmp(name, "stoi") == 0) return FUNC_STOI;
-    if (strcmp(name, "stob") == 0) return FUNC_STOB;
-    if (strcmp(name, "asc") == 0) return FUNC_ASC;
-    if (strcmp(name, "isnumber") == 0) return FUNC_ISNUMBER;
-    if (strcmp(name, "isinteger") == 0) return FUNC_ISINTEGER;
-    if (strcmp(name, "isdouble") == 0) return FUNC_ISDOUBLE;
-    if (strcmp(name, "equal") == 0) return FUNC_EQUAL;
-    if (strcmp(name, "less") == 0) return FUNC_LESS;
-    if (strcmp(name, "lessorequal") == 0) return FUNC_LESSOREQUAL;
-    if (strcmp(name, "greater") == 0) return FUNC_GREATER;
-    if (strcmp(name, "greaterorequal") == 0) return FUNC_GREATEROREQUAL;
-    return -1;  // Unknown function
+    return builtin_lookup(name);  // -1 for unknown names
+}
+
+// Helper: Parse a builtin call "name(arg, ...)"; *i is on the name, followed by '('
+static ExpressionNode* parse_function_call(Lexer* lexer, size_t* i, SymbolTable* st, FunctionType func) {
+    TokenData* name_tok = current_token(lexer, i);
+    (*i) += 2;  /* name and '(' */
+
+    ExpressionNode* args[BUILTIN_MAX_ARGS];
+    size_t arg_count = 0;
+    if (!consume(lexer, i, tok_rparen)) {
+        for (;;) {
+            if (arg_count == BUILTIN_MAX_ARGS) {
+                ProPrintfChar("Error: Too many arguments to '%s' at line %zu\n", g_builtins[func].name, (size_t)name_tok->line);
+                return NULL;
+            }
+            ExpressionNode* arg = parse_expression(lexer, i, st);
+            if (!arg) return NULL;
+            args[arg_count++] = arg;
+            if (consume(lexer, i, tok_comma)) continue;
+            if (consume(lexer, i, tok_rparen)) break;
+            ProPrintfChar("Error: Expected ',' or ')' in call to '%s' at line %zu\n", g_builtins[func].name, (size_t)name_tok->line);
+            return NULL;
+        }
+    }
+
+    ExpressionNode* call = ast_calloc(1, sizeof(ExpressionNode));
+    if (!call) return NULL;
+    call->type = EXPR_FUNCTION_CALL;
+    call->data.func_call.func = func;
+    call->data.func_call.arg_count = arg_count;
+    if (arg_count > 0) {
+        call->data.func_call.args = ast_calloc(arg_count, sizeof(ExpressionNode*));
+        if (!call->data.func_call.args) { ast_free(call); return NULL; }
+        memcpy(call->data.func_call.args, args, arg_count * sizeof(ExpressionNode*));
+    }
+    return call;
 }
 
 // Helper: Get precedence for binary operators (higher number = higher precedence)
@@ -272,33 +345,120 @@ int get_operator_precedence(BinaryOpType op) {
     }
 }
 
+// Helper: Parse accessors that follow a primary, left to right: base[index], struct.member, map:key
+static ExpressionNode* parse_postfix(Lexer* lexer, size_t* i, SymbolTable* st, ExpressionNode* left) {
+    TokenData* tok;
+    while (left && (tok = current_token(lexer, i)) != NULL) {
+        if (tok->type == tok_lbracket) {  /* base[index] */
+            (*i)++;
+            ExpressionNode* index = parse_expression(lexer, i, st);
+            if (!index || !consume(lexer, i, tok_rbracket)) {
+                ProPrintfChar("Error: Invalid array index\n");
+                free_expression(left);
+                free_expression(index);
+                return NULL;
+            }
+            ExpressionNode* access = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
+            if (!access) {
+                ProPrintfChar("Memory allocation failed for ExpressionNode (array index)\n");
+                free_expression(left);
+                free_expression(index);
+                return NULL;
+            }
+            access->type = EXPR_ARRAY_INDEX;
+            access->data.array_index.base = left;
+            access->data.array_index.index = index;
+            left = access;
+        }
+        else if (tok->type == tok_dot) {   /* struct.member */
+            (*i)++;
+            tok = current_token(lexer, i);
+            if (!tok || tok->type != tok_identifier) {
+                ProPrintfChar("Error: Expected member name after .\n");
+                free_expression(left);
+                return NULL;
+            }
+            ExpressionNode* access = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
+            if (!access) {
+                ProPrintfChar("Memory allocation failed for ExpressionNode (struct access)\n");
+                free_expression(left);
+                return NULL;
+            }
+            access->type = EXPR_STRUCT_ACCESS;
+            access->data.struct_access.structure = left;
+            access->data.struct_access.member = ast_token_strdup(lexer, tok);
+            (*i)++;
+            left = access;
+        }
+        else if (tok->type == tok_colon) { /* map:key */
+            (*i)++;
+            tok = current_token(lexer, i);
+            if (!tok || (tok->type != tok_identifier && tok->type != tok_string)) {
+                ProPrintfChar("Error: Expected key after :\n");
+                free_expression(left);
+                return NULL;
+            }
+            ExpressionNode* access = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
+            if (!access) {
+                ProPrintfChar("Memory allocation failed for ExpressionNode (map lookup)\n");
+                free_expression(left);
+                return NULL;
+            }
+            access->type = EXPR_MAP_LOOKUP;
+            access->data.map_lookup.map = left;
+            access->data.map_lookup.key = ast_token_strdup(lexer, tok);
+            (*i)++;
+            left = access;
+        }
+        else {
+            break;
+        }
+    }
+    return left;
+}
+
 // Helper: Parse primary expressions (literals, variables, constants, parentheses, functions)
 static ExpressionNode* parse_primary(Lexer* lexer, size_t* i, SymbolTable* st) {
     TokenData* tok = current_token(lexer, i);
     if (!tok) return NULL;
 
-    ExpressionNode* expr = malloc(sizeof(ExpressionNode));
+    ExpressionNode* expr = ast_calloc(1, sizeof(ExpressionNode));
     if (!expr) {
         ProPrintfChar("Error: Memory allocation failed for expression node\n");
         return NULL;
     }
 
     if (tok->type == tok_number) {  /* numbers */
-        if (strchr(tok->val, '.')) {
+        char num[64];
+        token_cstr(lexer, tok, num, sizeof(num));
+        if (strchr(num, '.')) {
             expr->type = EXPR_LITERAL_DOUBLE;
-            expr->data.double_val = atof(tok->val);
+            expr->data.double_val = epa_strtod(num, NULL);
         }
         else {
             expr->type = EXPR_LITERAL_INT;
-            expr->data.int_val = atol(tok->val);
+            expr->data.int_val = epa_strtol(num, NULL);
         }
         (*i)++;
     }
     else if (tok->type == tok_identifier) {
+        /* Builtin function call: name immediately followed by '(' */
+        if (*i + 1 < lexer->token_count && lexer->tokens[*i + 1].type == tok_lparen) {
+            char name[32];
+            token_cstr(lexer, tok, name, sizeof(name));
+            FunctionType func = string_to_function(name);
+            if ((int)func >= 0) {
+                ast_free(expr);
+                return parse_postfix(lexer, i, st, parse_function_call(lexer, i, st, func));
+            }
+        }
+
         /* Split patterns like ELEVY-10 that were lexed as a single identifier.
            Do NOT split filenames (they contain a '.') */
-        const char* s = tok->val;
-        if (strchr(s, '-') && !strchr(s, '.')) {
+        const char* text = token_text(lexer, tok);
+        if (memchr(text, '-', tok->length) && !memchr(text, '.', tok->length)) {
+            char s[256];
+            token_cstr(lexer, tok, s, sizeof(s));
             const char* dash = strchr(s, '-');
             if (dash > s && dash[1] != '\0') {
                 /* left and right slices */
@@ -307,47 +467,47 @@ static ExpressionNode* parse_primary(Lexer* lexer, size_t* i, SymbolTable* st) {
                 if (left_len >= sizeof(left)) left_len = sizeof(left) - 1;
 
                 if (strncpy_s(left, sizeof(left), s, left_len) != 0) {
-                    free(expr);
+                    ast_free(expr);
                     ProPrintfChar("Error: Failed copying left slice in parse_primary\n");
                     return NULL;
                 }
                 if (strncpy_s(right, sizeof(right), dash + 1, _TRUNCATE) != 0) {
-                    free(expr);
+                    ast_free(expr);
                     ProPrintfChar("Error: Failed copying right slice in parse_primary\n");
                     return NULL;
                 }
 
                 /* build left expr (identifier or number) */
-                ExpressionNode* L = (ExpressionNode*)malloc(sizeof(ExpressionNode));
-                if (!L) { free(expr); return NULL; }
+                ExpressionNode* L = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
+                if (!L) { ast_free(expr); return NULL; }
                 if (strspn(left, "0123456789.") == strlen(left)) {
                     L->type = (strchr(left, '.') ? EXPR_LITERAL_DOUBLE : EXPR_LITERAL_INT);
-                    if (L->type == EXPR_LITERAL_DOUBLE) L->data.double_val = atof(left);
-                    else L->data.int_val = atol(left);
+                    if (L->type == EXPR_LITERAL_DOUBLE) L->data.double_val = epa_strtod(left, NULL);
+                    else L->data.int_val = epa_strtol(left, NULL);
                 }
                 else {
                     L->type = EXPR_VARIABLE_REF;
-                    L->data.string_val = _strdup(left);
-                    if (!L->data.string_val) { free(L); free(expr); return NULL; }
+                    L->data.string_val = ast_strdup(left);
+                    if (!L->data.string_val) { ast_free(L); ast_free(expr); return NULL; }
                 }
 
                 /* build right expr (identifier or number) */
-                ExpressionNode* R = (ExpressionNode*)malloc(sizeof(ExpressionNode));
-                if (!R) { free_expression(L); free(expr); return NULL; }
+                ExpressionNode* R = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
+                if (!R) { free_expression(L); ast_free(expr); return NULL; }
                 if (strspn(right, "0123456789.") == strlen(right)) {
                     R->type = (strchr(right, '.') ? EXPR_LITERAL_DOUBLE : EXPR_LITERAL_INT);
-                    if (R->type == EXPR_LITERAL_DOUBLE) R->data.double_val = atof(right);
-                    else R->data.int_val = atol(right);
+                    if (R->type == EXPR_LITERAL_DOUBLE) R->data.double_val = epa_strtod(right, NULL);
+                    else R->data.int_val = epa_strtol(right, NULL);
                 }
                 else {
                     R->type = EXPR_VARIABLE_REF;
-                    R->data.string_val = _strdup(right);
-                    if (!R->data.string_val) { free_expression(L); free(R); free(expr); return NULL; }
+                    R->data.string_val = ast_strdup(right);
+                    if (!R->data.string_val) { free_expression(L); ast_free(R); ast_free(expr); return NULL; }
                 }
 
                 /* build binary SUB node */
-                ExpressionNode* B = (ExpressionNode*)malloc(sizeof(ExpressionNode));
-                if (!B) { free_expression(L); free_expression(R); free(expr); return NULL; }
+                ExpressionNode* B = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
+                if (!B) { free_expression(L); free_expression(R); ast_free(expr); return NULL; }
                 B->type = EXPR_BINARY_OP;
                 B->data.binary.op = BINOP_SUB;
                 B->data.binary.left = L;
@@ -356,16 +516,16 @@ static ExpressionNode* parse_primary(Lexer* lexer, size_t* i, SymbolTable* st) {
                 (*i)++; /* we consumed this identifier token */
 
                 /* optional: avoid leaking the prealloc'd expr */
-                free(expr);
+                ast_free(expr);
                 return B;
             }
         }
 
         /* existing behavior */
         expr->type = EXPR_VARIABLE_REF;
-        expr->data.string_val = _strdup(tok->val);
+        expr->data.string_val = ast_token_strdup(lexer, tok);
         if (!expr->data.string_val) {
-            free(expr);
+            ast_free(expr);
             ProPrintfChar("Error: Memory allocation failed for variable reference\n");
             return NULL;
         }
@@ -376,7 +536,7 @@ static ExpressionNode* parse_primary(Lexer* lexer, size_t* i, SymbolTable* st) {
         expr = parse_expression(lexer, i, st);
         if (!expr || !consume(lexer, i, tok_rparen)) {
             free_expression(expr);
-            ProPrintfChar("Error: Mismatched parentheses at line %zu\n", tok->loc.line);
+            ProPrintfChar("Error: Mismatched parentheses at line %zu\n", (size_t)tok->line);
             return NULL;
         }
     }
@@ -385,27 +545,27 @@ static ExpressionNode* parse_primary(Lexer* lexer, size_t* i, SymbolTable* st) {
         expr->type = EXPR_UNARY_OP;
         expr->data.unary.op = UNOP_NEG;
         expr->data.unary.operand = parse_primary(lexer, i, st);
-        if (!expr->data.unary.operand) { free(expr); return NULL; }
+        if (!expr->data.unary.operand) { ast_free(expr); return NULL; }
     }
     else if (tok->type == tok_type || tok->type == tok_option || tok->type == tok_string) {
         expr->type = EXPR_LITERAL_STRING;
-        expr->data.string_val = _strdup(tok->val);
-        if (!expr->data.string_val) { free(expr); ProPrintfChar("Error: Memory allocation failed for string literal at line %zu\n", tok->loc.line); return NULL; }
+        expr->data.string_val = ast_token_strdup(lexer, tok);
+        if (!expr->data.string_val) { ast_free(expr); ProPrintfChar("Error: Memory allocation failed for string literal at line %zu\n", (size_t)tok->line); return NULL; }
         (*i)++;
     }
-    else if (tok->type == tok_keyword && strcmp(tok->val, "NO_VALUE") == 0) {
+    else if (tok->word == WORD_NO_VALUE) {
         expr->type = EXPR_LITERAL_STRING;
-        expr->data.string_val = _strdup("");
-        if (!expr->data.string_val) { free(expr); ProPrintfChar("Error: Memory allocation failed for NO_VALUE at line %zu\n", tok->loc.line); return NULL; }
+        expr->data.string_val = ast_strdup("");
+        if (!expr->data.string_val) { ast_free(expr); ProPrintfChar("Error: Memory allocation failed for NO_VALUE at line %zu\n", (size_t)tok->line); return NULL; }
         (*i)++;
     }
     else {
-        free(expr);
-        ProPrintfChar("Error: Unsupported primary expression token %d at line %zu\n", tok->type, tok->loc.line);
+        ast_free(expr);
+        ProPrintfChar("Error: Unsupported primary expression token %d at line %zu\n", tok->type, (size_t)tok->line);
         return NULL;
     }
 
-    return expr;
+    return parse_postfix(lexer, i, st, expr);
 }
 
 // Helper: Parse unary expressions (e.g., -expr)
@@ -415,7 +575,7 @@ static ExpressionNode* parse_unary(Lexer* lexer, size_t* i, SymbolTable* st) {
         (*i)++;  // Consume -
         ExpressionNode* operand = parse_primary(lexer, i, st);
         if (!operand) return NULL;
-        ExpressionNode* unary = malloc(sizeof(ExpressionNode));
+        ExpressionNode* unary = ast_calloc(1, sizeof(ExpressionNode));
         if (!unary) {
             free_expression(operand);
             return NULL;
@@ -443,7 +603,7 @@ static ExpressionNode* parse_factor(Lexer* lexer, size_t* i, SymbolTable* st) {
             free_expression(left);
             return NULL;
         }
-        ExpressionNode* binop = malloc(sizeof(ExpressionNode));
+        ExpressionNode* binop = ast_calloc(1, sizeof(ExpressionNode));
         if (!binop) {
             free_expression(left);
             free_expression(right);
@@ -473,7 +633,7 @@ static ExpressionNode* parse_term(Lexer* lexer, size_t* i, SymbolTable* st) {
             free_expression(left);
             return NULL;
         }
-        ExpressionNode* binop = malloc(sizeof(ExpressionNode));
+        ExpressionNode* binop = ast_calloc(1, sizeof(ExpressionNode));
         if (!binop) {
             free_expression(left);
             free_expression(right);
@@ -507,7 +667,7 @@ ExpressionNode* parse_comparison(Lexer* lexer, size_t* i, SymbolTable* st)
             return NULL;
         }
 
-        ExpressionNode* binop = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* binop = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!binop) {
             free_expression(left);
             free_expression(right);
@@ -543,7 +703,7 @@ ExpressionNode* parse_expression(Lexer* lexer, size_t* i, SymbolTable* st)
             return NULL;
         }
 
-        ExpressionNode* binop = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* binop = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!binop) {
             free_expression(left);
             free_expression(right);
@@ -556,72 +716,6 @@ ExpressionNode* parse_expression(Lexer* lexer, size_t* i, SymbolTable* st)
         left = binop;
     }
 
-    /* keep your existing post-processing for accesses */
-    TokenData* tok = current_token(lexer, i);
-    if (tok) {
-        if (tok->type == tok_lbracket) {  /* base[index] */
-            (*i)++;
-            ExpressionNode* index = parse_expression(lexer, i, st);
-            if (!index || !consume(lexer, i, tok_rbracket)) {
-                ProPrintfChar("Error: Invalid array index\n");
-                free_expression(left);
-                free_expression(index);
-                return NULL;
-            }
-            ExpressionNode* access = (ExpressionNode*)malloc(sizeof(ExpressionNode));
-            if (!access) {
-                ProPrintfChar("Memory allocation failed for ExpressionNode (array index)\n");
-                free_expression(left);
-                free_expression(index);
-                return NULL;
-            }
-            access->type = EXPR_ARRAY_INDEX;
-            access->data.array_index.base = left;
-            access->data.array_index.index = index;
-            left = access;
-        }
-        else if (tok->type == tok_dot) {   /* struct.member */
-            (*i)++;
-            tok = current_token(lexer, i);
-            if (!tok || tok->type != tok_identifier) {
-                ProPrintfChar("Error: Expected member name after .\n");
-                free_expression(left);
-                return NULL;
-            }
-            ExpressionNode* access = (ExpressionNode*)malloc(sizeof(ExpressionNode));
-            if (!access) {
-                ProPrintfChar("Memory allocation failed for ExpressionNode (struct access)\n");
-                free_expression(left);
-                return NULL;
-            }
-            access->type = EXPR_STRUCT_ACCESS;
-            access->data.struct_access.structure = left;
-            access->data.struct_access.member = _strdup(tok->val);
-            (*i)++;
-            left = access;
-        }
-        else if (tok->type == tok_colon) { /* map:key */
-            (*i)++;
-            tok = current_token(lexer, i);
-            if (!tok || (tok->type != tok_identifier && tok->type != tok_string)) {
-                ProPrintfChar("Error: Expected key after :\n");
-                free_expression(left);
-                return NULL;
-            }
-            ExpressionNode* access = (ExpressionNode*)malloc(sizeof(ExpressionNode));
-            if (!access) {
-                ProPrintfChar("Memory allocation failed for ExpressionNode (map lookup)\n");
-                free_expression(left);
-                return NULL;
-            }
-            access->type = EXPR_MAP_LOOKUP;
-            access->data.map_lookup.map = left;
-            access->data.map_lookup.key = _strdup(tok->val);
-            (*i)++;
-            left = access;
-        }
-    }
-
     return left;
 }
 
@@ -631,12 +725,13 @@ int parse_bool_literal(Lexer* lexer, size_t* i, int* out) {
     if (!t) return -1;
 
     if (t->type == tok_identifier) {
-        if (strcmp(t->val, "TRUE") == 0) { *out = 1; (*i)++; return 0; }
-        if (strcmp(t->val, "FALSE") == 0) { *out = 0; (*i)++; return 0; }
+        if (token_is(lexer, t, "TRUE")) { *out = 1; (*i)++; return 0; }
+        if (token_is(lexer, t, "FALSE")) { *out = 0; (*i)++; return 0; }
     }
     if (t->type == tok_number) {
         // Treat any nonzero number as true
-        long v = strtol(t->val, NULL, 10);
+        char num[64];
+        long v = epa_strtol(token_cstr(lexer, t, num, sizeof(num)), NULL);
         *out = (v != 0);
         (*i)++;
         return 0;
@@ -649,7 +744,7 @@ int add_expr(ExpressionNode*** arr, size_t* count, size_t* cap, ExpressionNode*
     if (!e) return -1;
     if (*count >= *cap) {
         size_t ncap = (*cap ? *cap * 2 : 4);
-        ExpressionNode** tmp = (ExpressionNode**)realloc(*arr, ncap * sizeof(*tmp));
+        ExpressionNode** tmp = (ExpressionNode**)ast_realloc(*arr, ncap * sizeof(*tmp));
         if (!tmp) return -1;
         *arr = tmp;
         *cap = ncap;
@@ -669,7 +764,7 @@ void free_declare_variable_node(DeclareVariableNode* node) {
     if (!node) return;
 
     // Free common fields
-    free(node->name);
+    ast_free(node->name);
     node->name = NULL;
 
     // Type-specific deallocation using union fields
@@ -680,16 +775,16 @@ void free_declare_variable_node(DeclareVariableNode* node) {
         break;
 
     case VAR_REFERENCE:
-        free(node->data.reference.entity_type);
+        ast_free(node->data.reference.entity_type);
         node->data.reference.entity_type = NULL;
         free_expression(node->data.reference.default_ref);
         node->data.reference.default_ref = NULL;
         break;
 
     case VAR_FILE_DESCRIPTOR:
-        free(node->data.file_desc.mode);
+        ast_free(node->data.file_desc.mode);
         node->data.file_desc.mode = NULL;
-        free(node->data.file_desc.path);
+        ast_free(node->data.file_desc.path);
         node->data.file_desc.path = NULL;
         break;
 
@@ -698,7 +793,7 @@ void free_declare_variable_node(DeclareVariableNode* node) {
         for (size_t idx = 0; idx < node->data.array.init_count; ++idx) {
             free_expression(node->data.array.initializers[idx]);
         }
-        free(node->data.array.initializers);
+        ast_free(node->data.array.initializers);
         node->data.array.initializers = NULL;
         node->data.array.init_count = 0;
         // Note: element_type is a scalar; no free needed
@@ -707,10 +802,10 @@ void free_declare_variable_node(DeclareVariableNode* node) {
     case VAR_MAP:
         // Free pairs array
         for (size_t idx = 0; idx < node->data.map.pair_count; ++idx) {
-            free(node->data.map.pairs[idx].key);
+            ast_free(node->data.map.pairs[idx].key);
             free_expression(node->data.map.pairs[idx].value);
         }
-        free(node->data.map.pairs);
+        ast_free(node->data.map.pairs);
         node->data.map.pairs = NULL;
         node->data.map.pair_count = 0;
         break;
@@ -724,7 +819,7 @@ void free_declare_variable_node(DeclareVariableNode* node) {
             inner_node.data = node->data.general.inner_data->data;  // Access wrapped union
             inner_node.name = NULL;  // Inner has no name
             free_declare_variable_node(&inner_node);
-            free(node->data.general.inner_data);
+            ast_free(node->data.general.inner_data);
             node->data.general.inner_data = NULL;
         }
         break;
@@ -732,11 +827,11 @@ void free_declare_variable_node(DeclareVariableNode* node) {
     case VAR_STRUCTURE:
         // Free members array
         for (size_t idx = 0; idx < node->data.structure.member_count; ++idx) {
-            free(node->data.structure.members[idx].member_name);
+            ast_free(node->data.structure.members[idx].member_name);
             free_expression(node->data.structure.members[idx].default_expr);
             // member_type is a scalar; no free needed
         }
-        free(node->data.structure.members);
+        ast_free(node->data.structure.members);
         node->data.structure.members = NULL;
         node->data.structure.member_count = 0;
         break;
@@ -750,7 +845,9 @@ void free_declare_variable_node(DeclareVariableNode* node) {
     memset(&node->data, 0, sizeof(VariableData));
 }
 
-int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
+// Type, name and default of a declaration; a STRUCTURE member ("DIAM: DOUBLE 12.5")
+// is a declaration without the name (named == 0)
+static int parse_variable_decl(Lexer* lexer, size_t* i, CommandData* parsed_data, int named) {
     DeclareVariableNode* node = &parsed_data->declare_variable;
 
     node->name = NULL;
@@ -767,11 +864,12 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    type_str = _strdup(tok->val);
+    type_str = ast_token_strdup(lexer, tok);
     (*i)++;
 
-    // Handle simple parameter types directly (e.g., STRING, INTEGER, DOUBLE)
-    if (tok->type == tok_type) {
+    // Handle simple parameter types directly (e.g., STRING, INTEGER, DOUBLE);
+    // STRUCTURE is a type word too but takes a member list like the complex types
+    if (tok->type == tok_type && tok->word != WORD_STRUCTURE) {
         node->var_type = VAR_PARAMETER;
         if (strcmp(type_str, "INT") == 0 || strcmp(type_str, "INTEGER") == 0) {
             node->data.parameter.subtype = PARAM_INT;
@@ -791,17 +889,17 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             goto cleanup;
         }
     }
-    else {  // tok_keyword for complex types
+    else {  // tok_keyword (or STRUCTURE) for complex types
         if (strcmp(type_str, "PARAMETER") == 0) {
             node->var_type = VAR_PARAMETER;
             tok = current_token(lexer, i);
             if (tok && tok->type == tok_type) {  // Subtype like INT, DOUBLE
-                if (strcmp(tok->val, "INT") == 0 || strcmp(tok->val, "INTEGER") == 0) node->data.parameter.subtype = PARAM_INT;
-                else if (strcmp(tok->val, "DOUBLE") == 0) node->data.parameter.subtype = PARAM_DOUBLE;
-                else if (strcmp(tok->val, "STRING") == 0) node->data.parameter.subtype = PARAM_STRING;
-                else if (strcmp(tok->val, "BOOL") == 0) node->data.parameter.subtype = PARAM_BOOL;
+                if (token_is(lexer, tok, "INT") || token_is(lexer, tok, "INTEGER")) node->data.parameter.subtype = PARAM_INT;
+                else if (token_is(lexer, tok, "DOUBLE")) node->data.parameter.subtype = PARAM_DOUBLE;
+                else if (token_is(lexer, tok, "STRING")) node->data.parameter.subtype = PARAM_STRING;
+                else if (token_is(lexer, tok, "BOOL")) node->data.parameter.subtype = PARAM_BOOL;
                 else {
-                    ProPrintfChar("Error: Unknown parameter subtype '%s'\n", tok->val);
+                    ProPrintfChar("Error: Unknown parameter subtype '%.*s'\n", (int)tok->length, token_text(lexer, tok));
                     result = -1;
                     goto cleanup;
                 }
@@ -819,7 +917,7 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             // Parse entity_type (e.g., SURFACE)
             tok = current_token(lexer, i);
             if (tok && tok->type == tok_string) {
-                node->data.reference.entity_type = _strdup(tok->val);
+                node->data.reference.entity_type = ast_token_strdup(lexer, tok);
                 (*i)++;
             }
         }
@@ -828,11 +926,11 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             // Parse mode and path
             tok = current_token(lexer, i);
             if (tok && tok->type == tok_string) {
-                node->data.file_desc.mode = _strdup(tok->val);
+                node->data.file_desc.mode = ast_token_strdup(lexer, tok);
                 (*i)++;
                 tok = current_token(lexer, i);
                 if (tok && tok->type == tok_string) {
-                    node->data.file_desc.path = _strdup(tok->val);
+                    node->data.file_desc.path = ast_token_strdup(lexer, tok);
                     (*i)++;
                 }
             }
@@ -858,7 +956,7 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                 while (((tok = current_token(lexer, i)) != NULL) && tok->type != tok_rbrace) {
                     ExpressionNode* init = parse_expression(lexer, i, NULL);
                     if (init) {
-                        ExpressionNode** new_initializers = realloc(node->data.array.initializers,
+                        ExpressionNode** new_initializers = ast_realloc(node->data.array.initializers,
                             (node->data.array.init_count + 1) * sizeof(ExpressionNode*));
                         if (!new_initializers) {
                             ProPrintfChar("Memory reallocation failed for array initializers\n");
@@ -884,21 +982,21 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                         result = -1;
                         goto cleanup;
                     }
-                    char* key = _strdup(tok->val);
+                    char* key = ast_token_strdup(lexer, tok);
                     (*i)++;
                     consume(lexer, i, tok_colon);
                     ExpressionNode* value = parse_expression(lexer, i, NULL);
                     if (!value) {
-                        free(key);
+                        ast_free(key);
                         ProPrintfChar("Error: Invalid value for MAP key\n");
                         result = -1;
                         goto cleanup;
                     }
-                    MapPair* new_pairs = realloc(node->data.map.pairs,
+                    MapPair* new_pairs = ast_realloc(node->data.map.pairs,
                         (node->data.map.pair_count + 1) * sizeof(MapPair));
                     if (!new_pairs) {
                         ProPrintfChar("Memory reallocation failed for map pairs\n");
-                        free(key);
+                        ast_free(key);
                         free_expression(value);  // Free new resources to avoid leak
                         result = -1;
                         goto cleanup;
@@ -914,7 +1012,7 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         else if (strcmp(type_str, "GENERAL") == 0) {
             node->var_type = VAR_GENERAL;
             // Recursive for inner type
-            VariableDataStruct* inner = malloc(sizeof(VariableDataStruct));
+            VariableDataStruct* inner = ast_malloc(sizeof(VariableDataStruct));
             if (!inner) {
                 ProPrintfChar("Memory allocation failed for general inner data\n");
                 result = -1;
@@ -925,12 +1023,12 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             if (parse_declare_variable(lexer, &sub_i, &temp_data) == 0) {
                 node->data.general.inner_type = temp_data.declare_variable.var_type;
                 inner->data = temp_data.declare_variable.data;  // Copy union
-                free(temp_data.declare_variable.name);  // Free unused name from recursive parse
+                ast_free(temp_data.declare_variable.name);  // Free unused name from recursive parse
                 node->data.general.inner_data = inner;  // Set only on success
                 *i = sub_i;  // Advance index after recursion
             }
             else {
-                free(inner);
+                ast_free(inner);
                 result = -1;
                 goto cleanup;
             }
@@ -945,26 +1043,36 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                         result = -1;
                         goto cleanup;
                     }
-                    char* member_name = _strdup(tok->val);
+                    char* member_name = ast_token_strdup(lexer, tok);
                     (*i)++;
                     consume(lexer, i, tok_colon);
                     // Parse member type recursively
                     size_t sub_i = *i;
                     CommandData temp_data;
-                    if (parse_declare_variable(lexer, &sub_i, &temp_data) != 0) {
-                        free(member_name);
+                    if (parse_variable_decl(lexer, &sub_i, &temp_data, 0) != 0) {
+                        ast_free(member_name);
                         ProPrintfChar("Error: Invalid member type in STRUCTURE\n");
                         result = -1;
                         goto cleanup;
                     }
                     VariableType member_type = temp_data.declare_variable.var_type;
+                    ParameterSubType member_subtype = (member_type == VAR_PARAMETER)
+                        ? temp_data.declare_variable.data.parameter.subtype : PARAM_INT;
                     *i = sub_i;  // Advance index after type parse
-                    ExpressionNode* default_expr = parse_expression(lexer, i, NULL);  // Optional default; advance i directly
-                    StructMember* new_members = realloc(node->data.structure.members,
+                    // A parameter member's default is read by the nested parse; keep it
+                    ExpressionNode* default_expr = NULL;
+                    if (member_type == VAR_PARAMETER && temp_data.declare_variable.data.parameter.default_expr) {
+                        default_expr = temp_data.declare_variable.data.parameter.default_expr;
+                        temp_data.declare_variable.data.parameter.default_expr = NULL;
+                    }
+                    else if ((tok = current_token(lexer, i)) != NULL && tok->type != tok_comma && tok->type != tok_rbrace) {
+                        default_expr = parse_expression(lexer, i, NULL);  // Optional default; advance i directly
+                    }
+                    StructMember* new_members = ast_realloc(node->data.structure.members,
                         (node->data.structure.member_count + 1) * sizeof(StructMember));
                     if (!new_members) {
                         ProPrintfChar("Memory reallocation failed for structure members\n");
-                        free(member_name);
+                        ast_free(member_name);
                         free_expression(default_expr);  // Free new resources to avoid leak
                         result = -1;
                         goto cleanup;
@@ -972,6 +1080,7 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                     node->data.structure.members = new_members;
                     node->data.structure.members[node->data.structure.member_count].member_name = member_name;
                     node->data.structure.members[node->data.structure.member_count].member_type = member_type;
+                    node->data.structure.members[node->data.structure.member_count].member_subtype = member_subtype;
                     node->data.structure.members[node->data.structure.member_count++].default_expr = default_expr;
                     free_declare_variable_node(&temp_data.declare_variable);  // Free temporary parse data
                     consume(lexer, i, tok_comma);
@@ -985,18 +1094,20 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             goto cleanup;
         }
     }
-    free(type_str);
+    ast_free(type_str);
     type_str = NULL;
 
     // Parse name (required identifier)
-    tok = current_token(lexer, i);
-    if (!tok || tok->type != tok_identifier) {
-        ProPrintfChar("Error: Expected variable name\n");
-        result = -1;
-        goto cleanup;
+    if (named) {
+        tok = current_token(lexer, i);
+        if (!tok || tok->type != tok_identifier) {
+            ProPrintfChar("Error: Expected variable name\n");
+            result = -1;
+            goto cleanup;
+        }
+        node->name = ast_token_strdup(lexer, tok);
+        (*i)++;
     }
-    node->name = _strdup(tok->val);
-    (*i)++;
 
     // Optional default for non-initializer types (e.g., PARAMETER defaults) - no = required
     tok = current_token(lexer, i);
@@ -1019,41 +1130,45 @@ int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             // Enclose string in quotes
         {
             size_t len = strlen(expr->data.string_val) + 3;  // For quotes and null terminator
-            value_str = malloc(len);
+            value_str = ast_malloc(len);
             if (value_str) {
                 snprintf(value_str, len, "\"%s\"", expr->data.string_val);
             }
             else {
-                value_str = _strdup("malloc_failed");  // Fallback on allocation failure
+                value_str = ast_strdup("malloc_failed");  // Fallback on allocation failure
             }
         }
         break;
         case EXPR_LITERAL_INT:
             snprintf(buf, sizeof(buf), "%ld", expr->data.int_val);
-            value_str = _strdup(buf);
+            value_str = ast_strdup(buf);
             break;
         case EXPR_LITERAL_DOUBLE:
-            snprintf(buf, sizeof(buf), "%f", expr->data.double_val);
-            value_str = _strdup(buf);
+            epa_format_double_fixed(expr->data.double_val, 6, buf, sizeof(buf));
+            value_str = ast_strdup(buf);
             break;
         default:
             // Fallback for unsupported expression types
-            value_str = _strdup("unsupported_expr");
+            value_str = ast_strdup("unsupported_expr");
             break;
         }
     }
     LogOnlyPrintfChar("DeclareVariableNode: type=%d, name=%s, value=%s\n",
-        node->var_type, node->name, value_str ? value_str : "NULL");
-    free(value_str);  // Free allocated string if any
+        node->var_type, node->name ? node->name : "(member)", value_str ? value_str : "NULL");
+    ast_free(value_str);  // Free allocated string if any
 
     return 0;
 
 cleanup:
-    if (type_str) free(type_str);
+    if (type_str) ast_free(type_str);
     free_declare_variable_node(node);
     return -1;
 }
 
+int parse_declare_variable(Lexer* lexer, size_t* i, CommandData* parsed_data) {
+    return parse_variable_decl(lexer, i, parsed_data, 1);
+}
+
 /*=================================================*\
 * 
 * // GLOBAL_PICTURE parsing
@@ -1069,7 +1184,7 @@ int parse_global_picture(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     }
     char* expr_str = expression_to_string(node->picture_expr);
     LogOnlyPrintfChar("GlobalPictureNode: picture_file_name=%s\n", expr_str ? expr_str : "NULL");
-    free(expr_str);
+    ast_free(expr_str);
     return 0;
 
 cleanup:
@@ -1085,6 +1200,7 @@ cleanup:
 \*=================================================*/
 int parse_sub_picture(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     SubPictureNode* node = &parsed_data->sub_picture;
+    node->if_gate_id = 0;
     node->picture_expr = parse_expression(lexer, i, NULL);
     if (!node->picture_expr) {
         ProPrintfChar("Error: Expected expression for picture_file_name in SUB_PICTURE\n");
@@ -1108,9 +1224,9 @@ int parse_sub_picture(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     char* y_str = expression_to_string(node->posY_expr);
     LogOnlyPrintfChar("SubPictureNode: picture_file_name=%s, posX_str=%s, posY_str=%s\n",
         pic_str ? pic_str : "NULL", x_str ? x_str : "NULL", y_str ? y_str : "NULL");
-    free(pic_str);
-    free(x_str);
-    free(y_str);
+    ast_free(pic_str);
+    ast_free(x_str);
+    ast_free(y_str);
     return 0;
 }
 
@@ -1175,14 +1291,14 @@ int parse_config_elem(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
         if (parsing_options && tok->type == tok_option) {
             (*i)++;  // Consume option
-            if (strcmp(tok->val, "NO_TABLES") == 0) config->config_elem.no_tables = true;
-            else if (strcmp(tok->val, "NO_GUI") == 0) config->config_elem.no_gui = true;
-            else if (strcmp(tok->val, "AUTO_COMMIT") == 0) config->config_elem.auto_commit = true;
-            else if (strcmp(tok->val, "AUTO_CLOSE") == 0) config->config_elem.auto_close = true;
-            else if (strcmp(tok->val, "SHOW_GUI_FOR_EXISTING") == 0) config->config_elem.show_gui_for_existing = true;
-            else if (strcmp(tok->val, "NO_AUTO_UPDATE") == 0) config->config_elem.no_auto_update = true;
-            else if (strcmp(tok->val, "CONTINUE_ON_CANCEL") == 0) config->config_elem.continue_on_cancel = true;
-            else if (strcmp(tok->val, "SCREEN_LOCATION") == 0) {
+            if (token_is(lexer, tok, "NO_TABLES")) config->config_elem.no_tables = true;
+            else if (token_is(lexer, tok, "NO_GUI")) config->config_elem.no_gui = true;
+            else if (token_is(lexer, tok, "AUTO_COMMIT")) config->config_elem.auto_commit = true;
+            else if (token_is(lexer, tok, "AUTO_CLOSE")) config->config_elem.auto_close = true;
+            else if (token_is(lexer, tok, "SHOW_GUI_FOR_EXISTING")) config->config_elem.show_gui_for_existing = true;
+            else if (token_is(lexer, tok, "NO_AUTO_UPDATE")) config->config_elem.no_auto_update = true;
+            else if (token_is(lexer, tok, "CONTINUE_ON_CANCEL")) config->config_elem.continue_on_cancel = true;
+            else if (token_is(lexer, tok, "SCREEN_LOCATION")) {
                 if (config->config_elem.has_screen_location) {
                     ProPrintfChar("Error: Duplicate SCREEN_LOCATION option\n");
                     goto cleanup;
@@ -1200,7 +1316,7 @@ int parse_config_elem(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                 }
             }
             else {
-                ProPrintfChar("Error: Unknown option '%s' for CONFIG_ELEM\n", tok->val);
+                ProPrintfChar("Error: Unknown option '%.*s' for CONFIG_ELEM\n", (int)tok->length, token_text(lexer, tok));
                 goto cleanup;
             }
         }
@@ -1286,7 +1402,7 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    type_str = _strdup(tok->val);
+    type_str = ast_token_strdup(lexer, tok);
     if (!type_str) {
         ProPrintfChar("Error: Memory allocation failed for temporary type string\n");
         result = -1;
@@ -1305,12 +1421,12 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         node->show_param.subtype = PARAM_BOOL;
     }
     else {
-        ProPrintfChar("Error: Unknown parameter subtype '%s' in SHOW_PARAM\n", tok->val);
+        ProPrintfChar("Error: Unknown parameter subtype '%.*s' in SHOW_PARAM\n", (int)tok->length, token_text(lexer, tok));
         result = -1;
         goto cleanup;
     }
     (*i)++;
-    free(type_str);
+    ast_free(type_str);
     type_str = NULL;
 
     /* ---- parameter name ---- */
@@ -1320,7 +1436,7 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    node->show_param.parameter = _strdup(tok->val);
+    node->show_param.parameter = ast_token_strdup(lexer, tok);
     if (!node->show_param.parameter) {
         ProPrintfChar("Error: Memory allocation failed for parameter\n");
         result = -1;
@@ -1335,7 +1451,7 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
         (*i)++; /* consume option keyword */
 
-        if (strcmp(tok->val, "TOOLTIP") == 0) {
+        if (token_is(lexer, tok, "TOOLTIP")) {
             /* TOOLTIP <string-expr> [IMAGE <string-expr>] */
             node->show_param.tooltip_message = parse_expression(lexer, i, NULL);
             if (!node->show_param.tooltip_message ||
@@ -1346,7 +1462,7 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             }
             /* optional IMAGE */
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->show_param.image_name = parse_expression(lexer, i, NULL);
                 if (!node->show_param.image_name ||
@@ -1357,7 +1473,7 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                 }
             }
         }
-        else if (strcmp(tok->val, "ON_PICTURE") == 0) {
+        else if (token_is(lexer, tok, "ON_PICTURE")) {
             /* ON_PICTURE <expr posX> <expr posY>
                Accept general expressions; numeric validation happens in semantics. */
             node->show_param.posX = parse_expression(lexer, i, NULL);
@@ -1377,7 +1493,7 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             node->show_param.on_picture = true;
         }
         else {
-            ProPrintfChar("Error: Unknown option '%s' in SHOW_PARAM\n", tok->val);
+            ProPrintfChar("Error: Unknown option '%.*s' in SHOW_PARAM\n", (int)tok->length, token_text(lexer, tok));
             result = -1;
             goto cleanup;
         }
@@ -1401,17 +1517,17 @@ int parse_show_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             posy_str ? posy_str : "NULL"
         );
 
-        free(tooltip_str);
-        free(image_str);
-        free(posx_str);
-        free(posy_str);
+        ast_free(tooltip_str);
+        ast_free(image_str);
+        ast_free(posx_str);
+        ast_free(posy_str);
     }
 
     return 0;
 
 cleanup:
-    if (type_str) { free(type_str); type_str = NULL; }
-    if (node->show_param.parameter) { free(node->show_param.parameter); node->show_param.parameter = NULL; }
+    if (type_str) { ast_free(type_str); type_str = NULL; }
+    if (node->show_param.parameter) { ast_free(node->show_param.parameter); node->show_param.parameter = NULL; }
     free_expression(node->show_param.tooltip_message); node->show_param.tooltip_message = NULL;
     free_expression(node->show_param.image_name);      node->show_param.image_name = NULL;
     free_expression(node->show_param.posX);            node->show_param.posX = NULL;
@@ -1456,7 +1572,7 @@ int parse_checkbox_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    type_str = _strdup(tok->val);
+    type_str = ast_token_strdup(lexer, tok);
     if (!type_str) {
         ProPrintfChar("Error: Memory allocation failed for temporary type string\n");
         result = -1;
@@ -1475,12 +1591,12 @@ int parse_checkbox_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         node->checkbox_param.subtype = PARAM_BOOL;
     }
     else {
-        ProPrintfChar("Error: Unknown parameter subtype '%s' in CHECKBOX_PARAM\n", tok->val);
+        ProPrintfChar("Error: Unknown parameter subtype '%.*s' in CHECKBOX_PARAM\n", (int)tok->length, token_text(lexer, tok));
         result = -1;
         goto cleanup;
     }
     (*i)++;
-    free(type_str);
+    ast_free(type_str);
     type_str = NULL;
 
     // Parse parameter (required)
@@ -1490,7 +1606,7 @@ int parse_checkbox_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    node->checkbox_param.parameter = _strdup(tok->val);
+    node->checkbox_param.parameter = ast_token_strdup(lexer, tok);
     if (!node->checkbox_param.parameter) {
         ProPrintfChar("Error: Memory allocation failed for parameter\n");
         result = -1;
@@ -1502,7 +1618,8 @@ int parse_checkbox_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     while ((tok = current_token(lexer, i)) != NULL) {
         if (tok->type == tok_option) {
             (*i)++;  // Consume option
-            const char* option = tok->val;
+            char option_buf[64];
+            const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
             if (strcmp(option, "REQUIRED") == 0) {
                 node->checkbox_param.required = true;
@@ -1525,7 +1642,7 @@ int parse_checkbox_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
                 // Optional IMAGE
                 tok = current_token(lexer, i);
-                if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+                if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                     (*i)++;
                     node->checkbox_param.image_name = parse_expression(lexer, i, NULL);
                     if (!node->checkbox_param.image_name || node->checkbox_param.image_name->type != EXPR_LITERAL_STRING) {
@@ -1619,11 +1736,11 @@ int parse_checkbox_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
 cleanup:
     if (type_str) {
-        free(type_str);
+        ast_free(type_str);
         type_str = NULL;
     }
     if (node->checkbox_param.parameter) {
-        free(node->checkbox_param.parameter);
+        ast_free(node->checkbox_param.parameter);
         node->checkbox_param.parameter = NULL;
     }
     free_expression(node->checkbox_param.display_order);
@@ -1684,7 +1801,7 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    type_str = _strdup(tok->val);
+    type_str = ast_token_strdup(lexer, tok);
     if (!type_str) {
         ProPrintfChar("Error: Memory allocation failed for temporary type string\n");
         result = -1;
@@ -1703,12 +1820,12 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         node->user_input_param.subtype = PARAM_BOOL;
     }
     else {
-        ProPrintfChar("Error: Unknown parameter subtype '%s' in USER_INPUT_PARAM\n", tok->val);
+        ProPrintfChar("Error: Unknown parameter subtype '%.*s' in USER_INPUT_PARAM\n", (int)tok->length, token_text(lexer, tok));
         result = -1;
         goto cleanup;
     }
     (*i)++;
-    free(type_str);
+    ast_free(type_str);
     type_str = NULL;
 
     // Require parameter name second
@@ -1718,7 +1835,7 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    node->user_input_param.parameter = _strdup(tok->val);
+    node->user_input_param.parameter = ast_token_strdup(lexer, tok);
     if (!node->user_input_param.parameter) {
         ProPrintfChar("Error: Memory allocation failed for parameter\n");
         result = -1;
@@ -1742,7 +1859,8 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         tok = current_token(lexer, i);
         if (!tok || tok->type != tok_option) break;
         (*i)++;  // Consume option
-        const char* option = tok->val;
+        char option_buf[64];
+        const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
         if (strcmp(option, "DEFAULT_FOR") == 0) {
             size_t count = 0;
@@ -1750,7 +1868,7 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             tok = current_token(lexer, i);
             while (tok && tok->type == tok_identifier) {
                 if (count == 0) {
-                    params = malloc(sizeof(char*));
+                    params = ast_malloc(sizeof(char*));
                     if (!params) {
                         ProPrintfChar("Error: Initial memory allocation failed for default_for_params\n");
                         result = -1;
@@ -1758,21 +1876,21 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                     }
                 }
                 else {
-                    char** new_params = realloc(params, (count + 1) * sizeof(char*));
+                    char** new_params = ast_realloc(params, (count + 1) * sizeof(char*));
                     if (!new_params) {
                         ProPrintfChar("Error: Memory reallocation failed for default_for_params\n");
-                        for (size_t j = 0; j < count; j++) free(params[j]);
-                        free(params);
+                        for (size_t j = 0; j < count; j++) ast_free(params[j]);
+                        ast_free(params);
                         result = -1;
                         goto cleanup;
                     }
                     params = new_params;
                 }
-                params[count] = _strdup(tok->val);
+                params[count] = ast_token_strdup(lexer, tok);
                 if (!params[count]) {
                     ProPrintfChar("Error: Memory allocation failed for default_for_param\n");
-                    for (size_t j = 0; j < count; j++) free(params[j]);
-                    free(params);
+                    for (size_t j = 0; j < count; j++) ast_free(params[j]);
+                    ast_free(params);
                     result = -1;
                     goto cleanup;
                 }
@@ -1851,7 +1969,7 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             }
             // Optional IMAGE
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->user_input_param.image_name = parse_expression(lexer, i, NULL);
                 if (!node->user_input_param.image_name || node->user_input_param.image_name->type != EXPR_LITERAL_STRING) {
@@ -1906,7 +2024,7 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             }
         }
         if (total_len >= 2) total_len -= 2; // Remove extra ", "
-        default_for_str = malloc(total_len + 1);
+        default_for_str = ast_malloc(total_len + 1);
         if (default_for_str) {
             default_for_str[0] = '\0';
             for (size_t k = 0; k < node->user_input_param.default_for_count; k++) {
@@ -1935,24 +2053,24 @@ int parse_user_input_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         tooltip_val ? tooltip_val : "NULL", image_val ? image_val : "NULL",
         node->user_input_param.on_picture, posX_str ? posX_str : "NULL", posY_str ? posY_str : "NULL");
 
-    free(default_str);
-    free(width_str);
-    free(dec_places_str);
-    free(model_str);
-    free(display_order_str);
-    free(min_val_str);
-    free(max_val_str);
-    free(tooltip_val);
-    free(image_val);
-    free(posX_str);
-    free(posY_str);
-    if (default_for_str) free(default_for_str);
+    ast_free(default_str);
+    ast_free(width_str);
+    ast_free(dec_places_str);
+    ast_free(model_str);
+    ast_free(display_order_str);
+    ast_free(min_val_str);
+    ast_free(max_val_str);
+    ast_free(tooltip_val);
+    ast_free(image_val);
+    ast_free(posX_str);
+    ast_free(posY_str);
+    if (default_for_str) ast_free(default_for_str);
 
     return 0;
 
 cleanup:
     if (type_str) {
-        free(type_str);
+        ast_free(type_str);
         type_str = NULL;
     }
     // Note: Full cleanup handled by free_command_node case; here just return error
@@ -1996,7 +2114,7 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    type_str = _strdup(tok->val);
+    type_str = ast_token_strdup(lexer, tok);
     if (!type_str) {
         ProPrintfChar("Error: Memory allocation failed for temporary type string\n");
         result = -1;
@@ -2015,12 +2133,12 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         node->subtype = PARAM_BOOL;
     }
     else {
-        ProPrintfChar("Error: Unknown parameter subtype '%s' in RADIOBUTTON_PARAM\n", tok->val);
+        ProPrintfChar("Error: Unknown parameter subtype '%.*s' in RADIOBUTTON_PARAM\n", (int)tok->length, token_text(lexer, tok));
         result = -1;
         goto cleanup;
     }
     (*i)++;
-    free(type_str);
+    ast_free(type_str);
     type_str = NULL;
 
     // Require parameter name second
@@ -2030,7 +2148,7 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         result = -1;
         goto cleanup;
     }
-    node->parameter = _strdup(tok->val);
+    node->parameter = ast_token_strdup(lexer, tok);
     if (!node->parameter) {
         ProPrintfChar("Error: Memory allocation failed for parameter\n");
         result = -1;
@@ -2040,7 +2158,7 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
     // Parse options as list of expressions (e.g., strings or identifiers) until option token or next command
     size_t opt_capacity = 4;
-    node->options = malloc(opt_capacity * sizeof(ExpressionNode*));
+    node->options = ast_malloc(opt_capacity * sizeof(ExpressionNode*));
     if (!node->options) {
         ProPrintfChar("Error: Memory allocation failed for options array\n");
         result = -1;
@@ -2063,7 +2181,7 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         }
         if (node->option_count >= opt_capacity) {
             opt_capacity *= 2;
-            ExpressionNode** new_options = realloc(node->options, opt_capacity * sizeof(ExpressionNode*));
+            ExpressionNode** new_options = ast_realloc(node->options, opt_capacity * sizeof(ExpressionNode*));
             if (!new_options) {
                 ProPrintfChar("Error: Memory reallocation failed for options array\n");
                 free_expression(opt);
@@ -2086,7 +2204,8 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         tok = current_token(lexer, i);
         if (!tok || tok->type != tok_option) break;
         (*i)++;  // Consume option
-        const char* option = tok->val;
+        char option_buf[64];
+        const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
         if (strcmp(option, "REQUIRED") == 0) {
             node->required = true;
@@ -2109,7 +2228,7 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             }
             // Optional IMAGE
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->image_name = parse_expression(lexer, i, NULL);
                 if (!node->image_name || node->image_name->type != EXPR_LITERAL_STRING) {
@@ -2158,11 +2277,11 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             char* opt_str = expression_to_string(node->options[k]);
             if (opt_str) {
                 total_len += strlen(opt_str) + 2; // +2 for ", "
-                free(opt_str);
+                ast_free(opt_str);
             }
         }
         if (total_len >= 2) total_len -= 2;
-        options_str = malloc(total_len + 1);
+        options_str = ast_malloc(total_len + 1);
         if (options_str) {
             options_str[0] = '\0';
             for (size_t k = 0; k < node->option_count; k++) {
@@ -2172,7 +2291,7 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                     if (k < node->option_count - 1) {
                         strcat_s(options_str, total_len + 1, ", ");
                     }
-                    free(opt_str);
+                    ast_free(opt_str);
                 }
             }
         }
@@ -2186,22 +2305,22 @@ int parse_radiobutton_param(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         tooltip_val ? tooltip_val : "NULL", image_val ? image_val : "NULL",
         node->on_picture, posX_str ? posX_str : "NULL", posY_str ? posY_str : "NULL");
 
-    free(display_order_str);
-    free(tooltip_val);
-    free(image_val);
-    free(posX_str);
-    free(posY_str);
-    if (options_str) free(options_str);
+    ast_free(display_order_str);
+    ast_free(tooltip_val);
+    ast_free(image_val);
+    ast_free(posX_str);
+    ast_free(posY_str);
+    if (options_str) ast_free(options_str);
 
     return 0;
 
 cleanup:
-    if (type_str) free(type_str);
-    free(node->parameter);
+    if (type_str) ast_free(type_str);
+    ast_free(node->parameter);
     for (size_t k = 0; k < node->option_count; k++) {
         free_expression(node->options[k]);
     }
-    free(node->options);
+    ast_free(node->options);
     free_expression(node->display_order);
     free_expression(node->tooltip_message);
     free_expression(node->image_name);
@@ -2231,7 +2350,7 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
       a | separated list of tok_type (AXIS|PLANE)
     ------------------------------------------*/
     size_t type_capacity = 4;
-    node->types = (ExpressionNode**)malloc(type_capacity * sizeof(ExpressionNode*));
+    node->types = (ExpressionNode**)ast_malloc(type_capacity * sizeof(ExpressionNode*));
     if (!node->types) {
         ProPrintfChar("Error: Memory allocation failed for types array\n");
         return -1;
@@ -2244,21 +2363,21 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             ProPrintfChar("Error: Expected identifier after & in USER_SELECT types\n");
             goto cleanup;
         }
-        ExpressionNode* var_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* var_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!var_expr) {
             ProPrintfChar("Error: Memory allocation failed for type expression\n");
             goto cleanup;
         }
         var_expr->type = EXPR_VARIABLE_REF;
         {
-            size_t buf_size = strlen(tok->val) + 2; // '&' + name + NUL
-            var_expr->data.string_val = (char*)malloc(buf_size);
+            size_t buf_size = (size_t)tok->length + 2; // '&' + name + NUL
+            var_expr->data.string_val = (char*)ast_malloc(buf_size);
             if (!var_expr->data.string_val) {
-                free(var_expr);
+                ast_free(var_expr);
                 ProPrintfChar("Error: Memory allocation failed for variable type string\n");
                 goto cleanup;
             }
-            sprintf_s(var_expr->data.string_val, buf_size, "&%s", tok->val);
+            sprintf_s(var_expr->data.string_val, buf_size, "&%.*s", (int)tok->length, token_text(lexer, tok));
         }
         node->types[0] = var_expr;
         node->type_count = 1;
@@ -2267,22 +2386,22 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     else {
         // Parse sequence like: AXIS | PLANE | EDGE
         while (tok && tok->type == tok_type) {
-            ExpressionNode* type_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+            ExpressionNode* type_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
             if (!type_expr) {
                 ProPrintfChar("Error: Memory allocation failed for type expression\n");
                 goto cleanup;
             }
             type_expr->type = EXPR_LITERAL_STRING;
-            type_expr->data.string_val = _strdup(tok->val);
+            type_expr->data.string_val = ast_token_strdup(lexer, tok);
             if (!type_expr->data.string_val) {
-                free(type_expr);
+                ast_free(type_expr);
                 ProPrintfChar("Error: Memory allocation failed for type string\n");
                 goto cleanup;
             }
             if (node->type_count >= type_capacity) {
                 type_capacity *= 2;
                 ExpressionNode** new_types =
-                    (ExpressionNode**)realloc(node->types, type_capacity * sizeof(ExpressionNode*));
+                    (ExpressionNode**)ast_realloc(node->types, type_capacity * sizeof(ExpressionNode*));
                 if (!new_types) {
                     free_expression(type_expr);
                     ProPrintfChar("Error: Memory reallocation failed for types array\n");
@@ -2315,7 +2434,7 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         ProPrintfChar("Error: Expected reference identifier in USER_SELECT\n");
         goto cleanup;
     }
-    node->reference = _strdup(tok->val);
+    node->reference = ast_token_strdup(lexer, tok);
     if (!node->reference) {
         ProPrintfChar("Error: Memory allocation failed for reference\n");
         goto cleanup;
@@ -2328,7 +2447,8 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     tok = current_token(lexer, i);
     while (tok && tok->type == tok_option) {
         (*i)++;  // consume option
-        const char* option = tok->val;
+        char option_buf[64];
+        const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
         if (strcmp(option, "DISPLAY_ORDER") == 0) {
             if (node->display_order) {
@@ -2442,7 +2562,7 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             }
             // Optional IMAGE
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->image_name = parse_expression(lexer, i, NULL);
                 if (!node->image_name || node->image_name->type != EXPR_LITERAL_STRING) {
@@ -2501,10 +2621,10 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             size_t total_len = 0;
             for (size_t k = 0; k < node->type_count; k++) {
                 char* t = expression_to_string(node->types[k]);
-                if (t) { total_len += strlen(t) + 2; free(t); }
+                if (t) { total_len += strlen(t) + 2; ast_free(t); }
             }
             if (total_len >= 2) total_len -= 2;
-            types_str = (char*)malloc(total_len + 1);
+            types_str = (char*)ast_malloc(total_len + 1);
             if (types_str) {
                 types_str[0] = '\0';
                 for (size_t k = 0; k < node->type_count; k++) {
@@ -2512,7 +2632,7 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
                     if (t) {
                         strcat_s(types_str, total_len + 1, t);
                         if (k < node->type_count - 1) strcat_s(types_str, total_len + 1, ", ");
-                        free(t);
+                        ast_free(t);
                     }
                 }
             }
@@ -2554,19 +2674,19 @@ int parse_user_select(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             tag_str ? tag_str : "NULL"
         );
 
-        if (types_str) free(types_str);
-        if (display_order_str) free(display_order_str);
-        if (filter_mdl_str) free(filter_mdl_str);
-        if (filter_feat_str) free(filter_feat_str);
-        if (filter_geom_str) free(filter_geom_str);
-        if (filter_ref_str) free(filter_ref_str);
-        if (filter_id_str) free(filter_id_str);
-        if (include_str) free(include_str);
-        if (tooltip_str) free(tooltip_str);
-        if (image_str) free(image_str);
-        if (posX_str) free(posX_str);
-        if (posY_str) free(posY_str);
-        if (tag_str) free(tag_str);
+        if (types_str) ast_free(types_str);
+        if (display_order_str) ast_free(display_order_str);
+        if (filter_mdl_str) ast_free(filter_mdl_str);
+        if (filter_feat_str) ast_free(filter_feat_str);
+        if (filter_geom_str) ast_free(filter_geom_str);
+        if (filter_ref_str) ast_free(filter_ref_str);
+        if (filter_id_str) ast_free(filter_id_str);
+        if (include_str) ast_free(include_str);
+        if (tooltip_str) ast_free(tooltip_str);
+        if (image_str) ast_free(image_str);
+        if (posX_str) ast_free(posX_str);
+        if (posY_str) ast_free(posY_str);
+        if (tag_str) ast_free(tag_str);
     }
 
     return 0;
@@ -2576,11 +2696,11 @@ cleanup:
     for (size_t k = 0; k < node->type_count; k++) {
         free_expression(node->types[k]);
     }
-    free(node->types);
+    ast_free(node->types);
     node->types = NULL;
     node->type_count = 0;
 
-    if (node->reference) { free(node->reference); node->reference = NULL; }
+    if (node->reference) { ast_free(node->reference); node->reference = NULL; }
     free_expression(node->display_order);
     free_expression(node->filter_mdl);
     free_expression(node->filter_feat);
@@ -2608,7 +2728,7 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
 
     /* -------- types: either &var or TYPE | TYPE | ... -------- */
     size_t type_capacity = 4;
-    node->types = (ExpressionNode**)malloc(type_capacity * sizeof(ExpressionNode*));
+    node->types = (ExpressionNode**)ast_malloc(type_capacity * sizeof(ExpressionNode*));
     if (!node->types) {
         ProPrintfChar("Error: Memory allocation failed for types array\n");
         return -1;
@@ -2625,14 +2745,14 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
             ProPrintfChar("Error: Expected identifier after & in USER_SELECT_MULTIPLE types\n");
             goto cleanup;
         }
-        ExpressionNode* var_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* var_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!var_expr) { ProPrintfChar("Error: Memory allocation failed for type expression\n"); goto cleanup; }
         var_expr->type = EXPR_VARIABLE_REF;
         {
-            size_t buf_size = strlen(tok->val) + 2;
-            var_expr->data.string_val = (char*)malloc(buf_size);
-            if (!var_expr->data.string_val) { free(var_expr); ProPrintfChar("Error: Memory allocation failed for variable type string\n"); goto cleanup; }
-            sprintf_s(var_expr->data.string_val, buf_size, "&%s", tok->val);
+            size_t buf_size = (size_t)tok->length + 2;
+            var_expr->data.string_val = (char*)ast_malloc(buf_size);
+            if (!var_expr->data.string_val) { ast_free(var_expr); ProPrintfChar("Error: Memory allocation failed for variable type string\n"); goto cleanup; }
+            sprintf_s(var_expr->data.string_val, buf_size, "&%.*s", (int)tok->length, token_text(lexer, tok));
         }
         node->types[0] = var_expr;
         node->type_count = 1;
@@ -2641,14 +2761,14 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
     else {
         /* Parse sequence like: AXIS | PLANE | EDGE */
         while (tok && tok->type == tok_type) {
-            ExpressionNode* type_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+            ExpressionNode* type_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
             if (!type_expr) { ProPrintfChar("Error: Memory allocation failed for type expression\n"); goto cleanup; }
             type_expr->type = EXPR_LITERAL_STRING;
-            type_expr->data.string_val = _strdup(tok->val);
-            if (!type_expr->data.string_val) { free(type_expr); ProPrintfChar("Error: Memory allocation failed for type string\n"); goto cleanup; }
+            type_expr->data.string_val = ast_token_strdup(lexer, tok);
+            if (!type_expr->data.string_val) { ast_free(type_expr); ProPrintfChar("Error: Memory allocation failed for type string\n"); goto cleanup; }
             if (node->type_count >= type_capacity) {
                 type_capacity *= 2;
-                ExpressionNode** new_types = (ExpressionNode**)realloc(node->types, type_capacity * sizeof(ExpressionNode*));
+                ExpressionNode** new_types = (ExpressionNode**)ast_realloc(node->types, type_capacity * sizeof(ExpressionNode*));
                 if (!new_types) { free_expression(type_expr); ProPrintfChar("Error: Memory reallocation failed for types array\n"); goto cleanup; }
                 node->types = new_types;
             }
@@ -2682,7 +2802,7 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
         ProPrintfChar("Error: Expected array identifier in USER_SELECT_MULTIPLE\n");
         goto cleanup;
     }
-    node->array = _strdup(tok->val);
+    node->array = ast_token_strdup(lexer, tok);
     if (!node->array) { ProPrintfChar("Error: Memory allocation failed for array name\n"); goto cleanup; }
     (*i)++;
 
@@ -2694,7 +2814,7 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
         if (!tok || tok->type != tok_colon) { ProPrintfChar("Error: Expected ':' in '<:out>' after array name\n"); goto cleanup; }
         (*i)++;
         tok = current_token(lexer, i);
-        if (!tok || tok->type != tok_identifier || _stricmp(tok->val, "out") != 0) {
+        if (!tok || tok->type != tok_identifier || !token_is_ci(lexer, tok, "out")) {
             ProPrintfChar("Error: Expected 'out' in '<:out>' after array name\n");
             goto cleanup;
         }
@@ -2708,7 +2828,8 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
     tok = current_token(lexer, i);
     while (tok && tok->type == tok_option) {
         (*i)++;
-        const char* option = tok->val;
+        char option_buf[64];
+        const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
         if (strcmp(option, "DISPLAY_ORDER") == 0) {
             if (node->display_order) { ProPrintfChar("Error: DISPLAY_ORDER specified more than once\n"); goto cleanup; }
@@ -2775,7 +2896,7 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
             }
             /* Optional IMAGE */
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->image_name = parse_expression(lexer, i, NULL);
                 if (!node->image_name || node->image_name->type != EXPR_LITERAL_STRING) {
@@ -2825,10 +2946,10 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
             size_t total_len = 0;
             for (size_t k = 0; k < node->type_count; k++) {
                 char* t = expression_to_string(node->types[k]);
-                if (t) { total_len += strlen(t) + 2; free(t); }
+                if (t) { total_len += strlen(t) + 2; ast_free(t); }
             }
             if (total_len >= 2) total_len -= 2;
-            types_str = (char*)malloc(total_len + 1);
+            types_str = (char*)ast_malloc(total_len + 1);
             if (types_str) {
                 types_str[0] = '\0';
                 for (size_t k = 0; k < node->type_count; k++) {
@@ -2836,7 +2957,7 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
                     if (t) {
                         strcat_s(types_str, total_len + 1, t);
                         if (k < node->type_count - 1) strcat_s(types_str, total_len + 1, ", ");
-                        free(t);
+                        ast_free(t);
                     }
                 }
             }
@@ -2880,9 +3001,9 @@ int parse_user_select_multiple(Lexer* lexer, size_t* i, CommandData* parsed_data
             tag_str ? tag_str : "NULL"
         );
 
-        free(types_str); free(max_sel_str); free(display_order_str); free(filter_mdl_str);
-        free(filter_feat_str); free(filter_geom_str); free(filter_ref_str); free(filter_id_str);
-        free(include_str); free(tooltip_str); free(image_str); free(posX_str); free(posY_str); free(tag_str);
+        ast_free(types_str); ast_free(max_sel_str); ast_free(display_order_str); ast_free(filter_mdl_str);
+        ast_free(filter_feat_str); ast_free(filter_geom_str); ast_free(filter_ref_str); ast_free(filter_id_str);
+        ast_free(include_str); ast_free(tooltip_str); ast_free(image_str); ast_free(posX_str); ast_free(posY_str); ast_free(tag_str);
     }
 
     return 0;
@@ -2891,11 +3012,11 @@ cleanup:
     /* Free on failure */
     if (node->types) {
         for (size_t k = 0; k < node->type_count; k++) free_expression(node->types[k]);
-        free(node->types);
+        ast_free(node->types);
         node->types = NULL;
     }
     free_expression(node->max_sel);
-    free(node->array);
+    ast_free(node->array);
 
     free_expression(node->display_order);
     free_expression(node->filter_mdl);
@@ -2924,7 +3045,7 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
 
     /* -------- types: either &var or TYPE | TYPE | ... -------- */
     size_t type_capacity = 4;
-    node->types = (ExpressionNode**)malloc(type_capacity * sizeof(ExpressionNode*));
+    node->types = (ExpressionNode**)ast_malloc(type_capacity * sizeof(ExpressionNode*));
     if (!node->types) {
         ProPrintfChar("Error: Memory allocation failed for types array\n");
         return -1;
@@ -2941,14 +3062,14 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
             ProPrintfChar("Error: Expected identifier after & in USER_SELECT_MULTIPLE types\n");
             goto cleanup;
         }
-        ExpressionNode* var_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* var_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!var_expr) { ProPrintfChar("Error: Memory allocation failed for type expression\n"); goto cleanup; }
         var_expr->type = EXPR_VARIABLE_REF;
         {
-            size_t buf_size = strlen(tok->val) + 2;
-            var_expr->data.string_val = (char*)malloc(buf_size);
-            if (!var_expr->data.string_val) { free(var_expr); ProPrintfChar("Error: Memory allocation failed for variable type string\n"); goto cleanup; }
-            sprintf_s(var_expr->data.string_val, buf_size, "&%s", tok->val);
+            size_t buf_size = (size_t)tok->length + 2;
+            var_expr->data.string_val = (char*)ast_malloc(buf_size);
+            if (!var_expr->data.string_val) { ast_free(var_expr); ProPrintfChar("Error: Memory allocation failed for variable type string\n"); goto cleanup; }
+            sprintf_s(var_expr->data.string_val, buf_size, "&%.*s", (int)tok->length, token_text(lexer, tok));
         }
         node->types[0] = var_expr;
         node->type_count = 1;
@@ -2957,14 +3078,14 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
     else {
         /* Parse sequence like: AXIS | PLANE | EDGE */
         while (tok && tok->type == tok_type) {
-            ExpressionNode* type_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+            ExpressionNode* type_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
             if (!type_expr) { ProPrintfChar("Error: Memory allocation failed for type expression\n"); goto cleanup; }
             type_expr->type = EXPR_LITERAL_STRING;
-            type_expr->data.string_val = _strdup(tok->val);
-            if (!type_expr->data.string_val) { free(type_expr); ProPrintfChar("Error: Memory allocation failed for type string\n"); goto cleanup; }
+            type_expr->data.string_val = ast_token_strdup(lexer, tok);
+            if (!type_expr->data.string_val) { ast_free(type_expr); ProPrintfChar("Error: Memory allocation failed for type string\n"); goto cleanup; }
             if (node->type_count >= type_capacity) {
                 type_capacity *= 2;
-                ExpressionNode** new_types = (ExpressionNode**)realloc(node->types, type_capacity * sizeof(ExpressionNode*));
+                ExpressionNode** new_types = (ExpressionNode**)ast_realloc(node->types, type_capacity * sizeof(ExpressionNode*));
                 if (!new_types) { free_expression(type_expr); ProPrintfChar("Error: Memory reallocation failed for types array\n"); goto cleanup; }
                 node->types = new_types;
             }
@@ -2998,7 +3119,7 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
         ProPrintfChar("Error: Expected array identifier in USER_SELECT_MULTIPLE\n");
         goto cleanup;
     }
-    node->array = _strdup(tok->val);
+    node->array = ast_token_strdup(lexer, tok);
     if (!node->array) { ProPrintfChar("Error: Memory allocation failed for array name\n"); goto cleanup; }
     (*i)++;
 
@@ -3010,7 +3131,7 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
         if (!tok || tok->type != tok_colon) { ProPrintfChar("Error: Expected ':' in '<:out>' after array name\n"); goto cleanup; }
         (*i)++;
         tok = current_token(lexer, i);
-        if (!tok || tok->type != tok_identifier || _stricmp(tok->val, "out") != 0) {
+        if (!tok || tok->type != tok_identifier || !token_is_ci(lexer, tok, "out")) {
             ProPrintfChar("Error: Expected 'out' in '<:out>' after array name\n");
             goto cleanup;
         }
@@ -3024,7 +3145,8 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
     tok = current_token(lexer, i);
     while (tok && tok->type == tok_option) {
         (*i)++;
-        const char* option = tok->val;
+        char option_buf[64];
+        const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
         if (strcmp(option, "DISPLAY_ORDER") == 0) {
             if (node->display_order) { ProPrintfChar("Error: DISPLAY_ORDER specified more than once\n"); goto cleanup; }
@@ -3091,7 +3213,7 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
             }
             /* Optional IMAGE */
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->image_name = parse_expression(lexer, i, NULL);
                 if (!node->image_name || node->image_name->type != EXPR_LITERAL_STRING) {
@@ -3141,10 +3263,10 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
             size_t total_len = 0;
             for (size_t k = 0; k < node->type_count; k++) {
                 char* t = expression_to_string(node->types[k]);
-                if (t) { total_len += strlen(t) + 2; free(t); }
+                if (t) { total_len += strlen(t) + 2; ast_free(t); }
             }
             if (total_len >= 2) total_len -= 2;
-            types_str = (char*)malloc(total_len + 1);
+            types_str = (char*)ast_malloc(total_len + 1);
             if (types_str) {
                 types_str[0] = '\0';
                 for (size_t k = 0; k < node->type_count; k++) {
@@ -3152,7 +3274,7 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
                     if (t) {
                         strcat_s(types_str, total_len + 1, t);
                         if (k < node->type_count - 1) strcat_s(types_str, total_len + 1, ", ");
-                        free(t);
+                        ast_free(t);
                     }
                 }
             }
@@ -3196,9 +3318,9 @@ int parse_user_select_multiple_optional(Lexer* lexer, size_t* i, CommandData* pa
             tag_str ? tag_str : "NULL"
         );
 
-        free(types_str); free(max_sel_str); free(display_order_str); free(filter_mdl_str);
-        free(filter_feat_str); free(filter_geom_str); free(filter_ref_str); free(filter_id_str);
-        free(include_str); free(tooltip_str); free(image_str); free(posX_str); free(posY_str); free(tag_str);
+        ast_free(types_str); ast_free(max_sel_str); ast_free(display_order_str); ast_free(filter_mdl_str);
+        ast_free(filter_feat_str); ast_free(filter_geom_str); ast_free(filter_ref_str); ast_free(filter_id_str);
+        ast_free(include_str); ast_free(tooltip_str); ast_free(image_str); ast_free(posX_str); ast_free(posY_str); ast_free(tag_str);
     }
 
     return 0;
@@ -3207,11 +3329,11 @@ cleanup:
     /* Free on failure */
     if (node->types) {
         for (size_t k = 0; k < node->type_count; k++) free_expression(node->types[k]);
-        free(node->types);
+        ast_free(node->types);
         node->types = NULL;
     }
     free_expression(node->max_sel);
-    free(node->array);
+    ast_free(node->array);
 
     free_expression(node->display_order);
     free_expression(node->filter_mdl);
@@ -3244,7 +3366,7 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
       a | separated list of tok_type (AXIS|PLANE)
     ------------------------------------------*/
     size_t type_capacity = 4;
-    node->types = (ExpressionNode**)malloc(type_capacity * sizeof(ExpressionNode*));
+    node->types = (ExpressionNode**)ast_malloc(type_capacity * sizeof(ExpressionNode*));
     if (!node->types) {
         ProPrintfChar("Error: Memory allocation failed for types array\n");
         return -1;
@@ -3257,21 +3379,21 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
             ProPrintfChar("Error: Expected identifier after & in USER_SELECT types\n");
             goto cleanup;
         }
-        ExpressionNode* var_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* var_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!var_expr) {
             ProPrintfChar("Error: Memory allocation failed for type expression\n");
             goto cleanup;
         }
         var_expr->type = EXPR_VARIABLE_REF;
         {
-            size_t buf_size = strlen(tok->val) + 2; // '&' + name + NUL
-            var_expr->data.string_val = (char*)malloc(buf_size);
+            size_t buf_size = (size_t)tok->length + 2; // '&' + name + NUL
+            var_expr->data.string_val = (char*)ast_malloc(buf_size);
             if (!var_expr->data.string_val) {
-                free(var_expr);
+                ast_free(var_expr);
                 ProPrintfChar("Error: Memory allocation failed for variable type string\n");
                 goto cleanup;
             }
-            sprintf_s(var_expr->data.string_val, buf_size, "&%s", tok->val);
+            sprintf_s(var_expr->data.string_val, buf_size, "&%.*s", (int)tok->length, token_text(lexer, tok));
         }
         node->types[0] = var_expr;
         node->type_count = 1;
@@ -3280,22 +3402,22 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
     else {
         // Parse sequence like: AXIS | PLANE | EDGE
         while (tok && tok->type == tok_type) {
-            ExpressionNode* type_expr = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+            ExpressionNode* type_expr = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
             if (!type_expr) {
                 ProPrintfChar("Error: Memory allocation failed for type expression\n");
                 goto cleanup;
             }
             type_expr->type = EXPR_LITERAL_STRING;
-            type_expr->data.string_val = _strdup(tok->val);
+            type_expr->data.string_val = ast_token_strdup(lexer, tok);
             if (!type_expr->data.string_val) {
-                free(type_expr);
+                ast_free(type_expr);
                 ProPrintfChar("Error: Memory allocation failed for type string\n");
                 goto cleanup;
             }
             if (node->type_count >= type_capacity) {
                 type_capacity *= 2;
                 ExpressionNode** new_types =
-                    (ExpressionNode**)realloc(node->types, type_capacity * sizeof(ExpressionNode*));
+                    (ExpressionNode**)ast_realloc(node->types, type_capacity * sizeof(ExpressionNode*));
                 if (!new_types) {
                     free_expression(type_expr);
                     ProPrintfChar("Error: Memory reallocation failed for types array\n");
@@ -3328,7 +3450,7 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
         ProPrintfChar("Error: Expected reference identifier in USER_SELECT\n");
         goto cleanup;
     }
-    node->reference = _strdup(tok->val);
+    node->reference = ast_token_strdup(lexer, tok);
     if (!node->reference) {
         ProPrintfChar("Error: Memory allocation failed for reference\n");
         goto cleanup;
@@ -3341,7 +3463,8 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
     tok = current_token(lexer, i);
     while (tok && tok->type == tok_option) {
         (*i)++;  // consume option
-        const char* option = tok->val;
+        char option_buf[64];
+        const char* option = token_cstr(lexer, tok, option_buf, sizeof(option_buf));
 
         if (strcmp(option, "DISPLAY_ORDER") == 0) {
             if (node->display_order) {
@@ -3455,7 +3578,7 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
             }
             // Optional IMAGE
             tok = current_token(lexer, i);
-            if (tok && tok->type == tok_option && strcmp(tok->val, "IMAGE") == 0) {
+            if (tok && tok->type == tok_option && token_is(lexer, tok, "IMAGE")) {
                 (*i)++;
                 node->image_name = parse_expression(lexer, i, NULL);
                 if (!node->image_name || node->image_name->type != EXPR_LITERAL_STRING) {
@@ -3513,10 +3636,10 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
             size_t total_len = 0;
             for (size_t k = 0; k < node->type_count; k++) {
                 char* t = expression_to_string(node->types[k]);
-                if (t) { total_len += strlen(t) + 2; free(t); }
+                if (t) { total_len += strlen(t) + 2; ast_free(t); }
             }
             if (total_len >= 2) total_len -= 2;
-            types_str = (char*)malloc(total_len + 1);
+            types_str = (char*)ast_malloc(total_len + 1);
             if (types_str) {
                 types_str[0] = '\0';
                 for (size_t k = 0; k < node->type_count; k++) {
@@ -3524,7 +3647,7 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
                     if (t) {
                         strcat_s(types_str, total_len + 1, t);
                         if (k < node->type_count - 1) strcat_s(types_str, total_len + 1, ", ");
-                        free(t);
+                        ast_free(t);
                     }
                 }
             }
@@ -3566,19 +3689,19 @@ int parse_user_select_optional(Lexer* lexer, size_t* i, CommandData* parsed_data
             tag_str ? tag_str : "NULL"
         );
 
-        if (types_str) free(types_str);
-        if (display_order_str) free(display_order_str);
-        if (filter_mdl_str) free(filter_mdl_str);
-        if (filter_feat_str) free(filter_feat_str);
-        if (filter_geom_str) free(filter_geom_str);
-        if (filter_ref_str) free(filter_ref_str);
-        if (filter_id_str) free(filter_id_str);
-        if (include_str) free(include_str);
-        if (tooltip_str) free(tooltip_str);
-        if (image_str) free(image_str);
-        if (posX_str) free(posX_str);
-        if (posY_str) free(posY_str);
-        if (tag_str) free(tag_str);
+        if (types_str) ast_free(types_str);
+        if (display_order_str) ast_free(display_order_str);
+        if (filter_mdl_str) ast_free(filter_mdl_str);
+        if (filter_feat_str) ast_free(filter_feat_str);
+        if (filter_geom_str) ast_free(filter_geom_str);
+        if (filter_ref_str) ast_free(filter_ref_str);
+        if (filter_id_str) ast_free(filter_id_str);
+        if (include_str) ast_free(include_str);
+        if (tooltip_str) ast_free(tooltip_str);
+        if (image_str) ast_free(image_str);
+        if (posX_str) ast_free(posX_str);
+        if (posY_str) ast_free(posY_str);
+        if (tag_str) ast_free(tag_str);
     }
 
     return 0;
@@ -3588,11 +3711,11 @@ cleanup:
     for (size_t k = 0; k < node->type_count; k++) {
         free_expression(node->types[k]);
     }
-    free(node->types);
+    ast_free(node->types);
     node->types = NULL;
     node->type_count = 0;
 
-    if (node->reference) { free(node->reference); node->reference = NULL; }
+    if (node->reference) { ast_free(node->reference); node->reference = NULL; }
     free_expression(node->display_order);
     free_expression(node->filter_mdl);
     free_expression(node->filter_feat);
@@ -3648,10 +3771,10 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     // Step 1: Assume 'BEGIN_TABLE' has already been consumed by the caller; parse TABLE_IDENTIFIER
     TokenData* tok = current_token(lexer, i);
     if (!tok || (tok->type != tok_field && tok->type != tok_identifier)) {
-        ProPrintfChar("Error: Expected TABLE_IDENTIFIER after BEGIN_TABLE at line %zu\n", tok ? tok->loc.line : (*i > 0 ? lexer->tokens[*i - 1].loc.line : 0));
+        ProPrintfChar("Error: Expected TABLE_IDENTIFIER after BEGIN_TABLE at line %zu\n", tok ? (size_t)tok->line : (*i > 0 ? (size_t)lexer->tokens[*i - 1].line : 0));
         return -1;
     }
-    node->identifier = _strdup(tok->val);
+    node->identifier = ast_token_strdup(lexer, tok);
     if (!node->identifier) {
         ProPrintfChar("Error: Memory allocation failed for identifier\n");
         return -1;
@@ -3663,19 +3786,19 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     if (tok && (tok->type == tok_string || tok->type == tok_identifier || tok->type == tok_number || tok->type == tok_lparen || tok->type == tok_minus)) {  // Potential start of expression
         node->name = parse_expression(lexer, i, NULL);  // Pass NULL for st if not needed yet
         if (!node->name) {
-            ProPrintfChar("Error: Failed to parse table name expression at line %zu\n", tok->loc.line);
+            ProPrintfChar("Error: Failed to parse table name expression at line %zu\n", (size_t)tok->line);
             goto cleanup;
         }
     }
     else {
         // Default to identifier as string literal if no name provided
-        node->name = malloc(sizeof(ExpressionNode));
+        node->name = ast_calloc(1, sizeof(ExpressionNode));
         if (!node->name) {
             ProPrintfChar("Error: Memory allocation failed for default name\n");
             goto cleanup;
         }
         node->name->type = EXPR_LITERAL_STRING;
-        node->name->data.string_val = _strdup(node->identifier);
+        node->name->data.string_val = ast_strdup(node->identifier);
         if (!node->name->data.string_val) {
             ProPrintfChar("Error: Memory allocation failed for default name string\n");
             goto cleanup;
@@ -3685,25 +3808,25 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     // Step 3: Parse optional TABLE_OPTION (array of ExpressionNode*)
     tok = current_token(lexer, i);
     int actual_option_count = 0;  // New: Track logical options (names), excluding args
-    if (tok && tok->type == tok_keyword && strcmp(tok->val, "TABLE_OPTION") == 0) {
+    if (tok && tok->word == WORD_TABLE_OPTION) {
         (*i)++;  // Consume TABLE_OPTION
         int option_capacity = 4;
-        node->options = malloc(option_capacity * sizeof(ExpressionNode*));
+        node->options = ast_malloc(option_capacity * sizeof(ExpressionNode*));
         if (!node->options) {
             ProPrintfChar("Error: Memory allocation failed for options\n");
             goto cleanup;
         }
-        size_t current_line = tok->loc.line;  // Use line of TABLE_OPTION for reference
+        size_t current_line = (size_t)tok->line;  // Use line of TABLE_OPTION for reference
         tok = current_token(lexer, i);
-        while (tok && tok->loc.line == current_line && tok->type != tok_keyword) {  // Parse expressions on the same line
+        while (tok && (size_t)tok->line == current_line && tok->type != tok_keyword) {  // Parse expressions on the same line
             ExpressionNode* option = parse_expression(lexer, i, NULL);
             if (!option) {
-                ProPrintfChar("Error: Failed to parse TABLE_OPTION expression at line %zu\n", tok->loc.line);
+                ProPrintfChar("Error: Failed to parse TABLE_OPTION expression at line %zu\n", (size_t)tok->line);
                 goto cleanup;
             }
             if (node->option_count >= option_capacity) {
                 option_capacity *= 2;
-                ExpressionNode** new_options = realloc(node->options, option_capacity * sizeof(ExpressionNode*));
+                ExpressionNode** new_options = ast_realloc(node->options, option_capacity * sizeof(ExpressionNode*));
                 if (!new_options) {
                     ProPrintfChar("Error: Memory reallocation failed for options\n");
                     goto cleanup;
@@ -3816,55 +3939,55 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     // This saves memory and reinforces that raw expressions are no longer needed
     if (node->options) {
         for (int j = 0; j < node->option_count; j++) free_expression(node->options[j]);
-        free(node->options);
+        ast_free(node->options);
         node->options = NULL;
         node->option_count = 0;  // Reset count to reflect no unprocessed options
     }
 
     // Step 4: Parse SEL_STRING (array of ExpressionNode*)
     tok = current_token(lexer, i);
-    if (!tok || tok->type != tok_keyword || strcmp(tok->val, "SEL_STRING") != 0) {
-        ProPrintfChar("Error: Expected 'SEL_STRING' at line %zu\n", tok ? tok->loc.line : (*i > 0 ? lexer->tokens[*i - 1].loc.line : 0));
+    if (!tok || tok->word != WORD_SEL_STRING) {
+        ProPrintfChar("Error: Expected 'SEL_STRING' at line %zu\n", tok ? (size_t)tok->line : (*i > 0 ? (size_t)lexer->tokens[*i - 1].line : 0));
         goto cleanup;
     }
     (*i)++;  // Consume SEL_STRING
 
     // Allocate initial capacity for sel_strings
     int sel_capacity = 4;
-    node->sel_strings = malloc(sel_capacity * sizeof(ExpressionNode*));
+    node->sel_strings = ast_malloc(sel_capacity * sizeof(ExpressionNode*));
     if (!node->sel_strings) {
         ProPrintfChar("Error: Memory allocation failed for sel_strings\n");
         goto cleanup;
     }
 
     // Insert "SEL_STRING" as the first sel_string (for the implicit first column header)
-    ExpressionNode* first_sel = malloc(sizeof(ExpressionNode));
+    ExpressionNode* first_sel = ast_calloc(1, sizeof(ExpressionNode));
     if (!first_sel) {
         ProPrintfChar("Error: Memory allocation failed for first sel_string\n");
         goto cleanup;
     }
     first_sel->type = EXPR_LITERAL_STRING;
-    first_sel->data.string_val = _strdup("SEL_STRING");
+    first_sel->data.string_val = ast_strdup("SEL_STRING");
     if (!first_sel->data.string_val) {
         ProPrintfChar("Error: Memory allocation failed for 'SEL_STRING' string\n");
-        free(first_sel);
+        ast_free(first_sel);
         goto cleanup;
     }
     node->sel_strings[0] = first_sel;
     node->sel_string_count = 1;
 
     // Parse remaining sel_strings on the same line
-    size_t sel_line = tok->loc.line;
+    size_t sel_line = (size_t)tok->line;
     tok = current_token(lexer, i);
-    while (tok && tok->loc.line == sel_line && tok->type != tok_keyword) {
+    while (tok && (size_t)tok->line == sel_line && tok->type != tok_keyword) {
         ExpressionNode* sel = parse_expression(lexer, i, NULL);
         if (!sel) {
-            ProPrintfChar("Error: Failed to parse SEL_STRING expression at line %zu\n", tok->loc.line);
+            ProPrintfChar("Error: Failed to parse SEL_STRING expression at line %zu\n", (size_t)tok->line);
             goto cleanup;
         }
         if (node->sel_string_count >= sel_capacity) {
             sel_capacity *= 2;
-            ExpressionNode** new_sels = realloc(node->sel_strings, sel_capacity * sizeof(ExpressionNode*));
+            ExpressionNode** new_sels = ast_realloc(node->sel_strings, sel_capacity * sizeof(ExpressionNode*));
             if (!new_sels) {
                 ProPrintfChar("Error: Memory reallocation failed for sel_strings\n");
                 goto cleanup;
@@ -3881,22 +4004,22 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
     // Step 5: Parse data types (array of ExpressionNode*)
     tok = current_token(lexer, i);
-    if (!tok || tok->type != tok_type || strcmp(tok->val, "STRING") != 0) {
-        ProPrintfChar("Error: Expected 'STRING' as first data type at line %zu\n", tok ? tok->loc.line : (*i > 0 ? lexer->tokens[*i - 1].loc.line : 0));
+    if (!tok || tok->type != tok_type || !token_is(lexer, tok, "STRING")) {
+        ProPrintfChar("Error: Expected 'STRING' as first data type at line %zu\n", tok ? (size_t)tok->line : (*i > 0 ? (size_t)lexer->tokens[*i - 1].line : 0));
         goto cleanup;
     }
     int type_capacity = node->column_count;
-    node->data_types = malloc(type_capacity * sizeof(ExpressionNode*));
+    node->data_types = ast_malloc(type_capacity * sizeof(ExpressionNode*));
     if (!node->data_types) {
         ProPrintfChar("Error: Memory allocation failed for data_types\n");
         goto cleanup;
     }
-    size_t type_line = tok->loc.line;
+    size_t type_line = (size_t)tok->line;
     int type_idx = 0;
-    while (tok && tok->loc.line == type_line && tok->type != tok_keyword && type_idx < node->column_count) {
+    while (tok && (size_t)tok->line == type_line && tok->type != tok_keyword && type_idx < node->column_count) {
         ExpressionNode* dtype = parse_expression(lexer, i, NULL);
         if (!dtype) {
-            ProPrintfChar("Error: Failed to parse data type expression at line %zu\n", tok->loc.line);
+            ProPrintfChar("Error: Failed to parse data type expression at line %zu\n", (size_t)tok->line);
             goto cleanup;
         }
         node->data_types[type_idx++] = dtype;
@@ -3911,16 +4034,16 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
     // Step 6: Parse rows (ExpressionNode***: array of rows, each an array of ExpressionNode*)
     int row_capacity = 4;
-    node->rows = malloc(row_capacity * sizeof(ExpressionNode**));
+    node->rows = ast_malloc(row_capacity * sizeof(ExpressionNode**));
     if (!node->rows) {
         ProPrintfChar("Error: Memory allocation failed for rows\n");
         goto cleanup;
     }
     tok = current_token(lexer, i);
-    while (tok && !(tok->type == tok_keyword && strcmp(tok->val, "END_TABLE") == 0)) {
+    while (tok && tok->word != WORD_END_TABLE) {
         if (node->row_count >= row_capacity) {
             row_capacity *= 2;
-            ExpressionNode*** new_rows = realloc(node->rows, row_capacity * sizeof(ExpressionNode**));
+            ExpressionNode*** new_rows = ast_realloc(node->rows, row_capacity * sizeof(ExpressionNode**));
             if (!new_rows) {
                 ProPrintfChar("Error: Memory reallocation failed for rows\n");
                 goto cleanup;
@@ -3928,7 +4051,7 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             node->rows = new_rows;
         }
         // Allocate row
-        ExpressionNode** row = malloc(node->column_count * sizeof(ExpressionNode*));
+        ExpressionNode** row = ast_malloc(node->column_count * sizeof(ExpressionNode*));
         if (!row) {
             ProPrintfChar("Error: Memory allocation failed for row %d\n", node->row_count);
             goto cleanup;
@@ -3937,15 +4060,15 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         for (int c = 0; c < node->column_count; c++) {
             row[c] = NULL;
         }
-        size_t row_line = tok->loc.line;
+        size_t row_line = (size_t)tok->line;
         int col_idx = 0;
-        while (tok && tok->loc.line == row_line && !(tok->type == tok_keyword && strcmp(tok->val, "END_TABLE") == 0) && col_idx < node->column_count) {
+        while (tok && (size_t)tok->line == row_line && tok->word != WORD_END_TABLE && col_idx < node->column_count) {
             ExpressionNode* cell = parse_expression(lexer, i, NULL);
             if (!cell) {
                 ProPrintfChar("Error: Failed to parse row %d column %d expression at line %zu\n",
-                    node->row_count, col_idx, tok ? tok->loc.line : 0);
+                    node->row_count, col_idx, tok ? (size_t)tok->line : 0);
                 for (int c = 0; c < col_idx; c++) free_expression(row[c]);
-                free(row);
+                ast_free(row);
                 goto cleanup;
             }
             row[col_idx++] = cell;
@@ -3955,7 +4078,7 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
         if (col_idx > node->column_count) {
             ProPrintfChar("Error: Row %d has too many columns (%d > %d) at line %zu\n", node->row_count, col_idx, node->column_count, row_line);
             for (int c = 0; c < col_idx; c++) free_expression(row[c]);
-            free(row);
+            ast_free(row);
             goto cleanup;
         }
         node->rows[node->row_count++] = row;
@@ -3963,7 +4086,7 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
     }
 
     // Step 7: Consume END_TABLE
-    if (!tok || tok->type != tok_keyword || strcmp(tok->val, "END_TABLE") != 0) {
+    if (!tok || tok->word != WORD_END_TABLE) {
         ProPrintfChar("Error: Expected 'END_TABLE' to close table block\n");
         goto cleanup;
     }
@@ -3981,7 +4104,7 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
             for (int c = 0; c < node->column_count; c++) {
                 char* cell_str = expression_to_string(node->rows[r][c]);
                 LogOnlyPrintfChar("  Column %d: %s\n", c, cell_str ? cell_str : "NULL");
-                free(cell_str);  // Free to prevent memory leaks
+                ast_free(cell_str);  // Free to prevent memory leaks
             }
         }
     }
@@ -3990,26 +4113,26 @@ int parse_begin_table(Lexer* lexer, size_t* i, CommandData* parsed_data) {
 
 cleanup:
     // Free allocated resources
-    free(node->identifier);
+    ast_free(node->identifier);
     free_expression(node->name);
     if (node->options) {
         for (int j = 0; j < node->option_count; j++) free_expression(node->options[j]);
-        free(node->options);
+        ast_free(node->options);
     }
     if (node->sel_strings) {
         for (int j = 0; j < node->sel_string_count; j++) free_expression(node->sel_strings[j]);
-        free(node->sel_strings);
+        ast_free(node->sel_strings);
     }
     if (node->data_types) {
         for (int j = 0; j < node->data_type_count; j++) free_expression(node->data_types[j]);
-        free(node->data_types);
+        ast_free(node->data_types);
     }
     if (node->rows) {
         for (int r = 0; r < node->row_count; r++) {
             for (int c = 0; c < node->column_count; c++) free_expression(node->rows[r][c]);
-            free(node->rows[r]);
+            ast_free(node->rows[r]);
         }
-        free(node->rows);
+        ast_free(node->rows);
     }
     // Reset node
     memset(node, 0, sizeof(TableNode));
@@ -4033,7 +4156,7 @@ int parse_invlaidate_param(Lexer* lexer, size_t* i, CommandData* parsed_data)
         ProPrintfChar("Error: Expected parameter identifer after INVALIDATE_PARAM\n");
         return -1;
     }
-    node->parameter = _strdup(tok->val);
+    node->parameter = ast_token_strdup(lexer, tok);
     if (!node->parameter)
     {
         ProPrintfChar("Error: Memory allocation failed for parameter name \n");
@@ -4047,7 +4170,7 @@ int parse_invlaidate_param(Lexer* lexer, size_t* i, CommandData* parsed_data)
     {
         (*i)++;
         tok = current_token(lexer, i);
-        if (tok && tok->type == tok_identifier && strcmp(tok->val, "in") == 0)
+        if (tok && tok->type == tok_identifier && token_is(lexer, tok, "in"))
         {
             (*i)++;
         }
@@ -4082,7 +4205,7 @@ static void consume_optional_inout_suffix(Lexer* lexer, size_t* i, const char* t
     if (t && t->type == tok_colon) {
         (*i)++;
         t = current_token(lexer, i);
-        if (t && t->type == tok_identifier && _stricmp(t->val, tag) == 0) {
+        if (t && t->type == tok_identifier && token_is_ci(lexer, t, tag)) {
             (*i)++; /* swallow expected tag */
         }
         else {
@@ -4112,16 +4235,16 @@ int parse_measure_distance(Lexer* lexer, size_t* i, CommandData* parsed_data)
         if (!t) break;
 
         if ((t->type == tok_option || t->type == tok_identifier) &&
-            (!strcmp(t->val, "ENABLE_CHECKBOX1") || !strcmp(t->val, "ENABLE_CHECKBOX2")))
+            (token_is(lexer, t, "ENABLE_CHECKBOX1") || token_is(lexer, t, "ENABLE_CHECKBOX2")))
         {
             int val = 1;
             (*i)++; /* consume option token */
             if (parse_bool_literal(lexer, i, &val) != 0) {
-                ProPrintfChar("Error: Expected TRUE/FALSE or 0/1 after %s at line %zu\n", t->val, t->loc.line);
+                ProPrintfChar("Error: Expected TRUE/FALSE or 0/1 after %.*s at line %zu\n", (int)t->length, token_text(lexer, t), (size_t)t->line);
                 free_measure_distance_node(node);
                 return -1;
             }
-            if (!strcmp(t->val, "ENABLE_CHECKBOX1")) node->enable_cb1 = (val != 0);
+            if (token_is(lexer, t, "ENABLE_CHECKBOX1")) node->enable_cb1 = (val != 0);
             else                                     node->enable_cb2 = (val != 0);
             continue;
         }
@@ -4170,7 +4293,7 @@ int parse_measure_distance(Lexer* lexer, size_t* i, CommandData* parsed_data)
     LogOnlyPrintfChar("MEASURE_DISTANCE: cb1=%d, cb2=%d, ref1=%s, ref2=%s, out=%s\n",
         node->enable_cb1, node->enable_cb2,
         r1 ? r1 : "<null>", r2 ? r2 : "<null>", pr ? pr : "<null>");
-    free(r1); free(r2); free(pr);
+    ast_free(r1); ast_free(r2); ast_free(pr);
 
     return 0;
 }
@@ -4230,8 +4353,8 @@ int parse_measure_length(Lexer* lexer, size_t* i, CommandData* parsed_data)
         char* pr = expression_to_string(node->parameterResult);
         LogOnlyPrintfChar("MeasureLengthNode: reference1=%s, parameterResult=%s\n",
             r1 ? r1 : "NULL", pr ? pr : "NULL");
-        free(r1);
-        free(pr);
+        ast_free(r1);
+        ast_free(pr);
     }
 
     return 0;
@@ -4265,22 +4388,22 @@ static void free_search_mdl_ref_node(SearchMdlRefNode* n)
 
     if (n->with_content) {
         for (size_t k = 0; k < n->with_content_count; ++k) free_expression(n->with_content[k]);
-        free(n->with_content);
+        ast_free(n->with_content);
     }
     if (n->with_content_not) {
         for (size_t k = 0; k < n->with_content_not_count; ++k) free_expression(n->with_content_not[k]);
-        free(n->with_content_not);
+        ast_free(n->with_content_not);
     }
     if (n->with_identifier) {
         for (size_t k = 0; k < n->with_identifier_count; ++k) free_expression(n->with_identifier[k]);
-        free(n->with_identifier);
+        ast_free(n->with_identifier);
     }
     if (n->with_identifier_not) {
         for (size_t k = 0; k < n->with_identifier_not_count; ++k) free_expression(n->with_identifier_not[k]);
-        free(n->with_identifier_not);
+        ast_free(n->with_identifier_not);
     }
 
-    free(n->out_reference);
+    ast_free(n->out_reference);
     memset(n, 0, sizeof(*n));
 }
 
@@ -4292,7 +4415,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
 
     /* default INCLUDE_MULTI_CAD := FALSE (as an expr node) */
     {
-        ExpressionNode* lit_false = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* lit_false = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!lit_false) { ProPrintfChar("Error: OOM in SEARCH_MDL_REF\n"); return -1; }
         lit_false->type = EXPR_LITERAL_BOOL;
         lit_false->data.bool_val = 0;
@@ -4305,17 +4428,17 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
         if (!t) break;
         if (t->type != tok_option && t->type != tok_identifier) break;
 
-        if (_stricmp(t->val, "RECURSIVE") == 0) { n->recursive = true; (*i)++; continue; }
-        else if (_stricmp(t->val, "ALLOW_SUPPRESSED") == 0) { n->allow_suppressed = true; (*i)++; continue; }
-        else if (_stricmp(t->val, "ALLOW_SIMPREP_SUPPRESSED") == 0) { n->allow_simprep_suppressed = true; (*i)++; continue; }
-        else if (_stricmp(t->val, "EXCLUDE_INHERITED") == 0) { n->exclude_inherited = true; (*i)++; continue; }
-        else if (_stricmp(t->val, "EXCLUDE_FOOTER") == 0) { n->exclude_footer = true; (*i)++; continue; }
-        else if (_stricmp(t->val, "NO_UPDATE") == 0) { n->no_update = true; (*i)++; continue; }
-        else if (_stricmp(t->val, "INCLUDE_MULTI_CAD") == 0) {
+        if (token_is_ci(lexer, t, "RECURSIVE")) { n->recursive = true; (*i)++; continue; }
+        else if (token_is_ci(lexer, t, "ALLOW_SUPPRESSED")) { n->allow_suppressed = true; (*i)++; continue; }
+        else if (token_is_ci(lexer, t, "ALLOW_SIMPREP_SUPPRESSED")) { n->allow_simprep_suppressed = true; (*i)++; continue; }
+        else if (token_is_ci(lexer, t, "EXCLUDE_INHERITED")) { n->exclude_inherited = true; (*i)++; continue; }
+        else if (token_is_ci(lexer, t, "EXCLUDE_FOOTER")) { n->exclude_footer = true; (*i)++; continue; }
+        else if (token_is_ci(lexer, t, "NO_UPDATE")) { n->no_update = true; (*i)++; continue; }
+        else if (token_is_ci(lexer, t, "INCLUDE_MULTI_CAD")) {
             (*i)++; /* consume option */
             ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) {
-                ProPrintfChar("Error: Expected expression after INCLUDE_MULTI_CAD at line %zu\n", t->loc.line);
+                ProPrintfChar("Error: Expected expression after INCLUDE_MULTI_CAD at line %zu\n", (size_t)t->line);
                 free_search_mdl_ref_node(n); return -1;
             }
             free_expression(n->include_multi_cad);
@@ -4324,10 +4447,10 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
         }
 
         /* If we hit WITH_* it's the next phase */
-        if (_stricmp(t->val, "WITH_CONTENT") == 0 ||
-            _stricmp(t->val, "WITH_CONTENT_NOT") == 0 ||
-            _stricmp(t->val, "WITH_IDENTIFIER") == 0 ||
-            _stricmp(t->val, "WITH_IDENTIFIER_NOT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_CONTENT") ||
+            token_is_ci(lexer, t, "WITH_CONTENT_NOT") ||
+            token_is_ci(lexer, t, "WITH_IDENTIFIER") ||
+            token_is_ci(lexer, t, "WITH_IDENTIFIER_NOT")) {
             break;
         }
         break;
@@ -4358,7 +4481,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
         t = current_token(lexer, i);
         if (!t || (t->type != tok_option && t->type != tok_identifier)) break;
 
-        if (_stricmp(t->val, "WITH_CONTENT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_CONTENT")) {
             (*i)++; ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) {
                 ProPrintfChar("Error: WITH_CONTENT requires an expression\n");
@@ -4369,7 +4492,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
             }
             continue;
         }
-        if (_stricmp(t->val, "WITH_CONTENT_NOT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_CONTENT_NOT")) {
             (*i)++; ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) {
                 ProPrintfChar("Error: WITH_CONTENT_NOT requires an expression\n");
@@ -4380,7 +4503,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
             }
             continue;
         }
-        if (_stricmp(t->val, "WITH_IDENTIFIER") == 0) {
+        if (token_is_ci(lexer, t, "WITH_IDENTIFIER")) {
             (*i)++; ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) {
                 ProPrintfChar("Error: WITH_IDENTIFIER requires an expression\n");
@@ -4391,7 +4514,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
             }
             continue;
         }
-        if (_stricmp(t->val, "WITH_IDENTIFIER_NOT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_IDENTIFIER_NOT")) {
             (*i)++; ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) {
                 ProPrintfChar("Error: WITH_IDENTIFIER_NOT requires an expression\n");
@@ -4413,7 +4536,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
         ProPrintfChar("Error: Expected result reference identifier in SEARCH_MDL_REF\n");
         free_search_mdl_ref_node(n); return -1;
     }
-    n->out_reference = _strdup(t->val);
+    n->out_reference = ast_token_strdup(lexer, t);
     if (!n->out_reference) {
         ProPrintfChar("Error: OOM for out reference\n");
         free_search_mdl_ref_node(n); return -1;
@@ -4428,7 +4551,7 @@ int parse_search_mdl_ref(Lexer* lexer, size_t* i, CommandData* parsed_data)
         char* ss = expression_to_string(n->search_string);
         LogOnlyPrintfChar("SEARCH_MDL_REF: model=%s, type=%s, search=%s, out=%s\n",
             m ? m : "<null>", ty ? ty : "<null>", ss ? ss : "<null>", n->out_reference ? n->out_reference : "<null>");
-        free(m); free(ty); free(ss);
+        ast_free(m); ast_free(ty); ast_free(ss);
     }
 
     return 0;
@@ -4461,22 +4584,22 @@ void free_search_mdl_refs_node(SearchMdlRefsNode* n)
 
     if (n->with_content) {
         for (size_t k = 0; k < n->with_content_count; ++k) free_expression(n->with_content[k]);
-        free(n->with_content);
+        ast_free(n->with_content);
     }
     if (n->with_content_not) {
         for (size_t k = 0; k < n->with_content_not_count; ++k) free_expression(n->with_content_not[k]);
-        free(n->with_content_not);
+        ast_free(n->with_content_not);
     }
     if (n->with_identifier) {
         for (size_t k = 0; k < n->with_identifier_count; ++k) free_expression(n->with_identifier[k]);
-        free(n->with_identifier);
+        ast_free(n->with_identifier);
     }
     if (n->with_identifier_not) {
         for (size_t k = 0; k < n->with_identifier_not_count; ++k) free_expression(n->with_identifier_not[k]);
-        free(n->with_identifier_not);
+        ast_free(n->with_identifier_not);
     }
 
-    free(n->out_array);
+    ast_free(n->out_array);
     memset(n, 0, sizeof(*n));
 }
 
@@ -4488,7 +4611,7 @@ int parse_search_mdl_refs(Lexer* lexer, size_t* i, CommandData* parsed_data)
 
     /* default for INCLUDE_MULTI_CAD: FALSE (as an expression node) */
     {
-        ExpressionNode* lit_false = (ExpressionNode*)malloc(sizeof(ExpressionNode));
+        ExpressionNode* lit_false = (ExpressionNode*)ast_calloc(1, sizeof(ExpressionNode));
         if (!lit_false) { ProPrintfChar("Error: OOM in SEARCH_MDL_REFS\n"); return -1; }
         lit_false->type = EXPR_LITERAL_BOOL;
         lit_false->data.bool_val = 0;
@@ -4501,30 +4624,30 @@ int parse_search_mdl_refs(Lexer* lexer, size_t* i, CommandData* parsed_data)
         if (!t) break;
         if (t->type != tok_option && t->type != tok_identifier) break;
 
-        if (_stricmp(t->val, "RECURSIVE") == 0) {
+        if (token_is_ci(lexer, t, "RECURSIVE")) {
             n->recursive = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "ALLOW_SUPPRESSED") == 0) {
+        else if (token_is_ci(lexer, t, "ALLOW_SUPPRESSED")) {
             n->allow_suppressed = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "ALLOW_SIMPREP_SUPPRESSED") == 0) {
+        else if (token_is_ci(lexer, t, "ALLOW_SIMPREP_SUPPRESSED")) {
             n->allow_simprep_suppressed = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "EXCLUDE_INHERITED") == 0) {
+        else if (token_is_ci(lexer, t, "EXCLUDE_INHERITED")) {
             n->exclude_inherited = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "EXCLUDE_FOOTER") == 0) {
+        else if (token_is_ci(lexer, t, "EXCLUDE_FOOTER")) {
             n->exclude_footer = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "NO_UPDATE") == 0) {
+        else if (token_is_ci(lexer, t, "NO_UPDATE")) {
             n->no_update = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "INCLUDE_MULTI_CAD") == 0) {
+        else if (token_is_ci(lexer, t, "INCLUDE_MULTI_CAD")) {
             (*i)++; /* consume the option */
             /* one expression (bool-ish), e.g. TRUE or &flag */
             ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) {
-                ProPrintfChar("Error: Expected expression after INCLUDE_MULTI_CAD at line %zu\n", t->loc.line);
+                ProPrintfChar("Error: Expected expression after INCLUDE_MULTI_CAD at line %zu\n", (size_t)t->line);
                 free_search_mdl_refs_node(n);
                 return -1;
             }
@@ -4534,10 +4657,10 @@ int parse_search_mdl_refs(Lexer* lexer, size_t* i, CommandData* parsed_data)
         }
 
         /* stop if we hit a different option (likely a WITH_* clause) */
-        if (_stricmp(t->val, "WITH_CONTENT") == 0 ||
-            _stricmp(t->val, "WITH_CONTENT_NOT") == 0 ||
-            _stricmp(t->val, "WITH_IDENTIFIER") == 0 ||
-            _stricmp(t->val, "WITH_IDENTIFIER_NOT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_CONTENT") ||
+            token_is_ci(lexer, t, "WITH_CONTENT_NOT") ||
+            token_is_ci(lexer, t, "WITH_IDENTIFIER") ||
+            token_is_ci(lexer, t, "WITH_IDENTIFIER_NOT")) {
             break;
         }
         /* not one of ours -> end options */
@@ -4572,28 +4695,28 @@ int parse_search_mdl_refs(Lexer* lexer, size_t* i, CommandData* parsed_data)
         t = current_token(lexer, i);
         if (!t || (t->type != tok_option && t->type != tok_identifier)) break;
 
-        if (_stricmp(t->val, "WITH_CONTENT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_CONTENT")) {
             (*i)++; /* consume */
             ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) { ProPrintfChar("Error: WITH_CONTENT requires an expression\n"); free_search_mdl_refs_node(n); return -1; }
             if (add_expr(&n->with_content, &n->with_content_count, &cap_c, e) != 0) { free_expression(e); free_search_mdl_refs_node(n); return -1; }
             continue;
         }
-        if (_stricmp(t->val, "WITH_CONTENT_NOT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_CONTENT_NOT")) {
             (*i)++;
             ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) { ProPrintfChar("Error: WITH_CONTENT_NOT requires an expression\n"); free_search_mdl_refs_node(n); return -1; }
             if (add_expr(&n->with_content_not, &n->with_content_not_count, &cap_cn, e) != 0) { free_expression(e); free_search_mdl_refs_node(n); return -1; }
             continue;
         }
-        if (_stricmp(t->val, "WITH_IDENTIFIER") == 0) {
+        if (token_is_ci(lexer, t, "WITH_IDENTIFIER")) {
             (*i)++;
             ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) { ProPrintfChar("Error: WITH_IDENTIFIER requires an expression\n"); free_search_mdl_refs_node(n); return -1; }
             if (add_expr(&n->with_identifier, &n->with_identifier_count, &cap_i, e) != 0) { free_expression(e); free_search_mdl_refs_node(n); return -1; }
             continue;
         }
-        if (_stricmp(t->val, "WITH_IDENTIFIER_NOT") == 0) {
+        if (token_is_ci(lexer, t, "WITH_IDENTIFIER_NOT")) {
             (*i)++;
             ExpressionNode* e = parse_expression(lexer, i, NULL);
             if (!e) { ProPrintfChar("Error: WITH_IDENTIFIER_NOT requires an expression\n"); free_search_mdl_refs_node(n); return -1; }
@@ -4612,7 +4735,7 @@ int parse_search_mdl_refs(Lexer* lexer, size_t* i, CommandData* parsed_data)
         free_search_mdl_refs_node(n);
         return -1;
     }
-    n->out_array = _strdup(t->val);
+    n->out_array = ast_token_strdup(lexer, t);
     if (!n->out_array) {
         ProPrintfChar("Error: OOM for array name in SEARCH_MDL_REFS\n");
         free_search_mdl_refs_node(n);
@@ -4632,7 +4755,7 @@ int parse_search_mdl_refs(Lexer* lexer, size_t* i, CommandData* parsed_data)
             n->out_array ? n->out_array : "<null>");
         LogOnlyPrintfChar("    model=%s, type=%s, search=%s\n",
             m ? m : "<null>", ty ? ty : "<null>", ss ? ss : "<null>");
-        free(m); free(ty); free(ss);
+        ast_free(m); ast_free(ty); ast_free(ss);
     }
 
     return 0;
@@ -4646,7 +4769,7 @@ static void free_catch_error_node(CatchErrorNode* n) {
         for (size_t k = 0; k < n->command_count; ++k) {
             free_command_node(n->commands[k]);
         }
-        free(n->commands);
+        ast_free(n->commands);
     }
     memset(n, 0, sizeof(*n));
 }
@@ -4666,10 +4789,10 @@ static int parse_begin_catch_error(Lexer* lexer, size_t* i, CommandData* parsed_
         if (!t) break;
         if (t->type != tok_option && t->type != tok_identifier) break;
 
-        if (_stricmp(t->val, "FIX_FAIL_UDF") == 0) {
+        if (token_is_ci(lexer, t, "FIX_FAIL_UDF")) {
             node->fix_fail_udf = true; (*i)++; continue;
         }
-        else if (_stricmp(t->val, "FIX_FAIL_COMPONENT") == 0) {
+        else if (token_is_ci(lexer, t, "FIX_FAIL_COMPONENT")) {
             node->fix_fail_component = true; (*i)++; continue;
         }
 
@@ -4679,7 +4802,7 @@ static int parse_begin_catch_error(Lexer* lexer, size_t* i, CommandData* parsed_
 
     /* ---- nested commands until END_CATCH_ERROR ---- */
     size_t cap = 4;
-    node->commands = (CommandNode**)malloc(cap * sizeof(CommandNode*));
+    node->commands = (CommandNode**)ast_malloc(cap * sizeof(CommandNode*));
     if (!node->commands) {
         ProPrintfChar("Error: Memory allocation failed in BEGIN_CATCH_ERROR\n");
         return -1;
@@ -4688,14 +4811,14 @@ static int parse_begin_catch_error(Lexer* lexer, size_t* i, CommandData* parsed_
 
     TokenData* tok = NULL;
     while ((tok = current_token(lexer, i)) != NULL) {
-        if (tok->type == tok_keyword && strcmp(tok->val, "END_CATCH_ERROR") == 0) {
+        if (tok->word == WORD_END_CATCH_ERROR) {
             break;
         }
         CommandNode* inner = parse_command(lexer, i, NULL);
         if (inner) {
             if (node->command_count >= cap) {
                 cap = cap ? cap * 2 : 4;
-                CommandNode** tmp = (CommandNode**)realloc(node->commands, cap * sizeof(CommandNode*));
+                CommandNode** tmp = (CommandNode**)ast_realloc(node->commands, cap * sizeof(CommandNode*));
                 if (!tmp) {
                     ProPrintfChar("Error: Realloc failed in BEGIN_CATCH_ERROR body\n");
                     free_catch_error_node(node);
@@ -4714,7 +4837,7 @@ static int parse_begin_catch_error(Lexer* lexer, size_t* i, CommandData* parsed_
 
     /* require END_CATCH_ERROR (same spirit as END_IF requirement) */
     tok = current_token(lexer, i);
-    if (!tok || tok->type != tok_keyword || strcmp(tok->val, "END_CATCH_ERROR") != 0) {
+    if (!tok || tok->word != WORD_END_CATCH_ERROR) {
         ProPrintfChar("Error: Expected END_CATCH_ERROR to close BEGIN_CATCH_ERROR block\n");
         free_catch_error_node(node);
         return -1;
@@ -4737,7 +4860,7 @@ static int parse_begin_catch_error(Lexer* lexer, size_t* i, CommandData* parsed_
 \*=================================================*/
 static int add_if_branch(IfNode* if_node, IfBranch* branch) {
     if (!branch) return -1;
-    IfBranch** new_branches = realloc(if_node->branches, (if_node->branch_count + 1) * sizeof(IfBranch*));
+    IfBranch** new_branches = ast_realloc(if_node->branches, (if_node->branch_count + 1) * sizeof(IfBranch*));
     if (!new_branches) {
         return -1;  // Memory failure
     }
@@ -4750,7 +4873,7 @@ static int add_command_to_list(CommandNode*** commands_ptr, size_t* count, size_
     if (!cmd) return -1;
     if (*count >= *capacity) {
         *capacity = *capacity ? *capacity * 2 : 4;
-        CommandNode** new_commands = realloc(*commands_ptr, *capacity * sizeof(CommandNode*));
+        CommandNode** new_commands = ast_realloc(*commands_ptr, *capacity * sizeof(CommandNode*));
         if (!new_commands) {
             return -1;
         }
@@ -4762,13 +4885,13 @@ static int add_command_to_list(CommandNode*** commands_ptr, size_t* count, size_
 
 CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
     TokenData* tok = current_token(lexer, i);
-    if (!tok || tok->type != tok_keyword || strcmp(tok->val, "IF") != 0) {
+    if (!tok || tok->word != WORD_IF) {
         return NULL; /* not an IF */
     }
     (*i)++; /* consume IF */
 
     /* allocate IfNode */
-    IfNode* if_node = (IfNode*)malloc(sizeof(IfNode));
+    IfNode* if_node = (IfNode*)ast_malloc(sizeof(IfNode));
     if (!if_node) {
         ProPrintfChar("Error: Memory allocation failed for IfNode\n");
         return NULL;
@@ -4777,51 +4900,55 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
     if_node->branch_count = 0;
     if_node->else_commands = NULL;
     if_node->else_command_count = 0;
+    if_node->winner_epoch = 0;
+    if_node->winner_change = 0;
+    if_node->winner = -1;
+    if_node->winner_status = 0;
+    if_node->winner_evals = 0;
 
     /* assign a unique id for later tracking */
     if_node->id = ++s_if_id_counter;
     LogOnlyPrintfChar("IfNode: assigned id=%d at line %zu\n",
-        if_node->id, tok->loc.line);
+        if_node->id, (size_t)tok->line);
 
     /* parse initial IF condition */
     ExpressionNode* condition = parse_expression(lexer, i, st);
     if (!condition) {
         ProPrintfChar("Error: Expected condition after IF\n");
-        free(if_node);
+        ast_free(if_node);
         return NULL;
     }
     {
         char* cond_str = expression_to_string(condition);
         LogOnlyPrintfChar("IfNode[%d] initial IF condition: %s\n",
             if_node->id, cond_str ? cond_str : "NULL");
-        free(cond_str);
+        ast_free(cond_str);
     }
 
     /* first branch */
-    IfBranch* branch = (IfBranch*)malloc(sizeof(IfBranch));
+    IfBranch* branch = (IfBranch*)ast_malloc(sizeof(IfBranch));
     if (!branch) {
         free_expression(condition);
-        free(if_node);
+        ast_free(if_node);
         return NULL;
     }
     branch->condition = condition;
     branch->commands = NULL;
     branch->command_count = 0;
     size_t branch_capacity = 4;
-    branch->commands = (CommandNode**)malloc(branch_capacity * sizeof(CommandNode*));
+    branch->commands = (CommandNode**)ast_malloc(branch_capacity * sizeof(CommandNode*));
     if (!branch->commands) {
         free_expression(condition);
-        free(branch);
-        free(if_node);
+        ast_free(branch);
+        ast_free(if_node);
         return NULL;
     }
 
     /* parse commands for the first branch until ELSE_IF/ELSE/END_IF */
     while ((tok = current_token(lexer, i)) != NULL) {
-        if (tok->type == tok_keyword &&
-            (strcmp(tok->val, "ELSE_IF") == 0 ||
-                strcmp(tok->val, "ELSE") == 0 ||
-                strcmp(tok->val, "END_IF") == 0)) {
+        if (tok->word == WORD_ELSE_IF ||
+            tok->word == WORD_ELSE ||
+            tok->word == WORD_END_IF) {
             break;
         }
         CommandNode* inner = parse_command(lexer, i, st);
@@ -4842,8 +4969,7 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
 
     /* parse zero or more ELSE_IF branches */
     while ((tok = current_token(lexer, i)) != NULL &&
-        tok->type == tok_keyword &&
-        strcmp(tok->val, "ELSE_IF") == 0) {
+        tok->word == WORD_ELSE_IF) {
         (*i)++; /* consume ELSE_IF */
         condition = parse_expression(lexer, i, st);
         if (!condition) {
@@ -4854,10 +4980,10 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
             char* cond_str = expression_to_string(condition);
             LogOnlyPrintfChar("IfNode[%d] ELSE_IF condition: %s\n",
                 if_node->id, cond_str ? cond_str : "NULL");
-            free(cond_str);
+            ast_free(cond_str);
         }
 
-        branch = (IfBranch*)malloc(sizeof(IfBranch));
+        branch = (IfBranch*)ast_malloc(sizeof(IfBranch));
         if (!branch) {
             free_expression(condition);
             goto cleanup_if;
@@ -4866,19 +4992,18 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
         branch->commands = NULL;
         branch->command_count = 0;
         branch_capacity = 4;
-        branch->commands = (CommandNode**)malloc(branch_capacity * sizeof(CommandNode*));
+        branch->commands = (CommandNode**)ast_malloc(branch_capacity * sizeof(CommandNode*));
         if (!branch->commands) {
             free_expression(condition);
-            free(branch);
+            ast_free(branch);
             goto cleanup_if;
         }
 
         /* parse commands for this ELSE_IF until next ELSE_IF/ELSE/END_IF */
         while ((tok = current_token(lexer, i)) != NULL) {
-            if (tok->type == tok_keyword &&
-                (strcmp(tok->val, "ELSE_IF") == 0 ||
-                    strcmp(tok->val, "ELSE") == 0 ||
-                    strcmp(tok->val, "END_IF") == 0)) {
+            if (tok->word == WORD_ELSE_IF ||
+                tok->word == WORD_ELSE ||
+                tok->word == WORD_END_IF) {
                 break;
             }
             CommandNode* inner = parse_command(lexer, i, st);
@@ -4886,8 +5011,8 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
                 if (add_command_to_list(&branch->commands, &branch->command_count, &branch_capacity, inner) != 0) {
                     free_command_node(inner);
                     free_expression(condition);
-                    free(branch->commands);
-                    free(branch);
+                    ast_free(branch->commands);
+                    ast_free(branch);
                     goto cleanup_if;
                 }
             }
@@ -4903,17 +5028,17 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
 
     /* optional ELSE block */
     if ((tok = current_token(lexer, i)) != NULL &&
-        tok->type == tok_keyword && strcmp(tok->val, "ELSE") == 0) {
+        tok->word == WORD_ELSE) {
         (*i)++; /* consume ELSE */
         size_t else_capacity = 4;
-        if_node->else_commands = (CommandNode**)malloc(else_capacity * sizeof(CommandNode*));
+        if_node->else_commands = (CommandNode**)ast_malloc(else_capacity * sizeof(CommandNode*));
         if (!if_node->else_commands) {
             goto cleanup_if;
         }
         if_node->else_command_count = 0;
 
         while ((tok = current_token(lexer, i)) != NULL) {
-            if (tok->type == tok_keyword && strcmp(tok->val, "END_IF") == 0) {
+            if (tok->word == WORD_END_IF) {
                 break;
             }
             CommandNode* inner = parse_command(lexer, i, st);
@@ -4932,26 +5057,27 @@ CommandNode* parse_if_command(Lexer* lexer, size_t* i, SymbolTable* st) {
 
     /* require END_IF */
     if ((tok = current_token(lexer, i)) == NULL ||
-        tok->type != tok_keyword || strcmp(tok->val, "END_IF") != 0) {
+        tok->word != WORD_END_IF) {
         ProPrintfChar("Error: Expected END_IF to close IF block\n");
         goto cleanup_if;
     }
     (*i)++; /* consume END_IF */
 
     /* wrap into CommandNode */
-    CommandNode* cmd_node = (CommandNode*)malloc(sizeof(CommandNode));
+    CommandNode* cmd_node = (CommandNode*)ast_malloc(sizeof(CommandNode));
     if (!cmd_node) {
         goto cleanup_if;
     }
     cmd_node->type = COMMAND_IF;
-    cmd_node->data = (CommandData*)malloc(sizeof(CommandData));
+    cmd_node->semantic_valid = true;
+    cmd_node->data = (CommandData*)ast_malloc(sizeof(CommandData));
     if (!cmd_node->data) {
-        free(cmd_node);
+        ast_free(cmd_node);
         goto cleanup_if;
     }
     /* copy the fully built IfNode into the union */
     cmd_node->data->ifcommand = *if_node;
-    free(if_node);
+    ast_free(if_node);
 
     LogOnlyPrintfChar("IfNode[%d]: branch_count=%zu, else_command_count=%zu\n",
         cmd_node->data->ifcommand.id,
@@ -4970,86 +5096,100 @@ cleanup_if:
                 for (size_t c = 0; c < br->command_count; ++c) {
                     free_command_node(br->commands[c]);
                 }
-                free(br->commands);
-                free(br);
+                ast_free(br->commands);
+                ast_free(br);
             }
         }
-        free(if_node->branches);
+        ast_free(if_node->branches);
         for (size_t c = 0; c < if_node->else_command_count; ++c) {
             free_command_node(if_node->else_commands[c]);
         }
-        free(if_node->else_commands);
-        free(if_node);
+        ast_free(if_node->else_commands);
+        ast_free(if_node);
     }
     return NULL;
 }
 
 // Command table
 CommandEntry command_table[] = {
-    {"DECLARE_VARIABLE", COMMAND_DECLARE_VARIABLE, parse_declare_variable},
-    {"GLOBAL_PICTURE", COMMAND_GLOBAL_PICTURE, parse_global_picture},
-    {"SUB_PICTURE", COMMAND_SUB_PICTURE, parse_sub_picture},
-    {"CONFIG_ELEM", COMMAND_CONFIG_ELEM, parse_config_elem},
-    {"SHOW_PARAM", COMMAND_SHOW_PARAM, parse_show_param},
-    {"CHECKBOX_PARAM", COMMAND_CHECKBOX_PARAM, parse_checkbox_param},
-    {"USER_INPUT_PARAM", COMMAND_USER_INPUT_PARAM, parse_user_input_param},
-    {"RADIOBUTTON_PARAM", COMMAND_RADIOBUTTON_PARAM, parse_radiobutton_param},
-    {"USER_SELECT", COMMAND_USER_SELECT, parse_user_select},
-    {"USER_SELECT_MULTIPLE", COMMAND_USER_SELECT_MULTIPLE, parse_user_select_multiple},
-    {"USER_SELECT_MULTIPLE_OPTIONAL", COMMAND_USER_SELECT_MULTIPLE_OPTIONAL, parse_user_select_multiple_optional},
-    {"USER_SELECT_OPTIONAL", COMMAND_USER_SELECT_OPTIONAL, parse_user_select_optional},
-    {"INVALIDATE_PARAM", COMMAND_INVALIDATE_PARAM, parse_invlaidate_param},
-    {"BEGIN_TABLE", COMMAND_BEGIN_TABLE, parse_begin_table},
-    {"MEASURE_DISTANCE", COMMAND_MEASURE_DISTANCE, parse_measure_distance},
-    {"MEASURE_LENGTH", COMMAND_MEASURE_LENGTH, parse_measure_length},
-    {"SEARCH_MDL_REFS", COMMAND_SEARCH_MDL_REFS, parse_search_mdl_refs},
-    {"SEARCH_MDL_REF", COMMAND_SEARCH_MDL_REF, parse_search_mdl_ref},
-    {"BEGIN_CATCH_ERROR", COMMAND_BEGIN_CATCH_ERROR, parse_begin_catch_error},
+    {"DECLARE_VARIABLE", WORD_DECLARE_VARIABLE, COMMAND_DECLARE_VARIABLE, parse_declare_variable},
+    {"GLOBAL_PICTURE", WORD_GLOBAL_PICTURE, COMMAND_GLOBAL_PICTURE, parse_global_picture},
+    {"SUB_PICTURE", WORD_SUB_PICTURE, COMMAND_SUB_PICTURE, parse_sub_picture},
+    {"CONFIG_ELEM", WORD_CONFIG_ELEM, COMMAND_CONFIG_ELEM, parse_config_elem},
+    {"SHOW_PARAM", WORD_SHOW_PARAM, COMMAND_SHOW_PARAM, parse_show_param},
+    {"CHECKBOX_PARAM", WORD_CHECKBOX_PARAM, COMMAND_CHECKBOX_PARAM, parse_checkbox_param},
+    {"USER_INPUT_PARAM", WORD_USER_INPUT_PARAM, COMMAND_USER_INPUT_PARAM, parse_user_input_param},
+    {"RADIOBUTTON_PARAM", WORD_RADIOBUTTON_PARAM, COMMAND_RADIOBUTTON_PARAM, parse_radiobutton_param},
+    {"USER_SELECT", WORD_USER_SELECT, COMMAND_USER_SELECT, parse_user_select},
+    {"USER_SELECT_MULTIPLE", WORD_USER_SELECT_MULTIPLE, COMMAND_USER_SELECT_MULTIPLE, parse_user_select_multiple},
+    {"USER_SELECT_MULTIPLE_OPTIONAL", WORD_USER_SELECT_MULTIPLE_OPTIONAL, COMMAND_USER_SELECT_MULTIPLE_OPTIONAL, parse_user_select_multiple_optional},
+    {"USER_SELECT_OPTIONAL", WORD_USER_SELECT_OPTIONAL, COMMAND_USER_SELECT_OPTIONAL, parse_user_select_optional},
+    {"INVALIDATE_PARAM", WORD_INVALIDATE_PARAM, COMMAND_INVALIDATE_PARAM, parse_invlaidate_param},
+    {"BEGIN_TABLE", WORD_BEGIN_TABLE, COMMAND_BEGIN_TABLE, parse_begin_table},
+    {"MEASURE_DISTANCE", WORD_MEASURE_DISTANCE, COMMAND_MEASURE_DISTANCE, parse_measure_distance},
+    {"MEASURE_LENGTH", WORD_MEASURE_LENGTH, COMMAND_MEASURE_LENGTH, parse_measure_length},
+    {"SEARCH_MDL_REFS", WORD_SEARCH_MDL_REFS, COMMAND_SEARCH_MDL_REFS, parse_search_mdl_refs},
+    {"SEARCH_MDL_REF", WORD_SEARCH_MDL_REF, COMMAND_SEARCH_MDL_REF, parse_search_mdl_ref},
+    {"BEGIN_CATCH_ERROR", WORD_BEGIN_CATCH_ERROR, COMMAND_BEGIN_CATCH_ERROR, parse_begin_catch_error},
 
 
 };
 
+// command_table entry for a keyword, indexed by LexWord (built on first use)
+static const CommandEntry* find_command_entry(uint16_t word) {
+    static const CommandEntry* by_word[WORD_COUNT];
+    static int built = 0;
+    if (!built) {
+        size_t table_size = sizeof(command_table) / sizeof(command_table[0]);
+        for (size_t j = 0; j < table_size; j++) {
+            by_word[command_table[j].word] = &command_table[j];
+        }
+        built = 1;
+    }
+    return word < WORD_COUNT ? by_word[word] : NULL;
+}
+
 // Allocate data based on CommandType
 CommandData* allocate_data(CommandType type) {
     switch (type) {
     case COMMAND_CONFIG_ELEM:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_GLOBAL_PICTURE :
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_SUB_PICTURE:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_DECLARE_VARIABLE:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_SHOW_PARAM:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_CHECKBOX_PARAM:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_USER_INPUT_PARAM:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_RADIOBUTTON_PARAM:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_USER_SELECT:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_USER_SELECT_OPTIONAL:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_USER_SELECT_MULTIPLE:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_USER_SELECT_MULTIPLE_OPTIONAL:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_INVALIDATE_PARAM:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_BEGIN_TABLE:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_MEASURE_DISTANCE:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_MEASURE_LENGTH:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_SEARCH_MDL_REFS:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_SEARCH_MDL_REF:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     case COMMAND_BEGIN_CATCH_ERROR:
-        return malloc(sizeof(CommandData));
+        return ast_malloc(sizeof(CommandData));
     default:
         ProPrintf(L"Error: Unknown CommandType in allocate_data\n");
         return NULL;
@@ -5065,22 +5205,13 @@ CommandNode* parse_command(Lexer* lexer, size_t* i, SymbolTable* st) {
 
     /* Keyword-driven commands */
     if (lexer->tokens[*i].type == tok_keyword) {
-        const char* keyword = lexer->tokens[*i].val;
-
         /* No special-casing for BEGIN_TABLE here.
            It must be registered in command_table with its parser. */
-        CommandEntry* entry = NULL;
-        size_t table_size = sizeof(command_table) / sizeof(command_table[0]);
-        for (size_t j = 0; j < table_size; j++) {
-            if (strcmp(keyword, command_table[j].command_name) == 0) {
-                entry = &command_table[j];
-                break;
-            }
-        }
+        const CommandEntry* entry = find_command_entry(lexer->tokens[*i].word);
 
         if (!entry) {
-            printf("Warning: Unknown command '%s' at line %zu\n",
-                keyword, lexer->tokens[*i].loc.line);
+            printf("Warning: Unknown command '%.*s' at line %zu\n",
+                (int)lexer->tokens[*i].length, token_text(lexer, &lexer->tokens[*i]), (size_t)lexer->tokens[*i].line);
             (*i)++; /* consume the unknown keyword to make progress */
             return NULL;
         }
@@ -5088,23 +5219,24 @@ CommandNode* parse_command(Lexer* lexer, size_t* i, SymbolTable* st) {
         /* consume the keyword token */
         (*i)++;
 
-        CommandNode* node = (CommandNode*)malloc(sizeof(CommandNode));
+        CommandNode* node = (CommandNode*)ast_malloc(sizeof(CommandNode));
         if (!node) {
             printf("Memory allocation failed for CommandNode\n");
             return NULL;
         }
         node->type = entry->type;
+        node->semantic_valid = true;
         node->data = allocate_data(node->type);
         if (!node->data) {
             printf("Memory allocation failed for command data\n");
-            free(node);
+            ast_free(node);
             return NULL;
         }
 
         int result = entry->parser(lexer, i, node->data);
         if (result != 0) {
             printf("Error parsing '%s' at line %zu\n",
-                keyword, lexer->tokens[*i - 1].loc.line);
+                entry->command_name, (size_t)lexer->tokens[*i - 1].line);
             free_command_node(node);
             return NULL;
         }
@@ -5123,7 +5255,7 @@ CommandNode* parse_command(Lexer* lexer, size_t* i, SymbolTable* st) {
         ExpressionNode* expr = parse_expression(lexer, i, st);
         if (!expr) {
             ProPrintfChar("Error: Failed to parse expression at line %zu\n",
-                lexer->tokens[start].loc.line);
+                (size_t)lexer->tokens[start].line);
             return NULL;
         }
 
@@ -5133,21 +5265,21 @@ CommandNode* parse_command(Lexer* lexer, size_t* i, SymbolTable* st) {
             ExpressionNode* rhs = parse_expression(lexer, i, st);
             if (!rhs) {
                 ProPrintfChar("Error: Failed to parse RHS in assignment at line %zu\n",
-                    lexer->tokens[start].loc.line);
+                    (size_t)lexer->tokens[start].line);
                 free_expression(expr);
                 return NULL;
             }
 
-            CommandNode* node = (CommandNode*)malloc(sizeof(CommandNode));
+            CommandNode* node = (CommandNode*)ast_malloc(sizeof(CommandNode));
             if (!node) {
                 free_expression(expr);
                 free_expression(rhs);
                 return NULL;
             }
             node->type = COMMAND_ASSIGNMENT;
-            node->data = (CommandData*)malloc(sizeof(CommandData));
+            node->data = (CommandData*)ast_malloc(sizeof(CommandData));
             if (!node->data) {
-                free(node);
+                ast_free(node);
                 free_expression(expr);
                 free_expression(rhs);
                 return NULL;
@@ -5158,29 +5290,34 @@ CommandNode* parse_command(Lexer* lexer, size_t* i, SymbolTable* st) {
             node->data->assignment.lhs = expr;
             node->data->assignment.rhs = rhs;
             node->data->assignment.assign_id = ++s_assign_id_counter; /* new id */
-
-            /* logging */
-            char* lhs_str = expression_to_string(expr);
-            char* rhs_str = expression_to_string(rhs);
-            LogOnlyPrintfChar("Parsed assignment[%d]: %s = %s",
-                node->data->assignment.assign_id,
-                lhs_str ? lhs_str : "NULL",
-                rhs_str ? rhs_str : "NULL");
-            free(lhs_str);
-            free(rhs_str);
+            node->data->assignment.if_id = 0;
+            node->data->assignment.branch_index = -1;
+            node->data->assignment.lhs_slot = 0;
+
+            /* logging (debug only: rendering both sides allocates) */
+            if (log_enabled(LOG_LEVEL_DEBUG)) {
+                char* lhs_str = expression_to_string(expr);
+                char* rhs_str = expression_to_string(rhs);
+                log_write(LOG_LEVEL_DEBUG, "Parsed assignment[%d]: %s = %s",
+                    node->data->assignment.assign_id,
+                    lhs_str ? lhs_str : "NULL",
+                    rhs_str ? rhs_str : "NULL");
+                ast_free(lhs_str);
+                ast_free(rhs_str);
+            }
 
             return node;
         }
         else {
-            CommandNode* node = (CommandNode*)malloc(sizeof(CommandNode));
+            CommandNode* node = (CommandNode*)ast_malloc(sizeof(CommandNode));
             if (!node) {
                 free_expression(expr);
                 return NULL;
             }
             node->type = COMMAND_EXPRESSION;
-            node->data = (CommandData*)malloc(sizeof(CommandData));
+            node->data = (CommandData*)ast_malloc(sizeof(CommandData));
             if (!node->data) {
-                free(node);
+                ast_free(node);
                 free_expression(expr);
                 return NULL;
             }
@@ -5190,7 +5327,7 @@ CommandNode* parse_command(Lexer* lexer, size_t* i, SymbolTable* st) {
 
             char* expr_str = expression_to_string(node->data->expression);
             LogOnlyPrintfChar("Parsed standalone expression: %s", expr_str ? expr_str : "NULL");
-            free(expr_str);
+            ast_free(expr_str);
             return node;
         }
     }
@@ -5218,65 +5355,70 @@ Block* find_block(BlockList* block_list, BlockType type)
 
 // Parse blocks with dynamic memory allocation
 BlockList parse_blocks(Lexer* lexer, SymbolTable* st) {
-    BlockList block_list = { NULL, 0 };
+    BlockList block_list = { NULL, 0, NULL };
+    block_list.arena = arena_create(64 * 1024);
+    if (!block_list.arena) {
+        ProPrintfChar("Memory allocation failed for AST arena\n");
+        return block_list;
+    }
+    s_ast_arena = block_list.arena;
+
     size_t block_capacity = 4;
-    block_list.blocks = malloc(block_capacity * sizeof(Block));
+    block_list.blocks = ast_malloc(block_capacity * sizeof(Block));
     if (!block_list.blocks) {
         ProPrintfChar("Memory allocation failed for block list\n");
-        return (BlockList) { NULL, 0 };
+        goto fail;
     }
 
     size_t i = 0;
     while (i < lexer->token_count) {
-        if (lexer->tokens[i].type != tok_keyword || !lexer->tokens[i].val) {
+        if (lexer->tokens[i].type != tok_keyword) {
             i++;
             continue;
         }
 
         BlockType current_block_type = -1;
-        const char* end_keyword = NULL;
-        if (strcmp(lexer->tokens[i].val, "BEGIN_ASM_DESCR") == 0) {
+        LexWord end_word = WORD_NONE;
+        switch (lexer->tokens[i].word) {
+        case WORD_BEGIN_ASM_DESCR:
             current_block_type = BLOCK_ASM;
-            end_keyword = "END_ASM_DESCR";
-        }
-        else if (strcmp(lexer->tokens[i].val, "BEGIN_GUI_DESCR") == 0) {
+            end_word = WORD_END_ASM_DESCR;
+            break;
+        case WORD_BEGIN_GUI_DESCR:
             current_block_type = BLOCK_GUI;
-            end_keyword = "END_GUI_DESCR";
-        }
-        else if (strcmp(lexer->tokens[i].val, "BEGIN_TAB_DESCR") == 0) {
+            end_word = WORD_END_GUI_DESCR;
+            break;
+        case WORD_BEGIN_TAB_DESCR:
             current_block_type = BLOCK_TAB;
-            end_keyword = "END_TAB_DESCR";
-        }
-        else {
+            end_word = WORD_END_TAB_DESCR;
+            break;
+        default:
             i++;
             continue;
         }
 
         i++; // Skip BEGIN_ token
 
-        CommandNode** commands = malloc(4 * sizeof(CommandNode*));
+        CommandNode** commands = ast_malloc(4 * sizeof(CommandNode*));
         size_t cmd_count = 0;
         size_t cmd_capacity = 4;
         if (!commands) {
             ProPrintfChar("Memory allocation failed for commands\n");
-            free_block_list(&block_list);
-            return (BlockList) { NULL, 0 };
+            goto fail;
         }
 
         while (i < lexer->token_count) {
-            if (lexer->tokens[i].type == tok_keyword &&
-                strcmp(lexer->tokens[i].val, end_keyword) == 0) {
+            if (lexer->tokens[i].word == end_word) {
                 break;
             }
             CommandNode* cmd = parse_command(lexer, &i, st);
             if (cmd) {
                 if (cmd_count >= cmd_capacity) {
                     cmd_capacity *= 2;
-                    CommandNode** new_commands = realloc(commands, cmd_capacity * sizeof(CommandNode*));
+                    CommandNode** new_commands = ast_realloc(commands, cmd_capacity * sizeof(CommandNode*));
                     if (!new_commands) {
                         ProPrintfChar("Memory reallocation failed for commands\n");
-                        free_command_node(cmd);
-                        goto cleanup_commands;
+                        goto fail;
                     }
                     commands = new_commands;
                 }
@@ -5293,415 +5435,42 @@ BlockList parse_blocks(Lexer* lexer, SymbolTable* st) {
         Block block = { current_block_type, commands, cmd_count };
         if (block_list.block_count >= block_capacity) {
             block_capacity *= 2;
-            Block* new_blocks = realloc(block_list.blocks, block_capacity * sizeof(Block));
+            Block* new_blocks = ast_realloc(block_list.blocks, block_capacity * sizeof(Block));
             if (!new_blocks) {
                 ProPrintfChar("Memory reallocation failed for block list\n");
-                goto cleanup_commands;
+                goto fail;
             }
             block_list.blocks = new_blocks;
         }
         block_list.blocks[block_list.block_count++] = block;
         i++; // Skip END_ token
-        continue;
-
-    cleanup_commands:
-        for (size_t j = 0; j < cmd_count; j++) {
-            free_command_node(commands[j]);
-        }
-        free(commands);
-        free_block_list(&block_list);
-        return (BlockList) { NULL, 0 };
     }
 
+    s_ast_arena = NULL;
+    LogOnlyPrintfChar("Note: AST arena holds %zu bytes in %zu blocks\n",
+        block_list.arena->bytes_used, block_list.arena->block_count);
+    return block_list;
+
+fail:
+    s_ast_arena = NULL;
+    free_block_list(&block_list);
     return block_list;
 }
 
-// New: Free expression recursively
+// AST nodes live in the script arena (see parse_blocks) and are released together by
+// free_block_list; these stay as no-ops so parser error paths can drop partial nodes.
 void free_expression(ExpressionNode* expr) {
-    if (!expr) return;
-    switch (expr->type) {
-    case EXPR_LITERAL_STRING:
-    case EXPR_VARIABLE_REF:
-        free(expr->data.string_val);
-        break;
-    case EXPR_ARRAY_INDEX:
-        free_expression(expr->data.array_index.base);
-        free_expression(expr->data.array_index.index);
-        break;
-    case EXPR_MAP_LOOKUP:
-        free_expression(expr->data.map_lookup.map);
-        free(expr->data.map_lookup.key);
-        break;
-    case EXPR_STRUCT_ACCESS:
-        free_expression(expr->data.struct_access.structure);
-        free(expr->data.struct_access.member);
-        break;
-    default:
-        break;  // Literals have no alloc
-    }
-    free(expr);
+    (void)expr;
 }
 
-// Free a CommandNode and its data
 void free_command_node(CommandNode* node) {
-    if (!node) return;
-    if (node->data) {
-        switch (node->type) {
-        case COMMAND_CONFIG_ELEM: {
-            ConfigElemNode* cen = (ConfigElemNode*)node->data;
-            if (cen->location_option) free(cen->location_option);
-            free(cen);
-            break;
-        }
-        case COMMAND_INVALIDATE_PARAM: {
-            InvalidateParamNode* ipn = &((CommandData*)node->data)->invalidate_param;
-            free(ipn->parameter);
-            break;
-        }
-        case COMMAND_DECLARE_VARIABLE: {
-            DeclareVariableNode* dv = (DeclareVariableNode*)node->data;
-            free(dv->name);
-            switch (dv->var_type) {
-            case VAR_PARAMETER:
-                free_expression(dv->data.parameter.default_expr);
-                break;
-            case VAR_REFERENCE:
-                free(dv->data.reference.entity_type);
-                free_expression(dv->data.reference.default_ref);
-                break;
-            case VAR_FILE_DESCRIPTOR:
-                free(dv->data.file_desc.mode);
-                free(dv->data.file_desc.path);
-                break;
-            case VAR_ARRAY:
-                for (size_t j = 0; j < dv->data.array.init_count; j++) {
-                    free_expression(dv->data.array.initializers[j]);
-                }
-                free(dv->data.array.initializers);
-                break;
-            case VAR_MAP:
-                for (size_t j = 0; j < dv->data.map.pair_count; j++) {
-                    free(dv->data.map.pairs[j].key);
-                    free_expression(dv->data.map.pairs[j].value);
-                }
-                free(dv->data.map.pairs);
-                break;
-            case VAR_GENERAL:
-                // Recursive free (assuming inner_data is allocated)
-                free(dv->data.general.inner_data);
-                break;
-            case VAR_STRUCTURE:
-                for (size_t j = 0; j < dv->data.structure.member_count; j++) {
-                    free(dv->data.structure.members[j].member_name);
-                    free_expression(dv->data.structure.members[j].default_expr);
-                }
-                free(dv->data.structure.members);
-                break;
-            }
-            free(dv);
-            break;
-        }
-        case COMMAND_SHOW_PARAM: {
-            ShowParamNode* sp = (ShowParamNode*)node->data;
-            free(sp->parameter);
-            if (sp->tooltip_message) free(sp->tooltip_message);
-            if (sp->image_name) free(sp->image_name);
-            free(sp);
-            break;
-        }
-        case COMMAND_CHECKBOX_PARAM: {
-            CheckboxParamNode* cpn = (CheckboxParamNode*)node->data;
-            if (cpn->parameter) free(cpn->parameter);
-            if (cpn->tooltip_message) free(cpn->tooltip_message);
-            if (cpn->image_name) free(cpn->image_name);
-            if (cpn->tag) free(cpn->tag);
-            free(cpn);
-            break;
-        }
-        case COMMAND_USER_INPUT_PARAM: {
-            UserInputParamNode* uip = &((CommandData*)node->data)->user_input_param;
-            free(uip->parameter);
-            uip->parameter = NULL;
-            free_expression(uip->default_expr);
-            uip->default_expr = NULL;
-            for (size_t j = 0; j < uip->default_for_count; j++) {
-                free(uip->default_for_params[j]);
-                uip->default_for_params[j] = NULL;
-            }
-            free(uip->default_for_params);
-            uip->default_for_params = NULL;
-            uip->default_for_count = 0;
-            free_expression(uip->width);
-            uip->width = NULL;
-            free_expression(uip->decimal_places);
-            uip->decimal_places = NULL;
-            free_expression(uip->model);
-            uip->model = NULL;
-            free_expression(uip->display_order);
-            uip->display_order = NULL;
-            free_expression(uip->min_value);
-            uip->min_value = NULL;
-            free_expression(uip->max_value);
-            uip->max_value = NULL;
-            free_expression(uip->tooltip_message);
-            uip->tooltip_message = NULL;
-            free_expression(uip->image_name);
-            uip->image_name = NULL;
-            free_expression(uip->posX);
-            uip->posX = NULL;
-            free_expression(uip->posY);
-            uip->posY = NULL;
-            uip->required = false;
-            uip->no_update = false;
-            uip->on_picture = false;
-            break;
-        }
-        case COMMAND_RADIOBUTTON_PARAM: {
-            RadioButtonParamNode* rbn = (RadioButtonParamNode*)node->data;
-            free(rbn->parameter);
-            for (size_t k = 0; k < rbn->option_count; k++)
-            {
-                free_expression(rbn->options[k]);
-            }
-            free(rbn->options);
-            free_expression(rbn->display_order);
-            free_expression(rbn->tooltip_message);
-            free_expression(rbn->image_name);
-            free_expression(rbn->posX);
-            free_expression(rbn->posY);
-            break;
-        }
-        case COMMAND_GLOBAL_PICTURE: {
-            GlobalPictureNode* gpn = (GlobalPictureNode*)node->data;
-            free_expression(gpn->picture_expr);
-            free(gpn);
-            break;
-        }
-        case COMMAND_SUB_PICTURE: {
-            SubPictureNode* spn = (SubPictureNode*)node->data;
-            free_expression(spn->picture_expr);
-            free_expression(spn->posX_expr);
-            free_expression(spn->posY_expr);
-            free(spn);
-            break;
-        }
-        case COMMAND_USER_SELECT: {
-            UserSelectNode* usn = &((CommandData*)node->data)->user_select;
-            for (size_t k = 0; k < usn->type_count; k++) {
-                free_expression(usn->types[k]);
-            }
-            free(usn->types);
-            free(usn->reference);
-            free_expression(usn->display_order);
-            free_expression(usn->filter_mdl);
-            free_expression(usn->filter_feat);
-            free_expression(usn->filter_geom);
-            free_expression(usn->filter_ref);
-            free_expression(usn->filter_identifier);
-            free_expression(usn->include_multi_cad);
-            free_expression(usn->tooltip_message);
-            free_expression(usn->image_name);
-            free_expression(usn->posX);
-            free_expression(usn->posY);
-            free_expression(usn->tag);
-            break;
-        }
-        case COMMAND_USER_SELECT_OPTIONAL:
-        {
-            UserSelectOptionalNode* usn = &((CommandData*)node->data)->user_select_optional;
-            for (size_t k = 0; k < usn->type_count; k++) {
-                free_expression(usn->types[k]);
-            }
-            free(usn->types);
-            free(usn->reference);
-            free_expression(usn->display_order);
-            free_expression(usn->filter_mdl);
-            free_expression(usn->filter_feat);
-            free_expression(usn->filter_geom);
-            free_expression(usn->filter_ref);
-            free_expression(usn->filter_identifier);
-            free_expression(usn->include_multi_cad);
-            free_expression(usn->tooltip_message);
-            free_expression(usn->image_name);
-            free_expression(usn->posX);
-            free_expression(usn->posY);
-            free_expression(usn->tag);
-            break;
-        }
-        case COMMAND_USER_SELECT_MULTIPLE: {
-            UserSelectMultipleNode* n = &node->data->user_select_multiple;
-
-            if (n->types) {
-                for (size_t k = 0; k < n->type_count; k++) free_expression(n->types[k]);
-                free(n->types);
-            }
-            free_expression(n->max_sel);
-            free(n->array);
-
-            free_expression(n->display_order);
-            free_expression(n->filter_mdl);
-            free_expression(n->filter_feat);
-            free_expression(n->filter_geom);
-            free_expression(n->filter_ref);
-            free_expression(n->filter_identifier);
-            free_expression(n->include_multi_cad);
-            free_expression(n->tooltip_message);
-            free_expression(n->image_name);
-            free_expression(n->posX);
-            free_expression(n->posY);
-            free_expression(n->tag);
-        } break;
-        case COMMAND_USER_SELECT_MULTIPLE_OPTIONAL: {
-            UserSelectMultipleOptionalNode* n = &node->data->user_select_multiple_optional;
-
-            if (n->types) {
-                for (size_t k = 0; k < n->type_count; k++) free_expression(n->types[k]);
-                free(n->types);
-            }
-            free_expression(n->max_sel);
-            free(n->array);
-
-            free_expression(n->display_order);
-            free_expression(n->filter_mdl);
-            free_expression(n->filter_feat);
-            free_expression(n->filter_geom);
-            free_expression(n->filter_ref);
-            free_expression(n->filter_identifier);
-            free_expression(n->include_multi_cad);
-            free_expression(n->tooltip_message);
-            free_expression(n->image_name);
-            free_expression(n->posX);
-            free_expression(n->posY);
-            free_expression(n->tag);
-        } break;
-        case COMMAND_BEGIN_TABLE: {
-            TableNode* tn = &((CommandData*)node->data)->begin_table;
-
-            free(tn->identifier);
-            free_expression(tn->name);
-
-            for (size_t k = 0; k < tn->option_count; k++) {
-                free_expression(tn->options[k]);
-            }
-            free(tn->options);
-
-            for (size_t k = 0; k < tn->sel_string_count; k++) {
-                free_expression(tn->sel_strings[k]);
-            }
-            free(tn->sel_strings);
-
-            for (size_t k = 0; k < tn->data_type_count; k++) {
-                free_expression(tn->data_types[k]);
-            }
-            free(tn->data_types);
-
-            for (size_t r = 0; r < tn->row_count; r++) {
-                for (size_t c = 0; c < tn->column_count; c++) {
-                    free_expression(tn->rows[r][c]);
-                }
-                free(tn->rows[r]);
-            }
-            free(tn->rows);
-
-            free(node->data);  // Free the entire CommandData allocation after cleaning internals
-            break;
-        }
-        case COMMAND_MEASURE_DISTANCE: {
-            MeasureDistanceNode* md = (MeasureDistanceNode*)node->data;
-            if (md) {
-                free_expression(md->parameterResult);
-                free(md);
-            }
-            break;
-        }
-        case COMMAND_MEASURE_LENGTH: {
-            MeasureLengthNode* ml = &((CommandData*)node->data)->measure_length;
-            free_expression(ml->reference1);
-            free_expression(ml->parameterResult);
-            free(node->data);
-        } break;
-
-        case COMMAND_SEARCH_MDL_REFS: {
-            SearchMdlRefsNode* n = &((CommandData*)node->data)->search_mdl_refs;
-            /* use the same helper we wrote for the parser */
-            free_search_mdl_refs_node(n);
-            free(node->data);
-        } break;
-        case COMMAND_SEARCH_MDL_REF: {
-            SearchMdlRefNode* n = &((CommandData*)node->data)->search_mdl_ref;
-            /* use the same helper we wrote for the parser */
-            free_search_mdl_ref_node(n);
-            free(node->data);
-        } break;
-        case COMMAND_BEGIN_CATCH_ERROR: {
-            CatchErrorNode* cen = &((CommandData*)node->data)->begin_catch_error;
-            if (cen->commands) {
-                for (size_t k = 0; k < cen->command_count; ++k) {
-                    free_command_node(cen->commands[k]);
-                }
-                free(cen->commands);
-            }
-            free(node->data);
-            break;
-        }
-        case COMMAND_ASSIGNMENT: {
-            /* fix: node->data is CommandData*, not AssignmentNode* */
-            AssignmentNode* an = &((CommandData*)node->data)->assignment;
-            free_expression(an->lhs);
-            free_expression(an->rhs);
-            free(node->data);
-            break;
-        }
-        case COMMAND_EXPRESSION: {
-            free_expression(((CommandData*)node->data)->expression);
-            free(node->data);
-            break;
-        }
-        case COMMAND_IF: {
-            IfNode* ifn = &((CommandData*)node->data)->ifcommand;
-            for (size_t b = 0; b < ifn->branch_count; b++) {
-                IfBranch* branch = ifn->branches[b];
-                free_expression(branch->condition);
-                for (size_t c = 0; c < branch->command_count; c++)
-                    free_command_node(branch->commands[c]);
-                free(branch->commands);
-                free(branch);
-            }
-            free(ifn->branches);
-            for (size_t c = 0; c < ifn->else_command_count; c++)
-                free_command_node(ifn->else_commands[c]);
-            free(ifn->else_commands);
-            free(node->data);
-            break;
-        }
-        default:
-            ProPrintf(L"Warning: Unknown CommandType in free_command_node\n");
-            free(node->data);
-            break;
-        }
-    }
-    free(node);
+    (void)node;
 }
 
-// Free the BlockList and all associated memory
 void free_block_list(BlockList* block_list) {
-    if (!block_list || !block_list->blocks) return;
-
-    for (size_t i = 0; i < block_list->block_count; i++) {
-        Block* block = &block_list->blocks[i];
-        if (block->commands) {
-            for (size_t j = 0; j < block->command_count; j++) {
-                free_command_node(block->commands[j]);
-            }
-            free(block->commands);
-        }
-    }
-    free(block_list->blocks);
+    if (!block_list) return;
+    arena_destroy(block_list->arena);
+    block_list->arena = NULL;
     block_list->blocks = NULL;
     block_list->block_count = 0;
 }
-
-
-
-
-
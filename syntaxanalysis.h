@@ -55,6 +55,7 @@ typedef struct {
 typedef struct {
     char* member_name;
     VariableType member_type;
+    ParameterSubType member_subtype;  // VAR_PARAMETER members: INTEGER, DOUBLE, ...
     ExpressionNode* default_expr;
 } StructMember;
 
@@ -158,7 +159,8 @@ typedef enum {
     FUNC_LESS,
     FUNC_LESSOREQUAL,
     FUNC_GREATER,
-    FUNC_GREATEROREQUAL
+    FUNC_GREATEROREQUAL,
+    FUNC_COUNT          // Number of builtins (size of the registry in builtins.c)
 } FunctionType;
 
 // Enum for expression types (expanded for math expressions)
@@ -175,11 +177,16 @@ typedef enum {
     EXPR_ARRAY_INDEX,      // base[index]
     EXPR_MAP_LOOKUP,       // map.key
     EXPR_STRUCT_ACCESS,     // struct.member
+    EXPR_CONCAT,           // Flattened string + chain (built by semantic analysis)
 } ExpressionType;
 
 // Expression node for values, accesses, and computations (expanded)
 typedef struct ExpressionNode {
     ExpressionType type;
+    size_t slot;                     // EXPR_VARIABLE_REF: symbol slot from reserve_symbol_slot (0 = not yet bound)
+    struct ExprProgram* program;     // Root expressions: bytecode from expr_compile (NULL = tree walker)
+    uint8_t has_static_type;         // Set once get_expression_type has inferred static_type
+    uint8_t static_type;             // VariableType of the result, used by the evaluator sinks
     union {
         long int_val;                // EXPR_LITERAL_INT or EXPR_LITERAL_BOOL (0/1)
         double double_val;           // EXPR_LITERAL_DOUBLE or EXPR_CONSTANT (e.g., PI)
@@ -210,7 +217,13 @@ typedef struct ExpressionNode {
         struct {                     // EXPR_STRUCT_ACCESS
             ExpressionNode* structure;
             char* member;
+            size_t field;            // Member position + 1 in the structure layout (0 = look up by name)
+            unsigned long field_hash; // Hash of the member entry the position was resolved against
         } struct_access;
+        struct {                     // EXPR_CONCAT
+            ExpressionNode** parts;  // Operands in order; none is itself a string +
+            size_t part_count;
+        } concat;
     } data;
 } ExpressionNode;
 
@@ -256,6 +269,7 @@ typedef struct
     ExpressionNode* picture_expr;  // The file name (single or concatenated)
     ExpressionNode* posX_expr;           // X-position as a string (number or identifier)
     ExpressionNode* posY_expr;           // Y-position as a string (number or identifier)
+    int if_gate_id;                      // Gate id of the enclosing IF, tagged by the GUI prepare pass (0 = none)
 } SubPictureNode;
 
 // Update UserInputParamNode struct
@@ -551,6 +565,11 @@ typedef struct {
     CommandNode** else_commands; // Optional ELSE block
     size_t else_command_count;
     int id;
+    unsigned int winner_epoch;  // Refresh epoch the cached winner belongs to (0 = none)
+    unsigned long long winner_change; // Symbol table change_count the winner was evaluated at
+    int winner;                 // Cached winning branch, -1 = ELSE / no branch
+    int winner_status;          // 0, or -1 if a condition failed to evaluate
+    int winner_evals;           // Conditions evaluated to find the cached winner
 } IfNode;
 
 
@@ -565,6 +584,9 @@ typedef struct {
     ExpressionNode* lhs;              // Left-hand side (variable name)
     ExpressionNode* rhs;    // Right-hand side expression
     int assign_id;
+    int if_id;              // Innermost enclosing IF, set by its semantic check (0 = none)
+    int branch_index;       // Branch of that IF holding it: 0.., -1 for ELSE
+    size_t lhs_slot;        // Symbol slot of a plain-variable LHS (0 = not resolved)
 } AssignmentNode;
 
 
@@ -652,6 +674,7 @@ typedef struct {
 typedef struct {
     Block* blocks;
     size_t block_count;
+    Arena* arena;       // Owns every AST allocation of the script; released by free_block_list
 } BlockList;
 
 
@@ -659,6 +682,7 @@ typedef int (*CommandParser)(Lexer* lexer, size_t* i, CommandData* parsed_data);
 
 typedef struct {
     const char* command_name;
+    LexWord word;          // Keyword token that starts the command
     CommandType type;      // Added to associate with CommandType
     CommandParser parser;
 } CommandEntry;
@@ -0,0 +1,519 @@
+#include "utility.h"
+#include "symboltable.h"
+#include "tablestore.h"
+
+// Cells of a column are plain vectors indexed by row, with one presence bit per
+// row. String cells are offsets into the table's text pool; equal strings share
+// one offset, so a column of repeated values costs four bytes per row.
+
+#define TABLE_TEXT_MIN 64
+#define TABLE_INTERN_MIN 16
+
+static void table_index_free(TableIndex* ix);
+
+static unsigned long table_text_hash(const char* s)
+{
+	unsigned long hash = 5381;
+	int c;
+	while ((c = *s++) != 0) hash = ((hash << 5) + hash) + c;
+	return hash;
+}
+
+static size_t table_words(size_t rows)
+{
+	return rows ? (rows + 63) / 64 : 1;
+}
+
+TableStore* table_store_create(size_t column_count, size_t row_count)
+{
+	TableStore* ts = (TableStore*)calloc(1, sizeof(TableStore));
+	if (!ts) return NULL;
+	ts->refs = 1;
+	ts->row_count = row_count;
+	ts->column_count = column_count;
+	ts->columns = (TableColumn*)calloc(column_count ? column_count : 1, sizeof(TableColumn));
+	ts->text = (char*)malloc(TABLE_TEXT_MIN);
+	if (!ts->columns || !ts->text) {
+		free(ts->columns);
+		free(ts->text);
+		free(ts);
+		return NULL;
+	}
+	ts->text[0] = '\0';
+	ts->text_used = 1;
+	ts->text_capacity = TABLE_TEXT_MIN;
+	return ts;
+}
+
+int table_store_set_column(TableStore* ts, size_t c, const char* name, VariableType type)
+{
+	if (!ts || c >= ts->column_count || !name) return -1;
+	TableColumn* col = &ts->columns[c];
+	size_t rows = ts->row_count ? ts->row_count : 1;
+	if (col->name) return -1;
+
+	switch (type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		col->cells.ints = (int*)calloc(rows, sizeof(int));
+		break;
+	case TYPE_DOUBLE:
+		col->cells.doubles = (double*)calloc(rows, sizeof(double));
+		break;
+	case TYPE_REFERENCE:
+		type = TYPE_STRING;
+		/* fall through */
+	case TYPE_STRING:
+	case TYPE_SUBTABLE:
+		col->cells.strings = (uint32_t*)calloc(rows, sizeof(uint32_t));
+		break;
+	default:
+		return -1;
+	}
+	col->type = type;
+	col->name = _strdup(name);
+	col->present = (uint64_t*)calloc(table_words(ts->row_count), sizeof(uint64_t));
+	if (!col->cells.ints || !col->name || !col->present) return -1;
+	return 0;
+}
+
+static void table_mark_present(TableColumn* col, size_t r)
+{
+	col->present[r >> 6] |= (uint64_t)1 << (r & 63);
+}
+
+static int table_is_present(const TableColumn* col, size_t r)
+{
+	return col->present && (col->present[r >> 6] >> (r & 63)) & 1;
+}
+
+void table_store_set_int(TableStore* ts, size_t r, size_t c, int value)
+{
+	if (!ts || r >= ts->row_count || c >= ts->column_count) return;
+	TableColumn* col = &ts->columns[c];
+	if ((col->type != TYPE_INTEGER && col->type != TYPE_BOOL) || !col->cells.ints) return;
+	col->cells.ints[r] = value;
+	table_mark_present(col, r);
+}
+
+void table_store_set_double(TableStore* ts, size_t r, size_t c, double value)
+{
+	if (!ts || r >= ts->row_count || c >= ts->column_count) return;
+	TableColumn* col = &ts->columns[c];
+	if (col->type != TYPE_DOUBLE || !col->cells.doubles) return;
+	col->cells.doubles[r] = value;
+	table_mark_present(col, r);
+}
+
+// Offset of s in the text pool, appending it the first time it is seen (0 on failure)
+static uint32_t table_intern(TableStore* ts, const char* s)
+{
+	if (!s[0]) return 0;
+	if ((ts->intern_count + 1) * 4 > ts->intern_size * 3) {
+		size_t new_size = ts->intern_size ? ts->intern_size * 2 : TABLE_INTERN_MIN;
+		uint32_t* grown = (uint32_t*)calloc(new_size, sizeof(uint32_t));
+		if (!grown) return 0;
+		for (size_t k = 0; k < ts->intern_size; k++) {
+			uint32_t off = ts->intern[k];
+			if (!off) continue;
+			size_t i = table_text_hash(ts->text + off) & (new_size - 1);
+			while (grown[i]) i = (i + 1) & (new_size - 1);
+			grown[i] = off;
+		}
+		free(ts->intern);
+		ts->intern = grown;
+		ts->intern_size = new_size;
+	}
+
+	size_t mask = ts->intern_size - 1;
+	size_t i = table_text_hash(s) & mask;
+	while (ts->intern[i]) {
+		if (strcmp(ts->text + ts->intern[i], s) == 0) return ts->intern[i];
+		i = (i + 1) & mask;
+	}
+
+	size_t len = strlen(s) + 1;
+	if (ts->text_used + len > UINT32_MAX) return 0;
+	if (ts->text_used + len > ts->text_capacity) {
+		size_t cap = ts->text_capacity * 2;
+		while (cap < ts->text_used + len) cap *= 2;
+		char* grown = (char*)realloc(ts->text, cap);
+		if (!grown) return 0;
+		ts->text = grown;
+		ts->text_capacity = cap;
+	}
+	uint32_t off = (uint32_t)ts->text_used;
+	memcpy(ts->text + off, s, len);
+	ts->text_used += len;
+	ts->intern[i] = off;
+	ts->intern_count++;
+	return off;
+}
+
+int table_store_set_string(TableStore* ts, size_t r, size_t c, const char* value)
+{
+	if (!ts || r >= ts->row_count || c >= ts->column_count || !value) return -1;
+	TableColumn* col = &ts->columns[c];
+	if ((col->type != TYPE_STRING && col->type != TYPE_SUBTABLE) || !col->cells.strings) return -1;
+	uint32_t off = table_intern(ts, value);
+	if (!off && value[0]) return -1;
+	col->cells.strings[r] = off;
+	table_mark_present(col, r);
+	return 0;
+}
+
+void table_store_seal(TableStore* ts)
+{
+	if (!ts) return;
+	for (size_t c = 0; c < ts->column_count; c++) {
+		const char* name = ts->columns[c].name;
+		for (size_t k = c + 1; name && k < ts->column_count; k++) {
+			if (ts->columns[k].name && strcmp(ts->columns[k].name, name) == 0) {
+				ts->columns[c].shadowed = 1;
+				break;
+			}
+		}
+	}
+	free(ts->intern);
+	ts->intern = NULL;
+	ts->intern_size = 0;
+	ts->intern_count = 0;
+	if (ts->text_used < ts->text_capacity) {
+		char* fitted = (char*)realloc(ts->text, ts->text_used);
+		if (fitted) {
+			ts->text = fitted;
+			ts->text_capacity = ts->text_used;
+		}
+	}
+}
+
+void table_store_release(TableStore* ts)
+{
+	if (!ts) return;
+	if (ts->refs > 1) {
+		ts->refs--;
+		return;
+	}
+	for (size_t c = 0; c < ts->column_count; c++) {
+		free(ts->columns[c].name);
+		free(ts->columns[c].cells.ints);
+		free(ts->columns[c].present);
+		table_index_free(ts->columns[c].index);
+	}
+	free(ts->columns);
+	free(ts->text);
+	free(ts->intern);
+	free_variable(ts->rows_view);
+	free(ts);
+}
+
+size_t table_store_column(const TableStore* ts, const char* key)
+{
+	if (!ts || !key) return TABLE_NO_COLUMN;
+	for (size_t c = ts->column_count; c-- > 0; ) {
+		if (ts->columns[c].name && strcmp(ts->columns[c].name, key) == 0) return c;
+	}
+	return TABLE_NO_COLUMN;
+}
+
+void table_store_cell(const TableStore* ts, size_t r, size_t c, Variable* out)
+{
+	memset(out, 0, sizeof(*out));
+	out->type = TYPE_NULL;
+	if (!ts || r >= ts->row_count || c >= ts->column_count) return;
+	const TableColumn* col = &ts->columns[c];
+	if (!table_is_present(col, r)) return;
+	out->type = col->type;
+	switch (col->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		out->data.int_value = col->cells.ints[r];
+		break;
+	case TYPE_DOUBLE:
+		out->data.double_value = col->cells.doubles[r];
+		break;
+	default:
+		out->data.string_value = ts->text + col->cells.strings[r];
+		break;
+	}
+}
+
+/* Columns with at most this many distinct values are indexed by row bitmaps */
+#define TABLE_BITMAP_MAX_VALUES 64
+
+static unsigned table_lowest_bit(uint64_t w)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, w);
+	return (unsigned)i;
+#else
+	return (unsigned)__builtin_ctzll(w);
+#endif
+}
+
+static void table_index_free(TableIndex* ix)
+{
+	if (!ix) return;
+	free(ix->values);
+	free(ix->slots);
+	free(ix->start);
+	free(ix->rows);
+	free(ix->bitmaps);
+	free(ix);
+}
+
+// Index key of cell r of col; 0 when the cell equals nothing (absent or NaN)
+static int table_cell_key(const TableColumn* col, size_t r, uint64_t* key)
+{
+	if (!table_is_present(col, r)) return 0;
+	switch (col->type) {
+	case TYPE_INTEGER:
+	case TYPE_BOOL:
+		*key = (uint64_t)(int64_t)col->cells.ints[r];
+		return 1;
+	case TYPE_DOUBLE: {
+		double d = col->cells.doubles[r];
+		if (d != d) return 0;
+		if (d == 0.0) d = 0.0;  /* -0.0 == 0.0 */
+		memcpy(key, &d, sizeof(d));
+		return 1;
+	}
+	default:
+		*key = col->cells.strings[r];
+		return 1;
+	}
+}
+
+static size_t table_key_home(const TableStore* ts, const TableColumn* col, uint64_t key, size_t mask)
+{
+	if (col->type == TYPE_STRING || col->type == TYPE_SUBTABLE) {
+		return table_text_hash(ts->text + key) & mask;
+	}
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+// Slot of the value equal to key (by content for strings), or the empty slot where it would go
+static size_t table_index_find(const TableStore* ts, const TableColumn* col, const TableIndex* ix,
+	uint64_t key, const char* text)
+{
+	size_t mask = ix->slot_count - 1;
+	size_t i = text ? table_text_hash(text) & mask : table_key_home(ts, col, key, mask);
+	while (ix->slots[i]) {
+		uint64_t v = ix->values[ix->slots[i] - 1];
+		if (text ? strcmp(ts->text + v, text) == 0 : v == key) break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+int table_store_build_index(TableStore* ts, size_t c)
+{
+	if (!ts || c >= ts->column_count || !ts->columns[c].name) return -1;
+	TableColumn* col = &ts->columns[c];
+	if (col->index) return 0;
+
+	size_t rows = ts->row_count;
+	TableIndex* ix = (TableIndex*)calloc(1, sizeof(TableIndex));
+	uint32_t* value_of = (uint32_t*)malloc((rows ? rows : 1) * sizeof(uint32_t));
+	size_t value_cap = 16;
+	if (ix) {
+		ix->slot_count = 32;
+		ix->slots = (uint32_t*)calloc(ix->slot_count, sizeof(uint32_t));
+		ix->values = (uint64_t*)malloc(value_cap * sizeof(uint64_t));
+	}
+	if (!ix || !value_of || !ix->slots || !ix->values) goto fail;
+
+	/* 1) Number the distinct values; value_of[r] is row r's (0 = none) */
+	for (size_t r = 0; r < rows; r++) {
+		uint64_t key;
+		value_of[r] = 0;
+		if (!table_cell_key(col, r, &key)) continue;
+		size_t i = table_index_find(ts, col, ix, key, NULL);
+		if (ix->slots[i]) {
+			value_of[r] = ix->slots[i];
+		}
+		else {
+			if (ix->distinct + 1 >= UINT32_MAX) goto fail;
+			if (ix->distinct == value_cap) {
+				uint64_t* grown = (uint64_t*)realloc(ix->values, value_cap * 2 * sizeof(uint64_t));
+				if (!grown) goto fail;
+				ix->values = grown;
+				value_cap *= 2;
+			}
+			ix->values[ix->distinct++] = key;
+			ix->slots[i] = (uint32_t)ix->distinct;
+			value_of[r] = (uint32_t)ix->distinct;
+			if (ix->distinct * 4 > ix->slot_count * 3) {
+				size_t new_count = ix->slot_count * 2;
+				uint32_t* grown = (uint32_t*)calloc(new_count, sizeof(uint32_t));
+				if (!grown) goto fail;
+				for (size_t k = 0; k < ix->distinct; k++) {
+					size_t j = table_key_home(ts, col, ix->values[k], new_count - 1);
+					while (grown[j]) j = (j + 1) & (new_count - 1);
+					grown[j] = (uint32_t)(k + 1);
+				}
+				free(ix->slots);
+				ix->slots = grown;
+				ix->slot_count = new_count;
+			}
+		}
+	}
+
+	/* 2) Rows per value: a bitmap each when there are few values, else posting lists */
+	if (ix->distinct <= TABLE_BITMAP_MAX_VALUES) {
+		size_t words = table_words(rows);
+		ix->bitmaps = (uint64_t*)calloc((ix->distinct ? ix->distinct : 1) * words, sizeof(uint64_t));
+		if (!ix->bitmaps) goto fail;
+		for (size_t r = 0; r < rows; r++) {
+			if (value_of[r]) ix->bitmaps[(value_of[r] - 1) * words + (r >> 6)] |= (uint64_t)1 << (r & 63);
+		}
+	}
+	else {
+		ix->start = (size_t*)calloc(ix->distinct + 1, sizeof(size_t));
+		ix->rows = (size_t*)malloc((rows ? rows : 1) * sizeof(size_t));
+		if (!ix->start || !ix->rows) goto fail;
+		for (size_t r = 0; r < rows; r++) {
+			if (value_of[r]) ix->start[value_of[r]]++;
+		}
+		for (size_t k = 0; k < ix->distinct; k++) ix->start[k + 1] += ix->start[k];
+		/* Fill in row order, using start[k] as the cursor of value k, then shift back */
+		for (size_t r = 0; r < rows; r++) {
+			if (value_of[r]) ix->rows[ix->start[value_of[r] - 1]++] = r;
+		}
+		for (size_t k = ix->distinct; k > 0; k--) ix->start[k] = ix->start[k - 1];
+		ix->start[0] = 0;
+	}
+	free(value_of);
+	col->index = ix;
+	return 0;
+
+fail:
+	free(value_of);
+	table_index_free(ix);
+	return -1;
+}
+
+size_t table_store_match(TableStore* ts, size_t c, const Variable* value, size_t* rows)
+{
+	if (!ts || c >= ts->column_count || !value || !rows) return 0;
+	TableColumn* col = &ts->columns[c];
+	/* Cells only equal values of their own type: ints, doubles and strings */
+	if (value->type != col->type) return 0;
+	uint64_t key = 0;
+	const char* text = NULL;
+	switch (value->type) {
+	case TYPE_INTEGER:
+		key = (uint64_t)(int64_t)value->data.int_value;
+		break;
+	case TYPE_DOUBLE: {
+		double d = value->data.double_value;
+		if (d != d) return 0;
+		if (d == 0.0) d = 0.0;
+		memcpy(&key, &d, sizeof(d));
+		break;
+	}
+	case TYPE_STRING:
+		if (!value->data.string_value) return 0;
+		text = value->data.string_value;
+		break;
+	default:
+		return 0;
+	}
+
+	const TableIndex* ix = (col->index || table_store_build_index(ts, c) == 0) ? col->index : NULL;
+	size_t n = 0;
+	if (!ix) {
+		/* No memory for an index: compare every row */
+		for (size_t r = 0; r < ts->row_count; r++) {
+			uint64_t k;
+			if (!table_cell_key(col, r, &k)) continue;
+			if (text ? strcmp(ts->text + k, text) == 0 : k == key) rows[n++] = r;
+		}
+		return n;
+	}
+
+	uint32_t v = ix->slots[table_index_find(ts, col, ix, key, text)];
+	if (!v) return 0;
+	if (ix->bitmaps) {
+		size_t words = table_words(ts->row_count);
+		const uint64_t* bits = ix->bitmaps + (size_t)(v - 1) * words;
+		for (size_t w = 0; w < words; w++) {
+			for (uint64_t b = bits[w]; b; b &= b - 1) rows[n++] = (w << 6) + table_lowest_bit(b);
+		}
+		return n;
+	}
+	n = ix->start[v] - ix->start[v - 1];
+	memcpy(rows, ix->rows + ix->start[v - 1], n * sizeof(size_t));
+	return n;
+}
+
+// Heap copy of cell (r, c), as check_begin_table_semantics used to store it
+static Variable* table_cell_copy(const TableStore* ts, size_t r, size_t c)
+{
+	Variable cell;
+	table_store_cell(ts, r, c, &cell);
+	Variable* v = (Variable*)calloc(1, sizeof(Variable));
+	if (!v) return NULL;
+	*v = cell;
+	if (cell.type == TYPE_STRING || cell.type == TYPE_SUBTABLE) {
+		v->data.string_value = _strdup(cell.data.string_value);
+		if (!v->data.string_value) { free(v); return NULL; }
+	}
+	return v;
+}
+
+Variable* table_store_rows(TableStore* ts)
+{
+	if (!ts) return NULL;
+	if (ts->rows_view) return ts->rows_view;
+
+	Variable* rows = (Variable*)calloc(1, sizeof(Variable));
+	if (!rows) return NULL;
+	rows->type = TYPE_ARRAY;
+	rows->data.array.elements = (Variable**)calloc(ts->row_count ? ts->row_count : 1, sizeof(Variable*));
+	if (!rows->data.array.elements) { free(rows); return NULL; }
+
+	for (size_t r = 0; r < ts->row_count; r++) {
+		Variable* row = (Variable*)calloc(1, sizeof(Variable));
+		if (!row) goto fail;
+		row->type = TYPE_MAP;
+		row->data.map = create_hash_table(ts->column_count);
+		rows->data.array.elements[r] = row;
+		rows->data.array.size = r + 1;
+		if (!row->data.map) goto fail;
+		for (size_t c = 0; c < ts->column_count; c++) {
+			const char* name = ts->columns[c].name;
+			if (!name || hash_table_lookup(row->data.map, name)) continue;
+			/* A repeated key sits at its first position with its last value */
+			size_t src = ts->columns[c].shadowed ? table_store_column(ts, name) : c;
+			Variable* v = table_cell_copy(ts, r, src);
+			if (!v) goto fail;
+			hash_table_insert(row->data.map, name, v);
+		}
+	}
+	ts->rows_view = rows;
+	return rows;
+
+fail:
+	free_variable(rows);
+	return NULL;
+}
+
+TableStore* table_store_of(const Variable* var)
+{
+	if (!var) return NULL;
+	if (var->type == TYPE_TABLE) return var->data.table;
+	if (var->type != TYPE_MAP || !var->data.map) return NULL;
+	Variable* store = hash_table_lookup(var->data.map, "store");
+	return (store && store->type == TYPE_TABLE) ? store->data.table : NULL;
+}
+
+Variable* table_wrapper_lookup(HashTable* ht, const char* key)
+{
+	if (!ht || !key) return NULL;
+	Variable* v = hash_table_lookup(ht, key);
+	if (v || strcmp(key, "rows") != 0) return v;
+	Variable* store = hash_table_lookup(ht, "store");
+	return (store && store->type == TYPE_TABLE) ? table_store_rows(store->data.table) : NULL;
+}
@@ -0,0 +1,85 @@
+#ifndef TABLESTORE_H
+#define TABLESTORE_H
+
+#include "symboltable.h"
+
+// Column-wise storage of a BEGIN_TABLE block, built once by semantic analysis and
+// read-only afterwards. Every row shares one schema (column keys and cell types);
+// each column is a typed vector, so cell (r, c) is found by index arithmetic.
+// Strings are interned once per table. A table symbol is a wrapper map whose
+// "store" entry holds the TYPE_TABLE value; the array of row maps older code
+// reads as wrapper "rows" is built from it on first use only.
+
+#define TABLE_NO_COLUMN ((size_t)-1)
+
+// Equality index of one column: the rows holding each distinct value, as a row
+// bitmap per value when the column has few of them, else as posting lists
+typedef struct {
+    size_t distinct;        // Distinct values present (NaN cells equal nothing and are left out)
+    uint64_t* values;       // Per value: the int, the double's bits or the string's pool offset
+    uint32_t* slots;        // Open-addressed index of values (position + 1, 0 = empty)
+    size_t slot_count;
+    size_t* start;          // Posting lists: rows of value k are rows[start[k] .. start[k + 1])
+    size_t* rows;
+    uint64_t* bitmaps;      // Low cardinality instead: value k's rows are bitmap k (NULL if unused)
+} TableIndex;
+
+typedef struct {
+    char* name;             // Column key (column 0 is SEL_STRING)
+    VariableType type;      // Type a present cell reads as (INTEGER, BOOL, DOUBLE, STRING, SUBTABLE)
+    int shadowed;           // A later column has the same key; its cells win, as in a map
+    union {
+        int* ints;          // TYPE_INTEGER, TYPE_BOOL
+        double* doubles;    // TYPE_DOUBLE
+        uint32_t* strings;  // TYPE_STRING, TYPE_SUBTABLE: offsets into the string pool
+    } cells;
+    uint64_t* present;      // Bit r set: row r holds a value (else the cell reads as TYPE_NULL)
+    TableIndex* index;      // Built by table_store_build_index (NULL until then)
+} TableColumn;
+
+typedef struct TableStore {
+    size_t row_count;
+    size_t column_count;
+    TableColumn* columns;
+    char* text;             // Interned strings, NUL-terminated; offset 0 is ""
+    size_t text_used;
+    size_t text_capacity;
+    uint32_t* intern;       // While building: open-addressed index of text offsets (0 = empty)
+    size_t intern_size;
+    size_t intern_count;
+    Variable* rows_view;    // TYPE_ARRAY of row maps, built by table_store_rows (NULL until then)
+    unsigned int refs;      // Variables holding the store (see variable_share)
+} TableStore;
+
+// Store of row_count rows by column_count columns, every cell empty. Columns are
+// then named and typed with table_store_set_column and filled with the setters.
+TableStore* table_store_create(size_t column_count, size_t row_count);
+// Name and type column c; REFERENCE columns hold the reference name as TYPE_STRING.
+// Returns -1 on allocation failure or for a type the store cannot hold.
+int table_store_set_column(TableStore* ts, size_t c, const char* name, VariableType type);
+void table_store_set_int(TableStore* ts, size_t r, size_t c, int value);
+void table_store_set_double(TableStore* ts, size_t r, size_t c, double value);
+int table_store_set_string(TableStore* ts, size_t r, size_t c, const char* value);
+// Done filling: marks shadowed columns and drops the build-time intern index
+void table_store_seal(TableStore* ts);
+void table_store_release(TableStore* ts);
+
+// Column holding key (the last one, as a map keeps the last value), TABLE_NO_COLUMN if none
+size_t table_store_column(const TableStore* ts, const char* key);
+// Cell (r, c) as a borrowed Variable: strings point into the store, absent cells are TYPE_NULL
+void table_store_cell(const TableStore* ts, size_t r, size_t c, Variable* out);
+// Index column c for table_store_match (done when the table is materialized for
+// its filter columns). Returns -1 on allocation failure; matching then scans.
+int table_store_build_index(TableStore* ts, size_t c);
+// Rows whose cell in column c equals value (same type, INTEGER, DOUBLE or STRING),
+// in ascending order. rows must have room for row_count entries; returns the count.
+size_t table_store_match(TableStore* ts, size_t c, const Variable* value, size_t* rows);
+// Row maps for code that reads tables as wrapper "rows" (owned by the store)
+Variable* table_store_rows(TableStore* ts);
+
+// Store of a table symbol's wrapper map, NULL if var is not one
+TableStore* table_store_of(const Variable* var);
+// Entry key of a map, answering "rows" of a table wrapper from its store
+Variable* table_wrapper_lookup(HashTable* ht, const char* key);
+
+#endif // !TABLESTORE_H
@@ -0,0 +1,150 @@
+// Lookup cost of the symbol HashTable from 10 to 100k keys, next to the
+// fixed 16-bucket chained table it replaced. Columns, as the average time of
+// one lookup:
+//   hot     the same 16 keys over and over (a script's working set)
+//   random  every key in a shuffled order (includes cache misses)
+//   miss    absent keys
+//   chained random order on the old djb2 chains, 16 buckets
+// Build it optimized:
+//
+//   tests/run_tests.sh bench
+
+#include <time.h>
+#include "symboltable.h"
+
+#define LOOKUPS 4000000
+#define HOT_KEYS 16
+
+static unsigned long long s_rng = 0x9E3779B97F4A7C15ull;
+
+static unsigned rnd(unsigned n)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (unsigned)(s_rng % n);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Parameter-like names, so hashing cost resembles a script's symbols
+static char** make_keys(size_t n, const char* prefix)
+{
+    char** keys = malloc(n * sizeof *keys);
+    for (size_t i = 0; i < n; i++) {
+        char buf[64];
+        snprintf(buf, sizeof buf, "%s_%zu_DIAM", prefix, i);
+        keys[i] = _strdup(buf);
+    }
+    return keys;
+}
+
+static void free_keys(char** keys, size_t n)
+{
+    for (size_t i = 0; i < n; i++) free(keys[i]);
+    free(keys);
+}
+
+// The previous HashTable: djb2, separate chaining, never resized
+typedef struct ChainEntry {
+    char* key;
+    Variable* value;
+    struct ChainEntry* next;
+} ChainEntry;
+
+#define CHAIN_BUCKETS 16
+
+static unsigned long djb2(const char* str)
+{
+    unsigned long hash = 5381;
+    int c;
+    while ((c = *str++) != 0) hash = ((hash << 5) + hash) + c;
+    return hash;
+}
+
+static Variable* chain_lookup(ChainEntry** buckets, const char* key)
+{
+    for (ChainEntry* e = buckets[djb2(key) % CHAIN_BUCKETS]; e; e = e->next) {
+        if (strcmp(e->key, key) == 0) return e->value;
+    }
+    return NULL;
+}
+
+static double time_lookups(HashTable* ht, char** keys, const unsigned* order, size_t count, size_t* found)
+{
+    double t0 = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        if (hash_table_lookup(ht, keys[order[i]])) (*found)++;
+    }
+    return (now_ns() - t0) / count;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 10, 100, 1000, 10000, 100000 };
+    static Variable dummy;
+    size_t found = 0, expected = 0;
+
+    printf("%8s %9s %9s %9s %10s\n", "keys", "hot ns", "random ns", "miss ns", "chained ns");
+    for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+        size_t n = sizes[s];
+        char** keys = make_keys(n, "PARAM");
+        char** missing = make_keys(n, "OTHER");
+        HashTable* ht = create_hash_table(16);
+        ChainEntry* chain = malloc(n * sizeof *chain);
+        ChainEntry* buckets[CHAIN_BUCKETS] = { 0 };
+        for (size_t i = 0; i < n; i++) {
+            Variable* v = calloc(1, sizeof *v);
+            v->type = TYPE_INTEGER;
+            v->data.int_value = (int)i;
+            hash_table_insert(ht, keys[i], v);
+
+            size_t b = djb2(keys[i]) % CHAIN_BUCKETS;
+            chain[i].key = keys[i];
+            chain[i].value = &dummy;
+            chain[i].next = buckets[b];
+            buckets[b] = &chain[i];
+        }
+
+        // Probe orders are fixed up front so the timed loops are lookups only
+        unsigned* order = malloc(LOOKUPS * sizeof *order);
+        unsigned* hot = malloc(LOOKUPS * sizeof *hot);
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            order[i] = rnd((unsigned)n);
+            hot[i] = (unsigned)((i % HOT_KEYS) * (n / HOT_KEYS ? n / HOT_KEYS : 1) % n);
+        }
+
+        double hot_ns = time_lookups(ht, keys, hot, LOOKUPS, &found);
+        double random_ns = time_lookups(ht, keys, order, LOOKUPS, &found);
+        double miss_ns = time_lookups(ht, missing, order, LOOKUPS, &found);
+        expected += 2 * LOOKUPS;
+
+        // Chains grow linearly; scale the count so the run stays short
+        size_t chained = n > 100 ? LOOKUPS / (n / 100) : LOOKUPS;
+        double t0 = now_ns();
+        for (size_t i = 0; i < chained; i++) {
+            if (chain_lookup(buckets, keys[order[i]])) found++;
+        }
+        double chained_ns = (now_ns() - t0) / chained;
+        expected += chained;
+
+        if (found != expected) {
+            printf("lookup failed at %zu keys\n", n);
+            return 1;
+        }
+        printf("%8zu %9.1f %9.1f %9.1f %10.1f\n", n, hot_ns, random_ns, miss_ns, chained_ns);
+
+        free(hot);
+        free(order);
+        free(chain);
+        free_hash_table(ht);
+        free_keys(keys, n);
+        free_keys(missing, n);
+    }
+    return 0;
+}
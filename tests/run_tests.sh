@@ -0,0 +1,96 @@
+#!/bin/sh
+# Builds the platform-independent engine (lexer, parser, semantic analysis,
+# symbol table, bytecode VM) with the host compiler against tests/stubs and
+# runs the test programs. The Toolkit and Windows headers are replaced by
+# empty files; their declarations come from stubs/prostub.h.
+#
+#   tests/run_tests.sh            build into tests/build and run everything
+#   tests/run_tests.sh bench      optimized build, run the benchmarks instead
+#   CC=clang tests/run_tests.sh   pick the compiler; CFLAGS overrides the flags
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+root=$(dirname "$here")
+build="$here/build"
+CC=${CC:-cc}
+if [ "$1" = bench ]; then
+    CFLAGS=${CFLAGS:-"-std=gnu99 -O2 -DNDEBUG"}
+else
+    CFLAGS=${CFLAGS:-"-std=gnu99 -g -O1 -fsanitize=address,undefined -fno-omit-frame-pointer"}
+fi
+ENGINE="LexicalAnalysis syntaxanalysis semantic_analysis SymbolTable utility logging bytecode builtins depgraph execstate numfmt tablestore"
+
+rm -rf "$build"
+mkdir -p "$build/src" "$build/include" "$build/obj"
+for unit in $ENGINE; do
+    cp "$root/$unit.c" "$build/src/"
+done
+cp "$root"/*.h "$build/src/"
+
+# Empty stand-ins for the SDK headers the engine includes
+for header in $(sed -n -e 's/^#include <\(Pro[A-Za-z]*\.h\)>.*/\1/p' \
+        -e 's/^#include <\(windows\|Rpc\|direct\|io\|process\|tlhelp32\)\.h>.*/\1.h/p' \
+        "$build"/src/*.c "$build"/src/*.h | sort -u); do
+    : > "$build/include/$header"
+done
+echo '#include "symboltable.h"' > "$build/include/SymbolTable.h"
+
+# syntaxanalysis.h and symboltable.h both typedef VariableType; MSVC never sees
+# them in one unit with a conflicting definition, gcc does
+sed -i -e 's/} VariableType;/} SAVariableType;/' \
+    -e 's/^\([ \t]*\)VariableType \(member_type\|element_type\|inner_type\|var_type\);/\1SAVariableType \2;/' \
+    "$build/src/syntaxanalysis.h"
+# ReferenceValue has no model member
+sed -i '/reference\.model = NULL;/d' "$build/src/semantic_analysis.c"
+
+compile() {
+    $CC $CFLAGS -w -I"$build/include" -I"$build/src" -include "$here/stubs/prostub.h" "$@"
+}
+
+objects=""
+for unit in $ENGINE; do
+    compile -c "$build/src/$unit.c" -o "$build/obj/$unit.o"
+    objects="$objects $build/obj/$unit.o"
+done
+compile -c "$here/stubs/win32_stubs.c" -o "$build/obj/win32_stubs.o"
+objects="$objects $build/obj/win32_stubs.o"
+
+link_test() {
+    compile "$here/$1.c" $objects -o "$build/$1" -lm -lpthread
+}
+
+failed=0
+run() {
+    echo "== $*"
+    if ! (cd "$build" && ASAN_OPTIONS=detect_leaks=0 "$@"); then
+        echo "FAILED: $*"
+        failed=1
+    fi
+}
+
+# A script test passes when its output matches scripts/<name>.expected
+script_test() {
+    name=$1
+    shift
+    echo "== script $name"
+    if ! (cd "$build" && ASAN_OPTIONS=detect_leaks=0 ./script_test "$here/scripts/$name.tab" "$@" > "$name.out" 2>&1 &&
+            diff -u "$here/scripts/$name.expected" "$name.out"); then
+        echo "FAILED: script $name"
+        failed=1
+    fi
+}
+
+if [ "$1" = bench ]; then
+    link_test hash_bench
+    "$build/hash_bench"
+    exit $?
+fi
+
+link_test vm_difftest
+link_test script_test
+
+run ./vm_difftest 20000
+script_test structure AREA LABEL TOTAL
+script_test folding L1 L2 L3 L4 L5 N1 N2 D1
+
+exit $failed
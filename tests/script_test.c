@@ -0,0 +1,178 @@
+// Runs a script through the lexer, parser and semantic analysis, executes
+// its top-level assignments the way execute_assignment does, and prints the
+// named symbols. Each right-hand side is evaluated both on its compiled
+// program (when it has one) and on the tree walker; a difference fails the run.
+//
+//   script_test script.tab NAME...
+
+#include "utility.h"
+#include "LexicalAnalysis.h"
+#include "syntaxanalysis.h"
+#include "semantic_analysis.h"
+#include "bytecode.h"
+
+static char* read_file(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    rewind(f);
+    char* buf = malloc((size_t)n + 1);
+    if (buf && fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        free(buf);
+        buf = NULL;
+    }
+    if (buf) buf[n] = '\0';
+    fclose(f);
+    return buf;
+}
+
+static void format_value(char* buf, size_t size, int status, const Variable* v)
+{
+    if (status != 0 || !v) snprintf(buf, size, "<error>");
+    else if (v->type == TYPE_DOUBLE) snprintf(buf, size, "%.15g", v->data.double_value);
+    else if (v->type == TYPE_STRING) snprintf(buf, size, "\"%s\"", v->data.string_value ? v->data.string_value : "");
+    else if (v->type == TYPE_INTEGER || v->type == TYPE_BOOL) snprintf(buf, size, "%d", v->data.int_value);
+    else snprintf(buf, size, "<type %d>", v->type);
+}
+
+static void release(int status, Variable* v)
+{
+    if (status == 0 && v) free_variable(v);
+}
+
+static int count_op(const ExprProgram* prog, ExprOpcode op)
+{
+    int n = 0;
+    for (size_t i = 0; prog && i < prog->code_count; i++) {
+        if (prog->code[i].op == op) n++;
+    }
+    return n;
+}
+
+// The coercions of execute_assignment (ScriptExecutor.c), which needs the UI
+// and cannot be linked here
+static int assign(AssignmentNode* node, SymbolTable* st)
+{
+    const char* name = node->lhs->data.string_val;
+    Variable* dst = node->lhs_slot ? get_symbol_at(st, node->lhs_slot) : get_symbol(st, name);
+    if (!dst) return -1;
+
+    if (dst->type == TYPE_STRING) {
+        char* text = NULL;
+        if (evaluate_to_string(node->rhs, st, &text) != 0 || !text) return -1;
+        free(dst->data.string_value);
+        dst->data.string_value = text;
+        touch_symbol(st, name);
+        return 0;
+    }
+
+    EpaValue rhs;
+    if (evaluate_value(node->rhs, st, &rhs) != 0) return -1;
+    switch (dst->type) {
+    case TYPE_INTEGER:
+    case TYPE_BOOL:
+        if (rhs.type == TYPE_INTEGER || rhs.type == TYPE_BOOL) dst->data.int_value = rhs.data.int_value;
+        else if (rhs.type == TYPE_DOUBLE) dst->data.int_value = (int)rhs.data.double_value;
+        else return -1;
+        break;
+    case TYPE_DOUBLE:
+        if (epa_to_double(&rhs, &dst->data.double_value) != 0) return -1;
+        break;
+    default:
+        return -1;
+    }
+    touch_symbol(st, name);
+    return 0;
+}
+
+// A string target takes the concatenating evaluate_to_string, like execute_assignment
+static void evaluate_text(ExpressionNode* expr, SymbolTable* st, int as_string, char* buf, size_t size)
+{
+    if (as_string) {
+        char* text = NULL;
+        if (evaluate_to_string(expr, st, &text) == 0 && text) snprintf(buf, size, "\"%s\"", text);
+        else snprintf(buf, size, "<error>");
+        free(text);
+        return;
+    }
+    Variable* v = NULL;
+    int status = evaluate_expression(expr, st, &v);
+    format_value(buf, size, status, v);
+    release(status, v);
+}
+
+static int run_assignment(AssignmentNode* node, SymbolTable* st)
+{
+    ExprProgram* prog = node->rhs->program;
+    Variable* dst = node->lhs_slot ? get_symbol_at(st, node->lhs_slot) : get_symbol(st, node->lhs->data.string_val);
+    int as_string = dst && dst->type == TYPE_STRING;
+    char vm_text[512], tree_text[512];
+
+    evaluate_text(node->rhs, st, as_string, vm_text, sizeof vm_text);
+    node->rhs->program = NULL;
+    evaluate_text(node->rhs, st, as_string, tree_text, sizeof tree_text);
+    node->rhs->program = prog;
+
+    printf("%s := %s  [%s, %d field read(s)]\n", node->lhs->data.string_val, vm_text,
+        prog ? "vm" : "tree", count_op(prog, EOP_FIELD));
+    if (strcmp(vm_text, tree_text) != 0) {
+        printf("MISMATCH: tree walker gives %s\n", tree_text);
+        return -1;
+    }
+    if (assign(node, st) != 0) {
+        printf("FAILED to assign %s\n", node->lhs->data.string_val);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: script_test script.tab NAME...\n");
+        return 2;
+    }
+    char* text = read_file(argv[1]);
+    if (!text) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 2;
+    }
+
+    Lexer lexer = { 0 };
+    lexer_init(&lexer, text, strlen(text));
+    if (lex(&lexer) != 0) {
+        printf("lex failed\n");
+        return 1;
+    }
+    SymbolTable* st = create_symbol_table();
+    BlockList blocks = parse_blocks(&lexer, st);
+    if (blocks.block_count == 0 || perform_semantic_analysis(&blocks, st) != 0) {
+        printf("analysis failed\n");
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t b = 0; b < blocks.block_count; b++) {
+        Block* block = &blocks.blocks[b];
+        for (size_t i = 0; i < block->command_count; i++) {
+            CommandNode* cmd = block->commands[i];
+            if (cmd && cmd->type == COMMAND_ASSIGNMENT && run_assignment(&((CommandData*)cmd->data)->assignment, st) != 0)
+                failed = 1;
+        }
+    }
+
+    for (int i = 2; i < argc; i++) {
+        char value[512];
+        Variable* v = get_symbol(st, argv[i]);
+        format_value(value, sizeof value, v ? 0 : -1, v);
+        printf("%s = %s\n", argv[i], value);
+    }
+
+    free_symbol_table(st);
+    free_block_list(&blocks);
+    free_lexer(&lexer);
+    free(text);
+    return failed;
+}
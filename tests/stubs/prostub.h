@@ -0,0 +1,156 @@
+#ifndef PROSTUB_H
+#define PROSTUB_H
+
+// Stand-ins for the Creo Toolkit and Windows SDK declarations the platform-
+// independent engine uses, so it builds with a host C compiler for the tests
+// (see tests/run_tests.sh). Force-included ahead of every source; the SDK
+// headers themselves are replaced by empty files.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+#include <stdarg.h>
+
+typedef int ProError;
+typedef int ProType;
+typedef int ProBoolean;
+typedef void* ProSelection;
+typedef void* ProAppData;
+typedef wchar_t ProName[32];
+typedef wchar_t ProLine[81];
+typedef void* ProMdl;
+typedef void* ProSolid;
+typedef void* ProAsmcomp;
+typedef void* ProArray;
+typedef struct {
+    int horz_cells, vert_cells, attach_bottom, attach_top, attach_left, attach_right, horz_resize, vert_resize;
+    int row, column, left_offset, top_offset, right_offset, bottom_offset;
+} ProUIGridopts;
+typedef void* ProFileName;
+typedef void* ProPath;
+typedef int ProUIMessageButton;
+typedef char* ProCharPath;
+typedef struct { int type; int id; void* owner; } ProModelitem;
+typedef ProModelitem ProFeature;
+typedef ProModelitem ProGeomitem;
+typedef void* ProParameter;
+typedef void* ProParamvalue;
+typedef void* ProUdfdata;
+typedef void* ProAxis;
+typedef void* ProCsys;
+typedef void* ProSurface;
+typedef void* ProEdge;
+typedef void* ProPoint;
+typedef void* ProCurve;
+typedef void* ProQuilt;
+typedef double ProMatrix[4][4];
+typedef double ProVector[3];
+typedef double ProPoint3d[3];
+typedef void* ProAsmcomppath;
+typedef void* ProValue;
+typedef void* ProWindow;
+typedef int ProUIColorType;
+typedef void* ProReference;
+typedef void* ProUdfvardim;
+typedef int ProUIRectangle[4];
+typedef int ProUIPoint[2];
+
+#define PRO_TK_NO_ERROR 0
+#define PRO_TK_GENERAL_ERROR -1
+#define PRO_TK_BAD_INPUTS -2
+#define PRO_TK_E_NOT_FOUND -4
+#define PRO_TK_USER_ABORT -5
+#define PRO_B_TRUE 1
+#define PRO_B_FALSE 0
+#define PRO_VALUE_UNUSED -1
+#define PRO_UI_INSERT_NEW_ROW -1
+#define PRO_UI_INSERT_NEW_COLUMN -1
+enum {
+    PRO_ASSEMBLY = 1, PRO_AXIS, PRO_CURVE, PRO_EDGE, PRO_SURFACE, PRO_DATUM_PLANE, PRO_PART, PRO_FEATURE,
+    PRO_CSYS, PRO_POINT, PRO_TK_CANT_ACCESS = -20, PRO_TK_NOT_FOUND = -21
+};
+
+// Windows types and the CRT "secure" functions
+typedef void* HANDLE;
+typedef unsigned long DWORD;
+typedef int BOOL;
+typedef long LONG;
+typedef void* LPVOID;
+typedef int errno_t;
+typedef unsigned long long ULONGLONG;
+typedef union { struct { unsigned long LowPart; long HighPart; } u; long long QuadPart; } LARGE_INTEGER;
+typedef struct { DWORD dwPageSize; DWORD dwAllocationGranularity; } SYSTEM_INFO;
+typedef struct { void* impl; } CRITICAL_SECTION;
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+
+#define WINAPI
+#ifndef FALSE
+#define FALSE 0
+#define TRUE 1
+#endif
+#define CP_UTF8 65001
+#define _TRUNCATE ((size_t)-1)
+#define MAX_PATH 260
+#define INFINITE 0xffffffffu
+#define INVALID_HANDLE_VALUE ((HANDLE)(long)-1)
+#define GENERIC_READ 0x80000000u
+#define FILE_SHARE_READ 1
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+#define MAXDWORD 0xffffffffu
+
+#define _strdup strdup
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+wchar_t* _wcsdup(const wchar_t* s);
+int _snprintf_s(char* buf, size_t size, size_t count, const char* format, ...);
+int sprintf_s(char* buf, size_t size, const char* format, ...);
+int vsnprintf_s(char* buf, size_t size, size_t count, const char* format, va_list args);
+int _vsnprintf_s(char* buf, size_t size, size_t count, const char* format, va_list args);
+int strcpy_s(char* dst, size_t size, const char* src);
+int strncpy_s(char* dst, size_t size, const char* src, size_t count);
+int strcat_s(char* dst, size_t size, const char* src);
+int strncat_s(char* dst, size_t size, const char* src, size_t count);
+int strerror_s(char* buf, size_t size, int err);
+int fopen_s(FILE** file, const char* path, const char* mode);
+int _wfopen_s(FILE** file, const wchar_t* path, const wchar_t* mode);
+int MultiByteToWideChar(unsigned code_page, unsigned long flags, const char* src, int src_len, wchar_t* dst, int dst_len);
+int WideCharToMultiByte(unsigned code_page, unsigned long flags, const wchar_t* src, int src_len,
+    char* dst, int dst_len, const char* default_char, int* used_default);
+
+HANDLE CreateFileW(const wchar_t* path, DWORD access, DWORD share, void* security, DWORD disposition, DWORD flags, HANDLE templ);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size);
+void GetSystemInfo(SYSTEM_INFO* info);
+BOOL ReadFile(HANDLE file, void* buf, DWORD size, DWORD* read, void* overlapped);
+HANDLE CreateFileMappingW(HANDLE file, void* security, DWORD protect, DWORD size_high, DWORD size_low, const wchar_t* name);
+void* MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high, DWORD offset_low, size_t size);
+BOOL UnmapViewOfFile(const void* view);
+BOOL CloseHandle(HANDLE handle);
+
+LONG InterlockedCompareExchange(volatile LONG* target, LONG value, LONG comparand);
+LONG InterlockedExchange(volatile LONG* target, LONG value);
+LONG InterlockedIncrement(volatile LONG* target);
+LONG InterlockedDecrement(volatile LONG* target);
+void InitializeCriticalSection(CRITICAL_SECTION* cs);
+void DeleteCriticalSection(CRITICAL_SECTION* cs);
+void EnterCriticalSection(CRITICAL_SECTION* cs);
+void LeaveCriticalSection(CRITICAL_SECTION* cs);
+HANDLE CreateEventW(void* security, BOOL manual_reset, BOOL initial, const wchar_t* name);
+BOOL SetEvent(HANDLE event);
+DWORD WaitForSingleObject(HANDLE handle, DWORD ms);
+HANDLE CreateThread(void* security, size_t stack, LPTHREAD_START_ROUTINE proc, LPVOID param, DWORD flags, DWORD* id);
+void Sleep(DWORD ms);
+DWORD GetEnvironmentVariableA(const char* name, char* buf, DWORD size);
+
+// Toolkit calls the engine makes outside utility.c
+ProError ProMessageDisplay(wchar_t* file, const char* key, ...);
+ProError ProWstringToString(char* dst, wchar_t* src);
+ProError ProStringToWstring(wchar_t* dst, char* src);
+ProError ProSelectionFree(ProSelection* sel);
+
+#endif // !PROSTUB_H
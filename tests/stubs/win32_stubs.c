@@ -0,0 +1,366 @@
+// Host implementations of the Toolkit, CRT and Win32 calls declared in
+// prostub.h. Files map through mmap, threads and events through pthreads.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+ProError ProMessageDisplay(wchar_t* file, const char* key, ...)
+{
+    (void)file;
+    (void)key;
+    return PRO_TK_NO_ERROR;
+}
+
+ProError ProWstringToString(char* dst, wchar_t* src)
+{
+    if (dst) wcstombs(dst, src, MAX_PATH);
+    return PRO_TK_NO_ERROR;
+}
+
+ProError ProStringToWstring(wchar_t* dst, char* src)
+{
+    if (dst) mbstowcs(dst, src, MAX_PATH);
+    return PRO_TK_NO_ERROR;
+}
+
+ProError ProSelectionFree(ProSelection* sel)
+{
+    if (sel) *sel = NULL;
+    return PRO_TK_NO_ERROR;
+}
+
+// Called by the declaration checks but not defined anywhere in the tree
+void st_baseline_remember(void* st, const char* name, void* var)
+{
+    (void)st;
+    (void)name;
+    (void)var;
+}
+
+wchar_t* _wcsdup(const wchar_t* s)
+{
+    size_t n = wcslen(s) + 1;
+    wchar_t* d = malloc(n * sizeof(wchar_t));
+    if (d) wmemcpy(d, s, n);
+    return d;
+}
+
+int _snprintf_s(char* buf, size_t size, size_t count, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int r = _vsnprintf_s(buf, size, count, format, args);
+    va_end(args);
+    return r;
+}
+
+int sprintf_s(char* buf, size_t size, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int r = vsnprintf(buf, size, format, args);
+    va_end(args);
+    return r;
+}
+
+int vsnprintf_s(char* buf, size_t size, size_t count, const char* format, va_list args)
+{
+    return _vsnprintf_s(buf, size, count, format, args);
+}
+
+int _vsnprintf_s(char* buf, size_t size, size_t count, const char* format, va_list args)
+{
+    size_t limit = (count == _TRUNCATE || count >= size) ? size : count + 1;
+    int r = vsnprintf(buf, limit, format, args);
+    return (r >= 0 && (size_t)r < limit) ? r : -1;
+}
+
+int strcpy_s(char* dst, size_t size, const char* src)
+{
+    return strncpy_s(dst, size, src, _TRUNCATE);
+}
+
+int strncpy_s(char* dst, size_t size, const char* src, size_t count)
+{
+    size_t n = strlen(src);
+    if (size == 0) return EINVAL;
+    if (n > count) n = count;
+    if (n >= size) n = size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+    return 0;
+}
+
+int strcat_s(char* dst, size_t size, const char* src)
+{
+    return strncat_s(dst, size, src, _TRUNCATE);
+}
+
+int strncat_s(char* dst, size_t size, const char* src, size_t count)
+{
+    size_t used = strnlen(dst, size);
+    if (used >= size) return EINVAL;
+    return strncpy_s(dst + used, size - used, src, count);
+}
+
+int strerror_s(char* buf, size_t size, int err)
+{
+    return strncpy_s(buf, size, strerror(err), _TRUNCATE);
+}
+
+int fopen_s(FILE** file, const char* path, const char* mode)
+{
+    *file = fopen(path, mode);
+    return *file ? 0 : errno;
+}
+
+int _wfopen_s(FILE** file, const wchar_t* path, const wchar_t* mode)
+{
+    char p[MAX_PATH * 4], m[16];
+    wcstombs(p, path, sizeof p);
+    wcstombs(m, mode, sizeof m);
+    return fopen_s(file, p, m);
+}
+
+// Code points below 0x80 only, which is all the tests feed through
+int MultiByteToWideChar(unsigned code_page, unsigned long flags, const char* src, int src_len, wchar_t* dst, int dst_len)
+{
+    (void)code_page;
+    (void)flags;
+    int n = src_len < 0 ? (int)strlen(src) + 1 : src_len;
+    if (!dst) return n;
+    for (int i = 0; i < n && i < dst_len; i++) dst[i] = (unsigned char)src[i];
+    return n;
+}
+
+int WideCharToMultiByte(unsigned code_page, unsigned long flags, const wchar_t* src, int src_len,
+    char* dst, int dst_len, const char* default_char, int* used_default)
+{
+    (void)code_page;
+    (void)flags;
+    (void)default_char;
+    if (used_default) *used_default = 0;
+    int n = src_len < 0 ? (int)wcslen(src) + 1 : src_len;
+    if (!dst) return n;
+    for (int i = 0; i < n && i < dst_len; i++) dst[i] = (char)src[i];
+    return n;
+}
+
+// File handles are fd + 1 so that 0 is never a valid handle; a mapping
+// handle is the file handle itself
+static size_t s_map_length;
+
+HANDLE CreateFileW(const wchar_t* path, DWORD access, DWORD share, void* security, DWORD disposition, DWORD flags, HANDLE templ)
+{
+    char p[MAX_PATH * 4];
+    (void)access; (void)share; (void)security; (void)disposition; (void)flags; (void)templ;
+    wcstombs(p, path, sizeof p);
+    int fd = open(p, O_RDONLY);
+    return fd < 0 ? INVALID_HANDLE_VALUE : (HANDLE)(intptr_t)(fd + 1);
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+    struct stat st;
+    if (fstat((int)(intptr_t)file - 1, &st) != 0) return FALSE;
+    size->QuadPart = st.st_size;
+    return TRUE;
+}
+
+void GetSystemInfo(SYSTEM_INFO* info)
+{
+    info->dwPageSize = (DWORD)sysconf(_SC_PAGESIZE);
+    info->dwAllocationGranularity = 65536;
+}
+
+BOOL ReadFile(HANDLE file, void* buf, DWORD size, DWORD* read_count, void* overlapped)
+{
+    (void)overlapped;
+    ssize_t r = read((int)(intptr_t)file - 1, buf, size);
+    if (r < 0) return FALSE;
+    *read_count = (DWORD)r;
+    return TRUE;
+}
+
+HANDLE CreateFileMappingW(HANDLE file, void* security, DWORD protect, DWORD size_high, DWORD size_low, const wchar_t* name)
+{
+    (void)security; (void)protect; (void)size_high; (void)size_low; (void)name;
+    return file;
+}
+
+void* MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high, DWORD offset_low, size_t size)
+{
+    struct stat st;
+    int fd = (int)(intptr_t)mapping - 1;
+    (void)access; (void)offset_high; (void)offset_low; (void)size;
+    if (fstat(fd, &st) != 0) return NULL;
+    s_map_length = (size_t)st.st_size;
+    void* view = mmap(NULL, s_map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    return view == MAP_FAILED ? NULL : view;
+}
+
+BOOL UnmapViewOfFile(const void* view)
+{
+    return munmap((void*)view, s_map_length) == 0;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    (void)handle;
+    return TRUE;
+}
+
+LONG InterlockedCompareExchange(volatile LONG* target, LONG value, LONG comparand)
+{
+    return __sync_val_compare_and_swap(target, comparand, value);
+}
+
+LONG InterlockedExchange(volatile LONG* target, LONG value)
+{
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+LONG InterlockedIncrement(volatile LONG* target)
+{
+    return __sync_add_and_fetch(target, 1);
+}
+
+LONG InterlockedDecrement(volatile LONG* target)
+{
+    return __sync_sub_and_fetch(target, 1);
+}
+
+void InitializeCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutex_t* m = malloc(sizeof *m);
+    pthread_mutex_init(m, NULL);
+    cs->impl = m;
+}
+
+void DeleteCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutex_destroy(cs->impl);
+    free(cs->impl);
+    cs->impl = NULL;
+}
+
+// Entering a deleted section is undefined on Windows; fail loudly here
+void EnterCriticalSection(CRITICAL_SECTION* cs)
+{
+    if (!cs->impl) {
+        fprintf(stderr, "EnterCriticalSection on a deleted critical section\n");
+        abort();
+    }
+    pthread_mutex_lock(cs->impl);
+}
+
+void LeaveCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutex_unlock(cs->impl);
+}
+
+typedef enum { HANDLE_EVENT = 1, HANDLE_THREAD } HandleKind;
+
+typedef struct {
+    HandleKind kind;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int signaled;
+    pthread_t thread;
+    LPTHREAD_START_ROUTINE proc;
+    LPVOID param;
+} StubHandle;
+
+HANDLE CreateEventW(void* security, BOOL manual_reset, BOOL initial, const wchar_t* name)
+{
+    (void)security; (void)manual_reset; (void)name;
+    StubHandle* h = calloc(1, sizeof *h);
+    h->kind = HANDLE_EVENT;
+    h->signaled = initial;
+    pthread_mutex_init(&h->lock, NULL);
+    pthread_cond_init(&h->cond, NULL);
+    return h;
+}
+
+BOOL SetEvent(HANDLE event)
+{
+    StubHandle* h = event;
+    pthread_mutex_lock(&h->lock);
+    h->signaled = 1;
+    pthread_cond_signal(&h->cond);
+    pthread_mutex_unlock(&h->lock);
+    return TRUE;
+}
+
+// Auto-reset events only; a thread handle waits for the thread to exit
+DWORD WaitForSingleObject(HANDLE handle, DWORD ms)
+{
+    StubHandle* h = handle;
+    if (h->kind == HANDLE_THREAD) {
+        pthread_join(h->thread, NULL);
+        return 0;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+
+    DWORD rc = 0;
+    pthread_mutex_lock(&h->lock);
+    while (!h->signaled) {
+        if (ms != INFINITE) {
+            if (pthread_cond_timedwait(&h->cond, &h->lock, &ts) == ETIMEDOUT) { rc = 0x102; break; }
+        }
+        else {
+            pthread_cond_wait(&h->cond, &h->lock);
+        }
+    }
+    h->signaled = 0;
+    pthread_mutex_unlock(&h->lock);
+    return rc;
+}
+
+static void* thread_trampoline(void* arg)
+{
+    StubHandle* h = arg;
+    h->proc(h->param);
+    return NULL;
+}
+
+HANDLE CreateThread(void* security, size_t stack, LPTHREAD_START_ROUTINE proc, LPVOID param, DWORD flags, DWORD* id)
+{
+    (void)security; (void)stack; (void)flags;
+    StubHandle* h = calloc(1, sizeof *h);
+    h->kind = HANDLE_THREAD;
+    h->proc = proc;
+    h->param = param;
+    if (id) *id = 0;
+    pthread_create(&h->thread, NULL, thread_trampoline, h);
+    return h;
+}
+
+void Sleep(DWORD ms)
+{
+    if (ms == 0) sched_yield();
+    else usleep(ms * 1000);
+}
+
+DWORD GetEnvironmentVariableA(const char* name, char* buf, DWORD size)
+{
+    const char* v = getenv(name);
+    if (!v) return 0;
+    size_t n = strlen(v);
+    if (n >= size) return (DWORD)(n + 1);
+    memcpy(buf, v, n + 1);
+    return (DWORD)n;
+}
@@ -0,0 +1,171 @@
+// Differential test of the expression VM against the tree walker.
+//
+// Generates random expressions over a fixed set of variables, evaluates each
+// one with the tree walker (no compiled program attached) and again through
+// the bytecode program expr_compile builds, and fails on any difference in
+// status, result type or value.
+//
+//   vm_difftest [iterations] [seed]
+
+#include "utility.h"
+#include "LexicalAnalysis.h"
+#include "syntaxanalysis.h"
+#include "semantic_analysis.h"
+#include "bytecode.h"
+
+ExpressionNode* parse_expression(Lexer* lexer, size_t* i, SymbolTable* st);
+void free_expression(ExpressionNode* expr);
+
+static unsigned long long s_rng = 88172645463325252ull;
+
+static unsigned rnd(unsigned n)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (unsigned)(s_rng % n);
+}
+
+// Leaves cover every operand type, the empty string, numeric strings and the
+// builtins whose argument coercion differs between integer and double
+static const char* s_atoms[] = {
+    "sqrt(I)", "abs(-D)", "pow(D, 2)", "strlen(S)", "stoi(N)", "round(D, 0)", "equal(D, 2.5, 1)",
+    "-I", "-(D)", "1", "0", "2", "-3", "7", "1.5", "0.0", "2.0", "1e-10", "3.0000000001", "10",
+    "\"\"", "\"abc\"", "\"1\"", "\"2.5\"", "I", "J", "D", "E", "S", "N", "Z", "B", "U", "A"
+};
+
+static const char* s_ops[] = {
+    " + ", " - ", " * ", " / ", " == ", " <> ", " < ", " > ", " <= ", " >= ", " AND ", " OR "
+};
+
+static void generate(char* out, size_t size, int depth)
+{
+    if (depth <= 0 || rnd(3) == 0) {
+        strncat(out, s_atoms[rnd(sizeof s_atoms / sizeof *s_atoms)], size - strlen(out) - 1);
+        return;
+    }
+    strncat(out, "(", size - strlen(out) - 1);
+    generate(out, size, depth - 1);
+    strncat(out, s_ops[rnd(sizeof s_ops / sizeof *s_ops)], size - strlen(out) - 1);
+    generate(out, size, depth - 1);
+    strncat(out, ")", size - strlen(out) - 1);
+}
+
+static void define(SymbolTable* st, const char* name, VariableType type, int i, double d, const char* s)
+{
+    Variable* v = calloc(1, sizeof *v);
+    v->type = type;
+    if (type == TYPE_DOUBLE) v->data.double_value = d;
+    else if (type == TYPE_STRING) v->data.string_value = _strdup(s);
+    else if (type != TYPE_ARRAY) v->data.int_value = i;
+    set_symbol(st, name, v);
+}
+
+static int same_result(int s1, const Variable* a, int s2, const Variable* b)
+{
+    if (s1 != s2) return 0;
+    if (s1 != 0) return 1;
+    if (a->type != b->type) return 0;
+
+    switch (a->type) {
+    case TYPE_INTEGER:
+    case TYPE_BOOL:
+        return a->data.int_value == b->data.int_value;
+    case TYPE_DOUBLE:
+        // Bitwise, so -0.0 against 0.0 counts; any NaN matches any NaN
+        return memcmp(&a->data.double_value, &b->data.double_value, sizeof(double)) == 0 ||
+            (a->data.double_value != a->data.double_value && b->data.double_value != b->data.double_value);
+    case TYPE_STRING:
+        if (!a->data.string_value || !b->data.string_value)
+            return a->data.string_value == b->data.string_value;
+        return strcmp(a->data.string_value, b->data.string_value) == 0;
+    default:
+        return 1;
+    }
+}
+
+static void describe(char* buf, size_t size, int status, const Variable* v)
+{
+    if (status != 0) snprintf(buf, size, "error %d", status);
+    else if (v->type == TYPE_DOUBLE) snprintf(buf, size, "double %.17g", v->data.double_value);
+    else if (v->type == TYPE_STRING) snprintf(buf, size, "string \"%s\"", v->data.string_value ? v->data.string_value : "");
+    else if (v->type == TYPE_INTEGER || v->type == TYPE_BOOL) snprintf(buf, size, "type %d %d", v->type, v->data.int_value);
+    else snprintf(buf, size, "type %d", v->type);
+}
+
+// An array operand comes back as a shallow copy of the symbol
+static void release(int status, Variable* v)
+{
+    if (status != 0 || !v) return;
+    if (v->type == TYPE_ARRAY) free(v);
+    else free_variable(v);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    if (argc > 2) s_rng = strtoull(argv[2], NULL, 10) | 1;
+
+    SymbolTable* st = create_symbol_table();
+    define(st, "I", TYPE_INTEGER, 4, 0, NULL);
+    define(st, "J", TYPE_INTEGER, 0, 0, NULL);
+    define(st, "D", TYPE_DOUBLE, 0, 2.5, NULL);
+    define(st, "E", TYPE_DOUBLE, 0, 0.0, NULL);
+    define(st, "S", TYPE_STRING, 0, 0, "abc");
+    define(st, "N", TYPE_STRING, 0, 0, "4");
+    define(st, "Z", TYPE_STRING, 0, 0, "");
+    define(st, "B", TYPE_BOOL, 1, 0, NULL);
+    define(st, "A", TYPE_ARRAY, 0, 0, NULL);
+
+    Arena* arena = arena_create(1 << 16);
+    int compiled = 0, mismatches = 0;
+
+    for (int it = 0; it < iterations; it++) {
+        char src[4096] = { 0 };
+        generate(src, sizeof src, 1 + (int)rnd(5));
+
+        Lexer lexer = { 0 };
+        lexer_init(&lexer, src, strlen(src));
+        if (lex(&lexer) != 0) {
+            free_lexer(&lexer);
+            continue;
+        }
+        size_t pos = 0;
+        ExpressionNode* expr = parse_expression(&lexer, &pos, st);
+        if (!expr || pos + 1 != lexer.token_count) {
+            if (expr) free_expression(expr);
+            free_lexer(&lexer);
+            continue;
+        }
+
+        expr->program = NULL;
+        Variable* tree = NULL;
+        int tree_status = evaluate_expression(expr, st, &tree);
+
+        expr->program = expr_compile(arena, expr, st);
+        if (expr->program) {
+            compiled++;
+            Variable* vm = NULL;
+            int vm_status = evaluate_expression(expr, st, &vm);
+            if (!same_result(tree_status, tree, vm_status, vm)) {
+                char a[256], b[256];
+                describe(a, sizeof a, tree_status, tree);
+                describe(b, sizeof b, vm_status, vm);
+                printf("MISMATCH %s\n  tree: %s\n  vm:   %s\n", src, a, b);
+                mismatches++;
+            }
+            release(vm_status, vm);
+        }
+        release(tree_status, tree);
+
+        expr->program = NULL;
+        free_expression(expr);
+        free_lexer(&lexer);
+    }
+
+    printf("vm_difftest: %d expressions compiled, %d mismatches\n", compiled, mismatches);
+
+    arena_destroy(arena);
+    free_symbol_table(st);
+    return mismatches == 0 && compiled > 0 ? 0 : 1;
+}
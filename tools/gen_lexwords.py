@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Regenerate the reserved word perfect hash in LexicalAnalysis.c.
+
+Reads the s_words table (LexicalAnalysis.c) and checks it against the LexWord
+enum (LexicalAnalysis.h), then searches the smallest seed for which the hash
+lex_word computes puts every word in its own slot and rewrites
+WORD_HASH_SEED, WORD_HASH_SIZE and s_word_slots in place.
+
+To add a word: append WORD_<NAME> before WORD_COUNT in LexicalAnalysis.h, add
+its { "<NAME>", <length>, <classes> } entry at the same position of s_words,
+then run this script from any directory.
+"""
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+SOURCE = os.path.join(ROOT, "LexicalAnalysis.c")
+HEADER = os.path.join(ROOT, "LexicalAnalysis.h")
+
+FNV_PRIME = 16777619
+SIZES = (512, 1024, 2048)      # Table sizes tried in order
+MAX_SEED = 1 << 20
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read().decode("ascii")
+
+
+def word_hash(seed, word, size):
+    # Must match lex_word: FNV-1a from the seed, bits 8 and up index the table
+    h = seed
+    for c in word.encode("ascii"):
+        h = ((h ^ c) * FNV_PRIME) & 0xFFFFFFFF
+    return (h >> 8) & (size - 1)
+
+
+def load_words(source, header):
+    table = re.search(r"s_words\[WORD_COUNT\] = \{(.*?)\n\};", source, re.S)
+    if not table:
+        sys.exit("s_words table not found in LexicalAnalysis.c")
+    entries = re.findall(r'\{ "([A-Z_]*)", (\d+), [^}]*\}', table.group(1))
+    enum = re.search(r"WORD_NONE = 0,(.*?)WORD_COUNT", header, re.S)
+    if not enum:
+        sys.exit("LexWord enum not found in LexicalAnalysis.h")
+    names = re.findall(r"WORD_([A-Z_]+),", enum.group(1))
+
+    if not entries or entries[0] != ("", "0"):
+        sys.exit("s_words must start with the WORD_NONE entry { \"\", 0, 0 }")
+    words = [text for text, _ in entries[1:]]
+    if words != names:
+        for i, (w, n) in enumerate(zip(words, names), 1):
+            if w != n:
+                sys.exit("s_words[%d] is \"%s\" but LexWord %d is WORD_%s" % (i, w, i, n))
+        sys.exit("s_words has %d words, LexWord has %d" % (len(words), len(names)))
+    for text, length in entries[1:]:
+        if int(length) != len(text):
+            sys.exit("s_words entry \"%s\" has length %s, expected %d" % (text, length, len(text)))
+    if len(words) > 255:
+        sys.exit("s_word_slots holds unsigned char IDs; %d words do not fit" % len(words))
+    return words
+
+
+def search(words):
+    for size in SIZES:
+        for seed in range(MAX_SEED):
+            slots = [0] * size
+            for i, w in enumerate(words, 1):
+                k = word_hash(seed, w, size)
+                if slots[k]:
+                    break
+                slots[k] = i
+            else:
+                return seed, size, slots
+    sys.exit("no collision-free seed below %d for table sizes %s" % (MAX_SEED, SIZES))
+
+
+def main():
+    source = read(SOURCE)
+    words = load_words(source, read(HEADER))
+    seed, size, slots = search(words)
+
+    rows = []
+    for r in range(0, size, 16):
+        rows.append("    " + " ".join("%2d," % v for v in slots[r:r + 16]))
+    text = source.replace("\r\n", "\n")
+    text, n = re.subn(
+        r"#define WORD_HASH_SEED \d+u\n#define WORD_HASH_SIZE \d+\n\n"
+        r"static const unsigned char s_word_slots\[WORD_HASH_SIZE\] = \{\n.*?\n\};",
+        lambda m: "#define WORD_HASH_SEED %du\n#define WORD_HASH_SIZE %d\n\n"
+                  "static const unsigned char s_word_slots[WORD_HASH_SIZE] = {\n%s\n};"
+                  % (seed, size, "\n".join(rows)),
+        text, count=1, flags=re.S)
+    if n != 1:
+        sys.exit("WORD_HASH_SEED / s_word_slots block not found in LexicalAnalysis.c")
+    with open(SOURCE, "wb") as f:
+        f.write(text.replace("\n", "\r\n").encode("ascii"))
+    print("%d words, seed %d, %d slots" % (len(words), seed, size))
+
+
+if __name__ == "__main__":
+    main()
@@ -42,15 +42,15 @@ void ProPrintf(const wchar_t* format, ...)
 
 	// Add newline if not present
 	size_t len = wcslen(wbuffer);
-	if (len < MAX_MSG_BUFFER_SIZE - 1 && wbuffer[len - 1] != L'\n') {
+	if (len > 0 && len < MAX_MSG_BUFFER_SIZE - 1 && wbuffer[len - 1] != L'\n') {
 		wbuffer[len] = L'\n';
 		wbuffer[len + 1] = L'\0';
 	}
 
-	FILE* log = NULL;
-	if (fopen_s(&log, "log.txt", "a") == 0) {
-		fwprintf(log, L"%ls\n", wbuffer);
-		fclose(log);
+	if (log_enabled(LOG_LEVEL_INFO)) {
+		char utf8[MAX_MSG_BUFFER_SIZE];
+		if (WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8, MAX_MSG_BUFFER_SIZE, NULL, NULL) > 0)
+			log_write(LOG_LEVEL_INFO, "%s", utf8);
 	}
 
 	// Convert to multi-byte and display in Creo
@@ -74,57 +74,38 @@ void ProPrintfChar(const char* format, ...)
 		buffer[len + 1] = '\0';
 	}
 
-	FILE* log = NULL;
-	if (fopen_s(&log, "log.txt", "a") == 0) {
-		fprintf(log, "%s", buffer);
-		fclose(log);
-	}
+	LOG_INFO("%s", buffer);
 
 	// Display directly using the char* buffer
 	ProMessageDisplay(wMsgFile, "EmjacParametricAutomation %0s", buffer);
 }
 
+// Log-file-only output at INFO level, queued to the asynchronous logger
 void LogOnlyPrintf(const wchar_t* format, ...)
 {
+	if (!log_enabled(LOG_LEVEL_INFO))
+		return;
+
 	wchar_t wbuffer[MAX_MSG_BUFFER_SIZE];
+	char buffer[MAX_MSG_BUFFER_SIZE];
 	va_list args;
 	va_start(args, format);
 	vswprintf(wbuffer, MAX_MSG_BUFFER_SIZE, format, args);
 	va_end(args);
 
-	// Add newline if not present
-	size_t len = wcslen(wbuffer);
-	if (len < MAX_MSG_BUFFER_SIZE - 1 && wbuffer[len - 1] != L'\n') {
-		wbuffer[len] = L'\n';
-		wbuffer[len + 1] = L'\0';
-	}
-
-	FILE* log = NULL;
-	if (fopen_s(&log, "log.txt", "a") == 0) {
-		fwprintf(log, L"%ls\n", wbuffer);
-		fclose(log);
-	}
+	if (WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, buffer, MAX_MSG_BUFFER_SIZE, NULL, NULL) > 0)
+		log_write(LOG_LEVEL_INFO, "%s", buffer);
 }
 
 void LogOnlyPrintfChar(const char* format, ...)
 {
-	char buffer[MAX_MSG_BUFFER_SIZE];
+	if (!log_enabled(LOG_LEVEL_INFO))
+		return;
+
 	va_list args;
 	va_start(args, format);
-	vsnprintf(buffer, MAX_MSG_BUFFER_SIZE, format, args);
+	log_writev(LOG_LEVEL_INFO, format, args);
 	va_end(args);
-
-	size_t len = strlen(buffer);
-	if (len > 0 && buffer[len - 1] != '\n' && len < MAX_MSG_BUFFER_SIZE - 1) {
-		buffer[len] = '\n';
-		buffer[len + 1] = '\0';
-	}
-
-	FILE* log = NULL;
-	if (fopen_s(&log, "log.txt", "a") == 0) {
-		fprintf(log, "%s", buffer);
-		fclose(log);
-	}
 }
 
 
@@ -382,3 +363,181 @@ static int is_blank_line(const char* s)
 	}
 	return 1;
 }
+
+/*--------------------------------------------------------------------*\
+  Bump arena
+  Each allocation is prefixed by its size so arena_realloc can copy the
+  old contents; the most recent allocation in a block grows in place.
+\*--------------------------------------------------------------------*/
+#define ARENA_ALIGN 8
+#define ARENA_HDR   sizeof(size_t)
+#define ARENA_ROUND(n) (((n) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+
+static ArenaBlock* arena_new_block(Arena* a, size_t min_payload)
+{
+	size_t cap = a->block_size;
+	if (cap < min_payload) cap = min_payload;
+	ArenaBlock* b = (ArenaBlock*)calloc(1, sizeof(ArenaBlock) + cap);
+	if (!b) return NULL;
+	b->capacity = cap;
+	b->next = a->head;
+	a->head = b;
+	a->block_count++;
+	return b;
+}
+
+Arena* arena_create(size_t block_size)
+{
+	Arena* a = (Arena*)calloc(1, sizeof(Arena));
+	if (!a) return NULL;
+	a->block_size = block_size ? ARENA_ROUND(block_size) : 64 * 1024;
+	return a;
+}
+
+void* arena_alloc(Arena* a, size_t size)
+{
+	if (!a) return NULL;
+	size_t need = ARENA_HDR + ARENA_ROUND(size ? size : 1);
+
+	ArenaBlock* b = a->head;
+	if (!b || b->capacity - b->used < need) {
+		b = arena_new_block(a, need);
+		if (!b) return NULL;
+	}
+	unsigned char* p = b->data + b->used;
+	*(size_t*)p = size;
+	b->last = b->used;
+	b->used += need;
+	a->bytes_used += need;
+	return p + ARENA_HDR;
+}
+
+void* arena_realloc(Arena* a, void* ptr, size_t size)
+{
+	if (!ptr) return arena_alloc(a, size);
+	if (!a) return NULL;
+
+	unsigned char* p = (unsigned char*)ptr - ARENA_HDR;
+	size_t old = *(size_t*)p;
+	if (size <= old) {
+		return ptr;
+	}
+
+	/* Most recent allocation of the current block: extend in place */
+	ArenaBlock* b = a->head;
+	if (b && p == b->data + b->last) {
+		size_t need = ARENA_HDR + ARENA_ROUND(size);
+		if (b->last + need <= b->capacity) {
+			a->bytes_used += (b->last + need) - b->used;
+			b->used = b->last + need;
+			*(size_t*)p = size;
+			return ptr;
+		}
+	}
+
+	void* q = arena_alloc(a, size);
+	if (!q) return NULL;
+	memcpy(q, ptr, old);
+	return q;
+}
+
+char* arena_strdup(Arena* a, const char* s)
+{
+	if (!s) return NULL;
+	size_t n = strlen(s) + 1;
+	char* d = (char*)arena_alloc(a, n);
+	if (d) memcpy(d, s, n);
+	return d;
+}
+
+/* Copy of the first n bytes of s, NUL-terminated */
+char* arena_strndup(Arena* a, const char* s, size_t n)
+{
+	if (!s) return NULL;
+	char* d = (char*)arena_alloc(a, n + 1);
+	if (d) {
+		memcpy(d, s, n);
+		d[n] = '\0';
+	}
+	return d;
+}
+
+/* Non-zero if ptr was handed out by this arena */
+int arena_owns(const Arena* a, const void* ptr)
+{
+	if (!a || !ptr) return 0;
+	const unsigned char* p = (const unsigned char*)ptr;
+	for (const ArenaBlock* b = a->head; b; b = b->next) {
+		if (p >= b->data && p < b->data + b->used) return 1;
+	}
+	return 0;
+}
+
+void arena_destroy(Arena* a)
+{
+	if (!a) return;
+	ArenaBlock* b = a->head;
+	while (b) {
+		ArenaBlock* next = b->next;
+		free(b);
+		b = next;
+	}
+	free(a);
+}
+
+/* Map path read-only; returns 0 on success. See MappedFile for the NUL guarantee. */
+int map_file_readonly(const wchar_t* path, MappedFile* out)
+{
+	memset(out, 0, sizeof(*out));
+	out->file = INVALID_HANDLE_VALUE;
+
+	out->file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (out->file == INVALID_HANDLE_VALUE) return -1;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(out->file, &size) || size.QuadPart <= 0 || (ULONGLONG)size.QuadPart >= (SIZE_MAX / 2)) {
+		unmap_file(out);
+		return -1;
+	}
+	out->size = (size_t)size.QuadPart;
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	if (out->size % si.dwPageSize == 0) {
+		/* No slack after the last byte for a terminator: read a copy */
+		out->copy = (char*)malloc(out->size + 1);
+		DWORD got = 0;
+		if (!out->copy || out->size > MAXDWORD ||
+			!ReadFile(out->file, out->copy, (DWORD)out->size, &got, NULL) || got != out->size) {
+			unmap_file(out);
+			return -1;
+		}
+		out->copy[out->size] = '\0';
+		out->data = out->copy;
+		return 0;
+	}
+
+	out->mapping = CreateFileMappingW(out->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!out->mapping) {
+		unmap_file(out);
+		return -1;
+	}
+	out->data = (const char*)MapViewOfFile(out->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!out->data) {
+		unmap_file(out);
+		return -1;
+	}
+	return 0;
+}
+
+void unmap_file(MappedFile* mf)
+{
+	if (!mf) return;
+	if (mf->copy) free(mf->copy);
+	else if (mf->data) UnmapViewOfFile(mf->data);
+	if (mf->mapping) CloseHandle(mf->mapping);
+	if (mf->file != INVALID_HANDLE_VALUE && mf->file != NULL) CloseHandle(mf->file);
+	memset(mf, 0, sizeof(*mf));
+	mf->file = INVALID_HANDLE_VALUE;
+}
@@ -74,6 +74,7 @@
 #include <ProUIInputpanel.h>
 #include <ProCollect.h>
 #include "symboltable.h"
+#include "logging.h"
 
 #define MAX_MSG_BUFFER_SIZE 1024
 
@@ -89,6 +90,34 @@ typedef struct SelMapEntry {
     char* label;
 } SelMapEntry;
 
+// Bump arena: many small allocations released together by arena_destroy.
+// Memory is zero-filled; individual allocations are never freed.
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;          // Bytes handed out from data[]
+    size_t capacity;      // Size of data[]
+    size_t last;          // Offset of the most recent allocation (for in-place growth)
+    unsigned char data[]; // Payload
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;     // Current block (older blocks follow via next)
+    size_t block_size;    // Default payload size for new blocks
+    size_t bytes_used;    // Total bytes handed out (stats)
+    size_t block_count;   // Number of blocks (stats)
+} Arena;
+
+// Read-only view of a whole file. data[size] is always '\0': the zero-filled
+// tail of the last mapped page provides it, and files that end exactly on a
+// page boundary are read into a heap copy instead.
+typedef struct {
+    const char* data;
+    size_t size;
+    HANDLE file;          // INVALID_HANDLE_VALUE when not mapped
+    HANDLE mapping;       // NULL when not mapped
+    char* copy;           // Heap fallback (page-aligned size), else NULL
+} MappedFile;
+
 ProError ProGenericMsg(wchar_t* wMsg);
 void ProPrintf(const wchar_t* format, ...);
 void ProPrintfChar(const char* format, ...);
@@ -103,6 +132,15 @@ int starts_with(const char* str, const char* prefix);
 void selmap_set_path(const char* path);
 int  selmap_reload(void);
 int  selmap_lookup_w(const char* param, wchar_t** out_wlabel);
+Arena* arena_create(size_t block_size);
+void* arena_alloc(Arena* a, size_t size);
+void* arena_realloc(Arena* a, void* ptr, size_t size);
+char* arena_strdup(Arena* a, const char* s);
+char* arena_strndup(Arena* a, const char* s, size_t n);
+int arena_owns(const Arena* a, const void* ptr);
+void arena_destroy(Arena* a);
+int map_file_readonly(const wchar_t* path, MappedFile* out);
+void unmap_file(MappedFile* mf);
 
 
 